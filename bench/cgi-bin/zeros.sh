@@ -0,0 +1,10 @@
+#!/bin/sh
+
+# zeros.sh -- answers with 256 MB of zeros, as fast as the pipe takes them;
+# used by 'make bench-cgi' to measure the throughput of the CGI relay.
+
+size=268435456
+
+printf 'Content-Type: application/octet-stream\r\n'
+printf 'Content-Length: %d\r\n\r\n' $size
+exec head -c $size /dev/zero
@@ -0,0 +1,152 @@
+/*! \file       dates.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Microbenchmark of the date formatting per response.
+ *
+ *  Compares the cost of the timestamps of a single response: the Date and
+ *  Last-Modified header fields and the timestamp of the log entry.  Formerly,
+ *  each of them was formatted with gmtime() and strftime(); now, the Date and
+ *  the log timestamp come from the date cache and Last-Modified is formatted
+ *  once per cached file.  Before measuring, the cached strings are compared
+ *  with the strftime() results for a range of timestamps.
+ *
+ *  Build and run with 'make bench-dates'.
+ *
+ *  Usage: bench_dates [RESPONSES]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "date_cache.h"
+
+#define DEFAULT_RESPONSES   10000000
+
+/* the compiler must not optimize the formatting away */
+static volatile size_t sink;
+
+/* --------------------------------------------------------------------------
+ *  now_ns()
+ * -------------------------------------------------------------------------- */
+static double
+now_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  verify()
+ * -------------------------------------------------------------------------- */
+/*! \brief Compares the cached formatting with strftime().
+ *
+ *  \return  The number of mismatches.
+ */
+static int
+verify(void) {
+
+    char expected[64], buf[HTTP_DATE_SIZE];
+    int errors = 0;
+    time_t t;
+
+    for (t = 0; t < 4102444800; t += 86400 * 7 + 3661) {
+        strftime(expected, sizeof(expected), "%a, %d %b %Y %H:%M:%S GMT",
+                 gmtime(&t));
+        format_http_date(t, buf);
+        errors += (strcmp(expected, buf) != 0);
+        errors += (strcmp(expected, date_cache_http(t)) != 0);
+
+        strftime(expected, sizeof(expected), "%d/%b/%Y:%H:%M:%S %z",
+                 gmtime(&t));
+        errors += (strcmp(expected, date_cache_log(t)) != 0);
+    }
+    return errors;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  bench_strftime(responses, mtime)
+ * -------------------------------------------------------------------------- */
+/*! \brief The timestamps of a response as formatted before the date cache.
+ */
+static double
+bench_strftime(long responses, time_t mtime) {
+
+    char date[64], modified[64], logdate[32];
+    double start = now_ns();
+    long i;
+
+    for (i = 0; i < responses; i++) {
+        time_t now = time(NULL);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT\r\n",
+                 gmtime(&now));
+        strftime(modified, sizeof(modified), "%a, %d %b %Y %H:%M:%S GMT\r\n",
+                 gmtime(&mtime));
+        strftime(logdate, sizeof(logdate), "%d/%b/%Y:%H:%M:%S %z",
+                 gmtime(&now));
+        sink += date[0] + modified[0] + logdate[0];
+    }
+    return (now_ns() - start) / responses;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  bench_cached(responses, mtime)
+ * -------------------------------------------------------------------------- */
+/*! \brief The timestamps of a response with the date cache.
+ */
+static double
+bench_cached(long responses, time_t mtime) {
+
+    char modified[HTTP_DATE_SIZE];
+    double start = now_ns();
+    long i;
+
+    /* formatted once when the file enters the file cache */
+    format_http_date(mtime, modified);
+
+    for (i = 0; i < responses; i++) {
+        time_t now = time(NULL);
+        const char *date    = date_cache_http(now);
+        const char *logdate = date_cache_log(now);
+        sink += date[0] + modified[0] + logdate[0];
+    }
+    return (now_ns() - start) / responses;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  main(argc, argv)
+ * -------------------------------------------------------------------------- */
+int
+main(int argc, char *argv[]) {
+
+    long responses = (argc > 1) ? atol(argv[1]) : DEFAULT_RESPONSES;
+    time_t mtime = time(NULL) - 86400;
+    double before, after;
+    int errors;
+
+    if (responses <= 0) {
+        fprintf(stderr, "Usage: %s [RESPONSES]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((errors = verify()) != 0) {
+        fprintf(stderr, "ERROR: %d timestamps differ from strftime()\n",
+                errors);
+        return EXIT_FAILURE;
+    }
+
+    before = bench_strftime(responses, mtime);
+    after  = bench_cached(responses, mtime);
+
+    printf("%ld responses, timestamps per response:\n", responses);
+    printf("  gmtime() + strftime(): %8.1f ns\n", before);
+    printf("  date cache:            %8.1f ns  (%.1fx faster)\n", after,
+           before / after);
+    return EXIT_SUCCESS;
+}
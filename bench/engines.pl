@@ -0,0 +1,178 @@
+#!/usr/bin/perl
+#
+# Compares the throughput (requests/sec) of the tinyweb engines.
+#
+# For every engine, the server is started on a free port with the files of
+# the web directory, and a number of concurrent clients request all static
+# files in a round-robin fashion (one request per connection, as the fork
+# engine does not support persistent connections) for a fixed duration.
+#
+# Usage: bench/engines.pl [--engines=fork,epoll,uring] [--duration=SEC]
+#                         [--concurrency=N] [--workers=N] [--port=PORT]
+#
+# Build with 'make IO_URING=1' to include the io_uring engine, otherwise it
+# falls back to the fork engine (reported in the output).
+#
+# Only core Perl modules are used.
+
+use strict;
+use warnings;
+
+use File::Find;
+use Getopt::Long;
+use IO::Socket::INET;
+use POSIX qw(:sys_wait_h);
+use Time::HiRes qw(time sleep);
+
+my $engines     = 'fork,epoll,uring';
+my $duration    = 5;
+my $concurrency = 8;
+my $workers     = 0;
+my $port        = 8090;
+my $root        = 'web';
+
+GetOptions('engines=s'     => \$engines,
+           'duration=i'    => \$duration,
+           'concurrency=i' => \$concurrency,
+           'workers=i'     => \$workers,
+           'port=i'        => \$port,
+           'root=s'        => \$root) or die "invalid options\n";
+
+chomp(my $os   = `uname -s`);
+chomp(my $arch = `uname -m`);
+my $server = "./build/${os}_${arch}/tinyweb";
+-x $server or die "ERROR: $server not found, run make first\n";
+
+# all static files below the root directory
+my @urls;
+find(sub {
+    return unless -f $_;
+    return if $File::Find::dir =~ m{/cgi-bin};
+    (my $url = $File::Find::name) =~ s/^\Q$root\E//;
+    push @urls, $url;
+}, $root);
+@urls = sort @urls;
+die "ERROR: no files found in $root\n" unless @urls;
+
+printf "%d files, %d clients, %d s per engine, %s\n\n", scalar(@urls),
+       $concurrency, $duration,
+       $workers > 0 ? "$workers workers" : "no worker pool";
+printf "%-8s %10s %10s %10s\n", 'engine', 'requests', 'req/s', 'MB/s';
+
+foreach my $engine (split /,/, $engines) {
+    my ($pid, $note) = start_server($engine);
+    my ($requests, $bytes, $errors) = run_clients();
+    stop_server($pid);
+
+    printf "%-8s %10d %10.1f %10.2f%s\n", $engine, $requests,
+           $requests / $duration, $bytes / $duration / 1e6,
+           ($errors ? "  ($errors errors)" : '') . ($note ? "  ($note)" : '');
+}
+
+
+# Starts tinyweb with the given engine and waits until it accepts clients.
+sub start_server {
+    my $engine = shift;
+    my $out    = "/tmp/tinyweb_bench_$$.out";
+    my @args   = ('-p', $port, '-d', $root, '-f', '/dev/null', '-e', $engine);
+
+    push @args, ('-w', $workers) if $workers > 0;
+
+    my $pid = fork();
+    die "ERROR: fork(): $!\n" unless defined $pid;
+    if ($pid == 0) {
+        open(STDOUT, '>', $out);
+        open(STDERR, '>&', \*STDOUT);
+        exec($server, @args) or exit(1);
+    }
+
+    for (1 .. 50) {
+        my $s = IO::Socket::INET->new(PeerAddr => "127.0.0.1:$port");
+        if ($s) {
+            close($s);
+            last;
+        }
+        sleep(0.1);
+    }
+
+    my $note = '';
+    if (open(my $fh, '<', $out)) {
+        $note = 'fell back to fork' if grep { /io_uring is not available/ } <$fh>;
+        close($fh);
+    }
+    unlink($out);
+    return ($pid, $note);
+}
+
+
+# Stops the server like a keyboard interrupt would.
+sub stop_server {
+    my $pid = shift;
+
+    kill('INT', $pid);
+    waitpid($pid, 0);
+}
+
+
+# Runs the concurrent clients and sums up their results.
+sub run_clients {
+    my $deadline = time() + $duration;
+    my ($requests, $bytes, $errors) = (0, 0, 0);
+    my @readers;
+
+    for my $i (1 .. $concurrency) {
+        pipe(my $reader, my $writer) or die "ERROR: pipe(): $!\n";
+        my $pid = fork();
+        die "ERROR: fork(): $!\n" unless defined $pid;
+        if ($pid == 0) {
+            close($reader);
+            print $writer join(' ', client($i, $deadline)), "\n";
+            exit(0);
+        }
+        close($writer);
+        push @readers, $reader;
+    }
+
+    foreach my $reader (@readers) {
+        my ($r, $b, $e) = split ' ', (<$reader> || '0 0 1');
+        $requests += $r;
+        $bytes    += $b;
+        $errors   += $e;
+        close($reader);
+    }
+    while (waitpid(-1, WNOHANG) > 0) {}
+    return ($requests, $bytes, $errors);
+}
+
+
+# A single client: one GET request per connection until the deadline.
+sub client {
+    my ($id, $deadline) = @_;
+    my ($requests, $bytes, $errors) = (0, 0, 0);
+    my $n = $id;
+
+    while (time() < $deadline) {
+        my $url = $urls[$n++ % @urls];
+        my $s = IO::Socket::INET->new(PeerAddr => "127.0.0.1:$port");
+        unless ($s) {
+            $errors++;
+            next;
+        }
+        print $s "GET $url HTTP/1.0\r\nHost: localhost\r\n\r\n";
+
+        my ($buf, $len, $response) = ('', 0, '');
+        while (($len = sysread($s, $buf, 65536)) > 0) {
+            $response .= substr($buf, 0, 64) if length($response) < 64;
+            $bytes += $len;
+        }
+        close($s);
+
+        if ($response =~ m{^HTTP/1\.\d 2\d\d}) {
+            $requests++;
+        }
+        else {
+            $errors++;
+        }
+    }
+    return ($requests, $bytes, $errors);
+}
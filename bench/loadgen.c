@@ -0,0 +1,879 @@
+/*! \file       loadgen.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      HTTP load generator for tinyweb.
+ *
+ *  A number of concurrent client processes send requests for the static files
+ *  below the root directory (everything but cgi-bin), either one request per
+ *  connection or over persistent connections.  The requests are a mix of
+ *  plain GET requests, range requests for the second half of a file and
+ *  conditional requests with If-Modified-Since set to the modification time
+ *  of the file (answered with 304).  The mix is pseudo-random, but the same
+ *  in every run.
+ *
+ *  The latency of every request is recorded in a log-linear histogram (less
+ *  than 1.6 % error), from sending the request (or connecting, if a new
+ *  connection is needed) until the complete response has been received.  The
+ *  results are written to stdout as "key=value" lines, so the results of two
+ *  builds can be compared with diff(1).
+ *
+ *  With -u, only the given URI is requested with plain GET requests, e.g. a
+ *  CGI script; 'make bench-cgi' measures the throughput of the CGI output
+ *  relay this way.
+ *
+ *  With -s, the server is started locally with the given binary, the port,
+ *  the root directory and the arguments behind "--", and stopped with SIGINT
+ *  after the run.  Otherwise, a running server is used.
+ *
+ *  Build and run with 'make bench', see the Makefile for the default
+ *  arguments.
+ *
+ *  Usage: loadgen [-c CLIENTS] [-t SECONDS | -n REQUESTS] [-k] [-h HOST]
+ *                 [-p PORT] [-d ROOT] [-r RANGE_PCT] [-i IMS_PCT] [-l]
+ *                 [-u URI] [-s SERVER [-- SERVER_ARGS...]]
+ */
+
+#define _GNU_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "connect_tcp.h"
+#include "socket_io.h"
+
+#define DEFAULT_HOST        "127.0.0.1"
+#define DEFAULT_PORT        8090
+#define DEFAULT_ROOT        "web"
+#define DEFAULT_CLIENTS     8
+#define DEFAULT_DURATION    5
+#define DEFAULT_RANGE_PCT   10
+#define DEFAULT_IMS_PCT     10
+
+#define MAX_FILES           1024
+#define MAX_SIZE_REQUEST    512
+#define BUFFER_SIZE         (64 * 1024)
+#define READ_TIMEOUT        10      /* seconds until a response is an error */
+
+/* histogram: values below 2^HIST_SUB_BITS ns are exact, above, each power of
+ * two is divided into 2^HIST_SUB_BITS buckets; values up to 2^HIST_MAX_BITS
+ * ns (about 18 minutes) */
+#define HIST_SUB_BITS       6
+#define HIST_MAX_BITS       40
+#define HIST_BUCKETS        ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+/*! \brief The kinds of requests of the mix. */
+typedef enum {
+    REQ_GET = 0,            /*!< the whole file */
+    REQ_RANGE,              /*!< the second half of the file */
+    REQ_IMS,                /*!< If-Modified-Since the modification time */
+    REQ_KINDS
+} request_kind_t;
+
+static const char *kind_names[REQ_KINDS] = { "get", "range", "ims" };
+
+/*! \brief A file below the root directory with its prepared requests. */
+typedef struct {
+    char   request[REQ_KINDS][MAX_SIZE_REQUEST]; /*!< the requests */
+    size_t length[REQ_KINDS];                    /*!< their lengths */
+} target_t;
+
+/*! \brief The results of a client process, in shared memory. */
+typedef struct {
+    unsigned long      requests;            /*!< complete responses */
+    unsigned long      errors;              /*!< failed requests */
+    unsigned long      connections;         /*!< opened connections */
+    unsigned long long bytes;               /*!< received bytes */
+    unsigned long      kinds[REQ_KINDS];    /*!< requests per kind */
+    unsigned long      status[6];           /*!< responses per status class,
+                                                 [0] for invalid ones */
+    unsigned long      status_200, status_206, status_304;
+    unsigned long long latency_sum;         /*!< in ns */
+    unsigned long      hist[HIST_BUCKETS];  /*!< latencies */
+} client_stats_t;
+
+/*! \brief The memory shared between the load generator and its clients. */
+typedef struct {
+    long           remaining;   /*!< requests left to send, with -n */
+    client_stats_t clients[];   /*!< the results per client */
+} shared_t;
+
+/*! \brief The options of the load generator. */
+typedef struct {
+    const char  *host;
+    int          port;
+    const char  *root;
+    int          clients;
+    int          duration;
+    long         requests;
+    int          keep_alive;
+    int          range_pct;
+    int          ims_pct;
+    int          histogram;
+    const char  *server;
+    char *const *server_args;
+    const char  *uri;
+} options_t;
+
+static options_t opt = {
+    DEFAULT_HOST, DEFAULT_PORT, DEFAULT_ROOT, DEFAULT_CLIENTS,
+    DEFAULT_DURATION, 0, 0, DEFAULT_RANGE_PCT, DEFAULT_IMS_PCT, 0, NULL, NULL, NULL
+};
+
+static target_t *targets = NULL;
+static int n_targets = 0;
+static shared_t *shared = NULL;
+
+/* helper functions, defined at the bottom of the file */
+static int parse_options(int argc, char *argv[]);
+static int add_target(const char *path, const struct stat *st, int type,
+        struct FTW *ftw);
+static void prepare_target(const char *url, const struct stat *st);
+static pid_t start_server(void);
+static void stop_server(pid_t pid);
+static void run_client(int id, client_stats_t *stats);
+static int open_connection(void);
+static int exchange(int sd, const target_t *target, request_kind_t kind,
+        client_stats_t *stats, char *buf, int *keep);
+static double now_ns(void);
+static int hist_bucket(unsigned long long ns);
+static unsigned long long hist_lower(int bucket);
+static double hist_percentile(const unsigned long *hist, unsigned long total,
+        double p);
+static void print_results(const client_stats_t *total, double elapsed);
+
+/* --------------------------------------------------------------------------
+ *  main(argc, argv)
+ * -------------------------------------------------------------------------- */
+int
+main(int argc, char *argv[]) {
+
+    client_stats_t total;
+    struct stat st;
+    char path[MAX_SIZE_REQUEST];
+    size_t shared_size;
+    pid_t server = 0, pid;
+    double start, elapsed;
+    int i, j, status, failed = 0;
+
+    if (parse_options(argc, argv) < 0) {
+        fprintf(stderr, "Usage: %s [-c CLIENTS] [-t SECONDS | -n REQUESTS] "
+                "[-k] [-h HOST] [-p PORT]\n"
+                "       [-d ROOT] [-r RANGE_PCT] [-i IMS_PCT] [-l] [-u URI] "
+                "[-s SERVER [-- SERVER_ARGS...]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    targets = (target_t *)malloc(MAX_FILES * sizeof(target_t));
+    if (targets == NULL) {
+        perror("ERROR: malloc()");
+        return EXIT_FAILURE;
+    }
+    if (opt.uri != NULL) {
+        snprintf(path, sizeof(path), "%s%s", opt.root, opt.uri);
+        if (stat(path, &st) < 0) {
+            perror("ERROR: stat() of URI");
+            return EXIT_FAILURE;
+        }
+        prepare_target(opt.uri, &st);
+    }
+    else if (nftw(opt.root, add_target, 16, FTW_PHYS) < 0) {
+        perror("ERROR: nftw()");
+        return EXIT_FAILURE;
+    }
+    if (n_targets == 0) {
+        fprintf(stderr, "ERROR: no files found in %s\n", opt.root);
+        return EXIT_FAILURE;
+    }
+
+    shared_size = sizeof(shared_t) + opt.clients * sizeof(client_stats_t);
+    shared = (shared_t *)mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("ERROR: mmap()");
+        return EXIT_FAILURE;
+    }
+    shared->remaining = opt.requests;
+
+    /* a server which closes a connection must not terminate the clients */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (opt.server != NULL && (server = start_server()) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    start = now_ns();
+    for (i = 0; i < opt.clients; i++) {
+        if ((pid = fork()) < 0) {
+            perror("ERROR: fork()");
+            failed = 1;
+            break;
+        }
+        else if (pid == 0) {
+            run_client(i, &shared->clients[i]);
+            exit(EXIT_SUCCESS);
+        }
+    }
+    /* i is the number of running clients */
+    while (i > 0) {
+        if ((pid = wait(&status)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: wait()");
+            failed = 1;
+            break;
+        }
+        if (pid == server) {
+            fprintf(stderr, "ERROR: the server terminated during the run\n");
+            server = 0;
+            failed = 1;
+            continue;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            failed = 1;
+        }
+        i--;
+    }
+    elapsed = now_ns() - start;
+
+    if (server > 0) {
+        stop_server(server);
+    }
+
+    /* add up the results of all clients */
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < opt.clients; i++) {
+        const client_stats_t *c = &shared->clients[i];
+        total.requests    += c->requests;
+        total.errors      += c->errors;
+        total.connections += c->connections;
+        total.bytes       += c->bytes;
+        total.latency_sum += c->latency_sum;
+        total.status_200  += c->status_200;
+        total.status_206  += c->status_206;
+        total.status_304  += c->status_304;
+        for (j = 0; j < REQ_KINDS; j++) {
+            total.kinds[j] += c->kinds[j];
+        }
+        for (j = 0; j < 6; j++) {
+            total.status[j] += c->status[j];
+        }
+        for (j = 0; j < HIST_BUCKETS; j++) {
+            total.hist[j] += c->hist[j];
+        }
+    }
+
+    print_results(&total, elapsed / 1e9);
+
+    munmap(shared, shared_size);
+    free(targets);
+    return (failed || total.requests == 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  parse_options(argc, argv)
+ * -------------------------------------------------------------------------- */
+/*! \brief Reads the options into opt.
+ *
+ *  \return  0 on success, -1 if an option is invalid.
+ */
+static int
+parse_options(int argc, char *argv[]) {
+
+    int c;
+
+    while ((c = getopt(argc, argv, "c:t:n:kh:p:d:r:i:lu:s:")) != -1) {
+        switch (c) {
+            case 'c':
+                opt.clients = atoi(optarg);
+                break;
+            case 't':
+                opt.duration = atoi(optarg);
+                break;
+            case 'n':
+                opt.requests = atol(optarg);
+                break;
+            case 'k':
+                opt.keep_alive = 1;
+                break;
+            case 'h':
+                opt.host = optarg;
+                break;
+            case 'p':
+                opt.port = atoi(optarg);
+                break;
+            case 'd':
+                opt.root = optarg;
+                break;
+            case 'r':
+                opt.range_pct = atoi(optarg);
+                break;
+            case 'i':
+                opt.ims_pct = atoi(optarg);
+                break;
+            case 'l':
+                opt.histogram = 1;
+                break;
+            case 'u':
+                opt.uri = optarg;
+                break;
+            case 's':
+                opt.server = optarg;
+                break;
+            default:
+                return -1;
+        }
+    }
+    opt.server_args = argv + optind;
+
+    /* a single URI, e.g. a CGI script, only gets plain GET requests */
+    if (opt.uri != NULL) {
+        opt.range_pct = 0;
+        opt.ims_pct   = 0;
+    }
+
+    if (opt.clients <= 0 || opt.duration <= 0 || opt.requests < 0 ||
+            opt.port <= 0 || opt.port > 65535 ||
+            opt.range_pct < 0 || opt.ims_pct < 0 ||
+            opt.range_pct + opt.ims_pct > 100 ||
+            (opt.server == NULL && optind < argc)) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  add_target(path, st, type, ftw)
+ * -------------------------------------------------------------------------- */
+/*! \brief Prepares the requests for a file below the root directory, called
+ *         by nftw().
+ */
+static int
+add_target(const char *path, const struct stat *st, int type,
+        struct FTW *ftw) {
+
+    if (type == FTW_F && strstr(path, "/cgi-bin/") == NULL &&
+            n_targets < MAX_FILES) {
+        prepare_target(path + strlen(opt.root), st);
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  prepare_target(url, st)
+ * -------------------------------------------------------------------------- */
+/*! \brief Prepares the requests for a URL and adds it to the targets.
+ */
+static void
+prepare_target(const char *url, const struct stat *st) {
+
+    const char *connection = opt.keep_alive ? "keep-alive" : "close";
+    char date[64];
+    target_t *t = &targets[n_targets];
+    int cnt, i;
+
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT",
+             gmtime(&st->st_mtime));
+
+    cnt = snprintf(t->request[REQ_GET], MAX_SIZE_REQUEST,
+            "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+            url, opt.host, connection);
+    t->length[REQ_GET] = cnt;
+
+    cnt = snprintf(t->request[REQ_RANGE], MAX_SIZE_REQUEST,
+            "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n"
+            "Range: bytes=%lld-\r\n\r\n",
+            url, opt.host, connection, (long long)st->st_size / 2);
+    t->length[REQ_RANGE] = cnt;
+
+    cnt = snprintf(t->request[REQ_IMS], MAX_SIZE_REQUEST,
+            "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n"
+            "If-Modified-Since: %s\r\n\r\n",
+            url, opt.host, connection, date);
+    t->length[REQ_IMS] = cnt;
+
+    for (i = 0; i < REQ_KINDS; i++) {
+        if (t->length[i] >= MAX_SIZE_REQUEST) {
+            return;         /* path too long, skipped */
+        }
+    }
+    n_targets++;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  start_server()
+ * -------------------------------------------------------------------------- */
+/*! \brief Starts the server and waits until it accepts connections.
+ *
+ *  \return  The process ID of the server, -1 on error.
+ */
+static pid_t
+start_server(void) {
+
+    struct sockaddr_in sa;
+    struct timespec pause = { 0, 100000000L };
+    char port[16], **argv;
+    int argc = 0, i, sd;
+    pid_t pid;
+
+    for (i = 0; opt.server_args[i] != NULL; i++);
+    argv = (char **)calloc(i + 8, sizeof(char *));
+    if (argv == NULL) {
+        perror("ERROR: calloc()");
+        return -1;
+    }
+    snprintf(port, sizeof(port), "%d", opt.port);
+    argv[argc++] = (char *)opt.server;
+    argv[argc++] = "-p";
+    argv[argc++] = port;
+    argv[argc++] = "-d";
+    argv[argc++] = (char *)opt.root;
+    argv[argc++] = "-f";
+    argv[argc++] = "/dev/null";
+    for (i = 0; opt.server_args[i] != NULL; i++) {
+        argv[argc++] = opt.server_args[i];
+    }
+
+    if ((pid = fork()) < 0) {
+        perror("ERROR: fork()");
+        free(argv);
+        return -1;
+    }
+    else if (pid == 0) {
+        /* the status messages of the server would mix with the results */
+        if (freopen("/dev/null", "w", stdout) == NULL) {
+            perror("ERROR: freopen()");
+        }
+        execv(opt.server, argv);
+        perror("ERROR: execv()");
+        _exit(EXIT_FAILURE);
+    }
+    free(argv);
+
+    /* poll without connect_tcp(), which reports every failed attempt */
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family      = AF_INET;
+    sa.sin_port        = htons(opt.port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (i = 0; i < 50; i++) {
+        if ((sd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+            perror("ERROR: socket()");
+            break;
+        }
+        if (connect(sd, (struct sockaddr *)&sa, sizeof(sa)) == 0) {
+            close(sd);
+            return pid;
+        }
+        close(sd);
+        if (waitpid(pid, NULL, WNOHANG) == pid) {
+            fprintf(stderr, "ERROR: the server terminated at startup\n");
+            return -1;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    fprintf(stderr, "ERROR: the server does not accept connections\n");
+    stop_server(pid);
+    return -1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stop_server(pid)
+ * -------------------------------------------------------------------------- */
+/*! \brief Stops the server like a keyboard interrupt would.
+ */
+static void
+stop_server(pid_t pid) {
+
+    kill(pid, SIGINT);
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  run_client(id, stats)
+ * -------------------------------------------------------------------------- */
+/*! \brief The main loop of a client process.
+ *
+ *  Sends requests until the duration has elapsed or, with -n, until all
+ *  clients together have sent the given number of requests.
+ */
+static void
+run_client(int id, client_stats_t *stats) {
+
+    double deadline = now_ns() + opt.duration * 1e9;
+    unsigned long rng = 2654435761UL * (id + 1);
+    int sd = -1, keep, attempt, result, target = id % n_targets;
+    char *buf = (char *)malloc(BUFFER_SIZE);
+
+    if (buf == NULL) {
+        perror("ERROR: malloc()");
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;) {
+        request_kind_t kind = REQ_GET;
+        double start;
+        int pct;
+
+        if (opt.requests > 0) {
+            if (__atomic_fetch_sub(&shared->remaining, 1,
+                                   __ATOMIC_RELAXED) <= 0) {
+                break;
+            }
+        }
+        else if (now_ns() >= deadline) {
+            break;
+        }
+
+        /* xorshift, the same mix in every run */
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        pct = rng % 100;
+        if (pct < opt.range_pct) {
+            kind = REQ_RANGE;
+        }
+        else if (pct < opt.range_pct + opt.ims_pct) {
+            kind = REQ_IMS;
+        }
+        target = (target + 1) % n_targets;
+
+        start  = now_ns();
+        result = -1;
+        for (attempt = 0; attempt < 2; attempt++) {
+            int reused = (sd >= 0);
+
+            if (sd < 0) {
+                if ((sd = open_connection()) < 0) {
+                    break;
+                }
+                stats->connections++;
+            }
+            result = exchange(sd, &targets[target], kind, stats, buf, &keep);
+
+            /* a persistent connection may have been closed by the server
+             * (idle timeout) just before the request, retry once */
+            if (result == 0 && reused) {
+                close(sd);
+                sd = -1;
+                continue;
+            }
+            break;
+        }
+
+        if (result > 0) {
+            unsigned long long ns = now_ns() - start;
+            stats->requests++;
+            stats->kinds[kind]++;
+            stats->latency_sum += ns;
+            stats->hist[hist_bucket(ns)]++;
+        }
+        else {
+            stats->errors++;
+            keep = 0;
+        }
+
+        if (!keep && sd >= 0) {
+            close(sd);
+            sd = -1;
+        }
+    }
+
+    if (sd >= 0) {
+        close(sd);
+    }
+    free(buf);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  open_connection()
+ * -------------------------------------------------------------------------- */
+/*! \brief Connects to the server.
+ *
+ *  \return  The socket descriptor, -1 on error.
+ */
+static int
+open_connection(void) {
+
+    struct timeval timeout = { READ_TIMEOUT, 0 };
+    int sd = connect_tcp(opt.host, opt.port);
+
+    if (sd < 0) {
+        return -1;
+    }
+    /* a server which does not answer must not stop the run */
+    if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout)) < 0) {
+        perror("ERROR: setsockopt(SO_RCVTIMEO)");
+    }
+    return sd;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  exchange(sd, target, kind, stats, buf, keep)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends a request and receives the complete response.
+ *
+ *  \param keep  Receives if the connection can be used for the next request.
+ *
+ *  \return  1 if a response has been received, 0 if the connection was
+ *           closed before any byte of the response, -1 on error.
+ */
+static int
+exchange(int sd, const target_t *target, request_kind_t kind,
+        client_stats_t *stats, char *buf, int *keep) {
+
+    long long content_length = -1, body;
+    size_t len = 0, end_len = 4;
+    char *end = NULL, *lf, *field;
+    int cnt, status;
+
+    *keep = 0;
+    if (write_to_socket(sd, (char *)target->request[kind],
+                        target->length[kind], 0) <= 0) {
+        return -1;
+    }
+
+    /* the response header */
+    while (end == NULL) {
+        if (len == BUFFER_SIZE - 1) {
+            return -1;
+        }
+        cnt = read_from_socket(sd, buf + len, BUFFER_SIZE - 1 - len, 0);
+        if (cnt <= 0) {
+            return (cnt == 0 && len == 0) ? 0 : -1;
+        }
+        stats->bytes += cnt;
+        len += cnt;
+        buf[len] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+
+        /* the header fields of CGI scripts may end with bare line feeds */
+        if ((lf = strstr(buf, "\n\n")) != NULL && (end == NULL || lf < end)) {
+            end     = lf;
+            end_len = 2;
+        }
+    }
+    *end = '\0';
+
+    if (sscanf(buf, "HTTP/1.%*d %d", &status) != 1 ||
+            status < 100 || status > 599) {
+        stats->status[0]++;
+        return -1;
+    }
+    stats->status[status / 100]++;
+    stats->status_200 += (status == 200);
+    stats->status_206 += (status == 206);
+    stats->status_304 += (status == 304);
+
+    if ((field = strcasestr(buf, "\r\nContent-Length:")) != NULL) {
+        content_length = atoll(field + 17);
+    }
+    *keep = opt.keep_alive && content_length >= 0 &&
+            strcasestr(buf, "\r\nConnection: close") == NULL;
+
+    /* the body: none for 304, up to the end of the connection if its length
+     * is unknown */
+    body = len - (end + end_len - buf);
+    if (status == 304) {
+        content_length = 0;
+    }
+    while (content_length < 0 || body < content_length) {
+        cnt = read_from_socket(sd, buf, BUFFER_SIZE, 0);
+        if (cnt < 0) {
+            return -1;
+        }
+        if (cnt == 0) {
+            if (content_length >= 0) {
+                return -1;      /* truncated */
+            }
+            break;
+        }
+        stats->bytes += cnt;
+        body += cnt;
+    }
+
+    return (status >= 400) ? -1 : 1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  now_ns()
+ * -------------------------------------------------------------------------- */
+static double
+now_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  hist_bucket(ns)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the histogram bucket of a latency.
+ */
+static int
+hist_bucket(unsigned long long ns) {
+
+    int shift;
+
+    if (ns >= 1ULL << HIST_MAX_BITS) {
+        ns = (1ULL << HIST_MAX_BITS) - 1;
+    }
+    if (ns < 1ULL << HIST_SUB_BITS) {
+        return (int)ns;
+    }
+    shift = 63 - __builtin_clzll(ns) - HIST_SUB_BITS;
+    return (shift << HIST_SUB_BITS) + (int)(ns >> shift);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  hist_lower(bucket)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the smallest latency of a histogram bucket, in ns.
+ */
+static unsigned long long
+hist_lower(int bucket) {
+
+    int shift;
+
+    if (bucket < 2 << HIST_SUB_BITS) {
+        return bucket;
+    }
+    shift = (bucket >> HIST_SUB_BITS) - 1;
+    return (unsigned long long)(bucket - (shift << HIST_SUB_BITS)) << shift;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  hist_percentile(hist, total, p)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns a percentile of the latencies in us, the upper end of the
+ *         bucket in which it falls.
+ */
+static double
+hist_percentile(const unsigned long *hist, unsigned long total, double p) {
+
+    unsigned long rank = (unsigned long)(p / 100.0 * total + 0.5), seen = 0;
+    int i;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= rank) {
+            return hist_lower(i + 1) / 1e3;
+        }
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  print_results(total, elapsed)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the results as "key=value" lines.
+ */
+static void
+print_results(const client_stats_t *total, double elapsed) {
+
+    int i, first = -1, last = -1;
+
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        if (total->hist[i] > 0) {
+            last = i;
+            if (first < 0) {
+                first = i;
+            }
+        }
+    }
+
+    printf("target=%s:%d\n", opt.host, opt.port);
+    if (opt.server != NULL) {
+        printf("server=%s", opt.server);
+        for (i = 0; opt.server_args[i] != NULL; i++) {
+            printf(" %s", opt.server_args[i]);
+        }
+        printf("\n");
+    }
+    if (opt.uri != NULL) {
+        printf("uri=%s\n", opt.uri);
+    }
+    printf("files=%d\n", n_targets);
+    printf("clients=%d\n", opt.clients);
+    printf("keep_alive=%d\n", opt.keep_alive);
+    printf("mix_get_pct=%d\n", 100 - opt.range_pct - opt.ims_pct);
+    printf("mix_range_pct=%d\n", opt.range_pct);
+    printf("mix_ims_pct=%d\n", opt.ims_pct);
+    printf("duration_s=%.3f\n", elapsed);
+    printf("requests=%lu\n", total->requests);
+    for (i = 0; i < REQ_KINDS; i++) {
+        printf("requests_%s=%lu\n", kind_names[i], total->kinds[i]);
+    }
+    printf("errors=%lu\n", total->errors);
+    printf("connections=%lu\n", total->connections);
+    printf("bytes=%llu\n", total->bytes);
+    printf("status_200=%lu\n", total->status_200);
+    printf("status_206=%lu\n", total->status_206);
+    printf("status_304=%lu\n", total->status_304);
+    printf("status_4xx=%lu\n", total->status[4]);
+    printf("status_5xx=%lu\n", total->status[5]);
+    printf("status_invalid=%lu\n", total->status[0]);
+    printf("requests_per_s=%.1f\n", total->requests / elapsed);
+    printf("mbytes_per_s=%.2f\n", total->bytes / elapsed / 1e6);
+
+    if (total->requests == 0) {
+        return;
+    }
+    printf("latency_min_us=%.1f\n", hist_lower(first) / 1e3);
+    printf("latency_mean_us=%.1f\n",
+           total->latency_sum / 1e3 / total->requests);
+    printf("latency_p50_us=%.1f\n",
+           hist_percentile(total->hist, total->requests, 50));
+    printf("latency_p90_us=%.1f\n",
+           hist_percentile(total->hist, total->requests, 90));
+    printf("latency_p99_us=%.1f\n",
+           hist_percentile(total->hist, total->requests, 99));
+    printf("latency_p999_us=%.1f\n",
+           hist_percentile(total->hist, total->requests, 99.9));
+    printf("latency_max_us=%.1f\n", hist_lower(last + 1) / 1e3);
+
+    /* the non-empty buckets: lower and upper bound in us, count */
+    if (opt.histogram) {
+        for (i = first; i <= last; i++) {
+            if (total->hist[i] > 0) {
+                printf("latency_hist_us=%.3f,%.3f,%lu\n",
+                       hist_lower(i) / 1e3, hist_lower(i + 1) / 1e3,
+                       total->hist[i]);
+            }
+        }
+    }
+}
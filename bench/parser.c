@@ -0,0 +1,172 @@
+/*! \file       parser.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Microbenchmark of the incremental request parser.
+ *
+ *  A buffer is filled with pipelined requests, a short one as sent by curl
+ *  and a longer one as sent by a browser.  The buffer is parsed in two ways:
+ *  with all data available at once, where each parser starts at the end of
+ *  the previous request, and in small segments, where the parser is run
+ *  again after every segment as if the data arrived in several TCP
+ *  segments.  Every parsed request is also interpreted with parse_request().
+ *
+ *  Build and run with 'make bench-parser'.
+ *
+ *  Usage: bench_parser [ROUNDS] [SEGMENT_SIZE]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "request.h"
+
+#define DEFAULT_ROUNDS      2000
+#define DEFAULT_SEGMENT     64
+#define BUFFER_SIZE         (64 * 1024)
+
+static const char *requests[] = {
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "\r\n",
+
+    "GET /images/computerhead1.gif HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:131.0) Gecko/20100101 "
+        "Firefox/131.0\r\n"
+    "Accept: image/avif,image/webp,image/png,image/svg+xml,image/*;q=0.8,"
+        "*/*;q=0.5\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://localhost:8080/index.html\r\n"
+    "If-Modified-Since: Fri, 16 Oct 2026 08:49:37 GMT\r\n"
+    "Range: bytes=100-\r\n"
+    "Sec-Fetch-Dest: image\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Priority: u=5, i\r\n"
+    "\r\n"
+};
+
+/* --------------------------------------------------------------------------
+ *  now_ns()
+ * -------------------------------------------------------------------------- */
+static double
+now_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  parse_buffer(buf, len, segment)
+ * -------------------------------------------------------------------------- */
+/*! \brief Parses and interprets all requests of a buffer.
+ *
+ *  \param segment  The number of bytes made available per parser run, or 0
+ *                  if the whole buffer is available at once.
+ *
+ *  \return  The number of requests, -1 if a request could not be parsed.
+ */
+static int
+parse_buffer(const char *buf, size_t len, size_t segment) {
+
+    request_parser_t parser;
+    request_t req;
+    size_t avail = (segment > 0) ? segment : len;
+    int n = 0;
+
+    request_parser_init(&parser, 0);
+    for (;;) {
+        parse_result_t result = request_parser_run(&parser, buf, avail);
+
+        if (result == PARSE_DONE) {
+            if (parse_request(&parser, buf, &req) == HTTP_STATUS_BAD_REQUEST) {
+                return -1;
+            }
+            n++;
+            request_parser_init(&parser, parser.end);
+        }
+        else if (result == PARSE_ERROR) {
+            return -1;
+        }
+        else if (avail == len) {
+            break;
+        }
+        else {
+            avail = (avail + segment < len) ? avail + segment : len;
+        }
+    }
+    return n;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  main(argc, argv)
+ * -------------------------------------------------------------------------- */
+int
+main(int argc, char *argv[]) {
+
+    long rounds    = (argc > 1) ? atol(argv[1]) : DEFAULT_ROUNDS;
+    long segment   = (argc > 2) ? atol(argv[2]) : DEFAULT_SEGMENT;
+    size_t n_kinds = sizeof(requests) / sizeof(requests[0]);
+    size_t len = 0, i;
+    int per_buffer = 0, mode;
+    char *buf;
+
+    if (rounds <= 0 || segment <= 0) {
+        fprintf(stderr, "Usage: %s [ROUNDS] [SEGMENT_SIZE]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if ((buf = (char *)malloc(BUFFER_SIZE)) == NULL) {
+        perror("ERROR: malloc()");
+        return EXIT_FAILURE;
+    }
+
+    /* alternate between the kinds of requests until the buffer is full */
+    for (i = 0; len + strlen(requests[i % n_kinds]) < BUFFER_SIZE; i++) {
+        size_t size = strlen(requests[i % n_kinds]);
+        memcpy(buf + len, requests[i % n_kinds], size);
+        len += size;
+        per_buffer++;
+    }
+
+    printf("%d pipelined requests (%zu bytes) per buffer, %ld rounds\n",
+           per_buffer, len, rounds);
+
+    for (mode = 0; mode < 2; mode++) {
+        size_t seg = (mode == 0) ? 0 : (size_t)segment;
+        double start = now_ns(), elapsed;
+        long r, total = 0;
+
+        for (r = 0; r < rounds; r++) {
+            int n = parse_buffer(buf, len, seg);
+            if (n != per_buffer) {
+                fprintf(stderr, "ERROR: parsed %d of %d requests\n", n,
+                        per_buffer);
+                return EXIT_FAILURE;
+            }
+            total += n;
+        }
+        elapsed = now_ns() - start;
+
+        if (seg == 0) {
+            printf("  whole buffer:      ");
+        }
+        else {
+            printf("  %4zu byte segments:", seg);
+        }
+        printf(" %12.0f requests/s %8.1f ns/request %8.1f MB/s\n",
+               total / (elapsed / 1e9), elapsed / total,
+               (double)len * (total / per_buffer) / (elapsed / 1e9) / 1e6);
+    }
+
+    free(buf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,290 @@
+/*! \file       scan.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Microbenchmark of the implementations of the header scanning.
+ *
+ *  Compares the scalar, SSE2 and AVX2 implementations of scan.h on the
+ *  request headers of current browsers: once for the scanning alone (every
+ *  line break and field colon of the headers) and once for the complete
+ *  request parser.  Before measuring, the results of every implementation
+ *  are compared with those of the scalar one.  Each measurement is repeated
+ *  and the fastest run is reported.
+ *
+ *  Build and run with 'make bench-scan'.
+ *
+ *  Usage: bench_scan [ROUNDS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "request.h"
+#include "scan.h"
+
+#define DEFAULT_ROUNDS      200000
+#define REPEATS             5
+
+static const char *headers[] = {
+    /* Chrome, navigation */
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"130\", \"Google Chrome\";v=\"130\", "
+        "\"Not?A_Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+        "(KHTML, like Gecko) Chrome/130.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+        "image/avif,image/webp,image/apng,*/*;q=0.8,"
+        "application/signed-exchange;v=b3;q=0.7\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n"
+    "If-Modified-Since: Fri, 16 Oct 2026 08:49:37 GMT\r\n"
+    "\r\n",
+
+    /* Firefox, image */
+    "GET /images/computerhead1.gif HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:131.0) Gecko/20100101 "
+        "Firefox/131.0\r\n"
+    "Accept: image/avif,image/webp,image/png,image/svg+xml,image/*;q=0.8,"
+        "*/*;q=0.5\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://localhost:8080/index.html\r\n"
+    "Sec-Fetch-Dest: image\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Priority: u=5, i\r\n"
+    "\r\n",
+
+    /* Safari, stylesheet */
+    "GET /css/style.css HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Accept-Language: en-GB,en;q=0.9\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) "
+        "AppleWebKit/605.1.15 (KHTML, like Gecko) Version/18.0 "
+        "Safari/605.1.15\r\n"
+    "Referer: http://localhost:8080/index.html\r\n"
+    "Connection: keep-alive\r\n"
+    "Sec-Fetch-Dest: style\r\n"
+    "\r\n"
+};
+
+#define N_HEADERS   (sizeof(headers) / sizeof(headers[0]))
+
+static const struct {
+    scan_impl_t impl;
+    const char *name;
+} impls[] = {
+    { SCAN_SCALAR, "scalar" },
+    { SCAN_SSE2,   "sse2" },
+    { SCAN_AVX2,   "avx2" }
+};
+
+#define N_IMPLS     (sizeof(impls) / sizeof(impls[0]))
+
+/* the compiler must not optimize the scanning away */
+static volatile size_t sink;
+
+/* --------------------------------------------------------------------------
+ *  now_ns()
+ * -------------------------------------------------------------------------- */
+static double
+now_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_header(buf, len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Finds all line breaks and field colons of a header.
+ *
+ *  \return  A checksum of the positions.
+ */
+static size_t
+scan_header(const char *buf, size_t len) {
+
+    const char *p = buf, *end = buf + len, *nl, *colon;
+    size_t sum = 0;
+
+    for (;;) {
+        colon = NULL;
+        if ((nl = scan_line(p, end, &colon)) == NULL) {
+            break;
+        }
+        sum = sum * 31 + (nl - buf);
+        if (colon != NULL) {
+            sum = sum * 31 + (colon - buf);
+        }
+        p = nl + 1;
+    }
+    return sum;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  parse_header(buf, len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Parses and interprets a header.
+ *
+ *  \return  A checksum of the parser state, 0 if the header is invalid.
+ */
+static size_t
+parse_header(const char *buf, size_t len) {
+
+    request_parser_t parser;
+    request_t req;
+    size_t sum;
+    int i;
+
+    request_parser_init(&parser, 0);
+    if (request_parser_run(&parser, buf, len) != PARSE_DONE ||
+            parse_request(&parser, buf, &req) != HTTP_STATUS_OK) {
+        return 0;
+    }
+
+    sum = parser.end + parser.method.length + parser.uri.length;
+    for (i = 0; i < parser.n_fields; i++) {
+        sum = sum * 31 + parser.fields[i].name.offset;
+        sum = sum * 31 + parser.fields[i].value.offset;
+        sum = sum * 31 + parser.fields[i].value.length;
+    }
+    return sum;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  measure(fn, lens, rounds)
+ * -------------------------------------------------------------------------- */
+/*! \brief Runs scan_header() or parse_header() on all headers.
+ *
+ *  \return  The time per header in ns, the minimum of REPEATS runs.
+ */
+static double
+measure(size_t (*fn)(const char *, size_t), const size_t *lens, long rounds) {
+
+    double best = 0;
+    long r;
+    int i;
+    size_t h;
+
+    for (i = 0; i < REPEATS; i++) {
+        double start = now_ns(), ns;
+
+        for (r = 0; r < rounds; r++) {
+            for (h = 0; h < N_HEADERS; h++) {
+                sink += fn(headers[h], lens[h]);
+            }
+        }
+        ns = (now_ns() - start) / (rounds * N_HEADERS);
+        if (i == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  verify()
+ * -------------------------------------------------------------------------- */
+/*! \brief Compares the results of every implementation with the scalar one,
+ *         for every header and every prefix of it.
+ *
+ *  \return  The number of mismatches.
+ */
+static int
+verify(void) {
+
+    size_t expected[2], h, len, i;
+    int errors = 0;
+
+    for (h = 0; h < N_HEADERS; h++) {
+        for (len = 0; len <= strlen(headers[h]); len++) {
+            scan_select(SCAN_SCALAR);
+            expected[0] = scan_header(headers[h], len);
+            expected[1] = parse_header(headers[h], len);
+
+            for (i = 1; i < N_IMPLS; i++) {
+                if (scan_select(impls[i].impl) != 0) {
+                    continue;
+                }
+                errors += (scan_header(headers[h], len) != expected[0]);
+                errors += (parse_header(headers[h], len) != expected[1]);
+            }
+        }
+    }
+    return errors;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  main(argc, argv)
+ * -------------------------------------------------------------------------- */
+int
+main(int argc, char *argv[]) {
+
+    long rounds = (argc > 1) ? atol(argv[1]) : DEFAULT_ROUNDS;
+    size_t lens[N_HEADERS], bytes = 0, h, i;
+    double scalar[2] = { 0, 0 };
+    int errors;
+
+    if (rounds <= 0) {
+        fprintf(stderr, "Usage: %s [ROUNDS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((errors = verify()) != 0) {
+        fprintf(stderr, "ERROR: %d results differ from the scalar scan\n",
+                errors);
+        return EXIT_FAILURE;
+    }
+
+    for (h = 0; h < N_HEADERS; h++) {
+        lens[h] = strlen(headers[h]);
+        bytes  += lens[h];
+    }
+    scan_select(SCAN_AUTO);
+    printf("%zu browser headers (%zu bytes), %ld rounds, default: %s\n",
+           N_HEADERS, bytes, rounds, scan_impl_name());
+    printf("              scan only              parser\n");
+
+    for (i = 0; i < N_IMPLS; i++) {
+        double ns[2];
+
+        if (scan_select(impls[i].impl) != 0) {
+            printf("  %-8s not supported by this CPU\n", impls[i].name);
+            continue;
+        }
+        ns[0] = measure(scan_header, lens, rounds);
+        ns[1] = measure(parse_header, lens, rounds);
+
+        if (impls[i].impl == SCAN_SCALAR) {
+            scalar[0] = ns[0];
+            scalar[1] = ns[1];
+        }
+        printf("  %-8s %7.1f ns/header (%4.2fx) %7.1f ns/header (%4.2fx)\n",
+               impls[i].name, ns[0], scalar[0] / ns[0], ns[1],
+               scalar[1] / ns[1]);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -15,6 +15,7 @@
 #include <netdb.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "connect_tcp.h"
 
@@ -55,6 +56,7 @@ connect_tcp(const char *host, unsigned short port)
   retcode = connect(s, (struct sockaddr *)&sin, sizeof(sin));
   if (retcode < 0) {
     perror("ERROR: client connect() ");
+    close(s);
     return -1;
   } /* end if */
 
@@ -10,6 +10,7 @@
 #include <sys/socket.h>
 #include <sys/errno.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <syslog.h>
 #include <netdb.h>
@@ -44,36 +45,42 @@ get_port_from_name(const char *service)
 } /* end of get_port_from_name */
 
 
+static void set_option(int sd, int level, int name, const char *name_str,
+                       int value);
+
+
+/*
+ * Creates a socket listening on the address ai, as returned by
+ * getaddrinfo() (e.g. the wildcard address of IPv4 or IPv6 for AI_PASSIVE).
+ * The options are applied before the socket is bound, so that the buffer
+ * sizes also determine the window scaling of accepted connections.  A
+ * tuning option which cannot be set is reported, but the socket is still
+ * returned.  If opts is NULL, the defaults of the system are used.  If the
+ * address family is not supported, -1 is returned with errno set to
+ * EAFNOSUPPORT.
+ */
 int
-passive_tcp(unsigned short port, int qlen)
+passive_tcp(const struct addrinfo *ai, const passive_tcp_opts_t *opts)
 {
   int retcode;
   int sd;                    /* socket descriptor */
-  struct protoent *ppe;      /* pointer to protocol information entry */
-  struct sockaddr_in server;
   const int on = 1;          /* used to set socket option */
+  passive_tcp_opts_t defaults;
 
 
-  memset(&server, 0, sizeof(server));
-  server.sin_family = AF_INET;
-  server.sin_addr.s_addr = INADDR_ANY;
-  server.sin_port = htons(port);
-
-  /*
-   * Get protocol information entry.
-   */
-  ppe = getprotobyname("tcp");
-  if (ppe == 0) {
-    perror("ERROR: server getprotobyname(\"tcp\")");
-    return -1;
+  if (opts == NULL) {
+    memset(&defaults, 0, sizeof(defaults));
+    opts = &defaults;
   } /* end if */
 
   /*
    * Create a socket.
    */
-  sd = socket(PF_INET, SOCK_STREAM, ppe->p_proto);
+  sd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
   if (sd < 0) {
-    perror("ERROR: server socket()");
+    if (errno != EAFNOSUPPORT) {
+      perror("ERROR: server socket()");
+    } /* end if */
     return -1;
   } /* end if */
 
@@ -81,24 +88,110 @@ passive_tcp(unsigned short port, int qlen)
    * Set socket options.
    */
   setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
-  
+  if (opts->reuseport) {
+    retcode = setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    if (retcode < 0) {
+      perror("ERROR: server setsockopt(SO_REUSEPORT)");
+      close(sd);
+      return -1;
+    } /* end if */
+  } /* end if */
+  if (ai->ai_family == AF_INET6 && opts->v6only) {
+    set_option(sd, IPPROTO_IPV6, IPV6_V6ONLY, "IPV6_V6ONLY", 1);
+  } /* end if */
+  if (opts->rcvbuf > 0) {
+    set_option(sd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", opts->rcvbuf);
+  } /* end if */
+  if (opts->sndbuf > 0) {
+    set_option(sd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", opts->sndbuf);
+  } /* end if */
+  if (opts->nodelay) {
+    set_option(sd, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", 1);
+  } /* end if */
+  if (opts->defer_accept > 0) {
+    set_option(sd, IPPROTO_TCP, TCP_DEFER_ACCEPT, "TCP_DEFER_ACCEPT",
+               opts->defer_accept);
+  } /* end if */
+  if (opts->fastopen > 0) {
+    set_option(sd, IPPROTO_TCP, TCP_FASTOPEN, "TCP_FASTOPEN",
+               opts->fastopen);
+  } /* end if */
+
   /*
-   * Bind the socket to the provided port.
+   * Bind the socket to the provided address.
    */
-  retcode = bind(sd, (struct sockaddr *)&server, sizeof(server));
+  retcode = bind(sd, ai->ai_addr, ai->ai_addrlen);
   if (retcode < 0) {
     perror("ERROR: server bind()");
+    close(sd);
     return -1;
   } /* end if */
 
   /*
    * Place the socket in passive mode.
    */
-  retcode = listen (sd, qlen);
+  retcode = listen(sd, (opts->backlog > 0) ? opts->backlog : SOMAXCONN);
   if (retcode < 0) {
     perror("ERROR: server listen()");
+    close(sd);
     return -1;
   } /* end if */
 
   return sd;
 } /* end of passive_tcp */
+
+
+/*
+ * Reads the effective options of a listening socket, which may differ from
+ * the requested ones: the kernel doubles the buffer sizes, rounds the
+ * TCP_DEFER_ACCEPT timeout to retransmissions and limits the backlog to
+ * net.core.somaxconn.  opts->backlog has to hold the requested backlog.
+ */
+int
+get_passive_tcp_opts(int sd, passive_tcp_opts_t *opts)
+{
+  socklen_t len;
+  FILE *fp;
+  int somaxconn;
+
+  if (opts->backlog <= 0) {
+    opts->backlog = SOMAXCONN;
+  } /* end if */
+  fp = fopen("/proc/sys/net/core/somaxconn", "r");
+  if (fp != NULL) {
+    if (fscanf(fp, "%d", &somaxconn) == 1 && somaxconn < opts->backlog) {
+      opts->backlog = somaxconn;
+    } /* end if */
+    fclose(fp);
+  } /* end if */
+
+  len = sizeof(int);
+  if (getsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &opts->reuseport, &len) < 0 ||
+      getsockopt(sd, SOL_SOCKET, SO_RCVBUF, &opts->rcvbuf, &len) < 0 ||
+      getsockopt(sd, SOL_SOCKET, SO_SNDBUF, &opts->sndbuf, &len) < 0 ||
+      getsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &opts->nodelay, &len) < 0 ||
+      getsockopt(sd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &opts->defer_accept,
+                 &len) < 0) {
+    perror("ERROR: server getsockopt()");
+    return -1;
+  } /* end if */
+
+  /* older kernels cannot report the TFO queue length */
+  if (getsockopt(sd, IPPROTO_TCP, TCP_FASTOPEN, &opts->fastopen, &len) < 0) {
+    opts->fastopen = -1;
+  } /* end if */
+
+  return 0;
+} /* end of get_passive_tcp_opts */
+
+
+static void
+set_option(int sd, int level, int name, const char *name_str, int value)
+{
+  char msg[64];
+
+  if (setsockopt(sd, level, name, &value, sizeof(value)) < 0) {
+    snprintf(msg, sizeof(msg), "ERROR: server setsockopt(%s)", name_str);
+    perror(msg);
+  } /* end if */
+} /* end of set_option */
@@ -8,8 +8,33 @@
 #ifndef _PASSIVE_TCP_H
 #define _PASSIVE_TCP_H
 
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+/*
+ * Options of a listening socket.  A value of 0 keeps the default of the
+ * system (for the backlog: SOMAXCONN).  The buffer sizes and TCP_NODELAY
+ * are inherited by the accepted sockets.
+ */
+typedef struct passive_tcp_opts {
+  int backlog;       /* length of the queue of established connections */
+  int reuseport;     /* several sockets may listen on the port */
+  int defer_accept;  /* TCP_DEFER_ACCEPT: seconds to wait for the request */
+  int fastopen;      /* TCP_FASTOPEN: length of the queue of pending
+                        TFO connections, 0 disables TFO */
+  int rcvbuf;        /* SO_RCVBUF in bytes */
+  int sndbuf;        /* SO_SNDBUF in bytes */
+  int nodelay;       /* TCP_NODELAY */
+  int v6only;        /* IPV6_V6ONLY: an IPv6 socket does not accept IPv4
+                        clients, so that a socket of the same port can be
+                        bound to an IPv4 address */
+} passive_tcp_opts_t;
+
 unsigned short get_port_from_name(const char *service);
 
-int passive_tcp(unsigned short port, int qlen);
+int passive_tcp(const struct addrinfo *ai, const passive_tcp_opts_t *opts);
+
+int get_passive_tcp_opts(int sd, passive_tcp_opts_t *opts);
 
 #endif
@@ -30,8 +30,10 @@ get_socket_info(struct sockaddr_in from_sa, struct socket_info *si)
 
   strncpy(si->name,
 	  (from_he) ? from_he->h_name : inet_ntoa(from_sa.sin_addr),
-	  sizeof(si->name));
-  strncpy(si->addr, inet_ntoa(from_sa.sin_addr), sizeof(si->addr));
+	  sizeof(si->name) - 1);
+  si->name[sizeof(si->name) - 1] = '\0';
+  strncpy(si->addr, inet_ntoa(from_sa.sin_addr), sizeof(si->addr) - 1);
+  si->addr[sizeof(si->addr) - 1] = '\0';
   si->port = ntohs(from_sa.sin_port);
 } /* end of get_socket_info */
 
@@ -68,3 +70,39 @@ get_socket_peer(int fd, struct socket_info *si)
 
   return retcode;
 } /* end of get_socket_peer */
+
+
+/*
+ * Writes the numeric address of an IPv4 or IPv6 socket address to buf,
+ * which should hold SOCKET_ADDRSTRLEN characters.  IPv4 addresses mapped
+ * into IPv6 (the clients of a dual-stack socket) are written in the IPv4
+ * notation.  Returns the port, -1 for other address families.
+ */
+int
+format_socket_addr(const struct sockaddr *sa, char *buf, size_t size)
+{
+  const struct sockaddr_in *sin;
+  const struct sockaddr_in6 *sin6;
+
+  if (sa->sa_family == AF_INET) {
+    sin = (const struct sockaddr_in *)sa;
+    inet_ntop(AF_INET, &sin->sin_addr, buf, size);
+    return ntohs(sin->sin_port);
+  } /* end if */
+
+  if (sa->sa_family == AF_INET6) {
+    sin6 = (const struct sockaddr_in6 *)sa;
+    if (IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
+      /* the last four bytes are the IPv4 address */
+      inet_ntop(AF_INET, &sin6->sin6_addr.s6_addr[12], buf, size);
+    } else {
+      inet_ntop(AF_INET6, &sin6->sin6_addr, buf, size);
+    } /* end if */
+    return ntohs(sin6->sin6_port);
+  } /* end if */
+
+  if (size > 0) {
+    buf[0] = '\0';
+  } /* end if */
+  return -1;
+} /* end of format_socket_addr */
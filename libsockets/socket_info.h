@@ -15,6 +15,9 @@
 #include <netdb.h>
 #include <string.h>
 
+/* maximum length of an address formatted by format_socket_addr() */
+#define SOCKET_ADDRSTRLEN  INET6_ADDRSTRLEN
+
 struct socket_info {
   char name[100];
   char addr[20];
@@ -27,4 +30,6 @@ int get_socket_name(int fd, struct socket_info *si);
 
 int get_socket_peer(int fd, struct socket_info *si);
 
+int format_socket_addr(const struct sockaddr *sa, char *buf, size_t size);
+
 #endif
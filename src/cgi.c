@@ -0,0 +1,277 @@
+/*! \file       cgi.c
+ *  \author     Wolfram Reinke
+ *  \date       October 17, 2026
+ *  \brief      Parsing the header block of the output of CGI scripts.
+ *
+ *  See cgi.h for API documentation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "cgi.h"
+
+/*! The fields which are written by the server and not passed through */
+static const char *server_fields[] = {
+    "Connection", "Date", "Keep-Alive", "Server", "Transfer-Encoding", NULL
+};
+
+/* helper functions, defined at the bottom of the file */
+static int field_is(const char *name, size_t name_len, const char *field);
+static int parse_status(const char *value, size_t len, cgi_header_t *hdr);
+static http_status_t status_of_code(int code);
+
+/* --------------------------------------------------------------------------
+ *  cgi_header_end(buf, len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Finds the empty line which terminates the header block.
+ *
+ *  Scripts may end their lines with LF or CRLF.
+ *
+ *  \param buf  The beginning of the output of a script.
+ *  \param len  The number of bytes in buf.
+ *
+ *  \return  The length of the header block including the empty line, 0 if
+ *           the header block is not complete yet.
+ */
+size_t
+cgi_header_end(const char *buf, size_t len) {
+
+    size_t i;
+
+    /* a script without any fields is rejected by cgi_parse_header() */
+    if (len >= 1 && buf[0] == '\n') {
+        return 1;
+    }
+    if (len >= 2 && buf[0] == '\r' && buf[1] == '\n') {
+        return 2;
+    }
+
+    for (i = 0; i + 1 < len; i++) {
+        if (buf[i] != '\n') {
+            continue;
+        }
+        if (buf[i + 1] == '\n') {
+            return i + 2;
+        }
+        if (i + 2 < len && buf[i + 1] == '\r' && buf[i + 2] == '\n') {
+            return i + 3;
+        }
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  cgi_parse_header(buf, len, hdr)
+ * -------------------------------------------------------------------------- */
+/*! \brief Interprets the header block of a script.
+ *
+ *  A Location field without a Status field redirects the client with status
+ *  302.  The fields Connection, Date, Keep-Alive, Server and
+ *  Transfer-Encoding are dropped, as the server sends its own.
+ *
+ *  \param buf  The header block, as found by cgi_header_end().
+ *  \param len  The length of the header block.
+ *  \param hdr  The interpreted fields.
+ *
+ *  \return  0 on success, -1 if the header block is malformed or has none of
+ *           the fields Content-Type, Location and Status.
+ */
+int
+cgi_parse_header(const char *buf, size_t len, cgi_header_t *hdr) {
+
+    const char *line, *end = buf + len, *eol, *colon, *value;
+    size_t name_len, value_len;
+    int has_status = 0, has_location = 0, has_type = 0, i, cnt;
+
+    hdr->code            = 200;
+    hdr->status          = HTTP_STATUS_OK;
+    hdr->content_length  = -1;
+    hdr->content_type[0] = '\0';
+    hdr->content_encoded = 0;
+    hdr->fields_len      = 0;
+    snprintf(hdr->reason, sizeof(hdr->reason), "%s",
+             http_status_list[HTTP_STATUS_OK].text);
+
+    for (line = buf; line < end; line = eol + 1) {
+
+        if ((eol = memchr(line, '\n', end - line)) == NULL) {
+            eol = end;
+        }
+        name_len = eol - line;
+        if (name_len > 0 && line[name_len - 1] == '\r') {
+            name_len--;
+        }
+        if (name_len == 0) {
+            break;              /* the empty line */
+        }
+
+        if ((colon = memchr(line, ':', name_len)) == NULL || colon == line) {
+            return -1;
+        }
+        value     = colon + 1;
+        value_len = name_len - (value - line);
+        name_len  = colon - line;
+        while (value_len > 0 && (*value == ' ' || *value == '\t')) {
+            value++;
+            value_len--;
+        }
+        while (value_len > 0 && (value[value_len - 1] == ' ' ||
+                                 value[value_len - 1] == '\t')) {
+            value_len--;
+        }
+
+        if (field_is(line, name_len, "Status")) {
+            if (parse_status(value, value_len, hdr) < 0) {
+                return -1;
+            }
+            has_status = 1;
+            continue;
+        }
+        if (field_is(line, name_len, "Content-Length")) {
+            char digits[32], *digits_end;
+
+            if (value_len == 0 || value_len >= sizeof(digits)) {
+                return -1;
+            }
+            memcpy(digits, value, value_len);
+            digits[value_len] = '\0';
+            hdr->content_length = strtoll(digits, &digits_end, 10);
+            if (*digits_end != '\0' || hdr->content_length < 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        for (i = 0; server_fields[i] != NULL; i++) {
+            if (field_is(line, name_len, server_fields[i])) {
+                break;
+            }
+        }
+        if (server_fields[i] != NULL) {
+            continue;
+        }
+
+        has_location |= field_is(line, name_len, "Location");
+        hdr->content_encoded |= field_is(line, name_len, "Content-Encoding");
+        if (field_is(line, name_len, "Content-Type")) {
+            has_type = 1;
+            snprintf(hdr->content_type, sizeof(hdr->content_type), "%.*s",
+                     (int)value_len, value);
+        }
+
+        cnt = snprintf(hdr->fields + hdr->fields_len,
+                       sizeof(hdr->fields) - hdr->fields_len, "%.*s: %.*s\r\n",
+                       (int)name_len, line, (int)value_len, value);
+        if (cnt < 0 || (size_t)cnt >= sizeof(hdr->fields) - hdr->fields_len) {
+            return -1;
+        }
+        hdr->fields_len += cnt;
+    }
+
+    if (!has_status && !has_location && !has_type) {
+        return -1;
+    }
+    if (has_location && !has_status) {
+        hdr->code   = 302;
+        hdr->status = HTTP_STATUS_FOUND;
+        snprintf(hdr->reason, sizeof(hdr->reason), "%s",
+                 http_status_list[HTTP_STATUS_FOUND].text);
+    }
+    return 0;
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  field_is(name, name_len, field)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compares a field name case-insensitively.
+ */
+static int
+field_is(const char *name, size_t name_len, const char *field) {
+
+    return strlen(field) == name_len &&
+           strncasecmp(name, field, name_len) == 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  parse_status(value, len, hdr)
+ * -------------------------------------------------------------------------- */
+/*! \brief Parses the value of a Status field, a code and a reason phrase.
+ *
+ *  If the script does not send a reason phrase, the phrase of a code known to
+ *  tinyweb is used.
+ *
+ *  \return  0 on success, -1 if the code is invalid.
+ */
+static int
+parse_status(const char *value, size_t len, cgi_header_t *hdr) {
+
+    size_t i;
+    int code = 0;
+
+    for (i = 0; i < 3; i++) {
+        if (i >= len || value[i] < '0' || value[i] > '9') {
+            return -1;
+        }
+        code = code * 10 + (value[i] - '0');
+    }
+    if (code < 100 || (len > 3 && value[3] != ' ' && value[3] != '\t')) {
+        return -1;
+    }
+    while (i < len && (value[i] == ' ' || value[i] == '\t')) {
+        i++;
+    }
+
+    hdr->code   = code;
+    hdr->status = status_of_code(code);
+    if (i < len) {
+        snprintf(hdr->reason, sizeof(hdr->reason), "%.*s", (int)(len - i),
+                 value + i);
+    }
+    else if (http_status_list[hdr->status].code == code) {
+        snprintf(hdr->reason, sizeof(hdr->reason), "%s",
+                 http_status_list[hdr->status].text);
+    }
+    else {
+        hdr->reason[0] = '\0';
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  status_of_code(code)
+ * -------------------------------------------------------------------------- */
+/*! \brief Maps a status code to the status known to tinyweb.
+ *
+ *  Codes without an entry in http_status_list are counted as 200, 302, 400
+ *  or 500, depending on their class.
+ */
+static http_status_t
+status_of_code(int code) {
+
+    int i;
+
+    for (i = 0; i <= HTTP_STATUS_NOT_IMPLEMENTED; i++) {
+        if (http_status_list[i].code == code) {
+            return (http_status_t)i;
+        }
+    }
+
+    switch (code / 100) {
+        case 3:
+            return HTTP_STATUS_FOUND;
+        case 4:
+            return HTTP_STATUS_BAD_REQUEST;
+        case 5:
+            return HTTP_STATUS_INTERNAL_SERVER_ERROR;
+        default:
+            return HTTP_STATUS_OK;
+    }
+}
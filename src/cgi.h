@@ -0,0 +1,50 @@
+/*! \file       cgi.h
+ *  \author     Wolfram Reinke
+ *  \date       October 17, 2026
+ *  \brief      Parsing the header block of the output of CGI scripts.
+ *
+ *  A CGI script starts its output with header fields and an empty line (RFC
+ *  3875, section 6).  The fields Status, Location and Content-Length are
+ *  interpreted by the server, which writes the status line and the framing
+ *  of the response itself; all other fields, e.g. Content-Type, are passed
+ *  through to the client.
+ */
+
+#ifndef _CGI_H_
+#define _CGI_H_
+
+#include <sys/types.h>
+
+#include "http.h"
+
+/*! Maximum size of the header block of a script */
+#define CGI_MAX_HEADER      4096
+
+/*! \brief The interpreted header block of a script. */
+typedef struct {
+    int           code;             /*!< the status code sent to the client,
+                                         200 unless the script sends a Status
+                                         or Location field */
+    char          reason[64];       /*!< the reason phrase of the status */
+    http_status_t status;           /*!< the status for the log and the
+                                         statistics, the class of the code if
+                                         it is not known to tinyweb */
+    off_t         content_length;   /*!< the length of the body, -1 if the
+                                         script did not send it */
+    char          content_type[128]; /*!< the value of the Content-Type field,
+                                         empty if it is missing */
+    int           content_encoded;  /*!< whether the script sent a
+                                         Content-Encoding field, that is,
+                                         compressed the body itself */
+    char          fields[CGI_MAX_HEADER]; /*!< the fields passed through, each
+                                         terminated by CRLF */
+    size_t        fields_len;       /*!< the length of fields */
+} cgi_header_t;
+
+size_t
+cgi_header_end(const char *buf, size_t len);
+
+int
+cgi_parse_header(const char *buf, size_t len, cgi_header_t *hdr);
+
+#endif // _CGI_H_
@@ -14,46 +14,68 @@
  *
  *===================================================================*/
 
+#include <ctype.h>
+#include <stdint.h>
 #include <string.h>
 #include "content.h"
 
-/*! \brief The content tyes and content information. */
-static http_content_type_entry_t http_content_type_list[] = {
-    { ".html",    "text/html"          },
-    { ".css",     "text/css"           },
-    { ".gif",     "image/gif"          },
-    { ".jpg",     "image/jpeg"         },
-    { ".pdf",     "application/pdf"    },
-    { ".tar",     "application/x-tar"  },
-    { ".xml",     "application/xml"    },
-    { NULL,       "text/plain"         }
-};
+/* The content types and the perfect hash table of the file extensions,
+ * generated from src/mime.types by tools/gen_mime.pl (see the Makefile). */
+#include "mime_table.h"
+
+static uint32_t mime_hash_mix(uint32_t hash);
 
 /* --------------------------------------------------------------------------
  *  get_http_content_type(const char *filename)
  * -------------------------------------------------------------------------- */
 /*! \brief Processes filenames to fetch content types.
  *
- *  Fetches the content type based on the filname ending.
- *  
+ *  Fetches the content type based on the file extension, i.e. the part of
+ *  the last path component behind its last dot, compared case-insensitively.
+ *  The extension is looked up in a perfect hash table, so the cost does not
+ *  depend on the number of known types.
+ *
  *  \param filename     The filename used for content type detection.
  *
- *  \return             the http_content_type_t.
+ *  \return             the http_content_type_t, HTTP_CONTENT_TYPE_DEFAULT
+ *                      if the extension is unknown.
  */
 http_content_type_t
 get_http_content_type(const char *filename)
 {
-    int i;
+    const char *base, *dot;
+    const mime_hash_slot_t *slot;
+    char ext[MIME_EXT_MAX + 1];
+    uint32_t hash;
+    size_t len, i;
+
+    base = strrchr(filename, '/');
+    base = (base != NULL) ? base + 1 : filename;
+    dot  = strrchr(base, '.');
+    if (dot == NULL || dot == base) {
+        return HTTP_CONTENT_TYPE_DEFAULT;
+    } /* end if */
+
+    len = strlen(dot + 1);
+    if (len == 0 || len > MIME_EXT_MAX) {
+        return HTTP_CONTENT_TYPE_DEFAULT;
+    } /* end if */
+
+    /* FNV-1a of the lower-case extension, as in tools/gen_mime.pl */
+    hash = 2166136261u;
+    for (i = 0; i < len; i++) {
+        ext[i] = tolower((unsigned char)dot[1 + i]);
+        hash   = (hash ^ (unsigned char)ext[i]) * 16777619u;
+    } /* end for */
+    ext[len] = '\0';
 
-    i = 0;
-    while (http_content_type_list[i].ext != NULL) {
-        if (strstr(filename, http_content_type_list[i].ext)) {
-            break;
-        } /* end if */
-        i++;
-    } /* end while */
+    hash ^= mime_hash_seeds[hash & (MIME_HASH_BUCKETS - 1)];
+    slot  = &mime_hash_slots[mime_hash_mix(hash) & (MIME_HASH_SLOTS - 1)];
+    if (slot->ext == NULL || strcmp(slot->ext, ext) != 0) {
+        return HTTP_CONTENT_TYPE_DEFAULT;
+    } /* end if */
 
-    return (http_content_type_t)i;
+    return slot->type;
 } /* end of get_http_content_type */
 
 /* --------------------------------------------------------------------------
@@ -67,9 +89,26 @@ get_http_content_type(const char *filename)
  *
  *  \return         The string definition of the given http_content_type.
  */
-char *
+const char *
 get_http_content_type_str(const http_content_type_t type)
 {
-    return http_content_type_list[type].name;
+    return mime_type_names[type];
 } /* end of get_http_content_type_str */
 
+/* --------------------------------------------------------------------------
+ *  mime_hash_mix(uint32_t hash)
+ * -------------------------------------------------------------------------- */
+/*! \brief Mixes the bits of a hash value (the MurmurHash3 finalizer), so the
+ *         seed of a bucket changes the slot of every extension in it.
+ */
+static uint32_t
+mime_hash_mix(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+} /* end of mime_hash_mix */
+
@@ -0,0 +1,174 @@
+/*! \file       date_cache.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Cached formatting of HTTP dates and log timestamps.
+ *
+ *  See date_cache.h for API documentation.
+ */
+
+#include <time.h>
+
+#include "date_cache.h"
+
+/* the names are fixed by RFC 1123 and the Common Log Format, independent of
+ * the locale */
+static const char *day_names[] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+static const char *month_names[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+/*! \brief The most recently formatted timestamps. */
+typedef struct {
+    time_t http_date;                 /*!< timestamp of http */
+    time_t log_date;                  /*!< timestamp of log */
+    char http[HTTP_DATE_SIZE];        /*!< formatted RFC 1123 date */
+    char log[LOG_DATE_SIZE];          /*!< formatted log timestamp */
+} date_cache_t;
+
+static date_cache_t cache = { -1, -1, "", "" };
+
+/* helper functions, defined at the bottom of the file */
+static char *put_name(char *p, const char *name);
+static char *put_digits(char *p, int value, int digits);
+
+/* --------------------------------------------------------------------------
+ *  format_http_date(date, buf)
+ * -------------------------------------------------------------------------- */
+/*! \brief Formats a timestamp as RFC 1123 date, without caching.
+ *
+ *  Equivalent to strftime() with the format "%a, %d %b %Y %H:%M:%S GMT" in
+ *  the C locale.  Used for timestamps which are cached elsewhere, e.g. the
+ *  modification times of cached files.
+ *
+ *  \param date  The timestamp.
+ *  \param buf   A buffer of at least HTTP_DATE_SIZE bytes.
+ */
+void
+format_http_date(time_t date, char *buf) {
+
+    struct tm tm;
+    char *p = buf;
+
+    gmtime_r(&date, &tm);
+
+    p = put_name(p, day_names[tm.tm_wday]);
+    *p++ = ',';
+    *p++ = ' ';
+    p = put_digits(p, tm.tm_mday, 2);
+    *p++ = ' ';
+    p = put_name(p, month_names[tm.tm_mon]);
+    *p++ = ' ';
+    p = put_digits(p, (tm.tm_year + 1900) % 10000, 4);
+    *p++ = ' ';
+    p = put_digits(p, tm.tm_hour, 2);
+    *p++ = ':';
+    p = put_digits(p, tm.tm_min, 2);
+    *p++ = ':';
+    p = put_digits(p, tm.tm_sec, 2);
+    p = put_name(p, " GMT");
+    *p = '\0';
+}
+
+
+/* --------------------------------------------------------------------------
+ *  date_cache_http(date)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns a timestamp formatted as RFC 1123 date.
+ *
+ *  \param date  The timestamp, usually the current time.
+ *
+ *  \return  The formatted date, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+ */
+const char *
+date_cache_http(time_t date) {
+
+    if (date != cache.http_date) {
+        format_http_date(date, cache.http);
+        cache.http_date = date;
+    }
+    return cache.http;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  date_cache_log(date)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns a timestamp formatted for the Common Log Format.
+ *
+ *  Equivalent to strftime() with the format "%d/%b/%Y:%H:%M:%S %z" for a UTC
+ *  time in the C locale.
+ *
+ *  \param date  The timestamp, usually the current time.
+ *
+ *  \return  The formatted timestamp, e.g. "06/Nov/1994:08:49:37 +0000".
+ */
+const char *
+date_cache_log(time_t date) {
+
+    struct tm tm;
+    char *p = cache.log;
+
+    if (date == cache.log_date) {
+        return cache.log;
+    }
+
+    gmtime_r(&date, &tm);
+
+    p = put_digits(p, tm.tm_mday, 2);
+    *p++ = '/';
+    p = put_name(p, month_names[tm.tm_mon]);
+    *p++ = '/';
+    p = put_digits(p, (tm.tm_year + 1900) % 10000, 4);
+    *p++ = ':';
+    p = put_digits(p, tm.tm_hour, 2);
+    *p++ = ':';
+    p = put_digits(p, tm.tm_min, 2);
+    *p++ = ':';
+    p = put_digits(p, tm.tm_sec, 2);
+    p = put_name(p, " +0000");
+    *p = '\0';
+
+    cache.log_date = date;
+    return cache.log;
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  put_name(p, name)
+ * -------------------------------------------------------------------------- */
+/*! \brief Copies a string without its terminating '\0'.
+ *
+ *  \return  The position behind the copied string.
+ */
+static char *
+put_name(char *p, const char *name) {
+
+    while (*name != '\0') {
+        *p++ = *name++;
+    }
+    return p;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  put_digits(p, value, digits)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes a non-negative number with a fixed number of digits.
+ *
+ *  \return  The position behind the written digits.
+ */
+static char *
+put_digits(char *p, int value, int digits) {
+
+    int i;
+
+    for (i = digits - 1; i >= 0; i--) {
+        p[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return p + digits;
+}
@@ -0,0 +1,38 @@
+/*! \file       date_cache.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Cached formatting of HTTP dates and log timestamps.
+ *
+ *  Every response contains a Date header field and every request is logged
+ *  with a timestamp, but both only change once per second.  The functions of
+ *  this module format a timestamp only if it differs from the one formatted
+ *  by the previous call and otherwise return the previous string, so that
+ *  gmtime() and the formatting are not repeated for every response.
+ *
+ *  The returned strings are owned by the module and remain valid until the
+ *  next call of the same function.  Every process has a cache of its own.
+ */
+
+#ifndef _DATE_CACHE_H_
+#define _DATE_CACHE_H_
+
+#include <time.h>
+
+/*! \brief The size of a buffer for an RFC 1123 date, e.g.
+ *         "Sun, 06 Nov 1994 08:49:37 GMT", including the terminating '\0'. */
+#define HTTP_DATE_SIZE      30
+
+/*! \brief The size of a buffer for a log timestamp, e.g.
+ *         "06/Nov/1994:08:49:37 +0000", including the terminating '\0'. */
+#define LOG_DATE_SIZE       27
+
+void
+format_http_date(time_t date, char *buf);
+
+const char *
+date_cache_http(time_t date);
+
+const char *
+date_cache_log(time_t date);
+
+#endif // _DATE_CACHE_H_
@@ -0,0 +1,963 @@
+/*! \file       event_loop.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Non-blocking epoll event loop engine.
+ *
+ *  See event_loop.h for API documentation.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "request.h"
+#include "response.h"
+#include "socket_info.h"
+#include "stats.h"
+#include "trace.h"
+#include "worker.h"
+
+#include "event_loop.h"
+
+#define MAX_EVENTS          256
+
+/*! \brief The processing stages of a client connection. */
+typedef enum {
+    CONN_READ = 0,          /*!< waiting for a complete request header */
+    CONN_PARSE,             /*!< a request header is buffered */
+    CONN_WRITE_HEADER,      /*!< sending the response header */
+    CONN_SENDFILE,          /*!< sending the requested file (or ranges of
+                                 it) */
+    CONN_DONE,              /*!< the response has been sent completely */
+    CONN_CGI                /*!< a child process is serving a CGI request */
+} conn_state_t;
+
+/*! \brief The result of a single processing step of a connection. */
+typedef enum {
+    STEP_NEXT = 0,          /*!< continue with the next state immediately */
+    STEP_AGAIN,             /*!< wait until the socket becomes ready */
+    STEP_CLOSE              /*!< close the connection */
+} conn_step_t;
+
+/*! \brief The state of a single client connection. */
+typedef struct connection {
+    int sd;                           /*!< the client socket descriptor */
+    conn_state_t state;               /*!< the current processing stage */
+    uint32_t events;                  /*!< the registered epoll events */
+    char client_ip[SOCKET_ADDRSTRLEN]; /*!< the client address for logging */
+
+    char buf[MAX_SIZE_REQUEST];       /*!< received data, may contain
+                                           pipelined requests */
+    size_t buf_len;                   /*!< number of bytes in buf */
+    size_t req_start;                 /*!< offset of the next request */
+    request_parser_t parser;          /*!< parser of the next request */
+    const char *request;              /*!< first line of the current request
+                                           for the log, points into buf */
+    request_t req;                    /*!< the parsed current request */
+    response_t res;                   /*!< the response to the request */
+    trace_request_t trace;            /*!< the stage timing of the request */
+
+    char header[MAX_SIZE_HEADER];     /*!< the formatted response header */
+    size_t header_len;                /*!< length of the response header */
+    size_t header_sent;               /*!< bytes of the header already sent */
+    int fd;                           /*!< the file to send, -1 if none */
+    int cgi_fd;                       /*!< the status pipe of the child serving
+                                           a CGI request, -1 if none */
+    int part;                         /*!< next part of the body to send */
+    size_t part_sent;                 /*!< bytes of the header of the part
+                                           already sent */
+    off_t offset;                     /*!< next file offset to send */
+    off_t remaining;                  /*!< bytes of the current range of the
+                                           file still to send */
+    off_t bytes_sent;                 /*!< bytes sent for this response */
+    uint64_t stage_start;             /*!< start of the current stage of the
+                                           response; the time of the accept
+                                           until the first request, 0 while
+                                           waiting for another request */
+
+    time_t last_active;               /*!< time of the last I/O activity */
+    struct connection *prev;          /*!< previous connection in the
+                                           activity list (less active) */
+    struct connection *next;          /*!< next connection in the activity
+                                           list (more recently active) */
+} connection_t;
+
+/*! \brief The state of an event loop. */
+typedef struct {
+    int epfd;                         /*!< the epoll instance */
+    int sd_servers[MAX_LISTENERS];    /*!< the listening sockets */
+    int n_servers;                    /*!< number of listening sockets */
+    int spare_fd;                     /*!< reserved descriptor, released to
+                                           reject clients when out of fds */
+    int accepting;                    /*!< whether new clients are accepted */
+    int served;                       /*!< number of answered requests */
+    prog_options_t *opt;              /*!< the program options */
+    connection_t *oldest;             /*!< least recently active connection */
+    connection_t *newest;             /*!< most recently active connection */
+} event_loop_t;
+
+/* helper functions, defined at the bottom of the file */
+static void accept_clients(event_loop_t *loop, int sd_server);
+static void stop_accepting(event_loop_t *loop);
+static void conn_run(event_loop_t *loop, connection_t *conn);
+static conn_step_t conn_read(connection_t *conn);
+static conn_step_t conn_parse(event_loop_t *loop, connection_t *conn);
+static conn_step_t conn_write_header(connection_t *conn);
+static conn_step_t conn_sendfile(connection_t *conn);
+static conn_step_t conn_done(event_loop_t *loop, connection_t *conn);
+static conn_step_t conn_serve_cgi(event_loop_t *loop, connection_t *conn,
+        const char *filename);
+static conn_step_t conn_resume_cgi(event_loop_t *loop, connection_t *conn);
+static void conn_touch(event_loop_t *loop, connection_t *conn);
+static void conn_unlink(event_loop_t *loop, connection_t *conn);
+static void conn_close(event_loop_t *loop, connection_t *conn);
+static void expire_connections(event_loop_t *loop, time_t now);
+static void raise_fd_limit(void);
+
+/* --------------------------------------------------------------------------
+ *  run_event_loop(sd_servers, n_servers, opt, running)
+ * -------------------------------------------------------------------------- */
+/*! \brief Accepts and serves clients until the server is stopped.
+ *
+ *  The listening sockets are switched to non-blocking mode and multiplexed
+ *  with epoll, together with all accepted client sockets.  Idle connections are closed
+ *  after opt->timeout seconds.  If opt->max_requests is not 0, the loop stops
+ *  accepting new clients after this number of answered requests and returns
+ *  as soon as the open connections are finished, so that a worker process can
+ *  be recycled.
+ *
+ *  CGI scripts are executed in a forked child process which takes over the
+ *  client connection, as in the fork based engine.  A persistent connection
+ *  is handed back to the loop when the child has sent the response.
+ *
+ *  \param sd_servers The listening sockets.
+ *  \param n_servers  The number of listening sockets (up to MAX_LISTENERS).
+ *  \param opt        The program options.
+ *  \param running    The loop returns as soon as this flag becomes false.  All
+ *                    open connections are closed in that case.
+ *
+ *  \return  0 on a regular shutdown, -1 if the event loop could not be set up.
+ */
+int
+run_event_loop(const int *sd_servers, int n_servers, prog_options_t *opt,
+        volatile sig_atomic_t *running) {
+
+    struct epoll_event ev, events[MAX_EVENTS];
+    event_loop_t loop;
+    int i, n;
+
+    memset(&loop, 0, sizeof(loop));
+    memcpy(loop.sd_servers, sd_servers, n_servers * sizeof(int));
+    loop.n_servers = n_servers;
+    loop.opt       = opt;
+    loop.accepting = 1;
+
+    raise_fd_limit();
+
+    /* a client closing its connection must not terminate the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < n_servers; i++) {
+        if (fcntl(sd_servers[i], F_SETFL,
+                  fcntl(sd_servers[i], F_GETFL) | O_NONBLOCK) < 0) {
+            perror("ERROR: fcntl(O_NONBLOCK)");
+            return -1;
+        }
+    }
+
+    if ((loop.epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        perror("ERROR: epoll_create1()");
+        return -1;
+    }
+
+    /* when several workers wait on the same listening socket, only one of
+     * them is woken up for a new client.  A listening socket is registered
+     * with its index, which is never the address of a connection */
+    for (i = 0; i < n_servers; i++) {
+        ev.events   = EPOLLIN | (opt->workers > 0 ? EPOLLEXCLUSIVE : 0);
+        ev.data.u64 = i;
+        if (epoll_ctl(loop.epfd, EPOLL_CTL_ADD, sd_servers[i], &ev) < 0) {
+            perror("ERROR: epoll_ctl(listener)");
+            close(loop.epfd);
+            return -1;
+        }
+    }
+
+    loop.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    while (*running && (loop.accepting || loop.newest != NULL)) {
+
+        n = epoll_wait(loop.epfd, events, MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: epoll_wait()");
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            connection_t *conn = (connection_t *)events[i].data.ptr;
+
+            if (events[i].data.u64 < MAX_LISTENERS) {
+                accept_clients(&loop, loop.sd_servers[events[i].data.u64]);
+            }
+            else {
+                conn_touch(&loop, conn);
+                conn_run(&loop, conn);
+            }
+        }
+
+        /* reap the child processes which served CGI requests */
+        while (waitpid(-1, NULL, WNOHANG) > 0);
+
+        expire_connections(&loop, time(NULL));
+    }
+
+    while (loop.newest != NULL) {
+        conn_close(&loop, loop.newest);
+    }
+    if (loop.spare_fd >= 0) {
+        close(loop.spare_fd);
+    }
+    close(loop.epfd);
+
+    log_cache_stats();
+    if (opt->verbose) {
+        printf("[%d] Event loop answered %d requests.\n", getpid(),
+                loop.served);
+    }
+    return 0;
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  accept_clients(loop, sd_server)
+ * -------------------------------------------------------------------------- */
+/*! \brief Accepts all pending clients of a listening socket and registers
+ *         them with the loop.
+ */
+static void
+accept_clients(event_loop_t *loop, int sd_server) {
+
+    struct sockaddr_storage sa;
+    socklen_t sa_len;
+    struct epoll_event ev;
+
+    while (loop->accepting) {
+
+        sa_len = sizeof(sa);
+        int sd = accept4(sd_server, (struct sockaddr *)&sa, &sa_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (sd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && loop->spare_fd >= 0) {
+                /* out of descriptors: the pending client would wake us up
+                 * again and again, so accept and close it immediately */
+                close(loop->spare_fd);
+                if ((sd = accept(sd_server, NULL, NULL)) >= 0) {
+                    close(sd);
+                }
+                loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("ERROR: accept()");
+            }
+            return;
+        }
+
+        worker_count_accept();
+
+        connection_t *conn = (connection_t *)calloc(1, sizeof(connection_t));
+        if (conn == NULL) {
+            err_print("cannot allocate memory");
+            close(sd);
+            continue;
+        }
+
+        conn->sd     = sd;
+        conn->fd     = -1;
+        conn->cgi_fd = -1;
+        conn->state  = CONN_READ;
+        conn->events = EPOLLIN;
+        conn->stage_start = stats_connection_open();
+        request_parser_init(&conn->parser, 0);
+        format_socket_addr((struct sockaddr *)&sa, conn->client_ip,
+                           sizeof(conn->client_ip));
+
+        ev.events   = conn->events;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, sd, &ev) < 0) {
+            perror("ERROR: epoll_ctl(client)");
+            close(sd);
+            free(conn);
+            stats_connection_close();
+            continue;
+        }
+
+        conn_touch(loop, conn);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stop_accepting(loop)
+ * -------------------------------------------------------------------------- */
+/*! \brief Removes the listening sockets from the loop.
+ *
+ *  Used when the request limit of a worker has been reached.  The open
+ *  connections are completed, but not kept alive.
+ */
+static void
+stop_accepting(event_loop_t *loop) {
+
+    int i;
+
+    if (loop->accepting) {
+        for (i = 0; i < loop->n_servers; i++) {
+            epoll_ctl(loop->epfd, EPOLL_CTL_DEL, loop->sd_servers[i], NULL);
+        }
+        loop->accepting = 0;
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_run(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Advances the state machine of a connection as far as possible.
+ *
+ *  The states are processed until the socket would block or the connection
+ *  is closed.  If the connection has to wait, the registered epoll events are
+ *  adjusted to the current state.
+ */
+static void
+conn_run(event_loop_t *loop, connection_t *conn) {
+
+    conn_step_t step;
+
+    do {
+        switch (conn->state) {
+            case CONN_READ:
+                step = conn_read(conn);
+                break;
+            case CONN_PARSE:
+                step = conn_parse(loop, conn);
+                break;
+            case CONN_WRITE_HEADER:
+                step = conn_write_header(conn);
+                break;
+            case CONN_SENDFILE:
+                step = conn_sendfile(conn);
+                break;
+            case CONN_DONE:
+                step = conn_done(loop, conn);
+                break;
+            case CONN_CGI:
+                step = conn_resume_cgi(loop, conn);
+                break;
+            default:
+                step = STEP_CLOSE;
+                break;
+        }
+    } while (step == STEP_NEXT);
+
+    if (step == STEP_CLOSE) {
+        conn_close(loop, conn);
+        return;
+    }
+    if (conn->state == CONN_CGI) {
+        return;                 /* the socket belongs to the child process */
+    }
+
+    uint32_t events = (conn->state == CONN_READ) ? EPOLLIN : EPOLLOUT;
+    if (events != conn->events) {
+        struct epoll_event ev;
+        ev.events   = events;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, conn->sd, &ev) < 0) {
+            perror("ERROR: epoll_ctl(modify)");
+            conn_close(loop, conn);
+            return;
+        }
+        conn->events = events;
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_read(conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Reads from the client until a complete request header is buffered.
+ *
+ *  A request which is already buffered (pipelined behind the previous one)
+ *  is processed without reading from the socket.  The parser only scans the
+ *  newly received bytes.
+ */
+static conn_step_t
+conn_read(connection_t *conn) {
+
+    ssize_t cnt;
+
+    while (request_parser_run(&conn->parser, conn->buf, conn->buf_len) ==
+            PARSE_INCOMPLETE) {
+
+        /* make room by moving the incomplete request to the front, the
+         * previous requests have been answered */
+        if (conn->req_start > 0) {
+            conn->buf_len -= conn->req_start;
+            memmove(conn->buf, conn->buf + conn->req_start, conn->buf_len);
+            conn->req_start = 0;
+            request_parser_init(&conn->parser, 0);
+            continue;
+        }
+
+        if (conn->buf_len >= MAX_SIZE_REQUEST - 1) {
+            /* header too large, conn_parse() responds with an error */
+            break;
+        }
+
+        cnt = recv(conn->sd, conn->buf + conn->buf_len,
+                   MAX_SIZE_REQUEST - 1 - conn->buf_len, 0);
+        if (cnt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? STEP_AGAIN
+                                                             : STEP_CLOSE;
+        }
+        if (cnt == 0) {
+            return STEP_CLOSE;      /* client closed the connection */
+        }
+
+        conn->buf_len += cnt;
+    }
+
+    conn->state = CONN_PARSE;
+    return STEP_NEXT;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_parse(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Interprets the parsed request and prepares the response.
+ *
+ *  The request stays in the receive buffer until the response has been sent,
+ *  the parser continues with a pipelined request behind it.  The response
+ *  header is formatted and, if a file has to be sent, the file is opened.
+ */
+static conn_step_t
+conn_parse(event_loop_t *loop, connection_t *conn) {
+
+    char filename[MAX_SIZE_URI];
+    http_status_t status;
+    int cnt;
+    uint64_t start = stats_stage(STATS_STAGE_ACCEPT, conn->stage_start);
+
+    /* the accept stage of the first request includes receiving it */
+    trace_begin(&conn->trace, conn->sd, conn->stage_start);
+
+    status = parse_request(&conn->parser, conn->buf, &conn->req);
+    conn->request   = request_line(&conn->parser, conn->buf);
+    conn->req_start = (conn->parser.result == PARSE_DONE) ? conn->parser.end
+                                                          : conn->buf_len;
+    request_parser_init(&conn->parser, conn->req_start);
+
+    /* after a malformed request, the rest of the stream cannot be trusted */
+    if (status == HTTP_STATUS_BAD_REQUEST ||
+            status == HTTP_STATUS_NOT_IMPLEMENTED) {
+        conn->req.keep_alive = FALSE;
+    }
+    if (!loop->accepting) {
+        conn->req.keep_alive = FALSE;
+    }
+
+    cnt = snprintf(filename, MAX_SIZE_URI, "%s%s", loop->opt->root_dir,
+                   conn->req.uri);
+    if (cnt < 0) {
+        status = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    }
+    start = stats_stage(STATS_STAGE_PARSE, start);
+    trace_mark(&conn->trace, TRACE_PARSE);
+
+    generate_response_header(filename, status, &conn->req, &conn->res);
+    conn->stage_start = stats_stage(STATS_STAGE_STAT, start);
+    trace_mark(&conn->trace, TRACE_STAT);
+    conn->res.trace = &conn->trace;
+
+    if (response_has_body(&conn->res)) {
+        if (conn->res.is_cgi) {
+            return conn_serve_cgi(loop, conn, filename);
+        }
+
+        /* the descriptor belongs to the file cache, cached content is sent
+         * together with the header */
+        if (conn->res.cached != NULL) {
+            conn->fd = -1;
+        }
+        else if ((conn->fd = conn->res.file->fd) < 0) {
+            conn->res.status     = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+            conn->res.keep_alive = FALSE;
+        }
+        else {
+            conn->part      = 0;
+            conn->part_sent = 0;
+            conn->remaining = 0;
+        }
+    }
+
+    cnt = format_response_header(&conn->res, conn->header,
+                                 sizeof(conn->header));
+    if (cnt < 0) {
+        return STEP_CLOSE;
+    }
+    conn->header_len  = cnt;
+    conn->header_sent = 0;
+    conn->bytes_sent  = 0;
+
+    conn->state = CONN_WRITE_HEADER;
+    return STEP_NEXT;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_write_header(conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends the (remaining part of the) response header.
+ *
+ *  Pre-rendered content from the file cache is sent by the same call.
+ */
+static conn_step_t
+conn_write_header(connection_t *conn) {
+
+    /* the header and the beginning of the file should share a segment */
+    int flags = MSG_NOSIGNAL | (conn->fd >= 0 ? MSG_MORE : 0);
+    size_t total = conn->header_len + conn->res.cached_len;
+    struct iovec iov[2];
+    struct msghdr msg;
+    ssize_t cnt;
+
+    while (conn->header_sent < total) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        if (conn->header_sent < conn->header_len) {
+            iov[0].iov_base = conn->header + conn->header_sent;
+            iov[0].iov_len  = conn->header_len - conn->header_sent;
+            iov[1].iov_base = (void *)conn->res.cached;
+            iov[1].iov_len  = conn->res.cached_len;
+            msg.msg_iovlen  = (conn->res.cached_len > 0) ? 2 : 1;
+        }
+        else {
+            iov[0].iov_base = (void *)(conn->res.cached +
+                                       (conn->header_sent - conn->header_len));
+            iov[0].iov_len  = total - conn->header_sent;
+            msg.msg_iovlen  = 1;
+        }
+
+        conn->res.syscalls++;
+        cnt = sendmsg(conn->sd, &msg, flags);
+        if (cnt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? STEP_AGAIN
+                                                             : STEP_CLOSE;
+        }
+        conn->header_sent += cnt;
+        conn->bytes_sent  += cnt;
+    }
+    conn->stage_start = stats_stage(STATS_STAGE_HEADER, conn->stage_start);
+    trace_mark(&conn->trace, TRACE_HEADER);
+
+    conn->state = (conn->fd >= 0) ? CONN_SENDFILE : CONN_DONE;
+    return STEP_NEXT;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_sendfile(conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends the (remaining part of the) requested file.
+ *
+ *  The body consists of parts, ranges of the file which are sent one after
+ *  another.  The parts of a multipart/byteranges body are preceded by their
+ *  headers.
+ */
+static conn_step_t
+conn_sendfile(connection_t *conn) {
+
+    const body_part_t *part;
+    off_t start;
+    ssize_t cnt;
+    int rc;
+
+    for (;;) {
+        if (conn->remaining > 0) {
+            start = conn->offset;
+            rc = send_file_range(conn->sd, conn->fd, &conn->offset,
+                                 &conn->remaining, &conn->res.syscalls);
+            conn->bytes_sent += conn->offset - start;
+            if (rc < 0) {
+                return STEP_CLOSE;
+            }
+            if (conn->remaining > 0) {
+                return STEP_AGAIN;
+            }
+        }
+        if (conn->part == conn->res.n_parts) {
+            break;
+        }
+
+        /* the header of the next part shares a segment with its range */
+        part = &conn->res.parts[conn->part];
+        while (conn->part_sent < part->header_len) {
+            conn->res.syscalls++;
+            cnt = send(conn->sd, part->header + conn->part_sent,
+                       part->header_len - conn->part_sent, MSG_NOSIGNAL |
+                       (conn->part + 1 < conn->res.n_parts ? MSG_MORE : 0));
+            if (cnt < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return (errno == EAGAIN || errno == EWOULDBLOCK) ? STEP_AGAIN
+                                                                 : STEP_CLOSE;
+            }
+            conn->part_sent  += cnt;
+            conn->bytes_sent += cnt;
+        }
+        conn->offset    = part->begin;
+        conn->remaining = part->length;
+        conn->part_sent = 0;
+        conn->part++;
+    }
+    stats_stage(STATS_STAGE_BODY, conn->stage_start);
+    trace_mark(&conn->trace, TRACE_BODY);
+
+    conn->state = CONN_DONE;
+    return STEP_NEXT;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_done(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Logs the completed request and prepares for the next one.
+ */
+static conn_step_t
+conn_done(event_loop_t *loop, connection_t *conn) {
+
+    log_request(conn->client_ip, conn->res.date, conn->request,
+                conn->res.status, conn->bytes_sent);
+    stats_request(conn->res.status, conn->bytes_sent);
+    trace_mark(&conn->trace, TRACE_LOG);
+    trace_end(&conn->trace, conn->request, conn->res.status,
+              conn->bytes_sent);
+    conn->stage_start = 0;
+    if (loop->opt->verbose) {
+        printf("[%d] Sent %lld bytes with %d system calls.\n", getpid(),
+                (long long)conn->bytes_sent, conn->res.syscalls);
+    }
+
+    release_response(&conn->res);
+    conn->fd = -1;
+
+    loop->served++;
+    if (loop->opt->max_requests > 0 &&
+            loop->served >= loop->opt->max_requests) {
+        stop_accepting(loop);
+    }
+
+    if (!conn->res.keep_alive) {
+        shutdown(conn->sd, SHUT_WR);
+        return STEP_CLOSE;
+    }
+
+    conn->state = CONN_READ;
+    return STEP_NEXT;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_serve_cgi(loop, conn, filename)
+ * -------------------------------------------------------------------------- */
+/*! \brief Hands a CGI request over to a forked child process.
+ *
+ *  The child process executes the script with the blocking send_response()
+ *  and terminates afterwards.  If the connection is not kept alive, it is
+ *  closed in the event loop right away.  Otherwise, the socket is removed
+ *  from the loop while the child uses it, and the loop waits for the child
+ *  to report through a pipe whether the response has been sent completely.
+ */
+static conn_step_t
+conn_serve_cgi(event_loop_t *loop, connection_t *conn, const char *filename) {
+
+    struct epoll_event ev;
+    int i, status[2] = { -1, -1 };
+    off_t cnt;
+    pid_t pid;
+
+    if (conn->res.keep_alive && pipe2(status, O_CLOEXEC) < 0) {
+        perror("ERROR: pipe2() for CGI script");
+        conn->res.keep_alive = FALSE;
+    }
+
+    if ((pid = fork()) < 0) {
+        perror("ERROR: fork() for CGI script");
+        send_static_500(conn->sd);
+        if (status[0] >= 0) {
+            close(status[0]);
+            close(status[1]);
+        }
+        return STEP_CLOSE;
+    }
+    else if (pid > 0) {
+        if (status[0] < 0) {
+            return STEP_CLOSE;
+        }
+        close(status[1]);
+
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->sd, NULL);
+        ev.events   = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, status[0], &ev) < 0) {
+            perror("ERROR: epoll_ctl(CGI status)");
+            close(status[0]);
+            return STEP_CLOSE;
+        }
+        conn->cgi_fd = status[0];
+        conn->state  = CONN_CGI;
+        return STEP_AGAIN;
+    }
+
+    /* child process: only the CGI connection is kept */
+    connection_t *other, *next;
+    for (other = loop->oldest; other != NULL; other = next) {
+        next = other->next;
+        if (other != conn) {
+            close(other->sd);
+            if (other->cgi_fd >= 0) {
+                close(other->cgi_fd);
+            }
+        }
+    }
+    close(loop->epfd);
+    for (i = 0; i < loop->n_servers; i++) {
+        close(loop->sd_servers[i]);
+    }
+    if (status[0] >= 0) {
+        close(status[0]);
+    }
+
+    signal(SIGPIPE, SIG_DFL);
+    fcntl(conn->sd, F_SETFL, fcntl(conn->sd, F_GETFL) & ~O_NONBLOCK);
+
+    if ((cnt = send_response(conn->sd, filename, &conn->res)) < 0) {
+        send_static_500(conn->sd);
+        shutdown(conn->sd, SHUT_WR);
+        exit(EXIT_FAILURE);
+    }
+
+    log_request(conn->client_ip, conn->res.date, conn->request,
+                conn->res.status, cnt);
+    stats_request(conn->res.status, cnt);
+    trace_mark(&conn->trace, TRACE_LOG);
+    trace_end(&conn->trace, conn->request, conn->res.status, cnt);
+
+    /* the socket shares its flags with the one of the event loop */
+    if (conn->res.keep_alive) {
+        signal(SIGPIPE, SIG_IGN);
+        fcntl(conn->sd, F_SETFL, fcntl(conn->sd, F_GETFL) | O_NONBLOCK);
+        if (write(status[1], "1", 1) == 1) {
+            exit(EXIT_SUCCESS);
+        }
+    }
+    shutdown(conn->sd, SHUT_WR);
+    exit(EXIT_SUCCESS);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_resume_cgi(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Takes a connection back from the child which served a CGI request.
+ *
+ *  The child writes a byte to the status pipe if the connection can be kept
+ *  alive, it just terminates otherwise.  A pipelined request behind the CGI
+ *  request is still in the receive buffer.
+ */
+static conn_step_t
+conn_resume_cgi(event_loop_t *loop, connection_t *conn) {
+
+    struct epoll_event ev;
+    char status;
+    ssize_t cnt;
+
+    while ((cnt = read(conn->cgi_fd, &status, 1)) < 0 && errno == EINTR);
+
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->cgi_fd, NULL);
+    close(conn->cgi_fd);
+    conn->cgi_fd = -1;
+    if (cnt != 1) {
+        return STEP_CLOSE;
+    }
+
+    ev.events   = EPOLLIN;
+    ev.data.ptr = conn;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, conn->sd, &ev) < 0) {
+        perror("ERROR: epoll_ctl(client)");
+        return STEP_CLOSE;
+    }
+    conn->events = EPOLLIN;
+
+    release_response(&conn->res);
+    conn->stage_start = 0;
+    conn->state       = CONN_READ;
+    return STEP_NEXT;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_touch(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Marks a connection as active right now.
+ *
+ *  The connections are kept in a list ordered by their last activity, so that
+ *  expired connections can be found without scanning all of them.
+ */
+static void
+conn_touch(event_loop_t *loop, connection_t *conn) {
+
+    conn->last_active = time(NULL);
+
+    if (loop->newest == conn) {
+        return;
+    }
+    conn_unlink(loop, conn);
+
+    conn->prev = loop->newest;
+    conn->next = NULL;
+    if (loop->newest != NULL) {
+        loop->newest->next = conn;
+    }
+    else {
+        loop->oldest = conn;
+    }
+    loop->newest = conn;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_unlink(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Removes a connection from the activity list (if it is listed).
+ */
+static void
+conn_unlink(event_loop_t *loop, connection_t *conn) {
+
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    }
+    else if (loop->oldest == conn) {
+        loop->oldest = conn->next;
+    }
+
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    else if (loop->newest == conn) {
+        loop->newest = conn->prev;
+    }
+
+    conn->prev = conn->next = NULL;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_close(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Closes a connection and releases all of its resources.
+ */
+static void
+conn_close(event_loop_t *loop, connection_t *conn) {
+
+    conn_unlink(loop, conn);
+
+    /* closing the descriptor is not sufficient if a forked CGI child still
+     * holds a copy of it */
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->sd, NULL);
+    close(conn->sd);
+    if (conn->cgi_fd >= 0) {
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->cgi_fd, NULL);
+        close(conn->cgi_fd);
+    }
+    release_response(&conn->res);
+    free(conn);
+    stats_connection_close();
+}
+
+
+/* --------------------------------------------------------------------------
+ *  expire_connections(loop, now)
+ * -------------------------------------------------------------------------- */
+/*! \brief Closes all connections which were idle for opt->timeout seconds.
+ *
+ *  A connection served by a CGI child process is not idle, it is moved to
+ *  the end of the list instead.
+ */
+static void
+expire_connections(event_loop_t *loop, time_t now) {
+
+    while (loop->oldest != NULL &&
+            now - loop->oldest->last_active >= loop->opt->timeout) {
+        if (loop->oldest->state == CONN_CGI) {
+            conn_touch(loop, loop->oldest);
+        }
+        else {
+            conn_close(loop, loop->oldest);
+        }
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  raise_fd_limit()
+ * -------------------------------------------------------------------------- */
+/*! \brief Raises the soft limit of open descriptors to the hard limit.
+ *
+ *  The default soft limit of 1024 descriptors would restrict the number of
+ *  concurrent connections of the event loop.
+ */
+static void
+raise_fd_limit(void) {
+
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            perror("WARNING: setrlimit(RLIMIT_NOFILE)");
+        }
+    }
+}
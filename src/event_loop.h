@@ -0,0 +1,25 @@
+/*! \file       event_loop.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Non-blocking epoll event loop engine.
+ *
+ *  This module provides run_event_loop(), an alternative to the fork based
+ *  engine.  A single process multiplexes all of its client connections with
+ *  epoll(7).  Every connection is driven by a small state machine (read,
+ *  parse, write header, sendfile) on a non-blocking socket, and HTTP/1.1
+ *  persistent connections are kept open between requests.  Several event
+ *  loops can run side by side in the processes of the worker pool.
+ */
+
+#ifndef _EVENT_LOOP_H_
+#define _EVENT_LOOP_H_
+
+#include <signal.h>
+
+#include "tinyweb.h"
+
+int
+run_event_loop(const int *sd_servers, int n_servers, prog_options_t *opt,
+        volatile sig_atomic_t *running);
+
+#endif // _EVENT_LOOP_H_
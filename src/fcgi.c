@@ -0,0 +1,865 @@
+/*! \file       fcgi.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Pools of persistent FastCGI processes for CGI scripts.
+ *
+ *  See fcgi.h for API documentation.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fcgi.h"
+#include "request.h"
+#include "stats.h"
+#include "tinyweb.h"
+
+/*! Scripts with this suffix are served by a pool */
+#define FCGI_SUFFIX             ".fcgi"
+/*! Maximum number of scripts with a pool at the same time */
+#define FCGI_MAX_POOLS          16
+/*! Maximum number of processes per pool */
+#define FCGI_MAX_POOL_SIZE      64
+/*! Backlog of the listening socket of a pool */
+#define FCGI_BACKLOG            128
+/*! Interval in which the manager reaps processes and expires pools (ms) */
+#define FCGI_MANAGER_TICK_MS    1000
+/*! Size of the buffers for records sent to and read from a script */
+#define FCGI_BUFFER_SIZE        8192
+
+/* FastCGI protocol, see the FastCGI Specification 1.0 */
+#define FCGI_VERSION_1          1
+#define FCGI_HEADER_LEN         8
+#define FCGI_BEGIN_REQUEST      1
+#define FCGI_END_REQUEST        3
+#define FCGI_PARAMS             4
+#define FCGI_STDIN              5
+#define FCGI_STDOUT             6
+#define FCGI_STDERR             7
+#define FCGI_RESPONDER          1
+/*! Every connection carries a single request */
+#define FCGI_REQUEST_ID         1
+
+/*! \brief A pool as seen by all processes of the server. */
+typedef struct {
+    int    ready;                   /*!< whether the socket of the pool
+                                         accepts requests */
+    time_t last_used;               /*!< the time of the last request */
+    char   script[MAX_SIZE_URI];    /*!< the path of the script */
+} fcgi_pool_t;
+
+/*! \brief The memory shared between all processes of the server. */
+typedef struct {
+    int         stop;               /*!< set by the master to stop the
+                                         manager */
+    fcgi_pool_t pools[FCGI_MAX_POOLS];
+} fcgi_shared_t;
+
+/*! \brief The processes of a pool, only known to the manager. */
+typedef struct {
+    int    sd;                      /*!< the listening socket, -1 if the pool
+                                         is not running */
+    pid_t *pids;                    /*!< the processes, 0 if terminated */
+} fcgi_procs_t;
+
+/*! The shared pools, NULL if no manager is running */
+static fcgi_shared_t *shared = NULL;
+
+/*! The process ID of the manager */
+static pid_t manager_pid = -1;
+
+/*! The directory of the sockets, created by fcgi_start_manager() */
+static char socket_dir[] = "/tmp/tinyweb-XXXXXX";
+
+/* helper functions, defined at the bottom of the file */
+static void unix_address(struct sockaddr_un *sa, const char *name);
+static int listen_unix(const char *name, int type);
+static int connect_unix(const char *name, int type);
+static int connect_pool(const char *filename);
+static int request_pool(const char *filename);
+static int send_request(int fd, const char *filename, const char *method,
+        int *syscalls);
+static size_t put_header(unsigned char *buf, int type, size_t content_len);
+static size_t put_param(unsigned char *buf, const char *name,
+        const char *value);
+static int read_all(int fd, void *buf, size_t len, int *syscalls);
+static int write_all(int fd, const void *buf, size_t len, int *syscalls);
+static void manager_loop(int sd_control, int pool_size, int idle_timeout,
+        pid_t master);
+static void serve_control(int sd_control, fcgi_procs_t *procs,
+        int pool_size);
+static int start_pool(const char *script, fcgi_procs_t *procs,
+        int pool_size);
+static void stop_pool(fcgi_procs_t *procs, int index, int pool_size);
+static pid_t spawn_process(int sd, const char *script);
+
+/* --------------------------------------------------------------------------
+ *  fcgi_start_manager(pool_size, idle_timeout)
+ * -------------------------------------------------------------------------- */
+/*! \brief Starts the pool manager process.
+ *
+ *  Must be called by the master process before any other process is forked.
+ *  Pools are started on demand, when a script is requested for the first
+ *  time.  Every process of a pool runs the script with a listening Unix
+ *  socket as its stdin (FCGI_LISTENSOCK_FILENO) and /dev/null as its stdout;
+ *  the processes of a pool compete for the connections.  A process which
+ *  terminates is replaced.
+ *
+ *  \param pool_size     The number of processes per script, 0 disables the
+ *                       pools.
+ *  \param idle_timeout  A pool is terminated after this many seconds without
+ *                       a request, 0 means never.
+ *
+ *  \return  0 on success, -1 if the manager could not be started.  In this
+ *           case, all scripts are executed as plain CGI scripts.
+ */
+int
+fcgi_start_manager(int pool_size, int idle_timeout) {
+
+    pid_t master = getpid();
+    int sd_control;
+
+    if (pool_size <= 0) {
+        return 0;
+    }
+    if (pool_size > FCGI_MAX_POOL_SIZE) {
+        pool_size = FCGI_MAX_POOL_SIZE;
+    }
+
+    shared = (fcgi_shared_t *)mmap(NULL, sizeof(fcgi_shared_t),
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("ERROR: mmap() of FastCGI pools");
+        shared = NULL;
+        return -1;
+    }
+
+    /* the sockets live in a directory only accessible by the server */
+    if (mkdtemp(socket_dir) == NULL) {
+        perror("ERROR: mkdtemp() for FastCGI sockets");
+        munmap(shared, sizeof(fcgi_shared_t));
+        shared = NULL;
+        return -1;
+    }
+    if ((sd_control = listen_unix("control", SOCK_SEQPACKET)) < 0) {
+        rmdir(socket_dir);
+        munmap(shared, sizeof(fcgi_shared_t));
+        shared = NULL;
+        return -1;
+    }
+
+    /* make sure buffered output is not duplicated in the manager */
+    fflush(stdout);
+
+    if ((manager_pid = fork()) < 0) {
+        perror("ERROR: fork() of FastCGI pool manager");
+        close(sd_control);
+        fcgi_stop_manager();
+        return -1;
+    }
+    else if (manager_pid == 0) {
+        manager_loop(sd_control, pool_size, idle_timeout, master);
+    }
+
+    close(sd_control);
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  fcgi_stop_manager()
+ * -------------------------------------------------------------------------- */
+/*! \brief Stops the pool manager, which terminates all pools.
+ *
+ *  Must be called by the master process after all other processes which may
+ *  send requests to a pool have terminated.
+ */
+void
+fcgi_stop_manager(void) {
+
+    struct sockaddr_un sa;
+
+    if (shared == NULL) {
+        return;
+    }
+
+    if (manager_pid > 0) {
+        __atomic_store_n(&shared->stop, 1, __ATOMIC_RELEASE);
+
+        /* the manager may also be reaped by a SIGCHLD handler (ECHILD) */
+        while (waitpid(manager_pid, NULL, 0) < 0 && errno == EINTR);
+    }
+    else {
+        unix_address(&sa, "control");
+        unlink(sa.sun_path);
+        rmdir(socket_dir);
+    }
+
+    munmap(shared, sizeof(fcgi_shared_t));
+    shared      = NULL;
+    manager_pid = -1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  fcgi_open(s, filename, method, syscalls)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends a request to the pool of a script.
+ *
+ *  The request carries the CGI variables GATEWAY_INTERFACE, SERVER_SOFTWARE,
+ *  SERVER_PROTOCOL, REQUEST_METHOD and SCRIPT_FILENAME and an empty body.
+ *  The output of the script is read with fcgi_read().
+ *
+ *  \param s         The stream of the request.
+ *  \param filename  The path of the script (including the root directory).
+ *  \param method    The request method.
+ *  \param syscalls  Incremented by the number of system calls.
+ *
+ *  \return  0 on success, FCGI_UNAVAILABLE if the script is not served by a
+ *           pool or the request could not be sent.
+ */
+int
+fcgi_open(fcgi_stream_t *s, const char *filename, const char *method,
+        int *syscalls) {
+
+    size_t len = strlen(filename), suffix_len = strlen(FCGI_SUFFIX);
+
+    memset(s, 0, sizeof(fcgi_stream_t));
+    s->fd = -1;
+
+    if (shared == NULL || len <= suffix_len ||
+            strcmp(filename + len - suffix_len, FCGI_SUFFIX) != 0) {
+        return FCGI_UNAVAILABLE;
+    }
+
+    if ((s->fd = connect_pool(filename)) < 0) {
+        return FCGI_UNAVAILABLE;
+    }
+    if (send_request(s->fd, filename, method, syscalls) < 0) {
+        fcgi_close(s);
+        return FCGI_UNAVAILABLE;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  fcgi_read(s, buf, size, syscalls)
+ * -------------------------------------------------------------------------- */
+/*! \brief Reads the next part of the FCGI_STDOUT stream of a script.
+ *
+ *  The content of FCGI_STDERR records is written to stderr.  If the pool
+ *  fails before the script has written anything (s->received is 0), the
+ *  script can still be executed as a plain CGI script.
+ *
+ *  \param s         The stream of the request.
+ *  \param buf       The buffer to which the output is written.
+ *  \param size      The size of buf in bytes.
+ *  \param syscalls  Incremented by the number of system calls.
+ *
+ *  \return  The number of bytes read, 0 at FCGI_END_REQUEST, -1 if the
+ *           connection failed.
+ */
+ssize_t
+fcgi_read(fcgi_stream_t *s, char *buf, size_t size, int *syscalls) {
+
+    unsigned char header[FCGI_HEADER_LEN], skip[FCGI_HEADER_LEN + 255];
+    size_t chunk;
+    ssize_t cnt;
+
+    while (!s->done) {
+
+        /* the next record, after the padding of the current one */
+        if (s->content == 0) {
+            if ((s->padding > 0 &&
+                        read_all(s->fd, skip, s->padding, syscalls) < 0) ||
+                    read_all(s->fd, header, FCGI_HEADER_LEN, syscalls) < 0) {
+                return -1;
+            }
+            s->type    = header[1];
+            s->content = (header[4] << 8) | header[5];
+            s->padding = header[6];
+
+            if (s->type == FCGI_END_REQUEST) {
+                /* the application and protocol status are not needed */
+                if (s->content > FCGI_HEADER_LEN ||
+                        read_all(s->fd, skip, s->content + s->padding,
+                                 syscalls) < 0) {
+                    return -1;
+                }
+                s->done = 1;
+            }
+            continue;
+        }
+
+        chunk = (s->content < size) ? s->content : size;
+        (*syscalls)++;
+        if ((cnt = read(s->fd, buf, chunk)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: read() from FastCGI socket");
+            return -1;
+        }
+        if (cnt == 0) {
+            return -1;
+        }
+        s->content -= cnt;
+
+        if (s->type == FCGI_STDOUT) {
+            s->received += cnt;
+            return cnt;
+        }
+        if (s->type == FCGI_STDERR) {
+            fwrite(buf, 1, cnt, stderr);
+        }
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  fcgi_close(s)
+ * -------------------------------------------------------------------------- */
+/*! \brief Closes the connection of a request.
+ *
+ *  A script whose output has not been read completely gets an error when it
+ *  writes the rest.
+ */
+void
+fcgi_close(fcgi_stream_t *s) {
+
+    if (s->fd >= 0) {
+        close(s->fd);
+        s->fd = -1;
+    }
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  unix_address(sa, name)
+ * -------------------------------------------------------------------------- */
+/*! \brief Fills in the address of a socket in the socket directory.
+ */
+static void
+unix_address(struct sockaddr_un *sa, const char *name) {
+
+    memset(sa, 0, sizeof(struct sockaddr_un));
+    sa->sun_family = AF_UNIX;
+    snprintf(sa->sun_path, sizeof(sa->sun_path), "%s/%s", socket_dir, name);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  listen_unix(name, type)
+ * -------------------------------------------------------------------------- */
+/*! \brief Creates a listening Unix socket in the socket directory.
+ *
+ *  \return  The socket descriptor, -1 on error.
+ */
+static int
+listen_unix(const char *name, int type) {
+
+    struct sockaddr_un sa;
+    int sd;
+
+    unix_address(&sa, name);
+    unlink(sa.sun_path);
+
+    if ((sd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0)) < 0) {
+        perror("ERROR: socket() for FastCGI");
+        return -1;
+    }
+    if (bind(sd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+            listen(sd, FCGI_BACKLOG) < 0) {
+        perror("ERROR: bind() of FastCGI socket");
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  connect_unix(name, type)
+ * -------------------------------------------------------------------------- */
+/*! \brief Connects to a Unix socket in the socket directory.
+ *
+ *  \return  The socket descriptor, -1 on error.
+ */
+static int
+connect_unix(const char *name, int type) {
+
+    struct sockaddr_un sa;
+    int sd;
+
+    unix_address(&sa, name);
+    if ((sd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0)) < 0) {
+        return -1;
+    }
+    if (connect(sd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  connect_pool(filename)
+ * -------------------------------------------------------------------------- */
+/*! \brief Connects to the pool of a script, which is started if necessary.
+ *
+ *  \return  The socket descriptor, -1 if the script has no pool.
+ */
+static int
+connect_pool(const char *filename) {
+
+    char name[32];
+    int i, index = -1, fd = -1;
+
+    for (i = 0; i < FCGI_MAX_POOLS && index < 0; i++) {
+        if (__atomic_load_n(&shared->pools[i].ready, __ATOMIC_ACQUIRE) &&
+                strcmp(shared->pools[i].script, filename) == 0) {
+            index = i;
+        }
+    }
+    if (index >= 0) {
+        snprintf(name, sizeof(name), "pool%d", index);
+        fd = connect_unix(name, SOCK_STREAM);
+    }
+
+    /* the pool has not been started yet, or it has just expired */
+    if (fd < 0) {
+        if ((index = request_pool(filename)) < 0) {
+            return -1;
+        }
+        snprintf(name, sizeof(name), "pool%d", index);
+        if ((fd = connect_unix(name, SOCK_STREAM)) < 0) {
+            return -1;
+        }
+    }
+
+    __atomic_store_n(&shared->pools[index].last_used, time(NULL),
+                     __ATOMIC_RELAXED);
+    return fd;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  request_pool(filename)
+ * -------------------------------------------------------------------------- */
+/*! \brief Asks the manager to start the pool of a script.
+ *
+ *  \return  The index of the pool, -1 if it could not be started.
+ */
+static int
+request_pool(const char *filename) {
+
+    int sd, index = -1;
+
+    if ((sd = connect_unix("control", SOCK_SEQPACKET)) < 0) {
+        perror("ERROR: connect() to FastCGI pool manager");
+        return -1;
+    }
+    if (send(sd, filename, strlen(filename) + 1, MSG_NOSIGNAL) < 0 ||
+            recv(sd, &index, sizeof(index), 0) != sizeof(index)) {
+        index = -1;
+    }
+    close(sd);
+    return index;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  send_request(fd, filename, method, syscalls)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends a complete request (without a body) with a single write.
+ *
+ *  \return  0 on success, -1 on error.
+ */
+static int
+send_request(int fd, const char *filename, const char *method,
+        int *syscalls) {
+
+    unsigned char buf[FCGI_BUFFER_SIZE], *params;
+    size_t len = 0, params_len = 0;
+
+    /* the names and values are much shorter than the buffer */
+    len += put_header(buf + len, FCGI_BEGIN_REQUEST, 8);
+    memset(buf + len, 0, 8);
+    buf[len + 1] = FCGI_RESPONDER;
+    len += 8;
+
+    params = buf + len + FCGI_HEADER_LEN;
+    params_len += put_param(params + params_len, "GATEWAY_INTERFACE",
+                            "CGI/1.1");
+    params_len += put_param(params + params_len, "SERVER_SOFTWARE",
+                            "TinyWeb");
+    params_len += put_param(params + params_len, "SERVER_PROTOCOL",
+                            "HTTP/1.1");
+    params_len += put_param(params + params_len, "REQUEST_METHOD", method);
+    params_len += put_param(params + params_len, "SCRIPT_FILENAME",
+                            filename);
+    len += put_header(buf + len, FCGI_PARAMS, params_len) + params_len;
+
+    /* empty records terminate the parameters and the body */
+    len += put_header(buf + len, FCGI_PARAMS, 0);
+    len += put_header(buf + len, FCGI_STDIN, 0);
+
+    return write_all(fd, buf, len, syscalls);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  put_header(buf, type, content_len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes a record header without padding.
+ *
+ *  \return  The length of the header.
+ */
+static size_t
+put_header(unsigned char *buf, int type, size_t content_len) {
+
+    buf[0] = FCGI_VERSION_1;
+    buf[1] = type;
+    buf[2] = (FCGI_REQUEST_ID >> 8) & 0xff;
+    buf[3] = FCGI_REQUEST_ID & 0xff;
+    buf[4] = (content_len >> 8) & 0xff;
+    buf[5] = content_len & 0xff;
+    buf[6] = 0;
+    buf[7] = 0;
+    return FCGI_HEADER_LEN;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  put_param(buf, name, value)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes a name-value pair; lengths above 127 take four bytes.
+ *
+ *  \return  The length of the pair.
+ */
+static size_t
+put_param(unsigned char *buf, const char *name, const char *value) {
+
+    size_t len = 0, lengths[2], i;
+
+    lengths[0] = strlen(name);
+    lengths[1] = strlen(value);
+    for (i = 0; i < 2; i++) {
+        if (lengths[i] < 128) {
+            buf[len++] = lengths[i];
+        }
+        else {
+            buf[len++] = ((lengths[i] >> 24) & 0x7f) | 0x80;
+            buf[len++] = (lengths[i] >> 16) & 0xff;
+            buf[len++] = (lengths[i] >> 8) & 0xff;
+            buf[len++] = lengths[i] & 0xff;
+        }
+    }
+    memcpy(buf + len, name, lengths[0]);
+    memcpy(buf + len + lengths[0], value, lengths[1]);
+    return len + lengths[0] + lengths[1];
+}
+
+
+/* --------------------------------------------------------------------------
+ *  read_all(fd, buf, len, syscalls)
+ * -------------------------------------------------------------------------- */
+/*! \brief Reads exactly len bytes.
+ *
+ *  \return  0 on success, -1 on error or at the end of the stream.
+ */
+static int
+read_all(int fd, void *buf, size_t len, int *syscalls) {
+
+    ssize_t cnt;
+
+    while (len > 0) {
+        (*syscalls)++;
+        if ((cnt = read(fd, buf, len)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: read() from FastCGI socket");
+            return -1;
+        }
+        if (cnt == 0) {
+            return -1;
+        }
+        buf  = (char *)buf + cnt;
+        len -= cnt;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  write_all(fd, buf, len, syscalls)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes exactly len bytes to a socket.
+ *
+ *  \return  0 on success, -1 on error.
+ */
+static int
+write_all(int fd, const void *buf, size_t len, int *syscalls) {
+
+    ssize_t cnt;
+
+    while (len > 0) {
+        (*syscalls)++;
+        if ((cnt = send(fd, buf, len, MSG_NOSIGNAL)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: send() of FastCGI data");
+            return -1;
+        }
+        buf  = (const char *)buf + cnt;
+        len -= cnt;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  manager_loop(sd_control, pool_size, idle_timeout, master)
+ * -------------------------------------------------------------------------- */
+/*! \brief The main loop of the pool manager.
+ *
+ *  Starts pools on request, replaces terminated processes and terminates
+ *  idle pools.  Once the master has requested it (or has died), all pools
+ *  are terminated and the socket directory is removed.  This function never
+ *  returns.
+ */
+static void
+manager_loop(int sd_control, int pool_size, int idle_timeout, pid_t master) {
+
+    fcgi_procs_t procs[FCGI_MAX_POOLS];
+    struct pollfd pfd = { .fd = sd_control, .events = POLLIN };
+    struct sockaddr_un sa;
+    time_t now;
+    pid_t pid;
+    int i, j;
+
+    /* terminated by the master after the last request, a keyboard interrupt
+     * is sent to all processes of the terminal */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_IGN);
+    signal(SIGCHLD, SIG_DFL);
+
+    for (i = 0; i < FCGI_MAX_POOLS; i++) {
+        procs[i].sd   = -1;
+        procs[i].pids = (pid_t *)calloc(pool_size, sizeof(pid_t));
+        if (procs[i].pids == NULL) {
+            err_print("cannot allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    while (!__atomic_load_n(&shared->stop, __ATOMIC_ACQUIRE) &&
+            getppid() == master) {
+
+        if (poll(&pfd, 1, FCGI_MANAGER_TICK_MS) > 0) {
+            serve_control(sd_control, procs, pool_size);
+        }
+
+        /* replace the processes which have terminated */
+        while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+            for (i = 0; i < FCGI_MAX_POOLS; i++) {
+                for (j = 0; j < pool_size; j++) {
+                    if (procs[i].pids[j] == pid) {
+                        procs[i].pids[j] = (procs[i].sd >= 0)
+                            ? spawn_process(procs[i].sd,
+                                            shared->pools[i].script)
+                            : 0;
+                    }
+                }
+            }
+        }
+
+        now = time(NULL);
+        for (i = 0; i < FCGI_MAX_POOLS && idle_timeout > 0; i++) {
+            if (procs[i].sd >= 0 &&
+                    now - __atomic_load_n(&shared->pools[i].last_used,
+                                          __ATOMIC_RELAXED) >= idle_timeout) {
+                stop_pool(procs, i, pool_size);
+            }
+        }
+    }
+
+    for (i = 0; i < FCGI_MAX_POOLS; i++) {
+        if (procs[i].sd >= 0) {
+            stop_pool(procs, i, pool_size);
+        }
+    }
+    for (i = 0; i < FCGI_MAX_POOLS; i++) {
+        for (j = 0; j < pool_size; j++) {
+            if (procs[i].pids[j] > 0) {
+                waitpid(procs[i].pids[j], NULL, 0);
+            }
+        }
+    }
+
+    close(sd_control);
+    unix_address(&sa, "control");
+    unlink(sa.sun_path);
+    rmdir(socket_dir);
+    exit(EXIT_SUCCESS);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  serve_control(sd_control, procs, pool_size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Answers a request for the pool of a script with its index.
+ *
+ *  The request is the path of the script, the answer is the index of the
+ *  pool as an int, -1 if the pool could not be started.
+ */
+static void
+serve_control(int sd_control, fcgi_procs_t *procs, int pool_size) {
+
+    char script[MAX_SIZE_URI];
+    ssize_t cnt;
+    int sd, index = -1;
+
+    if ((sd = accept4(sd_control, NULL, NULL, SOCK_CLOEXEC)) < 0) {
+        return;
+    }
+    if ((cnt = recv(sd, script, sizeof(script) - 1, 0)) > 0) {
+        script[cnt] = '\0';
+        index = start_pool(script, procs, pool_size);
+    }
+    send(sd, &index, sizeof(index), MSG_NOSIGNAL);
+    close(sd);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  start_pool(script, procs, pool_size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Starts the pool of a script, unless it is running already.
+ *
+ *  \return  The index of the pool, -1 if no pool is free or the pool could
+ *           not be started.
+ */
+static int
+start_pool(const char *script, fcgi_procs_t *procs, int pool_size) {
+
+    fcgi_pool_t *pool;
+    char name[32];
+    int i, j, index = -1;
+
+    for (i = 0; i < FCGI_MAX_POOLS; i++) {
+        if (procs[i].sd >= 0 && strcmp(shared->pools[i].script, script) == 0) {
+            return i;
+        }
+        if (procs[i].sd < 0 && index < 0) {
+            index = i;
+        }
+    }
+    if (index < 0 || access(script, X_OK) < 0) {
+        return -1;
+    }
+
+    snprintf(name, sizeof(name), "pool%d", index);
+    if ((procs[index].sd = listen_unix(name, SOCK_STREAM)) < 0) {
+        return -1;
+    }
+
+    pool = &shared->pools[index];
+    strcpy(pool->script, script);
+    __atomic_store_n(&pool->last_used, time(NULL), __ATOMIC_RELAXED);
+    for (j = 0; j < pool_size; j++) {
+        procs[index].pids[j] = spawn_process(procs[index].sd, script);
+    }
+    __atomic_store_n(&pool->ready, 1, __ATOMIC_RELEASE);
+    return index;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stop_pool(procs, index, pool_size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Removes the socket of a pool and terminates its processes.
+ *
+ *  The processes are reaped by the main loop of the manager.
+ */
+static void
+stop_pool(fcgi_procs_t *procs, int index, int pool_size) {
+
+    struct sockaddr_un sa;
+    char name[32];
+    int j;
+
+    __atomic_store_n(&shared->pools[index].ready, 0, __ATOMIC_RELEASE);
+
+    snprintf(name, sizeof(name), "pool%d", index);
+    unix_address(&sa, name);
+    unlink(sa.sun_path);
+    close(procs[index].sd);
+    procs[index].sd = -1;
+
+    for (j = 0; j < pool_size; j++) {
+        if (procs[index].pids[j] > 0) {
+            kill(procs[index].pids[j], SIGTERM);
+        }
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  spawn_process(sd, script)
+ * -------------------------------------------------------------------------- */
+/*! \brief Starts a process of a pool.
+ *
+ *  \return  The process ID, 0 if the process could not be started.
+ */
+static pid_t
+spawn_process(int sd, const char *script) {
+
+    pid_t pid;
+    int fd_null;
+
+    if ((pid = fork()) < 0) {
+        perror("ERROR: fork() of FastCGI process");
+        return 0;
+    }
+    else if (pid > 0) {
+        stats_count(STATS_CGI_EXECUTIONS);
+        return pid;
+    }
+
+    /* the listening socket is passed as stdin (FCGI_LISTENSOCK_FILENO) */
+    dup2(sd, STDIN_FILENO);
+    if ((fd_null = open("/dev/null", O_WRONLY)) >= 0) {
+        dup2(fd_null, STDOUT_FILENO);
+        close(fd_null);
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+
+    execl(script, script, (char *)NULL);
+
+    /* if execl returns, something went wrong */
+    perror("ERROR: execl() on FastCGI script");
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,51 @@
+/*! \file       fcgi.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Pools of persistent FastCGI processes for CGI scripts.
+ *
+ *  CGI scripts whose names end in ".fcgi" are not executed for every request.
+ *  A pool manager process starts a number of persistent processes per script
+ *  on first use, which accept the requests through a listening Unix socket
+ *  passed as their stdin, as defined by the FastCGI specification.  Requests
+ *  are sent with the FastCGI protocol (responder role, one connection per
+ *  request) and the output of the script is read from the connection.  Pools
+ *  which have been idle for a while are terminated.  If a script cannot be
+ *  served by a pool, it is executed as a plain CGI script.
+ */
+
+#ifndef _FCGI_H_
+#define _FCGI_H_
+
+#include <sys/types.h>
+
+/*! Returned by fcgi_open() if the script has to be executed as a plain CGI
+ *  script */
+#define FCGI_UNAVAILABLE    (-2)
+
+/*! \brief The output of a script for a single request. */
+typedef struct {
+    int    fd;              /*!< the connection to the pool */
+    int    type;            /*!< the type of the current record */
+    size_t content;         /*!< bytes of content left in the current record */
+    size_t padding;         /*!< bytes of padding behind the content */
+    int    done;            /*!< whether FCGI_END_REQUEST has been received */
+    off_t  received;        /*!< bytes of FCGI_STDOUT read so far */
+} fcgi_stream_t;
+
+int
+fcgi_start_manager(int pool_size, int idle_timeout);
+
+void
+fcgi_stop_manager(void);
+
+int
+fcgi_open(fcgi_stream_t *s, const char *filename, const char *method,
+        int *syscalls);
+
+ssize_t
+fcgi_read(fcgi_stream_t *s, char *buf, size_t size, int *syscalls);
+
+void
+fcgi_close(fcgi_stream_t *s);
+
+#endif // _FCGI_H_
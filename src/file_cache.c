@@ -0,0 +1,599 @@
+/*! \file       file_cache.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Cache of open file descriptors and file metadata.
+ *
+ *  See file_cache.h for API documentation.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "file_cache.h"
+#include "stats.h"
+
+/* events which make a cached descriptor or its metadata stale; IN_ATTRIB
+ * also covers the unlinking of the file (e.g. when it is replaced by
+ * rename()), which does not delete the inode while it is still open */
+#define WATCH_EVENTS    (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | \
+                         IN_DELETE_SELF | IN_MOVE_SELF)
+
+/*! \brief The state of the cache of the current process. */
+typedef struct {
+    int max_entries;                  /*!< maximum number of entries, 0 if
+                                           the cache is disabled */
+    int ttl;                          /*!< seconds until revalidation */
+    int ready;                        /*!< whether the tables are set up */
+    int inotify_fd;                   /*!< inotify instance, -1 if none */
+    time_t last_drain;                /*!< last time inotify was read */
+    int n_entries;                    /*!< current number of entries */
+    size_t n_buckets;                 /*!< size of the hash table */
+    file_entry_t **buckets;           /*!< the hash table */
+    file_entry_t *lru_head;           /*!< most recently used entry */
+    file_entry_t *lru_tail;           /*!< least recently used entry */
+    size_t max_memory;                /*!< limit of the data in memory, 0 if
+                                           no files are kept in memory */
+    size_t max_file_size;             /*!< largest file kept in memory */
+    file_cache_stats_t stats;         /*!< counters of the data in memory */
+} file_cache_t;
+
+static file_cache_t cache = { .inotify_fd = -1 };
+
+/* helper functions, defined at the bottom of the file */
+static int cache_setup(void);
+static uint32_t hash_path(const char *path);
+static file_entry_t *entry_load(const char *path);
+static void format_etag(const struct stat *st, char *buf);
+static void entry_free(file_entry_t *entry);
+static void entry_detach(file_entry_t *entry);
+static void entry_drop_data(file_entry_t *entry);
+static void lru_unlink(file_entry_t *entry);
+static void lru_push(file_entry_t *entry);
+static int same_file(const struct stat *a, const struct stat *b);
+static void drain_inotify(void);
+
+/* --------------------------------------------------------------------------
+ *  file_cache_init(max_entries, ttl, max_memory, max_file_size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Configures the cache.
+ *
+ *  The cache tables are allocated lazily by the first file_cache_get() of
+ *  every process.  The cache should only be enabled for long-lived processes;
+ *  a process which serves a single request does not benefit from it.
+ *
+ *  \param max_entries    The maximum number of cached files, 0 disables the
+ *                        cache.
+ *  \param ttl            The number of seconds after which a cached entry is
+ *                        revalidated with stat(), even if inotify did not
+ *                        report a change.
+ *  \param max_memory     The maximum number of bytes of file data kept in
+ *                        memory, 0 if no files are kept in memory.
+ *  \param max_file_size  The size of the largest file kept in memory.
+ */
+void
+file_cache_init(int max_entries, int ttl, size_t max_memory,
+        size_t max_file_size) {
+
+    cache.max_entries   = (max_entries > 0) ? max_entries : 0;
+    cache.ttl           = (ttl > 0) ? ttl : 0;
+    cache.max_memory    = max_memory;
+    cache.max_file_size = max_file_size;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  file_cache_get(path)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the entry of a file and acquires a reference to it.
+ *
+ *  On a cache hit, neither stat() nor open() is called.  An expired entry is
+ *  revalidated with stat() and keeps its descriptor if the file has not been
+ *  changed.
+ *
+ *  \param path  The path of the file (including the root directory).
+ *
+ *  \return  The entry, which has to be released with file_cache_put(), or
+ *           NULL if stat() failed (errno is set accordingly).
+ */
+file_entry_t *
+file_cache_get(const char *path) {
+
+    file_entry_t *entry, **link;
+    struct stat st;
+    time_t now;
+
+    if (cache.max_entries == 0 || cache_setup() < 0) {
+        return entry_load(path);
+    }
+
+    now = time(NULL);
+    if (now != cache.last_drain) {
+        drain_inotify();
+        cache.last_drain = now;
+    }
+
+    link = &cache.buckets[hash_path(path) & (cache.n_buckets - 1)];
+    for (entry = *link; entry != NULL; entry = entry->hash_next) {
+        if (strcmp(entry->path, path) == 0) {
+            break;
+        }
+    }
+
+    if (entry != NULL && now >= entry->expires) {
+        if (stat(path, &st) == 0 && same_file(&st, &entry->st)) {
+            entry->expires  = now + cache.ttl;
+            entry->has_gzip = -1;
+        }
+        else {
+            entry_detach(entry);
+            entry = NULL;
+        }
+    }
+
+    if (entry != NULL) {
+        stats_count(STATS_FILE_CACHE_HITS);
+        lru_unlink(entry);
+        lru_push(entry);
+        entry->refcnt++;
+        return entry;
+    }
+
+    /* miss: load the file and make room for it */
+    stats_count(STATS_FILE_CACHE_MISSES);
+    if ((entry = entry_load(path)) == NULL) {
+        return NULL;
+    }
+    while (cache.n_entries >= cache.max_entries && cache.lru_tail != NULL) {
+        entry_detach(cache.lru_tail);
+    }
+
+    entry->cached  = 1;
+    entry->expires = now + cache.ttl;
+    if (cache.inotify_fd >= 0) {
+        entry->wd = inotify_add_watch(cache.inotify_fd, path, WATCH_EVENTS);
+    }
+
+    entry->hash_next = *link;
+    *link = entry;
+    lru_push(entry);
+    cache.n_entries++;
+    return entry;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  file_cache_put(entry)
+ * -------------------------------------------------------------------------- */
+/*! \brief Releases a reference acquired with file_cache_get().
+ *
+ *  Entries which are no longer part of the cache are closed and freed when
+ *  their last reference is released.
+ *
+ *  \param entry  The entry, may be NULL.
+ */
+void
+file_cache_put(file_entry_t *entry) {
+
+    if (entry != NULL && --entry->refcnt == 0 && !entry->cached) {
+        entry_free(entry);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  file_cache_data(entry, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the data of a file kept in memory.
+ *
+ *  Every call is counted as a hit if the data is in memory, or as a miss if
+ *  the file is small enough to be kept in memory (see
+ *  file_cache_wants_data()).  The data remains valid until the entry is
+ *  released with file_cache_put().
+ *
+ *  \param entry  The entry acquired with file_cache_get().
+ *  \param size   Set to the size of the data.
+ *
+ *  \return  The data passed to file_cache_set_data(), or NULL.
+ */
+const char *
+file_cache_data(file_entry_t *entry, size_t *size) {
+
+    if (entry->data != NULL) {
+        cache.stats.hits++;
+        stats_count(STATS_MEMORY_CACHE_HITS);
+        *size = entry->data_size;
+        return entry->data;
+    }
+    if (file_cache_wants_data(entry)) {
+        cache.stats.misses++;
+        stats_count(STATS_MEMORY_CACHE_MISSES);
+    }
+    return NULL;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  file_cache_wants_data(entry)
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks whether the data of a file should be kept in memory.
+ *
+ *  \param entry  The entry acquired with file_cache_get().
+ *
+ *  \return  1 if the entry is cached, has no data yet and the file is not
+ *           larger than the limit for files in memory, 0 otherwise.
+ */
+int
+file_cache_wants_data(const file_entry_t *entry) {
+
+    return cache.max_memory > 0 && entry->cached && entry->data == NULL &&
+           entry->st.st_size <= (off_t)cache.max_file_size;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  file_cache_set_data(entry, data, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Keeps data of a file in memory.
+ *
+ *  To stay within the memory limit, the data of the least recently used files
+ *  which are not in use is dropped.  The data is freed together with the entry
+ *  or when it is dropped, it must not be changed afterwards.
+ *
+ *  \param entry  The entry acquired with file_cache_get().
+ *  \param data   The data allocated with malloc().  Ownership passes to the
+ *                cache on success.
+ *  \param size   The size of data in bytes.
+ *
+ *  \return  0 on success, -1 if the data cannot be kept in memory (the
+ *           caller still owns data in this case).
+ */
+int
+file_cache_set_data(file_entry_t *entry, char *data, size_t size) {
+
+    file_entry_t *victim, *prev;
+
+    if (!file_cache_wants_data(entry) || size > cache.max_memory) {
+        return -1;
+    }
+
+    for (victim = cache.lru_tail;
+            victim != NULL && cache.stats.bytes + size > cache.max_memory;
+            victim = prev) {
+        prev = victim->lru_prev;
+        if (victim->data != NULL && victim->refcnt == 0) {
+            entry_drop_data(victim);
+        }
+    }
+    if (cache.stats.bytes + size > cache.max_memory) {
+        return -1;              /* all files in memory are in use */
+    }
+
+    entry->data      = data;
+    entry->data_size = size;
+    cache.stats.files++;
+    cache.stats.bytes += size;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  file_cache_stats(stats)
+ * -------------------------------------------------------------------------- */
+/*! \brief Copies the counters of the files kept in memory.
+ *
+ *  \param stats  The structure to which the counters are written.
+ *
+ *  \return  0 on success, -1 if no files are kept in memory by the current
+ *           process.
+ */
+int
+file_cache_stats(file_cache_stats_t *stats) {
+
+    if (cache.max_entries == 0 || cache.max_memory == 0 || !cache.ready) {
+        return -1;
+    }
+    *stats = cache.stats;
+    return 0;
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  cache_setup()
+ * -------------------------------------------------------------------------- */
+/*! \brief Allocates the tables of the cache in the current process.
+ *
+ *  The tables must not be set up before the worker processes are forked,
+ *  otherwise the workers would share the inotify instance.
+ *
+ *  \return  0 on success, -1 if the cache cannot be used.
+ */
+static int
+cache_setup(void) {
+
+    if (cache.ready) {
+        return 0;
+    }
+
+    /* a power of two with a load factor of at most 0.5 */
+    for (cache.n_buckets = 16;
+            cache.n_buckets < 2 * (size_t)cache.max_entries;
+            cache.n_buckets *= 2);
+
+    cache.buckets = (file_entry_t **)calloc(cache.n_buckets,
+                                            sizeof(file_entry_t *));
+    if (cache.buckets == NULL) {
+        cache.max_entries = 0;
+        return -1;
+    }
+
+    /* without inotify, changes are only noticed after the ttl */
+    cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    cache.ready = 1;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  hash_path(path)
+ * -------------------------------------------------------------------------- */
+/*! \brief The FNV-1a hash of a path.
+ */
+static uint32_t
+hash_path(const char *path) {
+
+    uint32_t hash = 2166136261u;
+
+    while (*path != '\0') {
+        hash = (hash ^ (unsigned char)*path++) * 16777619u;
+    }
+    return hash;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  entry_load(path)
+ * -------------------------------------------------------------------------- */
+/*! \brief Creates an uncached entry with the metadata and descriptor of a
+ *         file.
+ *
+ *  \return  The entry with a reference count of 1, NULL if stat() failed.
+ */
+static file_entry_t *
+entry_load(const char *path) {
+
+    file_entry_t *entry = (file_entry_t *)calloc(1, sizeof(file_entry_t));
+
+    if (entry == NULL || (entry->path = strdup(path)) == NULL) {
+        free(entry);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (stat(path, &entry->st) < 0) {
+        int err = errno;
+        free(entry->path);
+        free(entry);
+        errno = err;
+        return NULL;
+    }
+
+    format_http_date(entry->st.st_mtime, entry->last_modified);
+    format_etag(&entry->st, entry->etag);
+    entry->fd = S_ISREG(entry->st.st_mode)
+                ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    entry->wd = -1;
+    entry->refcnt = 1;
+    entry->has_gzip = -1;
+    return entry;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  format_etag(st, buf)
+ * -------------------------------------------------------------------------- */
+/*! \brief Formats the strong entity tag of a file.
+ *
+ *  The tag changes whenever the file is replaced (inode), modified (size and
+ *  modification time in nanoseconds), the same values by which the cache
+ *  notices a change of the file.
+ *
+ *  \param st   The metadata of the file.
+ *  \param buf  A buffer of HTTP_ETAG_SIZE bytes.
+ */
+static void
+format_etag(const struct stat *st, char *buf) {
+
+    snprintf(buf, HTTP_ETAG_SIZE, "\"%llx-%llx-%llx\"",
+             (unsigned long long)st->st_ino,
+             (unsigned long long)st->st_size,
+             (unsigned long long)st->st_mtim.tv_sec * 1000000000ULL +
+             (unsigned long long)st->st_mtim.tv_nsec);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  entry_free(entry)
+ * -------------------------------------------------------------------------- */
+/*! \brief Closes the descriptor of an entry and frees it.
+ */
+static void
+entry_free(file_entry_t *entry) {
+
+    if (entry->fd >= 0) {
+        close(entry->fd);
+    }
+    free(entry->data);
+    free(entry->path);
+    free(entry);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  entry_detach(entry)
+ * -------------------------------------------------------------------------- */
+/*! \brief Removes an entry from the cache.
+ *
+ *  The entry is freed right away unless it is still in use.  Its inotify
+ *  watch is removed if no other entry refers to the same file.
+ */
+static void
+entry_detach(file_entry_t *entry) {
+
+    file_entry_t **link, *other;
+
+    link = &cache.buckets[hash_path(entry->path) & (cache.n_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+    lru_unlink(entry);
+    cache.n_entries--;
+    entry->cached = 0;
+
+    /* the data remains available to the current users of the entry */
+    if (entry->data != NULL) {
+        cache.stats.files--;
+        cache.stats.bytes -= entry->data_size;
+    }
+
+    if (entry->wd >= 0) {
+        for (other = cache.lru_head; other != NULL; other = other->lru_next) {
+            if (other->wd == entry->wd) {
+                break;
+            }
+        }
+        if (other == NULL) {
+            inotify_rm_watch(cache.inotify_fd, entry->wd);
+        }
+    }
+
+    if (entry->refcnt == 0) {
+        entry_free(entry);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  entry_drop_data(entry)
+ * -------------------------------------------------------------------------- */
+/*! \brief Frees the data of an unused cached entry, the entry itself is kept.
+ */
+static void
+entry_drop_data(file_entry_t *entry) {
+
+    cache.stats.files--;
+    cache.stats.bytes -= entry->data_size;
+    free(entry->data);
+    entry->data      = NULL;
+    entry->data_size = 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  lru_unlink(entry)
+ * -------------------------------------------------------------------------- */
+/*! \brief Removes an entry from the LRU list.
+ */
+static void
+lru_unlink(file_entry_t *entry) {
+
+    if (entry->lru_prev != NULL) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    }
+    else if (cache.lru_head == entry) {
+        cache.lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next != NULL) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }
+    else if (cache.lru_tail == entry) {
+        cache.lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  lru_push(entry)
+ * -------------------------------------------------------------------------- */
+/*! \brief Inserts an entry as the most recently used one.
+ */
+static void
+lru_push(file_entry_t *entry) {
+
+    entry->lru_prev = NULL;
+    entry->lru_next = cache.lru_head;
+    if (cache.lru_head != NULL) {
+        cache.lru_head->lru_prev = entry;
+    }
+    else {
+        cache.lru_tail = entry;
+    }
+    cache.lru_head = entry;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  same_file(a, b)
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks whether two stat() results describe an unchanged file.
+ */
+static int
+same_file(const struct stat *a, const struct stat *b) {
+
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+           a->st_size == b->st_size && a->st_mode == b->st_mode &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+           a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  drain_inotify()
+ * -------------------------------------------------------------------------- */
+/*! \brief Reads all pending inotify events and detaches the changed files.
+ *
+ *  Called at most once per second, so that a cache hit usually does not cost
+ *  any system call.
+ */
+static void
+drain_inotify(void) {
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    file_entry_t *entry, *next;
+    ssize_t len;
+    char *p;
+
+    if (cache.inotify_fd < 0) {
+        return;
+    }
+
+    while ((len = read(cache.inotify_fd, buf, sizeof(buf))) > 0) {
+        for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+            ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_IGNORED) {
+                continue;       /* the watch is gone already */
+            }
+            for (entry = cache.lru_head; entry != NULL; entry = next) {
+                next = entry->lru_next;
+                if (entry->wd == ev->wd) {
+                    entry->wd = -1;
+                    entry_detach(entry);
+                }
+            }
+            inotify_rm_watch(cache.inotify_fd, ev->wd);
+        }
+    }
+}
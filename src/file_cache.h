@@ -0,0 +1,96 @@
+/*! \file       file_cache.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Cache of open file descriptors and file metadata.
+ *
+ *  This module keeps the descriptors and the stat() results of recently
+ *  requested files, so that repeated requests for the same file need neither
+ *  a stat() nor an open() call.  The cache is bounded and evicts the least
+ *  recently used files.  Entries are revalidated with stat() after a
+ *  configurable time to live and invalidated immediately when inotify reports
+ *  a change of the file.
+ *
+ *  Small files can additionally be kept in memory, together with a part of the
+ *  response header which is rendered only once (see file_cache_data()).  The
+ *  total size of the data in memory is limited, the data of the least
+ *  recently used files is dropped first.
+ *
+ *  Every process has a cache of its own, which is set up when it is used for
+ *  the first time, so that the workers of the pool do not share descriptors
+ *  or inotify instances.  Entries are reference counted: an entry which is
+ *  evicted while a response still uses it is released by the last
+ *  file_cache_put().  If the cache is disabled, file_cache_get() and
+ *  file_cache_put() simply call stat(), open() and close().
+ */
+
+#ifndef _FILE_CACHE_H_
+#define _FILE_CACHE_H_
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include "date_cache.h"
+#include "http.h"
+
+/*! \brief A file (or directory) and its metadata. */
+typedef struct file_entry {
+    char *path;                       /*!< the path used for the lookup */
+    struct stat st;                   /*!< the metadata of the file */
+    char last_modified[HTTP_DATE_SIZE]; /*!< st.st_mtime as RFC 1123 date */
+    char etag[HTTP_ETAG_SIZE];        /*!< the strong entity tag of the file,
+                                           derived from the inode, the size
+                                           and the modification time in
+                                           nanoseconds */
+    int fd;                           /*!< read-only descriptor of a regular
+                                           file, -1 for other file types or
+                                           if the file cannot be opened */
+    int refcnt;                       /*!< number of users of the entry */
+    int cached;                       /*!< whether the entry is still part of
+                                           the cache */
+    int wd;                           /*!< inotify watch, -1 if none */
+    time_t expires;                   /*!< time of the next revalidation */
+    char *data;                       /*!< the file contents in memory, with
+                                           a prefix chosen by the user of the
+                                           cache, or NULL */
+    size_t data_size;                 /*!< size of data in bytes */
+    int has_gzip;                     /*!< whether a compressed copy of the
+                                           file (path.gz) exists: 1 or 0, -1
+                                           until it has been checked; checked
+                                           again after the time to live */
+    struct file_entry *hash_next;     /*!< next entry in the hash bucket */
+    struct file_entry *lru_prev;      /*!< more recently used entry */
+    struct file_entry *lru_next;      /*!< less recently used entry */
+} file_entry_t;
+
+/*! \brief Counters of the in-memory part of the cache. */
+typedef struct {
+    unsigned long hits;               /*!< requests answered from memory */
+    unsigned long misses;             /*!< requests for small files which
+                                           were not in memory */
+    int files;                        /*!< number of files in memory */
+    size_t bytes;                     /*!< memory used by the files */
+} file_cache_stats_t;
+
+void
+file_cache_init(int max_entries, int ttl, size_t max_memory,
+        size_t max_file_size);
+
+file_entry_t *
+file_cache_get(const char *path);
+
+void
+file_cache_put(file_entry_t *entry);
+
+const char *
+file_cache_data(file_entry_t *entry, size_t *size);
+
+int
+file_cache_wants_data(const file_entry_t *entry);
+
+int
+file_cache_set_data(file_entry_t *entry, char *data, size_t size);
+
+int
+file_cache_stats(file_cache_stats_t *stats);
+
+#endif // _FILE_CACHE_H_
@@ -0,0 +1,867 @@
+/*! \file       gzip.c
+ *  \author     Wolfram Reinke
+ *  \date       October 17, 2026
+ *  \brief      On-the-fly gzip compression of responses.
+ *
+ *  See gzip.h for API documentation.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+
+#include "gzip.h"
+
+#ifndef HAVE_ZLIB
+
+/* --------------------------------------------------------------------------
+ *  gzip_init(level, min_size, cache_dir)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ *
+ *  \return  0 if compression is not requested (level 0), -1 otherwise.
+ */
+int
+gzip_init(int level, off_t min_size, const char *cache_dir) {
+
+    return (level > 0) ? -1 : 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_cleanup()
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ */
+void
+gzip_cleanup(void) {
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_wanted(content_type, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ */
+int
+gzip_wanted(const char *content_type, off_t size) {
+
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_copy_path(filename, st, path, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ */
+int
+gzip_copy_path(const char *filename, const struct stat *st, char *path,
+        size_t size) {
+
+    return -1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_create_copy(filename, fd, st, path)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ */
+int
+gzip_create_copy(const char *filename, int fd, const struct stat *st,
+        const char *path) {
+
+    return -1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_stream_open()
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ */
+gzip_stream_t *
+gzip_stream_open(void) {
+
+    return NULL;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_stream_compress(s, in, in_len, out, size, finish)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ */
+ssize_t
+gzip_stream_compress(gzip_stream_t *s, const char **in, size_t *in_len,
+        char *out, size_t size, int finish) {
+
+    return -1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_stream_close(s)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compression has not been compiled in.
+ */
+void
+gzip_stream_close(gzip_stream_t *s) {
+}
+
+#else /* HAVE_ZLIB */
+
+#define ZLIB_CONST
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+#include "stats.h"
+
+/* the size of the buffers through which a file is compressed */
+#define COPY_BUFFER_SIZE    65536
+
+/* the largest file compressed in the request path, larger files are
+ * compressed in the background */
+#define GZIP_INLINE_SIZE    COPY_BUFFER_SIZE
+
+/* the seconds after which an abandoned part file is removed */
+#define GZIP_STALE_TIME     60
+
+/* how often the compressor checks whether the master is still running */
+#define GZIP_COMPRESSOR_TICK_MS 1000
+
+/* gzip instead of zlib framing (RFC 1952), with the largest window */
+#define GZIP_WINDOW_BITS    (15 + 16)
+#define GZIP_MEM_LEVEL      8
+
+/*! \brief A compressed stream. */
+struct gzip_stream {
+    z_stream z;                       /*!< the state of zlib */
+};
+
+/*! \brief The configuration, shared by all processes of the server. */
+typedef struct {
+    int   level;                      /*!< zlib compression level, 0 if
+                                           compression is disabled */
+    off_t min_size;                   /*!< smallest file compressed */
+    char  dir[256];                   /*!< the cache of compressed copies */
+    pid_t owner;                      /*!< the process which created dir and
+                                           removes it, 0 if it is given by
+                                           the user */
+    int   sd_jobs;                    /*!< the socket through which jobs are
+                                           sent to the compressor, -1 if it
+                                           is not running */
+} gzip_config_t;
+
+/*! \brief A file to be compressed by the compressor process. */
+typedef struct {
+    struct stat st;                   /*!< the metadata of the file when it
+                                           was requested */
+    char filename[PATH_MAX];          /*!< the path of the file, only sent up
+                                           to its terminating zero */
+} gzip_job_t;
+
+static gzip_config_t config = { .sd_jobs = -1 };
+static pid_t master_pid = -1;
+static pid_t compressor_pid = -1;
+
+/*! Content types outside text/ which compress well; types with the suffix
+ *  +xml or +json are compressed as well */
+static const char *compressible_types[] = {
+    "application/javascript", "application/json", "application/postscript",
+    "application/rtf", "application/sql", "application/wasm",
+    "application/x-csh", "application/x-httpd-php", "application/x-javascript",
+    "application/x-latex", "application/x-sh", "application/x-texinfo",
+    "application/xml", "application/xml-dtd", "application/vnd.ms-fontobject",
+    "font/otf", "font/ttf", "image/bmp", "image/vnd.microsoft.icon", NULL
+};
+
+/* helper functions, defined at the bottom of the file */
+static int is_compressible(const char *content_type);
+static int deflate_init(z_stream *z);
+static int compress_copy(int fd, const struct stat *st, int tmp_fd,
+        const char *tmp, const char *path);
+static void remove_old_copies(const char *path);
+static int start_compressor(void);
+static void compressor_loop(int sd, pid_t master);
+static void compress_job(const gzip_job_t *job);
+static int write_all(int fd, const char *buf, size_t len);
+static uint64_t hash_path(const char *path);
+
+/* --------------------------------------------------------------------------
+ *  gzip_init(level, min_size, cache_dir)
+ * -------------------------------------------------------------------------- */
+/*! \brief Configures the compression, before the workers are forked.
+ *
+ *  Starts the compressor process, which creates the compressed copies of
+ *  large files in the background.  Must be called by the master process
+ *  before the listening sockets are opened, so that the compressor holds
+ *  neither them nor any client connection.
+ *
+ *  \param level      The zlib compression level, from 1 (fastest) to 9
+ *                    (smallest), 0 disables compression.
+ *  \param min_size   The size of the smallest file which is compressed.
+ *  \param cache_dir  The directory of the compressed copies of static files,
+ *                    NULL for a temporary directory which is removed by
+ *                    gzip_cleanup().
+ *
+ *  \return  0 on success, -1 if compression is not available (it is
+ *           disabled in this case).
+ */
+int
+gzip_init(int level, off_t min_size, const char *cache_dir) {
+
+    int cnt;
+
+    config.level = 0;
+    if (level <= 0) {
+        return 0;
+    }
+
+    if (cache_dir == NULL) {
+        const char *tmpdir = getenv("TMPDIR");
+
+        cnt = snprintf(config.dir, sizeof(config.dir), "%s/tinyweb-gzip-XXXXXX",
+                       (tmpdir != NULL) ? tmpdir : "/tmp");
+        if (cnt < 0 || (size_t)cnt >= sizeof(config.dir) ||
+                mkdtemp(config.dir) == NULL) {
+            perror("ERROR: mkdtemp() for compressed files");
+            return -1;
+        }
+        config.owner = getpid();
+    }
+    else {
+        cnt = snprintf(config.dir, sizeof(config.dir), "%s", cache_dir);
+        if (cnt < 0 || (size_t)cnt >= sizeof(config.dir)) {
+            fprintf(stderr, "ERROR: Cache directory name too long\n");
+            return -1;
+        }
+        if (access(config.dir, W_OK | X_OK) < 0) {
+            perror("ERROR: Cannot write to the cache directory");
+            return -1;
+        }
+        config.owner = 0;
+    }
+
+    config.level    = (level > Z_BEST_COMPRESSION) ? Z_BEST_COMPRESSION
+                                                   : level;
+    config.min_size = min_size;
+    master_pid      = getpid();
+
+    /* without the compressor, only small files are compressed */
+    start_compressor();
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_cleanup()
+ * -------------------------------------------------------------------------- */
+/*! \brief Stops the compressor and removes the temporary cache directory
+ *         with the compressed copies.
+ *
+ *  Only the process which called gzip_init() stops the compressor, and it
+ *  only removes the directory if it has created it.  A copy which is still
+ *  being created is abandoned.
+ */
+void
+gzip_cleanup(void) {
+
+    char path[sizeof(config.dir) + 256];
+    struct dirent *ent;
+    DIR *dir;
+
+    if (config.level == 0 || master_pid != getpid()) {
+        return;
+    }
+    config.level = 0;
+
+    if (compressor_pid > 0) {
+        close(config.sd_jobs);
+        config.sd_jobs = -1;
+        kill(compressor_pid, SIGTERM);
+
+        /* the compressor may also be reaped by a SIGCHLD handler (ECHILD) */
+        while (waitpid(compressor_pid, NULL, 0) < 0 && errno == EINTR);
+        compressor_pid = -1;
+    }
+    if (config.owner != getpid()) {
+        return;
+    }
+
+    if ((dir = opendir(config.dir)) != NULL) {
+        while ((ent = readdir(dir)) != NULL) {
+            if (strcmp(ent->d_name, ".") != 0 &&
+                    strcmp(ent->d_name, "..") != 0) {
+                snprintf(path, sizeof(path), "%s/%s", config.dir,
+                         ent->d_name);
+                unlink(path);
+            }
+        }
+        closedir(dir);
+    }
+    if (rmdir(config.dir) < 0) {
+        perror("ERROR: rmdir() of the cache directory");
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_wanted(content_type, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks whether content is worth compressing.
+ *
+ *  \param content_type  The media type of the content, parameters such as
+ *                       "; charset=utf-8" are ignored.
+ *  \param size          The size of the content, -1 if it is not known.
+ *
+ *  \return  1 if compression is enabled, the type compresses well and the
+ *           content is not smaller than the minimum size, 0 otherwise.
+ */
+int
+gzip_wanted(const char *content_type, off_t size) {
+
+    return config.level > 0 && (size < 0 || size >= config.min_size) &&
+           is_compressible(content_type);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_copy_path(filename, st, path, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the path of the compressed copy of a file in the cache.
+ *
+ *  The name is made of a hash of the path, the inode, the size and the
+ *  modification time of the file, so every version of a file has a copy of
+ *  its own and a changed file is compressed again.
+ *
+ *  \param filename  The path of the file.
+ *  \param st        The metadata of the file.
+ *  \param path      The buffer to which the path of the copy is written.
+ *  \param size      The size of path in bytes.
+ *
+ *  \return  0 on success, -1 if compression is disabled or path is too small.
+ */
+int
+gzip_copy_path(const char *filename, const struct stat *st, char *path,
+        size_t size) {
+
+    int cnt;
+
+    if (config.level == 0) {
+        return -1;
+    }
+    cnt = snprintf(path, size, "%s/%016llx-%llx-%lld-%lld.%09ld.gz",
+                   config.dir, (unsigned long long)hash_path(filename),
+                   (unsigned long long)st->st_ino, (long long)st->st_size,
+                   (long long)st->st_mtim.tv_sec, (long)st->st_mtim.tv_nsec);
+    return (cnt < 0 || (size_t)cnt >= size) ? -1 : 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_create_copy(filename, fd, st, path)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compresses a file into the cache.
+ *
+ *  The copy is written to "path.part" first and renamed when it is
+ *  complete, so that other processes never see a partial copy.  The part
+ *  file is created exclusively and marks a copy in progress: other processes
+ *  which request the same file meanwhile send the file itself instead of
+ *  compressing it a second time.  A part file which has not been written to
+ *  for GZIP_STALE_TIME seconds has been abandoned and is removed.
+ *
+ *  Files up to GZIP_INLINE_SIZE bytes are compressed right away.  Larger
+ *  files would hold up the event loops (-e epoll, -e uring) and all the
+ *  connections they serve, so they are handed over to the compressor
+ *  process.  If it is not running or cannot take any more jobs, the file is
+ *  not compressed this time.
+ *
+ *  \param filename  The path of the file.
+ *  \param fd        A descriptor of the file, read with pread().
+ *  \param st        The metadata of the file.
+ *  \param path      The path of the copy, see gzip_copy_path().
+ *
+ *  \return  0 if the copy has been created, 1 if it is being created in the
+ *           background, -1 on error.
+ */
+int
+gzip_create_copy(const char *filename, int fd, const struct stat *st,
+        const char *path) {
+
+    char tmp[PATH_MAX];
+    struct stat tmp_st;
+    gzip_job_t job;
+    size_t len;
+    int tmp_fd, cnt;
+
+    cnt = snprintf(tmp, sizeof(tmp), "%s.part", path);
+    if (cnt < 0 || (size_t)cnt >= sizeof(tmp)) {
+        return -1;
+    }
+    if ((tmp_fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                       0644)) < 0) {
+        if (errno != EEXIST) {
+            perror("ERROR: open() for a compressed file");
+            return -1;
+        }
+        if (stat(tmp, &tmp_st) == 0 &&
+                tmp_st.st_mtime + GZIP_STALE_TIME < time(NULL)) {
+            unlink(tmp);
+        }
+        return 1;
+    }
+
+    if (st->st_size <= GZIP_INLINE_SIZE) {
+        return compress_copy(fd, st, tmp_fd, tmp, path);
+    }
+    close(tmp_fd);
+
+    /* the compressor opens the file and the part file itself */
+    len = strlen(filename);
+    if (config.sd_jobs < 0 || len >= sizeof(job.filename)) {
+        unlink(tmp);
+        return -1;
+    }
+    job.st = *st;
+    memcpy(job.filename, filename, len + 1);
+    if (send(config.sd_jobs, &job, offsetof(gzip_job_t, filename) + len + 1,
+             MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_stream_open()
+ * -------------------------------------------------------------------------- */
+/*! \brief Starts a compressed stream.
+ *
+ *  \return  The stream, which has to be closed with gzip_stream_close(), or
+ *           NULL if compression is disabled or an error occurred.
+ */
+gzip_stream_t *
+gzip_stream_open(void) {
+
+    gzip_stream_t *s;
+
+    if (config.level == 0 ||
+            (s = (gzip_stream_t *)malloc(sizeof(gzip_stream_t))) == NULL) {
+        return NULL;
+    }
+    if (deflate_init(&s->z) < 0) {
+        free(s);
+        return NULL;
+    }
+
+    stats_count(STATS_GZIP_STREAMS);
+    return s;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_stream_compress(s, in, in_len, out, size, finish)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compresses a part of a stream.
+ *
+ *  All input is flushed to the output, so the client can decompress
+ *  everything it has received so far; this costs a few bytes per call.  The
+ *  function has to be called again as long as there is input left or the
+ *  output buffer has been filled.
+ *
+ *  \param s       The stream.
+ *  \param in      The input, advanced by the number of bytes consumed.
+ *  \param in_len  The number of bytes of input, decreased accordingly.
+ *  \param out     The buffer to which the compressed data is written.
+ *  \param size    The size of out in bytes.
+ *  \param finish  Whether this is the end of the input.  The stream is
+ *                 complete once the function returns less than size.
+ *
+ *  \return  The number of bytes written to out, -1 on error.
+ */
+ssize_t
+gzip_stream_compress(gzip_stream_t *s, const char **in, size_t *in_len,
+        char *out, size_t size, int finish) {
+
+    int ret;
+
+    s->z.next_in   = (const Bytef *)*in;
+    s->z.avail_in  = *in_len;
+    s->z.next_out  = (Bytef *)out;
+    s->z.avail_out = size;
+
+    ret = deflate(&s->z, finish ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret == Z_STREAM_ERROR) {
+        fprintf(stderr, "ERROR: deflate() failed\n");
+        return -1;
+    }
+
+    *in     = (const char *)s->z.next_in;
+    *in_len = s->z.avail_in;
+    return size - s->z.avail_out;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  gzip_stream_close(s)
+ * -------------------------------------------------------------------------- */
+/*! \brief Releases a stream.
+ *
+ *  \param s  The stream, may be NULL.
+ */
+void
+gzip_stream_close(gzip_stream_t *s) {
+
+    if (s != NULL) {
+        deflateEnd(&s->z);
+        free(s);
+    }
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  is_compressible(content_type)
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks whether a media type compresses well.
+ */
+static int
+is_compressible(const char *content_type) {
+
+    size_t len = strcspn(content_type, "; \t");
+    int i;
+
+    if (strncasecmp(content_type, "text/", 5) == 0) {
+        return 1;
+    }
+    if (len > 5 && (strncasecmp(content_type + len - 4, "+xml", 4) == 0 ||
+                    strncasecmp(content_type + len - 5, "+json", 5) == 0)) {
+        return 1;
+    }
+    for (i = 0; compressible_types[i] != NULL; i++) {
+        if (strlen(compressible_types[i]) == len &&
+                strncasecmp(content_type, compressible_types[i], len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  deflate_init(z)
+ * -------------------------------------------------------------------------- */
+/*! \brief Prepares a zlib stream for gzip output with the configured level.
+ *
+ *  \return  0 on success, -1 on error.
+ */
+static int
+deflate_init(z_stream *z) {
+
+    memset(z, 0, sizeof(*z));
+    if (deflateInit2(z, config.level, Z_DEFLATED, GZIP_WINDOW_BITS,
+                     GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "ERROR: deflateInit2() failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  compress_copy(fd, st, tmp_fd, tmp, path)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compresses a file into a part file and renames it to the copy.
+ *
+ *  The copy gets the modification time of the file, so the Last-Modified
+ *  field of both is the same.  The part file is closed, and removed on
+ *  error.
+ *
+ *  \return  0 on success, -1 on error.
+ */
+static int
+compress_copy(int fd, const struct stat *st, int tmp_fd, const char *tmp,
+        const char *path) {
+
+    char in[COPY_BUFFER_SIZE], out[COPY_BUFFER_SIZE];
+    struct timespec times[2] = { { .tv_nsec = UTIME_OMIT }, st->st_mtim };
+    z_stream z;
+    off_t offset = 0;
+    ssize_t cnt;
+    int ret = Z_OK, flush;
+
+    if (deflate_init(&z) < 0) {
+        close(tmp_fd);
+        unlink(tmp);
+        return -1;
+    }
+
+    while (ret != Z_STREAM_END) {
+        if (z.avail_in == 0 && offset < st->st_size) {
+            if ((cnt = pread(fd, in, sizeof(in), offset)) <= 0) {
+                if (cnt < 0 && errno == EINTR) {
+                    continue;
+                }
+                break;          /* the file has been truncated */
+            }
+            z.next_in  = (const Bytef *)in;
+            z.avail_in = cnt;
+            offset    += cnt;
+        }
+
+        flush = (offset < st->st_size) ? Z_NO_FLUSH : Z_FINISH;
+        z.next_out  = (Bytef *)out;
+        z.avail_out = sizeof(out);
+        if ((ret = deflate(&z, flush)) == Z_STREAM_ERROR ||
+                write_all(tmp_fd, out, sizeof(out) - z.avail_out) < 0) {
+            break;
+        }
+    }
+    deflateEnd(&z);
+
+    /* the copy must be readable like any file which is served */
+    if (ret != Z_STREAM_END || fchmod(tmp_fd, 0644) < 0 ||
+            futimens(tmp_fd, times) < 0) {
+        fprintf(stderr, "ERROR: Cannot compress a file into %s\n", tmp);
+        close(tmp_fd);
+        unlink(tmp);
+        return -1;
+    }
+    if (close(tmp_fd) < 0 || rename(tmp, path) < 0) {
+        perror("ERROR: Cannot store a compressed file");
+        unlink(tmp);
+        return -1;
+    }
+
+    remove_old_copies(path);
+    stats_count(STATS_GZIP_FILES);
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  remove_old_copies(path)
+ * -------------------------------------------------------------------------- */
+/*! \brief Removes the copies of earlier versions of a file from the cache.
+ *
+ *  The copies of a file share the hash of its path at the beginning of
+ *  their names (see gzip_copy_path()).  Part files of copies in progress are
+ *  kept.
+ *
+ *  \param path  The path of the current copy.
+ */
+static void
+remove_old_copies(const char *path) {
+
+    char old[sizeof(config.dir) + 256];
+    const char *name = strrchr(path, '/') + 1;
+    size_t prefix = strcspn(name, "-") + 1, len;
+    struct dirent *ent;
+    DIR *dir;
+
+    if ((dir = opendir(config.dir)) == NULL) {
+        return;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        len = strlen(ent->d_name);
+        if (strncmp(ent->d_name, name, prefix) == 0 &&
+                strcmp(ent->d_name, name) != 0 &&
+                (len < 5 || strcmp(ent->d_name + len - 5, ".part") != 0)) {
+            snprintf(old, sizeof(old), "%s/%s", config.dir, ent->d_name);
+            unlink(old);
+        }
+    }
+    closedir(dir);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  start_compressor()
+ * -------------------------------------------------------------------------- */
+/*! \brief Forks the compressor process.
+ *
+ *  The jobs are sent through a socket pair of the type SOCK_SEQPACKET,
+ *  which keeps the boundaries of the jobs of all processes which share the
+ *  sending end.  The compressor terminates when all of them have closed it.
+ *
+ *  \return  0 on success, -1 on error.
+ */
+static int
+start_compressor(void) {
+
+    pid_t master = getpid();
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        perror("ERROR: socketpair() for the compressor");
+        return -1;
+    }
+
+    /* make sure buffered output is not duplicated in the compressor */
+    fflush(stdout);
+
+    if ((compressor_pid = fork()) < 0) {
+        perror("ERROR: fork() of the compressor");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    else if (compressor_pid == 0) {
+        close(sv[1]);
+        compressor_loop(sv[0], master);
+    }
+
+    close(sv[0]);
+    config.sd_jobs = sv[1];
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  compressor_loop(sd, master)
+ * -------------------------------------------------------------------------- */
+/*! \brief The main loop of the compressor process.
+ *
+ *  Compresses one file after the other, in the order in which they have
+ *  been requested.  Terminates once the master has stopped it (or has died)
+ *  or all senders have closed the socket.  This function never returns.
+ *
+ *  \param sd      The receiving end of the socket pair.
+ *  \param master  The process ID of the master process.
+ */
+static void
+compressor_loop(int sd, pid_t master) {
+
+    struct pollfd pfd = { .fd = sd, .events = POLLIN };
+    gzip_job_t job;
+    ssize_t cnt;
+
+    /* stopped by the master with SIGTERM, a keyboard interrupt is sent to
+     * all processes of the terminal */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+
+    while (getppid() == master) {
+        if (poll(&pfd, 1, GZIP_COMPRESSOR_TICK_MS) <= 0) {
+            continue;
+        }
+        if ((cnt = recv(sd, &job, sizeof(job), 0)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: recv() of the compressor");
+            break;
+        }
+        if (cnt == 0) {
+            break;                  /* no process is left to send jobs */
+        }
+        if ((size_t)cnt > offsetof(gzip_job_t, filename)) {
+            ((char *)&job)[cnt - 1] = '\0';
+            compress_job(&job);
+        }
+    }
+
+    exit(EXIT_SUCCESS);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  compress_job(job)
+ * -------------------------------------------------------------------------- */
+/*! \brief Creates the compressed copy of a file in the compressor process.
+ *
+ *  The part file has been created by the process which sent the job.  If
+ *  the file has changed in the meantime, no copy is created and the part
+ *  file is removed; the next request for the file compresses its new
+ *  version.
+ */
+static void
+compress_job(const gzip_job_t *job) {
+
+    char path[PATH_MAX], tmp[PATH_MAX + 8];
+    struct stat st;
+    int fd, tmp_fd;
+
+    if (gzip_copy_path(job->filename, &job->st, path, sizeof(path)) < 0) {
+        return;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.part", path);
+
+    fd = open(job->filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_ino != job->st.st_ino ||
+            st.st_size != job->st.st_size ||
+            st.st_mtim.tv_sec != job->st.st_mtim.tv_sec ||
+            st.st_mtim.tv_nsec != job->st.st_mtim.tv_nsec) {
+        unlink(tmp);
+    }
+    else if ((tmp_fd = open(tmp, O_WRONLY | O_TRUNC | O_CLOEXEC)) >= 0) {
+        compress_copy(fd, &job->st, tmp_fd, tmp, path);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  write_all(fd, buf, len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes a buffer completely to a file.
+ *
+ *  \return  0 on success, -1 on error.
+ */
+static int
+write_all(int fd, const char *buf, size_t len) {
+
+    ssize_t cnt;
+
+    while (len > 0) {
+        if ((cnt = write(fd, buf, len)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += cnt;
+        len -= cnt;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  hash_path(path)
+ * -------------------------------------------------------------------------- */
+/*! \brief The 64-bit FNV-1a hash of a path.
+ */
+static uint64_t
+hash_path(const char *path) {
+
+    uint64_t hash = 14695981039346656037ull;
+
+    while (*path != '\0') {
+        hash = (hash ^ (unsigned char)*path++) * 1099511628211ull;
+    }
+    return hash;
+}
+
+#endif /* HAVE_ZLIB */
@@ -0,0 +1,60 @@
+/*! \file       gzip.h
+ *  \author     Wolfram Reinke
+ *  \date       October 17, 2026
+ *  \brief      On-the-fly gzip compression of responses.
+ *
+ *  Static files of a compressible content type (text, JavaScript, JSON,
+ *  XML, ...) are compressed with zlib when a client which accepts gzip
+ *  requests them for the first time; files larger than a single buffer are
+ *  compressed in the background by a compressor process forked at startup,
+ *  so that they do not hold up the event loops.  The compressed copy is written to a cache
+ *  directory shared by all processes of the server, under a name derived
+ *  from the path, the size and the modification time of the file, so it is
+ *  created once per version of the file and sent like any other file
+ *  afterwards (with sendfile(), from the file cache, in ranges).  A new copy
+ *  replaces the copies of earlier versions of the file.  The
+ *  output of CGI scripts cannot be cached and is compressed while it is
+ *  relayed to the client, as a stream.
+ *
+ *  Files smaller than a minimum size are not compressed, as the savings do
+ *  not outweigh the work.  Compression is only compiled in if HAVE_ZLIB is
+ *  defined (the default, make ZLIB=0 builds without it).
+ */
+
+#ifndef _GZIP_H_
+#define _GZIP_H_
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/*! \brief A compressed stream, e.g. the output of a CGI script. */
+typedef struct gzip_stream gzip_stream_t;
+
+int
+gzip_init(int level, off_t min_size, const char *cache_dir);
+
+void
+gzip_cleanup(void);
+
+int
+gzip_wanted(const char *content_type, off_t size);
+
+int
+gzip_copy_path(const char *filename, const struct stat *st, char *path,
+        size_t size);
+
+int
+gzip_create_copy(const char *filename, int fd, const struct stat *st,
+        const char *path);
+
+gzip_stream_t *
+gzip_stream_open(void);
+
+ssize_t
+gzip_stream_compress(gzip_stream_t *s, const char **in, size_t *in_len,
+        char *out, size_t size, int finish);
+
+void
+gzip_stream_close(gzip_stream_t *s);
+
+#endif // _GZIP_H_
@@ -43,6 +43,7 @@ http_status_entry_t http_status_list[] = {
     { 200, "OK"                              },  /* HTTP_STATUS_OK                    */
     { 206, "Partial Content"                 },  /* HTTP_STATUS_PARTIAL_CONTENT       */
     { 301, "Moved Permanently"               },  /* HTTP_STATUS_MOVED_PERMANENTLY     */
+    { 302, "Found"                           },  /* HTTP_STATUS_FOUND                 */
     { 304, "Not Modified"                    },  /* HTTP_STATUS_NOT_MODIFIED          */
     { 400, "Bad Request"                     },  /* HTTP_STATUS_BAD_REQUEST           */
     { 403, "Forbidden"                       },  /* HTTP_STATUS_FORBIDDEN             */
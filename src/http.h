@@ -16,6 +16,11 @@
 #ifndef _HTTP_H
 #define _HTTP_H
 
+/*! \brief The size of a buffer for an entity tag, e.g.
+ *         "\"2a0c41-1ce-18a3f1c2b7d4e6f0\"", including the terminating
+ *         '\0'. */
+#define HTTP_ETAG_SIZE      64
+
 /*! \brief The HTTP methods accepted by Tinyweb. */
 typedef enum http_method {
     HTTP_METHOD_GET = 0,
@@ -31,6 +36,7 @@ typedef enum http_status {
     HTTP_STATUS_OK = 0,                    /* 200 */
     HTTP_STATUS_PARTIAL_CONTENT,           /* 206 */
     HTTP_STATUS_MOVED_PERMANENTLY,         /* 301 */
+    HTTP_STATUS_FOUND,                     /* 302 */
     HTTP_STATUS_NOT_MODIFIED,              /* 304 */
     HTTP_STATUS_BAD_REQUEST,               /* 400 */
     HTTP_STATUS_FORBIDDEN,                 /* 403 */
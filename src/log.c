@@ -7,13 +7,80 @@
  *
  *  See log.h for API documentation.
  */
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "sem_print.h"
 
 #include "log.h"
+#include "date_cache.h"
+#include "file_cache.h"
 #include "http.h"
+#include "request.h"
+#include "tinyweb.h"
+
+/*! Number of records per ring, a power of two */
+#define LOG_RING_RECORDS        1024
+/*! Size of the buffer in which the log writer collects entries */
+#define LOG_BATCH_SIZE          (64 * 1024)
+/*! Pause of the log writer when all rings are empty, in milliseconds */
+#define LOG_WRITER_SLEEP_MS     10
+/*! A reserved record which is not published within this time (seconds) is
+ *  skipped, its producer has most likely been killed while writing it */
+#define LOG_STALL_TIMEOUT       1
+/*! Maximum length of a client address, including the terminating '\0' */
+#define LOG_HOST_SIZE           48
+
+/*! \brief The kinds of log records. */
+typedef enum {
+    LOG_RECORD_REQUEST,     /*!< a request, formatted by the log writer */
+    LOG_RECORD_TEXT         /*!< a preformatted line, e.g. statistics */
+} log_record_kind_t;
+
+/*! \brief A fixed-format log record in a ring buffer. */
+typedef struct {
+    unsigned long     seq;        /*!< sequence number, see ring_reserve() */
+    log_record_kind_t kind;       /*!< the kind of the record */
+    int               status;     /*!< the HTTP status code */
+    time_t            date;       /*!< the date of the response */
+    long long         bytes_sent; /*!< the number of bytes sent */
+    char              host[LOG_HOST_SIZE];  /*!< the client address */
+    char              text[MAX_SIZE_LINE];  /*!< the request line (truncated
+                                                 if longer) or the text */
+} log_record_t;
+
+/*! \brief A bounded multi-producer, single-consumer ring of log records.
+ *
+ *  Every record carries a sequence number: a producer may fill the record at
+ *  position pos once its sequence number equals pos, and publishes it by
+ *  setting it to pos + 1.  The log writer reads the record and releases it
+ *  for the next round by setting it to pos + LOG_RING_RECORDS.  Producers
+ *  only compete for the tail with a compare-and-swap, nobody ever waits.
+ *  A record which is not published in time is released by the writer with a
+ *  compare-and-swap as well, so that a producer which publishes it late
+ *  fails instead of overwriting the sequence number of the next round. */
+typedef struct {
+    unsigned long tail __attribute__((aligned(64))); /*!< next position to be
+                                                          reserved */
+    unsigned long dropped;     /*!< records lost because the ring was full */
+    unsigned long head __attribute__((aligned(64))); /*!< next position to be
+                                                          read by the writer */
+    log_record_t  records[LOG_RING_RECORDS];         /*!< the records */
+} log_ring_t;
+
+/*! \brief The memory shared between all processes of the server. */
+typedef struct {
+    int        stop;        /*!< set by the master to stop the log writer */
+    int        n_rings;     /*!< the number of rings */
+    log_ring_t rings[];     /*!< one ring per worker */
+} log_shared_t;
 
 /* we chose to use a global variable because it seemed more difficult to pass
  * around the FILE pointer everywhere we write log messages */
@@ -21,6 +88,29 @@
 /*! The file to which log entries are written */
 static FILE *logfile = 0;
 
+/*! The rings of the log writer, NULL if the log file is written directly */
+static log_shared_t *shared = NULL;
+static size_t shared_size = 0;
+
+/*! The ring of the current process */
+static log_ring_t *ring = NULL;
+
+/*! The process ID of the log writer, in the master process */
+static pid_t writer_pid = -1;
+
+/* helper functions, defined at the bottom of the file */
+static log_record_t *ring_reserve(log_ring_t *r, unsigned long *pos);
+static void ring_publish(log_record_t *rec, unsigned long pos);
+static void copy_string(char *dst, const char *src, size_t size);
+static void writer_loop(int fd, pid_t master);
+static size_t drain_ring(log_ring_t *r, time_t *stalled, char *batch,
+        size_t *len, int fd);
+static size_t format_record(const log_record_t *rec, char *buf,
+        size_t size);
+static void write_batch(int fd, char *batch, size_t *len);
+static void append_batch(int fd, char *batch, size_t *len, const char *text,
+        size_t text_len);
+
 /* --------------------------------------------------------------------------
  *  set_logfile(lf)
  * -------------------------------------------------------------------------- */
@@ -36,6 +126,133 @@ set_logfile(FILE *lf) {
     logfile = lf;
 }
 
+/* --------------------------------------------------------------------------
+ *  log_start_writer(n_rings)
+ * -------------------------------------------------------------------------- */
+/*!
+ * \brief Starts the log writer process.
+ *
+ * From now on, log entries are not written into the log file by the process
+ * which serves the request.  They are appended as fixed-format records to a
+ * ring buffer in shared memory, without locks and without system calls, and
+ * the log writer formats and writes them with large, batched write() calls.
+ * If a ring is full, the entry is dropped instead of waiting for the writer;
+ * the number of dropped entries is written into the log file as a comment:
+ *      # [<pid>] [<date>] log ring <n>: <dropped> entries dropped
+ *
+ * Must be called by the master process after set_logfile() and before any
+ * other process is forked.  Every worker uses a ring of its own (see
+ * log_select_ring()), all other processes share the first ring.
+ *
+ * \param n_rings  The number of rings, at least 1.
+ *
+ * \return  0 on success, -1 if the writer could not be started.  In this
+ *          case, log entries are still written directly into the log file.
+ */
+int
+log_start_writer(int n_rings) {
+
+    int i;
+    unsigned long j;
+    pid_t master = getpid();
+
+    if (logfile == NULL) {
+        return -1;
+    }
+
+    shared_size = sizeof(log_shared_t) + n_rings * sizeof(log_ring_t);
+    shared = (log_shared_t *)mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("ERROR: mmap() of log rings");
+        shared = NULL;
+        return -1;
+    }
+    shared->n_rings = n_rings;
+    for (i = 0; i < n_rings; i++) {
+        for (j = 0; j < LOG_RING_RECORDS; j++) {
+            shared->rings[i].records[j].seq = j;
+        }
+    }
+
+    /* make sure buffered output is not duplicated in the writer */
+    fflush(stdout);
+    fflush(logfile);
+
+    if ((writer_pid = fork()) < 0) {
+        perror("ERROR: fork() of log writer");
+        munmap(shared, shared_size);
+        shared = NULL;
+        return -1;
+    }
+    else if (writer_pid == 0) {
+        writer_loop(fileno(logfile), master);
+    }
+
+    ring = &shared->rings[0];
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  log_select_ring(index)
+ * -------------------------------------------------------------------------- */
+/*!
+ * \brief Selects the ring to which the current process appends its entries.
+ *
+ * Called by every worker with its slot in the pool, so that workers do not
+ * compete for the same ring.  Has no effect if the writer is not running.
+ *
+ * \param index  The ring, modulo the number of rings.
+ */
+void
+log_select_ring(int index) {
+
+    if (shared != NULL) {
+        ring = &shared->rings[index % shared->n_rings];
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  log_stop_writer()
+ * -------------------------------------------------------------------------- */
+/*!
+ * \brief Stops the log writer after it has written all pending entries.
+ *
+ * Must be called by the master process after all other processes which may
+ * log have terminated.  The number of dropped entries, if any, is printed.
+ */
+void
+log_stop_writer(void) {
+
+    unsigned long dropped = 0;
+    int i;
+
+    if (shared == NULL || writer_pid <= 0) {
+        return;
+    }
+
+    __atomic_store_n(&shared->stop, 1, __ATOMIC_RELEASE);
+
+    /* the writer may also be reaped by a SIGCHLD handler (ECHILD) */
+    while (waitpid(writer_pid, NULL, 0) < 0 && errno == EINTR);
+
+    for (i = 0; i < shared->n_rings; i++) {
+        dropped += shared->rings[i].dropped;
+    }
+    if (dropped > 0) {
+        printf("[%d] %lu log entries dropped, the log writer could not keep "
+               "up.\n", getpid(), dropped);
+    }
+
+    munmap(shared, shared_size);
+    shared     = NULL;
+    ring       = NULL;
+    writer_pid = -1;
+}
+
+
 /* --------------------------------------------------------------------------
  *  log_request(host, date, request_first_line, status, bytes_sent)
  * -------------------------------------------------------------------------- */
@@ -51,6 +268,9 @@ set_logfile(FILE *lf) {
  *      <status>     The status code of the HTTP response sent by the server
  *      <bytes-sent> The number of bytes sent to the client
  *
+ * If the log writer is running, the entry is only appended to the ring of
+ * the current process, so this function never blocks.
+ *
  * \param host                A string containing the ip address of the host
  * \param date                The date and time when the response was sent
  * \param request_first_line  The first line of the HTTP request
@@ -59,17 +279,363 @@ set_logfile(FILE *lf) {
  */
 void
 log_request(const char *host, time_t date, const char *request_first_line,
-        http_status_t status, size_t bytes_sent) {
+        http_status_t status, off_t bytes_sent) {
+
+    if (ring != NULL) {
+        unsigned long pos;
+        log_record_t *rec = ring_reserve(ring, &pos);
 
-    char timebuf[32];
-    struct tm *timestruct = gmtime(&date);
-    strftime(timebuf, 32, "%d/%b/%Y:%H:%M:%S %z", timestruct);
-    timebuf[31] = '\0';
+        if (rec != NULL) {
+            rec->kind       = LOG_RECORD_REQUEST;
+            rec->status     = http_status_list[status].code;
+            rec->date       = date;
+            rec->bytes_sent = bytes_sent;
+            copy_string(rec->host, host, sizeof(rec->host));
+            copy_string(rec->text, request_first_line, sizeof(rec->text));
+            ring_publish(rec, pos);
+        }
+        return;
+    }
 
-    fprintf(logfile, "%s - - [%s] \"%s\" %d %zd\n",
+    fprintf(logfile, "%s - - [%s] \"%s\" %d %lld\n",
             host,
-            timebuf,
+            date_cache_log(date),
             request_first_line,
             http_status_list[status].code,
-            bytes_sent);
+            (long long)bytes_sent);
+
+    /* long-lived worker processes would otherwise hold back their log
+     * entries until they terminate */
+    fflush(logfile);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  log_cache_stats()
+ * -------------------------------------------------------------------------- */
+/*!
+ * \brief Writes the counters of the in-memory file cache into the log file.
+ *
+ * The written entry is a comment, so that it is skipped by tools which parse
+ * the request entries:
+ *      # [<pid>] [<date>] file cache: <hits> hits, <misses> misses,
+ *        <files> files (<bytes> bytes) in memory
+ *
+ * Nothing is written if the current process does not keep files in memory.
+ * Every process has a cache of its own, so the counters of all processes have
+ * to be added up.
+ */
+void
+log_cache_stats(void) {
+
+    file_cache_stats_t stats;
+    char text[MAX_SIZE_LINE];
+
+    if (logfile == NULL || file_cache_stats(&stats) < 0) {
+        return;
+    }
+
+    snprintf(text, sizeof(text), "# [%d] [%s] file cache: %lu hits, "
+             "%lu misses, %d files (%lu bytes) in memory",
+             getpid(),
+             date_cache_log(time(NULL)),
+             stats.hits,
+             stats.misses,
+             stats.files,
+             (unsigned long)stats.bytes);
+
+    if (ring != NULL) {
+        unsigned long pos;
+        log_record_t *rec = ring_reserve(ring, &pos);
+
+        if (rec != NULL) {
+            rec->kind = LOG_RECORD_TEXT;
+            copy_string(rec->text, text, sizeof(rec->text));
+            ring_publish(rec, pos);
+        }
+        return;
+    }
+
+    fprintf(logfile, "%s\n", text);
+    fflush(logfile);
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  ring_reserve(r, pos)
+ * -------------------------------------------------------------------------- */
+/*! \brief Reserves the next free record of a ring.
+ *
+ *  \param r    The ring.
+ *  \param pos  Receives the position of the record, needed to publish it.
+ *
+ *  \return  The record, which must be published with ring_publish(), or NULL
+ *           if the ring is full (the record is counted as dropped).
+ */
+static log_record_t *
+ring_reserve(log_ring_t *r, unsigned long *pos) {
+
+    unsigned long p = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+
+    for (;;) {
+        log_record_t *rec = &r->records[p & (LOG_RING_RECORDS - 1)];
+        long diff = (long)(__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) - p);
+
+        if (diff == 0) {
+            /* free, claim it unless another producer was faster */
+            if (__atomic_compare_exchange_n(&r->tail, &p, p + 1, 1,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *pos = p;
+                return rec;
+            }
+        }
+        else if (diff < 0) {
+            /* not yet read by the writer */
+            __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        else {
+            /* reserved by another producer in the meantime */
+            p = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  ring_publish(rec, pos)
+ * -------------------------------------------------------------------------- */
+/*! \brief Hands a filled record over to the log writer.
+ *
+ *  Fails if the writer has already skipped the record because it was not
+ *  published within LOG_STALL_TIMEOUT; it has been counted as dropped then.
+ */
+static void
+ring_publish(log_record_t *rec, unsigned long pos) {
+
+    unsigned long expected = pos;
+
+    __atomic_compare_exchange_n(&rec->seq, &expected, pos + 1, 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  copy_string(dst, src, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Copies a string, truncated to size - 1 characters.
+ */
+static void
+copy_string(char *dst, const char *src, size_t size) {
+
+    size_t len = strlen(src);
+
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+
+/* --------------------------------------------------------------------------
+ *  writer_loop(fd, master)
+ * -------------------------------------------------------------------------- */
+/*! \brief The main loop of the log writer process.
+ *
+ *  Drains all rings into a batch buffer, which is written whenever it is
+ *  full or all rings are empty, and reports new dropped entries.  When the
+ *  rings are empty, the writer sleeps for LOG_WRITER_SLEEP_MS.  It terminates
+ *  once the master has requested it (or has died) and all rings are empty.
+ *  This function never returns.
+ *
+ *  \param fd      The descriptor of the log file.
+ *  \param master  The process ID of the master process.
+ */
+static void
+writer_loop(int fd, pid_t master) {
+
+    struct timespec pause = { 0, LOG_WRITER_SLEEP_MS * 1000000L };
+    unsigned long *reported;
+    time_t *stalled;
+    char *batch, text[MAX_SIZE_LINE];
+    size_t len = 0, n;
+    int i, stop, n_rings = shared->n_rings;
+
+    /* terminated by the master once all entries have been logged, a
+     * keyboard interrupt is sent to all processes of the terminal */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_IGN);
+    signal(SIGCHLD, SIG_DFL);
+
+    batch    = (char *)malloc(LOG_BATCH_SIZE);
+    reported = (unsigned long *)calloc(n_rings, sizeof(unsigned long));
+    stalled  = (time_t *)calloc(n_rings, sizeof(time_t));
+    if (batch == NULL || reported == NULL || stalled == NULL) {
+        err_print("cannot allocate memory");
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;) {
+        /* entries logged before the stop request are drained below */
+        stop = __atomic_load_n(&shared->stop, __ATOMIC_ACQUIRE) ||
+               getppid() != master;
+
+        for (i = 0, n = 0; i < n_rings; i++) {
+            n += drain_ring(&shared->rings[i], &stalled[i], batch, &len, fd);
+        }
+
+        for (i = 0; i < n_rings; i++) {
+            unsigned long dropped = __atomic_load_n(&shared->rings[i].dropped,
+                                                    __ATOMIC_RELAXED);
+            if (dropped != reported[i]) {
+                int cnt = snprintf(text, sizeof(text),
+                        "# [%d] [%s] log ring %d: %lu entries dropped\n",
+                        getpid(), date_cache_log(time(NULL)), i,
+                        dropped - reported[i]);
+                append_batch(fd, batch, &len, text, cnt);
+                reported[i] = dropped;
+            }
+        }
+
+        if (n == 0) {
+            write_batch(fd, batch, &len);
+            if (stop) {
+                break;
+            }
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    exit(EXIT_SUCCESS);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  drain_ring(r, stalled, batch, len, fd)
+ * -------------------------------------------------------------------------- */
+/*! \brief Formats all published records of a ring into the batch buffer.
+ *
+ *  \param r        The ring.
+ *  \param stalled  Since when the next record has been reserved, but not
+ *                  published, 0 if it is not stalled.
+ *
+ *  \return  The number of records read.
+ */
+static size_t
+drain_ring(log_ring_t *r, time_t *stalled, char *batch, size_t *len,
+        int fd) {
+
+    char line[LOG_HOST_SIZE + MAX_SIZE_LINE + 64];
+    size_t n = 0;
+
+    for (;;) {
+        log_record_t *rec = &r->records[r->head & (LOG_RING_RECORDS - 1)];
+        unsigned long seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == r->head + 1) {
+            append_batch(fd, batch, len, line,
+                         format_record(rec, line, sizeof(line)));
+        }
+        else if (seq == r->head &&
+                __atomic_load_n(&r->tail, __ATOMIC_RELAXED) != r->head) {
+            /* reserved, but not published (yet) */
+            if (*stalled == 0) {
+                *stalled = time(NULL);
+            }
+            if (time(NULL) - *stalled <= LOG_STALL_TIMEOUT) {
+                break;
+            }
+            /* skip it, unless it is being published right now */
+            if (!__atomic_compare_exchange_n(&rec->seq, &seq,
+                        r->head + LOG_RING_RECORDS, 0, __ATOMIC_ACQ_REL,
+                        __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+            __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+        }
+        else {
+            break;
+        }
+
+        if (seq == r->head + 1) {
+            __atomic_store_n(&rec->seq, r->head + LOG_RING_RECORDS,
+                             __ATOMIC_RELEASE);
+        }
+        r->head++;
+        *stalled = 0;
+        n++;
+    }
+    return n;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  format_record(rec, buf, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Formats a record as a line of the log file.
+ *
+ *  \return  The length of the line, truncated to size - 1.
+ */
+static size_t
+format_record(const log_record_t *rec, char *buf, size_t size) {
+
+    int cnt;
+
+    if (rec->kind == LOG_RECORD_TEXT) {
+        cnt = snprintf(buf, size, "%s\n", rec->text);
+    }
+    else {
+        cnt = snprintf(buf, size, "%s - - [%s] \"%s\" %d %lld\n",
+                       rec->host,
+                       date_cache_log(rec->date),
+                       rec->text,
+                       rec->status,
+                       rec->bytes_sent);
+    }
+    return (cnt < 0) ? 0 : ((size_t)cnt >= size) ? size - 1 : (size_t)cnt;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  append_batch(fd, batch, len, text, text_len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Appends a line to the batch buffer, writes the buffer first if the
+ *         line does not fit.
+ */
+static void
+append_batch(int fd, char *batch, size_t *len, const char *text,
+        size_t text_len) {
+
+    if (*len + text_len > LOG_BATCH_SIZE) {
+        write_batch(fd, batch, len);
+    }
+    memcpy(batch + *len, text, text_len);
+    *len += text_len;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  write_batch(fd, batch, len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the batch buffer into the log file and empties it.
+ */
+static void
+write_batch(int fd, char *batch, size_t *len) {
+
+    size_t done = 0;
+
+    while (done < *len) {
+        ssize_t cnt = write(fd, batch + done, *len - done);
+        if (cnt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: write() of log entries");
+            break;
+        }
+        done += cnt;
+    }
+    *len = 0;
 }
@@ -6,18 +6,34 @@
  *  \brief      Functions to define logfile and write log-messages into logfile
  *
  *  This module provides functions to set a logfile and to write log-messages
- *  into the defined logfile.
+ *  into the defined logfile.  Once the log writer process has been started,
+ *  the messages are passed to it through lock-free ring buffers in shared
+ *  memory, so that logging never blocks the process serving a request.
  */
 #ifndef _LOG_H_
 #define _LOG_H_
 
+#include <sys/types.h>
+
 #include "http.h"
 
 void
 set_logfile(FILE *logfile);
 
+int
+log_start_writer(int n_rings);
+
+void
+log_select_ring(int index);
+
+void
+log_stop_writer(void);
+
 void
 log_request(const char *host, time_t date, const char *request_first_line,
-        http_status_t status, size_t bytes_sent);
+        http_status_t status, off_t bytes_sent);
+
+void
+log_cache_stats(void);
 
 #endif /* _LOG_H_ */
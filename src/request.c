@@ -11,33 +11,133 @@
 #define __USE_XOPEN
 #define _GNU_SOURCE
 
+#include <ctype.h>
+#include <errno.h>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "request.h"
 #include "safe_print.h"
+#include "scan.h"
 
 // helper functions, defined below parse_request
-static http_status_t parse_method_and_uri(char *first_line, request_t *out);
+static parse_result_t parse_request_line(request_parser_t *parser,
+        const char *buf, size_t end);
+static parse_result_t parse_field_line(request_parser_t *parser,
+        const char *buf, size_t end);
+static int slice_equals(const char *buf, slice_t slice, const char *str);
+static int slice_equals_nocase(const char *buf, slice_t slice,
+        const char *str);
+static size_t slice_copy(const char *buf, slice_t slice, char *dst,
+        size_t size);
 static http_status_t parse_range(char *field, request_t *out);
+static int parse_byte_range(char *spec, byte_range_t *range);
+static void parse_if_range(char *field, request_t *out);
 static http_status_t parse_date(char *field, request_t *out);
+static void parse_accept_encoding(char *field, request_t *out);
 
 
 /* --------------------------------------------------------------------------
- *  parse_request(strrequest, request)
+ *  request_parser_init(parser, start)
  * -------------------------------------------------------------------------- */
-/*! \brief Parses a HTTP request
+/*! \brief Prepares a parser for a request starting at the given offset.
+ *
+ *  \param parser  The parser.
+ *  \param start   The offset of the first byte of the request in the buffer,
+ *                 e.g. the end of the previous (pipelined) request.
+ */
+void
+request_parser_init(request_parser_t *parser, size_t start) {
+
+    memset(parser, 0, sizeof(*parser));
+    parser->result = PARSE_INCOMPLETE;
+    parser->line   = start;
+    parser->pos    = start;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  request_parser_run(parser, buf, len)
+ * -------------------------------------------------------------------------- */
+/*! \brief Parses the bytes appended to the buffer since the last run.
+ *
+ *  Lines may end with "\r\n" or a single "\n", empty lines before the
+ *  request line are skipped.  The buffer does not need to be null-terminated
+ *  and is not modified.
+ *
+ *  \param parser  The parser, initialized with request_parser_init().
+ *  \param buf     The connection buffer.  Data may be appended to it between
+ *                 two runs, but the parsed part must not change.
+ *  \param len     The number of valid bytes in buf.
+ *
+ *  \return  PARSE_DONE once the empty line at the end of the header has been
+ *           found, PARSE_ERROR if the header is malformed or has more than
+ *           MAX_HEADER_FIELDS fields, and PARSE_INCOMPLETE otherwise.  Once
+ *           the result is not PARSE_INCOMPLETE, it does not change anymore.
+ */
+parse_result_t
+request_parser_run(request_parser_t *parser, const char *buf, size_t len) {
+
+    const char *nl, *colon;
+    size_t end;
+
+    while (parser->result == PARSE_INCOMPLETE && parser->pos < len) {
+
+        /* the colon of a header field is found in the same pass */
+        colon = (parser->colon > 0) ? buf + parser->colon : NULL;
+        nl = scan_line(buf + parser->pos, buf + len,
+                       parser->in_fields ? &colon : NULL);
+        if (colon != NULL) {
+            parser->colon = colon - buf;
+        }
+        if (nl == NULL) {
+            parser->pos = len;
+            break;
+        }
+
+        /* the line without "\r\n" is [parser->line, end) */
+        parser->pos = (nl - buf) + 1;
+        end = nl - buf;
+        if (end > parser->line && buf[end - 1] == '\r') {
+            end--;
+        }
+
+        if (!parser->in_fields) {
+            if (end > parser->line) {
+                parser->result = parse_request_line(parser, buf, end);
+            }
+        }
+        else if (end == parser->line) {
+            parser->end    = parser->pos;
+            parser->result = PARSE_DONE;
+        }
+        else {
+            parser->result = parse_field_line(parser, buf, end);
+        }
+        parser->line  = parser->pos;
+        parser->colon = 0;
+    }
+
+    return parser->result;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  parse_request(parser, buf, out)
+ * -------------------------------------------------------------------------- */
+/*! \brief Interprets a parsed HTTP request
  *
  *  This function is only concerned with the structural analysis of the given
  *  HTTP request, and will as such return error codes if the request is
  *  syntactically invalid.  It does not check if the request is semantically
  *  valid (e.g. if the requested file doesn't exist).
  *
- *  \param strrequest  The null-terminated request string.  This input string is
- *                     modified, so a safety copy should be created if one needs
- *                     to preserve the original input string.  In particular,
- *                     every "\r\n" in the string is replaced with "\0\n".
- *  \param request     The request_t pointer to which the result is written.
+ *  \param parser   A parser which has been run on buf.  A result other than
+ *                  PARSE_DONE is reported as a bad request.
+ *  \param buf      The buffer which holds the request.  It is not modified.
+ *  \param out      The request_t pointer to which the result is written.
  *
  *  \return  A HTTP status code.  If the request could not be parsed correctly,
  *           a code different from HTTP_STATUS_OK is returned.  This error code
@@ -48,156 +148,409 @@ static http_status_t parse_date(char *field, request_t *out);
  *           the requested file exists and is readable.
  */
 http_status_t
-parse_request(char *strrequest, request_t *request) {
+parse_request(const request_parser_t *parser, const char *buf,
+        request_t *out) {
+
+    http_status_t result = HTTP_STATUS_OK;
+    char value[MAX_SIZE_LINE];
+    int i;
+
+    /* sets the default values of the optional fields, they might be
+     * overwritten below */
+    out->method          = HTTP_METHOD_UNKNOWN;
+    out->uri[0]          = '\0';
+    out->n_ranges        = 0;
+    out->if_range        = 0;
+    out->if_range_etag[0] = '\0';
+    out->if_none_match[0] = '\0';
+    out->modified_since  = 0;
+    out->is_cgi          = FALSE;
+    out->keep_alive      = FALSE;
+    out->accepts_chunked = FALSE;
+    out->accepts_gzip    = FALSE;
+
+    if (parser->result != PARSE_DONE) {
+        return HTTP_STATUS_BAD_REQUEST;
+    }
 
-    int result = parse_method_and_uri(strrequest, request);
-    if (result != HTTP_STATUS_OK) {
-        return result;
+    if (slice_equals(buf, parser->method, "HEAD")) {
+        out->method = HTTP_METHOD_HEAD;
+    }
+    else if (slice_equals(buf, parser->method, "GET")) {
+        out->method = HTTP_METHOD_GET;
+    }
+    else {
+        return HTTP_STATUS_NOT_IMPLEMENTED;
     }
 
-    /* Caution: the '\0' at the end of the first line is needed outside of this
-     * function.  Don't change unless you know what you're doing. */
-    char *rest = strstr(strrequest, "\r\n");
-    *rest = '\0';
+    /* the URI and its trailing '\0' byte must fit into out->uri */
+    if (parser->uri.length + 1 > MAX_SIZE_URI) {
+        return HTTP_STATUS_BAD_REQUEST;
+    }
+    slice_copy(buf, parser->uri, out->uri, MAX_SIZE_URI);
 
+    /* the requested file is a CGI script if the URI starts with /cgi-bin */
+    out->is_cgi = (strncmp(out->uri, "/cgi-bin", 8) == 0);
 
+    /* HTTP/1.1 connections are persistent unless the client sends
+     * "Connection: close", older versions have to ask for it */
+    out->accepts_chunked = slice_equals(buf, parser->version, "HTTP/1.1");
+    out->keep_alive      = out->accepts_chunked;
 
-    /* sets the default value for the requested Content-Range.  This default
-     * value might be overwritten below */
-    request->range_start = 0;
+    for (i = 0; i < parser->n_fields; i++) {
 
-    while (rest != NULL) {
+        const header_field_t *field = &parser->fields[i];
 
-        int ret;
-        char *current_line = rest + 2;
+        if (slice_equals_nocase(buf, field->name, "Range")) {
 
-        if (strncmp(current_line, "Range:", 6) == 0) {
+            slice_copy(buf, field->value, value, sizeof(value));
+            result = parse_range(value, out);
+        }
+        else if (slice_equals_nocase(buf, field->name, "If-Range")) {
+
+            slice_copy(buf, field->value, value, sizeof(value));
+            parse_if_range(value, out);
+        }
+        else if (slice_equals_nocase(buf, field->name, "Connection")) {
 
-            char *field_value = &current_line[6];
-            ret = parse_range(field_value, request);
-            if (ret == HTTP_STATUS_BAD_REQUEST) {
-                return ret;
+            slice_copy(buf, field->value, value, sizeof(value));
+            if (strncasecmp(value, "close", 5) == 0) {
+                out->keep_alive = FALSE;
+            }
+            else if (strncasecmp(value, "keep-alive", 10) == 0) {
+                out->keep_alive = TRUE;
             }
-            result = HTTP_STATUS_PARTIAL_CONTENT;
         }
-        else if (strncmp(current_line, "If-Modified-Since:", 18) == 0) {
+        else if (slice_equals_nocase(buf, field->name, "If-Modified-Since")) {
 
-            char *field_value = &current_line[18];
-            while (*field_value == ' ') {
-                field_value++;
+            slice_copy(buf, field->value, value, sizeof(value));
+            if (parse_date(value, out) == HTTP_STATUS_BAD_REQUEST) {
+                return HTTP_STATUS_BAD_REQUEST;
             }
+        }
+        else if (slice_equals_nocase(buf, field->name, "If-None-Match")) {
 
-            ret = parse_date(field_value, request);
-            if (ret == HTTP_STATUS_BAD_REQUEST) {
-                return ret;
+            /* a list which does not fit is ignored rather than truncated */
+            if (field->value.length < sizeof(out->if_none_match)) {
+                slice_copy(buf, field->value, out->if_none_match,
+                           sizeof(out->if_none_match));
             }
         }
+        else if (slice_equals_nocase(buf, field->name, "Accept-Encoding")) {
 
-        rest = strstr(rest + 2, "\r\n");
+            slice_copy(buf, field->value, value, sizeof(value));
+            parse_accept_encoding(value, out);
+        }
     }
 
     return result;
 }
 
 
-/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
-
 /* --------------------------------------------------------------------------
- *  parse_method_and_uri(first_line, out)
+ *  request_line(parser, buf)
  * -------------------------------------------------------------------------- */
-/*! \brief Determines the HTTP method and the requested URI.
+/*! \brief Returns the request line for the log file.
  *
- *  Both values are written to the given request_t pointer.
+ *  The line is null-terminated in place, the byte behind it (usually the
+ *  '\r' of the line break) is overwritten.  If the request line is not
+ *  complete, the bytes scanned so far are returned.
  *
- *  \param first_line    The first line of the HTTP request (method and URI are
- *                       parsed from the first line)
- *  \param out           The request_t pointer to which the result is written.
+ *  \param parser  A parser which has been run on buf.
+ *  \param buf     The buffer which holds the request.  It must have room for
+ *                 a '\0' byte behind the valid data.
  *
- *  \return  A HTTP status code.  If the return value is not HTTP_STATUS_OK, an
- *           error occurred.
+ *  \return  The request line, pointing into buf.
  */
-static http_status_t
-parse_method_and_uri(char *first_line, request_t *out) {
+const char *
+request_line(const request_parser_t *parser, char *buf) {
 
-    char *uri;
-    if (strncmp(first_line, "HEAD", 4) == 0) {
-        out->method = HTTP_METHOD_HEAD;
-        uri = first_line + 5;   /* uri points to the char after "HEAD " */
-    }
-    else if (strncmp(first_line, "GET", 3) == 0) {
-        out->method = HTTP_METHOD_GET;
-        uri = first_line + 4;   /* uri points to the char after "GET " */
+    slice_t line = parser->request_line;
+
+    if (!parser->in_fields) {
+        line.offset = parser->line;
+        line.length = parser->pos - parser->line;
+        while (line.length > 0 && (buf[line.offset + line.length - 1] == '\n'
+                    || buf[line.offset + line.length - 1] == '\r')) {
+            line.length--;
+        }
     }
-    else {
-        return HTTP_STATUS_NOT_IMPLEMENTED;
+    buf[line.offset + line.length] = '\0';
+    return buf + line.offset;
+}
+
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  parse_request_line(parser, buf, end)
+ * -------------------------------------------------------------------------- */
+/*! \brief Splits the request line into method, URI and protocol version.
+ *
+ *  \param parser  The parser, parser->line is the start of the line.
+ *  \param buf     The buffer which holds the request.
+ *  \param end     The offset of the end of the line (without line break).
+ *
+ *  \return  PARSE_INCOMPLETE if the line consists of exactly three parts
+ *           separated by single spaces and the version starts with "HTTP/",
+ *           PARSE_ERROR otherwise.
+ */
+static parse_result_t
+parse_request_line(request_parser_t *parser, const char *buf, size_t end) {
+
+    slice_t *parts[3] = { &parser->method, &parser->uri, &parser->version };
+    size_t pos = parser->line;
+    int i;
+
+    parser->in_fields           = 1;
+    parser->request_line.offset = parser->line;
+    parser->request_line.length = end - parser->line;
+
+    for (i = 0; i < 3; i++) {
+        const char *sp = scan_byte(buf + pos, buf + end, ' ');
+        size_t part_end = (i < 2 && sp != NULL) ? (size_t)(sp - buf) : end;
+
+        if (part_end == pos || (i == 2 && sp != NULL)) {
+            return PARSE_ERROR;
+        }
+        parts[i]->offset = pos;
+        parts[i]->length = part_end - pos;
+        pos = part_end + 1;
     }
 
-    /* allocates MAX_SIZE_URI bytes for the URI. The terminating null-byte will
-     * be written to this buffer too */
-    out->uri = (char *)malloc(MAX_SIZE_URI * sizeof(char));
-    if (out->uri == NULL) {
-        return HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    if (parser->version.length < 5 ||
+            strncmp(buf + parser->version.offset, "HTTP/", 5) != 0) {
+        return PARSE_ERROR;
     }
+    return PARSE_INCOMPLETE;
+}
 
-    /* looks for the next whitespace character, which should occur directly
-     * after the URI.  If it cannot be found, or, the URI is too large
-     * (difference between start of URI and end of URI + trailing '\0' byte */
-    char *nextspace = strchr(uri, ' ');
-    if (nextspace == NULL || nextspace-uri+1 > MAX_SIZE_URI) {
-        return HTTP_STATUS_BAD_REQUEST;
+
+/* --------------------------------------------------------------------------
+ *  parse_field_line(parser, buf, end)
+ * -------------------------------------------------------------------------- */
+/*! \brief Records the name and the value of a header field.
+ *
+ *  \param parser  The parser, parser->line is the start of the line and
+ *                 parser->colon the first colon in it (0 if there is none).
+ *  \param buf     The buffer which holds the request.
+ *  \param end     The offset of the end of the line (without line break).
+ *
+ *  \return  PARSE_INCOMPLETE if the field has been recorded, PARSE_ERROR if
+ *           the line is not a valid field (obsolete line folding is not
+ *           supported) or if there are too many fields.
+ */
+static parse_result_t
+parse_field_line(request_parser_t *parser, const char *buf, size_t end) {
+
+    const char *colon = (parser->colon > 0) ? buf + parser->colon : NULL;
+    header_field_t *field;
+    size_t pos;
+
+    if (colon == NULL || colon == buf + parser->line ||
+            buf[parser->line] == ' ' || buf[parser->line] == '\t' ||
+            colon[-1] == ' ' || colon[-1] == '\t' ||
+            parser->n_fields == MAX_HEADER_FIELDS) {
+        return PARSE_ERROR;
     }
-    else {
-        /* temporarily null-terminates the URI in the request */
-        *nextspace = '\0';
-        strcpy(out->uri, uri);
 
-        /* this is necessary since the first line of the request will be written
-         * to the log file, and the null-byte would interfere with thatj */
-        *nextspace = ' ';
+    field = &parser->fields[parser->n_fields++];
+    field->name.offset = parser->line;
+    field->name.length = (colon - buf) - parser->line;
 
-        /* the requested file is a CGI script if the URI starts with /cgi-bin */
-        out->is_cgi = (strncmp(out->uri, "/cgi-bin", 8) == 0);
+    pos = (colon - buf) + 1;
+    while (pos < end && (buf[pos] == ' ' || buf[pos] == '\t')) {
+        pos++;
     }
+    while (end > pos && (buf[end - 1] == ' ' || buf[end - 1] == '\t')) {
+        end--;
+    }
+    field->value.offset = pos;
+    field->value.length = end - pos;
 
-    return HTTP_STATUS_OK;
+    return PARSE_INCOMPLETE;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  slice_equals(buf, slice, str)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compares a slice with a string, e.g. a method or version.
+ */
+static int
+slice_equals(const char *buf, slice_t slice, const char *str) {
+
+    return strlen(str) == slice.length &&
+           strncmp(buf + slice.offset, str, slice.length) == 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  slice_equals_nocase(buf, slice, str)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compares a slice with a string ignoring the case, e.g. a field name.
+ */
+static int
+slice_equals_nocase(const char *buf, slice_t slice, const char *str) {
+
+    return strlen(str) == slice.length &&
+           strncasecmp(buf + slice.offset, str, slice.length) == 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  slice_copy(buf, slice, dst, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Copies a slice into a null-terminated string, truncated to size.
+ *
+ *  \return  The number of bytes copied, without the terminating '\0' byte.
+ */
+static size_t
+slice_copy(const char *buf, slice_t slice, char *dst, size_t size) {
+
+    size_t len = (slice.length < size - 1) ? slice.length : size - 1;
+
+    memcpy(dst, buf + slice.offset, len);
+    dst[len] = '\0';
+    return len;
 }
 
 
 /* --------------------------------------------------------------------------
  *  parse_range(field, out)
  * -------------------------------------------------------------------------- */
-/*! \brief Parses the value of a Content-Range field
+/*! \brief Parses the value of a Range field
  *
- *  The Content-Range field value must have the format bytes=<begin>-, that is
- *  it must only contain a start index but not an end index.  If it contains an
- *  end index, only the start index is parsed and no error occurs.
+ *  The field value is a list of byte ranges, e.g. "bytes=0-99, 200-, -50"
+ *  (RFC 7233).  The ranges are stored as requested, they are resolved against
+ *  the size of the file by generate_response_header().  A field with another
+ *  unit, an invalid range or more than MAX_RANGES ranges is ignored, the
+ *  complete file is sent in this case.
  *
- *  \param field  The Content-Range field value
+ *  \param field  The Range field value, modified by this function.
  *  \param out    The request_t pointer to which the result is written.
  *
- *  \return  A HTTP status code.  If the return value is not HTTP_STATUS_OK, an
- *           error occurred.
+ *  \return  HTTP_STATUS_PARTIAL_CONTENT if ranges have been requested,
+ *           HTTP_STATUS_OK if the field is ignored.
  */
 static http_status_t
 parse_range(char *field, request_t *out) {
 
-    /* This function does not check if the request uses the exact format
-     * 'bytes=<begin>-', instead it just parses the integer directly after the
-     * first '='.
-     */
+    char *spec, *save = NULL;
+    int n = 0;
 
-    char *begin = strchr(field, '=');
-    if (begin == NULL) {
-        return HTTP_STATUS_BAD_REQUEST;
+    out->n_ranges = 0;
+    if (strncasecmp(field, "bytes=", 6) != 0) {
+        return HTTP_STATUS_OK;
     }
 
-    int range_begin;
-    if (sscanf(begin + 1, "%d", &range_begin) != 1) {
-        return HTTP_STATUS_BAD_REQUEST;
+    for (spec = strtok_r(field + 6, ",", &save); spec != NULL;
+            spec = strtok_r(NULL, ",", &save)) {
+
+        /* the list may contain empty elements */
+        spec += strspn(spec, " \t");
+        if (*spec == '\0') {
+            continue;
+        }
+        if (n == MAX_RANGES || parse_byte_range(spec, &out->ranges[n]) < 0) {
+            return HTTP_STATUS_OK;
+        }
+        n++;
     }
 
-    out->range_start = range_begin;
-    return HTTP_STATUS_PARTIAL_CONTENT;
+    out->n_ranges = n;
+    return (n > 0) ? HTTP_STATUS_PARTIAL_CONTENT : HTTP_STATUS_OK;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  parse_byte_range(spec, range)
+ * -------------------------------------------------------------------------- */
+/*! \brief Parses a single range of a Range field, "a-b", "a-" or "-n"
+ *
+ *  A last byte position too large for off_t extends the range to the end of
+ *  the file, a suffix length too large covers the whole file; only a first
+ *  byte position too large makes the range invalid.
+ *
+ *  \param spec   The range, without leading whitespace.
+ *  \param range  The byte_range_t to which the result is written.
+ *
+ *  \return  0 on success, -1 if the range is invalid.
+ */
+static int
+parse_byte_range(char *spec, byte_range_t *range) {
+
+    char *end;
+
+    range->first = -1;
+    range->last  = -1;
+
+    errno = 0;
+    if (*spec != '-') {
+        if (!isdigit((unsigned char)*spec)) {
+            return -1;
+        }
+        range->first = strtoll(spec, &end, 10);
+        spec = end;
+        if (errno == ERANGE) {
+            return -1;
+        }
+    }
+    if (*spec++ != '-') {
+        return -1;
+    }
+    if (isdigit((unsigned char)*spec)) {
+        range->last = strtoll(spec, &end, 10);
+        spec = end;
+        if (errno == ERANGE && range->first >= 0) {
+            range->last = -1;       /* to the end of the file */
+        }
+    }
+    else if (range->first < 0) {
+        return -1;                  /* neither first nor last byte */
+    }
+    spec += strspn(spec, " \t");
+
+    if (*spec != '\0' || (range->first >= 0 && range->last >= 0 &&
+                           range->last < range->first)) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  parse_if_range(field, out)
+ * -------------------------------------------------------------------------- */
+/*! \brief Parses the value of an If-Range field
+ *
+ *  The ranges are only sent if the file still has the given strong entity
+ *  tag, or if it has not been modified since the given date.  A weak entity
+ *  tag (or an invalid date) never matches, the complete file is sent.
+ *
+ *  \param field  The If-Range field value
+ *  \param out    The request_t pointer to which the result is written.
+ */
+static void
+parse_if_range(char *field, request_t *out) {
+
+    struct tm timestruct;
+
+    if (field[0] == '"' || strncmp(field, "W/", 2) == 0) {
+        out->if_range = -1;
+        if (field[0] == '"' && strlen(field) < sizeof(out->if_range_etag)) {
+            strcpy(out->if_range_etag, field);
+        }
+        return;
+    }
+
+    memset(&timestruct, 0, sizeof(timestruct));
+    if (strptime(field, "%a, %d %b %Y %H:%M:%S GMT", &timestruct) != NULL) {
+        out->if_range = timegm(&timestruct);
+    }
+    else {
+        out->if_range = -1;
+    }
 }
 
 
@@ -226,3 +579,52 @@ parse_date(char *field, request_t *out) {
 
     return HTTP_STATUS_OK;
 }
+
+
+/* --------------------------------------------------------------------------
+ *  parse_accept_encoding(field, out)
+ * -------------------------------------------------------------------------- */
+/*! \brief Parses the value of an Accept-Encoding field
+ *
+ *  The field is a list of content codings with optional weights, e.g.
+ *  "gzip, deflate;q=0.5".  gzip is accepted if it is listed as "gzip" or
+ *  "x-gzip" with a weight above 0, or if it is not listed but "*" is.  An
+ *  invalid field is ignored, the file is sent uncompressed in this case.
+ *
+ *  \param field  The Accept-Encoding field value, modified by this function.
+ *  \param out    The request_t pointer to which the result is written.
+ */
+static void
+parse_accept_encoding(char *field, request_t *out) {
+
+    char *coding, *params, *end, *save = NULL;
+    int accepted, gzip = -1, any = -1;
+
+    for (coding = strtok_r(field, ",", &save); coding != NULL;
+            coding = strtok_r(NULL, ",", &save)) {
+
+        accepted = TRUE;
+        if ((params = strchr(coding, ';')) != NULL) {
+            *params++ = '\0';
+            params += strspn(params, " \t");
+            if (strncasecmp(params, "q=", 2) == 0) {
+                accepted = (strtod(params + 2, NULL) > 0);
+            }
+        }
+
+        coding += strspn(coding, " \t");
+        for (end = coding + strlen(coding);
+                end > coding && (end[-1] == ' ' || end[-1] == '\t'); end--);
+        *end = '\0';
+
+        if (strcasecmp(coding, "gzip") == 0 ||
+                strcasecmp(coding, "x-gzip") == 0) {
+            gzip = accepted;
+        }
+        else if (strcmp(coding, "*") == 0) {
+            any = accepted;
+        }
+    }
+
+    out->accepts_gzip = (gzip >= 0) ? gzip : (any == TRUE);
+}
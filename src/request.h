@@ -5,13 +5,21 @@
  *  \date       July 22, 2016
  *  \brief      Parsing HTTP requests.
  *
- *  This module contains HTTP requests (request_t), and the function
- *  parse_request(), which parses a HTTP request from a string.
+ *  This module contains HTTP requests (request_t), an incremental parser of
+ *  request headers (request_parser_t), which finds the request line and the
+ *  header fields in a connection buffer without copying them, and the
+ *  function parse_request(), which interprets a parsed header.
+ *
+ *  The parser can be run on a buffer which is still being filled: it resumes
+ *  with the bytes received since the previous run.  Pipelined requests in the
+ *  same buffer are parsed one after another by starting a new parser at the
+ *  end of the previous request header.
  */
 
 #ifndef _REQUEST_H_
 #define _REQUEST_H_
 
+#include <sys/types.h>
 #include <time.h>
 #include "http.h"
 
@@ -19,10 +27,32 @@
 #define MAX_SIZE_URI         255
 #define MAX_SIZE_LINE        512
 #define MAX_SIZE_BUFFER_CGI 2048
+#define MAX_SIZE_ETAG_LIST   256
 
 #define TRUE  1
 #define FALSE 0
 
+/*! \brief The maximum number of header fields of a request */
+#define MAX_HEADER_FIELDS     32
+
+/*! \brief The maximum number of ranges of a Range field, a request for more
+ *  ranges is answered with the complete file */
+#define MAX_RANGES            16
+
+/*!
+ *  \brief A byte range of a Range field, as requested by the client.
+ *
+ *  The range is resolved against the size of the file when the response is
+ *  generated: "bytes=a-b" is stored as {a, b}, "bytes=a-" as {a, -1} and the
+ *  suffix range "bytes=-n" (the last n bytes) as {-1, n}.
+ */
+typedef struct {
+    off_t first;           /*!< The first byte, -1 for a suffix range */
+    off_t last;            /*!< The last byte, -1 if the range extends to the
+                                end of the file; the length of a suffix
+                                range */
+} byte_range_t;
+
 /*!
  *  \brief The contents of a HTTP GET or HEAD request
  */
@@ -30,17 +60,96 @@ typedef struct {
 
     http_method_t method;  /*!< The HTTP request method, only GET and HEAD are
                                 supported */
-    char *uri;             /*!< The requested URI */
-    int range_start;       /*!< The first component of the Content-Range field,
-                                the second component is always EOF */
+    char uri[MAX_SIZE_URI]; /*!< The requested URI, empty if the request line
+                                could not be parsed */
+    byte_range_t ranges[MAX_RANGES]; /*!< The ranges of the Range field */
+    int n_ranges;          /*!< The number of ranges, 0 if the complete file
+                                is requested */
+    time_t if_range;       /*!< The date of the If-Range field, 0 if not sent,
+                                -1 if it is an entity tag or no valid date */
+    char if_range_etag[HTTP_ETAG_SIZE]; /*!< The strong entity tag of the
+                                If-Range field, empty if none */
     time_t modified_since; /*!< The value of the If-Modified-Since field, if
                                 sent */
+    char if_none_match[MAX_SIZE_ETAG_LIST]; /*!< The value of the
+                                If-None-Match field, a list of entity tags or
+                                "*"; empty if not sent */
     int is_cgi;            /*!< If the URI starts with /cgi-bin (that is, we
                                 need to execute a CGI script */
+    int keep_alive;        /*!< If the client wants a persistent connection,
+                                derived from the protocol version and the
+                                Connection field */
+    int accepts_chunked;   /*!< If the client understands the chunked transfer
+                                coding, that is, it speaks HTTP/1.1 */
+    int accepts_gzip;      /*!< If the Accept-Encoding field allows the gzip
+                                content coding */
 
 } request_t;
 
+/*!
+ *  \brief A part of the buffer which holds a request, e.g. a field value.
+ *
+ *  Slices refer to the buffer by offsets, so they remain valid if the buffer
+ *  is moved as a whole.
+ */
+typedef struct {
+    size_t offset;         /*!< The position of the first byte in the buffer */
+    size_t length;         /*!< The number of bytes */
+} slice_t;
+
+/*!
+ *  \brief A header field of a request, without copies of name and value.
+ */
+typedef struct {
+    slice_t name;          /*!< The field name, without the colon */
+    slice_t value;         /*!< The field value, without surrounding spaces */
+} header_field_t;
+
+/*!
+ *  \brief The state of an incremental request parser.
+ */
+typedef enum {
+    PARSE_INCOMPLETE = 0,  /*!< more data is needed */
+    PARSE_DONE,            /*!< the request header is complete */
+    PARSE_ERROR            /*!< the request header is malformed */
+} parse_result_t;
+
+/*!
+ *  \brief An incremental parser of a request header in a connection buffer.
+ *
+ *  The parser is run again whenever more data has been appended to the buffer
+ *  and continues where it stopped, so every byte is only scanned once.  Once
+ *  the header is complete, parser.end is the offset of the first byte behind
+ *  it, where a pipelined request may start.
+ */
+typedef struct {
+    parse_result_t result; /*!< The result of the last run */
+    int in_fields;         /*!< If the request line has been parsed */
+    size_t line;           /*!< The offset of the current line */
+    size_t pos;            /*!< The offset of the next byte to scan */
+    size_t colon;          /*!< The offset of the first ':' of the current
+                                line, 0 if none has been found yet */
+    size_t end;            /*!< The offset behind the request header, valid
+                                if result is PARSE_DONE */
+    slice_t request_line;  /*!< The request line, without the line break */
+    slice_t method;        /*!< The method of the request line */
+    slice_t uri;           /*!< The URI of the request line */
+    slice_t version;       /*!< The protocol version of the request line */
+    header_field_t fields[MAX_HEADER_FIELDS]; /*!< The header fields */
+    int n_fields;          /*!< The number of header fields */
+} request_parser_t;
+
+void
+request_parser_init(request_parser_t *parser, size_t start);
+
+parse_result_t
+request_parser_run(request_parser_t *parser, const char *buf, size_t len);
+
 http_status_t
-parse_request(char *request, request_t *out);
+parse_request(const request_parser_t *parser, const char *buf,
+        request_t *out);
+
+const char *
+request_line(const request_parser_t *parser, char *buf);
 
 #endif // _REQUEST_H_
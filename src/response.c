@@ -8,26 +8,57 @@
  *  See response.h for API documentation.
  */
 
+#define _GNU_SOURCE
+
 #include <errno.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
+#include <poll.h>
+#include <string.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "cgi.h"
 #include "content.h"
+#include "date_cache.h"
+#include "fcgi.h"
+#include "gzip.h"
 #include "socket_io.h"
 #include "safe_print.h"
+#include "stats.h"
 
 #include "response.h"
 
 #define FIELD_ACCEPT_RANGES "Accept-Ranges: bytes\r\n"
+#define FIELD_CHUNKED       "Transfer-Encoding: chunked\r\n"
 #define FIELD_CONNECTION    "Connection: Close\r\n"
+#define FIELD_GZIP          "Content-Encoding: gzip\r\n"
+#define FIELD_KEEP_ALIVE    "Connection: Keep-Alive\r\n"
 #define FIELD_SERVER        "Server: TinyWeb\r\n"
+#define FIELD_VARY          "Vary: Accept-Encoding\r\n"
+
+/* files up to this size are sent together with the header by one call */
+#define MAX_SIZE_INLINE_BODY    16384
+
+/* the maximum number of bytes transferred by a single sendfile() call */
+#define MAX_SIZE_SENDFILE       0x7ffff000
+
+/* the capacity of the pipe between a CGI script and the server, which is
+ * also the maximum number of bytes moved by a single splice() call; the
+ * default limit for unprivileged processes (/proc/sys/fs/pipe-max-size) */
+#define CGI_PIPE_SIZE           (1024 * 1024)
+
+/* the size of the buffer through which the output of a CGI script is copied
+ * if it cannot be spliced, e.g. to frame it in chunks */
+#define CGI_COPY_SIZE           65536
 
 #define IS_EXECUTABLE(mode) (S_ISREG(mode) && (S_IXOTH & (mode)))
 #define IS_DIRECTORY(mode)  (S_ISDIR(mode) && ((S_IXOTH || S_IROTH) & (mode)))
@@ -36,9 +67,53 @@
 /* used to ensure that CGI script child processes inherit env vars. */
 extern char **environ;
 
+/*! \brief The output of a CGI script. */
+typedef struct {
+    int fd;                         /*!< the receiving end of the pipe from the
+                                         script, -1 for a FastCGI script */
+    fcgi_stream_t *fcgi;            /*!< the request to a FastCGI pool, NULL
+                                         for a pipe */
+} cgi_source_t;
+
+/*! \brief How the end of the output of a CGI script is marked. */
+typedef enum {
+    CGI_FRAME_NONE = 0,             /*!< the status has no body */
+    CGI_FRAME_LENGTH,               /*!< Content-Length of the script */
+    CGI_FRAME_CHUNKED,              /*!< chunked transfer coding */
+    CGI_FRAME_CLOSE                 /*!< closing the connection */
+} cgi_framing_t;
+
 /* helper functions, defined at the bottom of the file */
-static int send_cgi_output(int sd_client, const char *filename);
-static int send_date(int sd, const time_t *date, char *name, char *buf);
+static off_t send_cgi_output(int sd_client, const char *filename,
+        response_t *res, uint64_t *start);
+static off_t relay_cgi_output(cgi_source_t *src, int sd_client,
+        response_t *res, uint64_t *start);
+static off_t forward_cgi_output(cgi_source_t *src, int sd_client,
+        off_t limit, response_t *res);
+static off_t compress_cgi_output(cgi_source_t *src, int sd_client,
+        gzip_stream_t *gz, const char *data, size_t len, off_t limit,
+        int chunked, response_t *res);
+static ssize_t read_cgi_output(cgi_source_t *src, char *buf, size_t size,
+        response_t *res);
+static int format_cgi_header(const response_t *res, const cgi_header_t *hdr,
+        cgi_framing_t framing, char *buf, size_t size);
+static int send_cgi_data(int sd_client, const char *header, size_t header_len,
+        const char *data, size_t len, int chunked, int flags,
+        response_t *res);
+static int send_iov(int sd_client, struct iovec *iov, int iovcnt, int flags,
+        response_t *res);
+static int format_content_fields(const response_t *res, char *buf,
+        size_t size);
+static void select_gzip_variant(const char *filename, const request_t *req,
+        response_t *res);
+static void select_compressed_copy(const char *filename,
+        const request_t *req, response_t *res);
+static int etag_list_matches(const char *list, const char *etag);
+static int if_range_holds(const request_t *req, const response_t *res);
+static void select_ranges(const request_t *req, response_t *res);
+static int format_part_headers(response_t *res);
+static void attach_cached_content(response_t *res);
+static void attach_status_page(response_t *res, stats_format_t format);
 
 /* --------------------------------------------------------------------------
  *  generate_response_header(filename, status, req, out)
@@ -64,177 +139,433 @@ generate_response_header(char *filename, http_status_t status, request_t *req,
     out->content_location = req->uri;
     out->date             = time(NULL);
     out->status           = status;
+    out->method           = req->method;
+    out->is_cgi           = 0;
+    out->keep_alive       = req->keep_alive;
+    out->accepts_chunked  = req->accepts_chunked;
+    out->accepts_gzip     = req->accepts_gzip;
+    out->content_gzip     = 0;
+    out->vary_encoding    = 0;
+    out->syscalls         = 0;
+    out->file             = NULL;
+    out->cached           = NULL;
+    out->cached_len       = 0;
+    out->page             = NULL;
+    out->trace            = NULL;
+    out->n_parts          = 0;
+    out->part_headers     = NULL;
+
+    /* the status page is rendered instead of looking up a file */
+    if (status == HTTP_STATUS_OK || status == HTTP_STATUS_PARTIAL_CONTENT) {
+        int format = stats_status_format(req->uri);
+        if (format >= 0) {
+            attach_status_page(out, (stats_format_t)format);
+            return;
+        }
+    }
 
     /* content-related fields are only send for status OK and PARTIAL_CONTENT */
     if (status == HTTP_STATUS_OK || status == HTTP_STATUS_PARTIAL_CONTENT) {
 
-        struct stat file_stats;
-        if (stat(filename, &file_stats) == -1) {
+        /* the stat() result and the descriptor usually come from the cache */
+        if ((out->file = file_cache_get(filename)) == NULL) {
             out->status = HTTP_STATUS_NOT_FOUND;
+            return;
         }
-        else if (IS_DIRECTORY(file_stats.st_mode)) {
+
+        const struct stat *file_stats = &out->file->st;
+        int not_modified;
+
+        if (IS_DIRECTORY(file_stats->st_mode)) {
             out->status = HTTP_STATUS_MOVED_PERMANENTLY;
+            return;
         }
-        else if (!IS_READABLE(file_stats.st_mode)) {
+        else if (!IS_READABLE(file_stats->st_mode)) {
             out->status = HTTP_STATUS_FORBIDDEN;
+            return;
+        }
+
+        /* the range and the modification time refer to the file sent */
+        if (!req->is_cgi) {
+            select_gzip_variant(filename, req, out);
+            if (!out->content_gzip && out->file->has_gzip == 0) {
+                select_compressed_copy(filename, req, out);
+            }
+            file_stats = &out->file->st;
         }
-        else if (req->range_start >= file_stats.st_size ||
-                 req->range_start  < 0) {
-            out->status = HTTP_STATUS_RANGE_NOT_SATISFIABLE;
+
+        out->last_modified = file_stats->st_mtime;
+
+        if (req->is_cgi) {
+            /* ranges do not apply to the output of a script */
+            out->is_cgi = 1;
+            out->status = HTTP_STATUS_OK;
+            if (!IS_EXECUTABLE(file_stats->st_mode)) {
+                out->status = HTTP_STATUS_FORBIDDEN;
+            }
         }
         else {
-            out->last_modified       = file_stats.st_mtime;
-            out->content_range.begin = req->range_start;
+            out->content_type   = get_http_content_type(filename);
+            out->content_length = file_stats->st_size;
+            out->parts[0].header     = NULL;
+            out->parts[0].header_len = 0;
+            out->parts[0].begin      = 0;
+            out->parts[0].length     = file_stats->st_size;
+            out->n_parts             = 1;
+        }
 
-            if (req->is_cgi) {
-                out->is_cgi = 1;
-                if (!IS_EXECUTABLE(file_stats.st_mode)) {
-                    out->status = HTTP_STATUS_FORBIDDEN;
-                }
+        /* If-None-Match takes precedence over If-Modified-Since, entity
+         * tags only describe static files */
+        if (req->if_none_match[0] != '\0' && !out->is_cgi) {
+            not_modified = etag_list_matches(req->if_none_match,
+                                             out->file->etag);
+        }
+        else {
+            not_modified = (out->last_modified <= req->modified_since);
+        }
+
+        if (not_modified) {
+            out->status = HTTP_STATUS_NOT_MODIFIED;
+        }
+        else if (out->status == HTTP_STATUS_PARTIAL_CONTENT) {
+            /* If-Range: the ranges refer to the version of the file the
+             * client has, a newer version is sent completely */
+            if (!if_range_holds(req, out)) {
+                out->status = HTTP_STATUS_OK;
             }
             else {
-                out->content_range.total = file_stats.st_size;
-                out->content_length      = file_stats.st_size- req->range_start;
-                out->content_type        = get_http_content_type(filename);
-                out->is_cgi              = 0;
+                select_ranges(req, out);
             }
+        }
 
-            if (out->last_modified <= req->modified_since) {
-                out->status = HTTP_STATUS_NOT_MODIFIED;
-            }
+        if (out->status == HTTP_STATUS_OK && !out->is_cgi &&
+                !out->content_gzip) {
+            /* the cached fields of a compressed copy would also be sent
+             * if it is requested by its own name */
+            attach_cached_content(out);
         }
     }
 }
 
 
 /* --------------------------------------------------------------------------
- *  send_response(sd_client, filename, res)
+ *  release_response(res)
  * -------------------------------------------------------------------------- */
-/*! \brief Writes the given HTTP response to the specified socket descriptor
+/*! \brief Releases the resources held by a response.
  *
- *  If any of the steps of the function fails, partial output might be written
- *  to the socket descriptor.  If the requested file is a CGI script, the script
- *  will be executed in a new child process.
+ *  Must be called for every response generated with generate_response_header()
+ *  once it has been sent (or could not be sent).
  *
- *  \param sd_client  The socket descriptor to which the HTTP response shall be
- *                    written.
- *  \param filename   The path to the requested file, either as an absolute path
- *                    or as a relative path from the current working directory
- *                    (that is, including the root directory of tinyweb).
- *  \param res        The HTTP response header data.
+ *  \param res  The response.
+ */
+void
+release_response(response_t *res) {
+
+    file_cache_put(res->file);
+    free(res->page);
+    free(res->part_headers);
+    res->file         = NULL;
+    res->cached       = NULL;
+    res->cached_len   = 0;
+    res->page         = NULL;
+    res->part_headers = NULL;
+    res->n_parts      = 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  response_has_body(res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks whether a message body follows the response header.
  *
- *  \return           On success, the number of bytes written to the socket
- *                    descriptor, on error -1.
+ *  \param res  The HTTP response header data.
+ *
+ *  \return  1 if the requested file or the output of the CGI script has to be
+ *           sent after the header, 0 otherwise.
  */
 int
-send_response(int sd_client, const char *filename, response_t *res) {
+response_has_body(const response_t *res) {
 
-    int bytes_sent = 0, cnt;
-    char buf[MAX_SIZE_LINE];
+    return res->method == HTTP_METHOD_GET &&
+           (res->status == HTTP_STATUS_OK ||
+            res->status == HTTP_STATUS_PARTIAL_CONTENT);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  format_response_header(res, buf, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the header of the given HTTP response to a buffer.
+ *
+ *  The header is terminated by an empty line.  The header of the output of a
+ *  CGI script depends on the header fields written by the script and is
+ *  formatted by send_response().  If the response has pre-rendered content
+ *  (res->cached), only the fields which differ between the responses are
+ *  written, the rest of the header is part of the cached content.
+ *
+ *  \param res   The HTTP response header data.
+ *  \param buf   The buffer to which the header is written.  A buffer of
+ *               MAX_SIZE_HEADER bytes is large enough for every header
+ *               generated by tinyweb.
+ *  \param size  The size of buf in bytes.
+ *
+ *  \return  The length of the header in bytes (not including a terminating
+ *           '\0' byte), or -1 if the buffer is too small.
+ */
+int
+format_response_header(const response_t *res, char *buf, size_t size) {
+
+    size_t len = 0;
 
     /* Local macro to remove some boilerplate.  This macro is undef'd at the end
      * of the function */
-    #define SEND_TO_CLIENT(buffer, length)                                   \
+    #define APPEND(...)                                                      \
         {                                                                    \
-            if ((cnt = write_to_socket(sd_client, buffer, length, 0)) < 0) { \
+            int cnt = snprintf(buf + len, size - len, __VA_ARGS__);          \
+            if (cnt < 0 || (size_t)cnt >= size - len) {                      \
                 return -1;                                                   \
             }                                                                \
-            bytes_sent += cnt;                                               \
+            len += cnt;                                                      \
         }
 
-    cnt = sprintf(buf, "HTTP/1.1 %d %s\r\n",
+    APPEND("HTTP/1.1 %d %s\r\n",
             http_status_list[res->status].code,
             http_status_list[res->status].text);
-
-    if (cnt < 0) { return -1; }
-    bytes_sent += cnt;
-    SEND_TO_CLIENT(buf, cnt);
-
-    if (send_date(sd_client, &res->date, "Date", (char *)buf) < 0) {
-        return -1;
+    APPEND("Date: %s\r\n", date_cache_http(res->date));
+    APPEND(FIELD_SERVER);
+    APPEND(res->keep_alive ? FIELD_KEEP_ALIVE : FIELD_CONNECTION);
+    if (res->vary_encoding) {
+        APPEND(FIELD_VARY);
+    }
+    if (res->content_gzip) {
+        APPEND(FIELD_GZIP);
     }
 
-    SEND_TO_CLIENT(FIELD_SERVER, sizeof(FIELD_SERVER)-1);
+    if (res->cached != NULL) {
+        return len;
+    }
 
     if (res->status == HTTP_STATUS_OK ||
             res->status == HTTP_STATUS_PARTIAL_CONTENT ||
             res->status == HTTP_STATUS_NOT_MODIFIED) {
 
-        if (send_date(sd_client, &res->last_modified, "Last-Modified",
-                    (char *)buf) < 0) {
+        int cnt = format_content_fields(res, buf + len, size - len);
+        if (cnt < 0) {
             return -1;
         }
+        len += cnt;
+    }
+    else {
+        if (res->status == HTTP_STATUS_MOVED_PERMANENTLY) {
+            APPEND("Location: %s/\r\n", res->content_location);
+        }
+        else if (res->status == HTTP_STATUS_RANGE_NOT_SATISFIABLE &&
+                 res->file != NULL) {
+            APPEND("Content-Range: bytes */%lld\r\n",
+                    (long long)res->file->st.st_size);
+        }
 
+        /* no message body, which is important for persistent connections */
+        APPEND("Content-Length: 0\r\n\r\n");
+    }
 
-        SEND_TO_CLIENT(FIELD_ACCEPT_RANGES, sizeof(FIELD_ACCEPT_RANGES)-1);
-        SEND_TO_CLIENT(FIELD_CONNECTION, sizeof(FIELD_CONNECTION)-1);
+    return len;
 
-        if (res->is_cgi) {
+    #undef APPEND
+}
 
-            if (res->status != HTTP_STATUS_NOT_MODIFIED &&
-                    res->method == HTTP_METHOD_GET) {
-                if ((cnt = send_cgi_output(sd_client, filename)) < 0) {
-                    return -1;
-                }
-                bytes_sent += cnt;
-            }
-        }
-        else {
 
-            if ((cnt = sprintf(buf, "Content-Type: %s\r\n",
-                           get_http_content_type_str(res->content_type))) < 0) {
+/* --------------------------------------------------------------------------
+ *  send_response(sd_client, filename, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the given HTTP response to the specified socket descriptor
+ *
+ *  The header is never sent on its own: a small file is read into memory (or
+ *  taken from the file cache, together with the rest of the header) and sent
+ *  together with the header by a single sendmsg() call, otherwise the
+ *  header is sent with MSG_MORE, so that the kernel puts it into the same
+ *  segment as the beginning of the file or of the output of a CGI script.
+ *  The ranges of a multipart/byteranges body are sent with sendfile() as
+ *  well, each after the header of its part.  The number of system calls used
+ *  is counted in res->syscalls.  The file is read from the descriptor opened
+ *  by generate_response_header().
+ *
+ *  If any of the steps of the function fails, partial output might be written
+ *  to the socket descriptor.  A failure while the file is sent cannot be
+ *  reported to the client anymore, so the number of bytes sent up to that
+ *  point is returned in this case.  If the requested file is a CGI script, the
+ *  script will be executed in a new child process.  The response header is
+ *  formatted when the script has written its header fields, which may change
+ *  res->status.  If the end of the output cannot be marked without closing
+ *  the connection, or if the output is incomplete, res->keep_alive is reset.
+ *
+ *  \param sd_client  The socket descriptor to which the HTTP response shall be
+ *                    written.
+ *  \param filename   The path to the requested file, either as an absolute path
+ *                    or as a relative path from the current working directory
+ *                    (that is, including the root directory of tinyweb).
+ *  \param res        The HTTP response header data.
+ *
+ *  \return           On success, the number of bytes written to the socket
+ *                    descriptor, on error -1.
+ */
+off_t
+send_response(int sd_client, const char *filename, response_t *res) {
 
-                return -1;
-            }
-            SEND_TO_CLIENT(buf, cnt);
+    off_t bytes_sent, offset, remaining;
+    int cnt, fd, i;
+    char header[MAX_SIZE_HEADER], body[MAX_SIZE_INLINE_BODY];
+    struct iovec iov[2];
+    uint64_t start = stats_now();
 
-            if ((cnt = sprintf(buf, "Content-Length: %zd\r\n",
-                            res->content_length)) < 0) {
-                return -1;
-            }
-            SEND_TO_CLIENT(buf, cnt);
+    if ((cnt = format_response_header(res, header, sizeof(header))) < 0) {
+        return -1;
+    }
+    iov[0].iov_base = header;
+    iov[0].iov_len  = cnt;
 
+    if (res->cached != NULL) {
+        iov[1].iov_base = (void *)res->cached;
+        iov[1].iov_len  = res->cached_len;
+        bytes_sent = send_iov(sd_client, iov, 2, 0, res);
+        stats_stage(STATS_STAGE_HEADER, start);
+        trace_mark(res->trace, TRACE_HEADER);
+        return bytes_sent;
+    }
 
-            if ((cnt = sprintf(buf, "Content-Range: bytes %d-%d/%d\r\n\r\n",
-                            res->content_range.begin,
-                            res->content_range.total - 1,
-                            res->content_range.total)) < 0) {
-                return -1;
-            }
-            SEND_TO_CLIENT(buf, cnt);
+    if (!response_has_body(res)) {
+        bytes_sent = send_iov(sd_client, iov, 1, 0, res);
+        stats_stage(STATS_STAGE_HEADER, start);
+        trace_mark(res->trace, TRACE_HEADER);
+        return bytes_sent;
+    }
 
+    if (res->is_cgi) {
+        if ((bytes_sent = send_cgi_output(sd_client, filename, res,
+                                          &start)) < 0) {
+            return -1;
+        }
+        stats_stage(STATS_STAGE_BODY, start);
+        trace_mark(res->trace, TRACE_BODY);
+        return bytes_sent;
+    }
 
-            if (res->status != HTTP_STATUS_NOT_MODIFIED &&
-                    res->method == HTTP_METHOD_GET) {
+    if (res->file == NULL || (fd = res->file->fd) < 0) {
+        fprintf(stderr, "ERROR: %s is not open\n", filename);
+        return -1;
+    }
 
-                int fd;
-                if ((fd = open(filename, O_RDONLY)) < 0) {
-                    perror("ERROR: open()");
-                    return -1;
-                }
-                off_t offset = res->content_range.begin;
+    if (res->n_parts == 1 && res->content_length <= (off_t)sizeof(body)) {
+        res->syscalls++;
+        cnt = pread(fd, body, res->content_length, res->parts[0].begin);
+        if (cnt < 0) {
+            perror("ERROR: pread()");
+            return -1;
+        }
+        if (cnt != (int)res->content_length) {
+            return -1;          /* the file has been truncated */
+        }
+        iov[1].iov_base = body;
+        iov[1].iov_len  = cnt;
+        bytes_sent = send_iov(sd_client, iov, 2, 0, res);
+        stats_stage(STATS_STAGE_HEADER, start);
+        trace_mark(res->trace, TRACE_HEADER);
+        return bytes_sent;
+    }
 
-                if (sendfile(sd_client, fd, &offset, res->content_length) < 0) {
-                    perror("ERROR: sendfile()");
-                    return -1;
-                }
-                bytes_sent += res->content_length;
+    if ((bytes_sent = send_iov(sd_client, iov, 1, MSG_MORE, res)) < 0) {
+        return -1;
+    }
+    start = stats_stage(STATS_STAGE_HEADER, start);
+    trace_mark(res->trace, TRACE_HEADER);
+
+    /* the parts of a multipart/byteranges body: the header of each part
+     * shares a segment with the beginning of its range */
+    remaining = 0;
+    for (i = 0; i < res->n_parts && remaining == 0; i++) {
+
+        const body_part_t *part = &res->parts[i];
+
+        if (part->header_len > 0) {
+            iov[1].iov_base = (void *)part->header;
+            iov[1].iov_len  = part->header_len;
+            if ((cnt = send_iov(sd_client, &iov[1], 1,
+                                (i + 1 < res->n_parts) ? MSG_MORE : 0,
+                                res)) < 0) {
+                break;
             }
+            bytes_sent += cnt;
         }
 
-    }
-    else if (res->status == HTTP_STATUS_MOVED_PERMANENTLY) {
+        offset    = part->begin;
+        remaining = part->length;
+        while (send_file_range(sd_client, fd, &offset, &remaining,
+                    &res->syscalls) == 0 && remaining > 0) {
 
-        if ((cnt = sprintf(buf, "Location: %s/\r\n\r\n",
-                        res->content_location)) < 0) {
-            return -1;
+            /* the socket is non-blocking: wait until it is writable again */
+            struct pollfd pfd = { .fd = sd_client, .events = POLLOUT };
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+                break;
+            }
+        }
+        if (remaining > 0 && errno != EPIPE && errno != ECONNRESET) {
+            perror("ERROR: sendfile()");
         }
-        SEND_TO_CLIENT(buf, cnt);
+        bytes_sent += offset - part->begin;
     }
+    stats_stage(STATS_STAGE_BODY, start);
+    trace_mark(res->trace, TRACE_BODY);
 
     return bytes_sent;
+}
+
 
-    #undef SEND_TO_CLIENT
+/* --------------------------------------------------------------------------
+ *  send_file_range(sd, fd, offset, remaining, syscalls)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends a range of a file to a socket with sendfile().
+ *
+ *  sendfile() may transfer fewer bytes than requested, so it is called until
+ *  the complete range has been sent, the socket would block or an error
+ *  occurs.  *offset and *remaining are updated with every call, the number of
+ *  bytes sent is the difference between the final and the initial offset.
+ *
+ *  \param sd         The socket descriptor, either blocking or non-blocking.
+ *  \param fd         The descriptor of the file.
+ *  \param offset     The offset of the next byte of the file to send.
+ *  \param remaining  The number of bytes still to send.
+ *  \param syscalls   Incremented for every sendfile() call.
+ *
+ *  \return  0 if the range has been sent completely or if the socket would
+ *           block (*remaining is greater than 0 in this case), -1 on error.
+ *           Sending a file which is truncated in the meantime is an error
+ *           (errno is set to EIO).
+ */
+int
+send_file_range(int sd, int fd, off_t *offset, off_t *remaining,
+        int *syscalls) {
+
+    ssize_t cnt;
+
+    while (*remaining > 0) {
+        (*syscalls)++;
+        cnt = sendfile(sd, fd, offset, (*remaining < MAX_SIZE_SENDFILE)
+                                       ? (size_t)*remaining
+                                       : MAX_SIZE_SENDFILE);
+        if (cnt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        if (cnt == 0) {
+            errno = EIO;
+            return -1;
+        }
+        *remaining -= cnt;
+    }
+
+    return 0;
 }
 
 /* --------------------------------------------------------------------------
@@ -255,95 +586,625 @@ void
 send_static_500(int sd) {
 
     /* local stack allocations like these should be fine (?) */
-    char buf[MAX_SIZE_LINE], timebuf[32];
+    char buf[MAX_SIZE_LINE];
     int cnt;
-    time_t now = time(NULL);
-    struct tm *timestruct = gmtime(&now);
 
-    if ((cnt = sprintf(buf, "HTTP/1.1 500 Internal Server Error\r\n")) < 0){
+    cnt = snprintf(buf, sizeof(buf), "HTTP/1.1 500 Internal Server Error\r\n"
+                   "Date: %s\r\n" FIELD_SERVER "\r\n",
+                   date_cache_http(time(NULL)));
+    if (cnt < 0 || (size_t)cnt >= sizeof(buf)) {
         return;
     }
 
-    if (write_to_socket(sd, buf, cnt, 0) < 0) {
+    write_to_socket(sd, buf, cnt, 0);
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  format_content_fields(res, buf, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the header fields which describe the requested file.
+ *
+ *  For static files, the fields only depend on the file and the requested
+ *  ranges and are terminated by the empty line at the end of the header.
+ *  Several ranges are sent as a multipart/byteranges body, whose parts carry
+ *  their own Content-Range fields.
+ *
+ *  \param res   The HTTP response header data.
+ *  \param buf   The buffer to which the fields are written.
+ *  \param size  The size of buf in bytes.
+ *
+ *  \return  The length of the fields in bytes, or -1 if the buffer is too
+ *           small.
+ */
+static int
+format_content_fields(const response_t *res, char *buf, size_t size) {
+
+    size_t len = 0;
+    char timebuf[HTTP_DATE_SIZE];
+    const char *last_modified = timebuf;
+
+    /* Local macro as in format_response_header() */
+    #define APPEND(...)                                                      \
+        {                                                                    \
+            int cnt = snprintf(buf + len, size - len, __VA_ARGS__);          \
+            if (cnt < 0 || (size_t)cnt >= size - len) {                      \
+                return -1;                                                   \
+            }                                                                \
+            len += cnt;                                                      \
+        }
+
+    /* the file cache formats the modification time once per file */
+    if (res->file != NULL && res->file->st.st_mtime == res->last_modified) {
+        last_modified = res->file->last_modified;
+    }
+    else {
+        format_http_date(res->last_modified, timebuf);
+    }
+
+    APPEND("Last-Modified: %s\r\n", last_modified);
+    if (!res->is_cgi && res->file != NULL) {
+        APPEND("ETag: %s\r\n", res->file->etag);
+    }
+    APPEND(FIELD_ACCEPT_RANGES);
+
+    if (res->is_cgi) {
+        /* the script is only executed if its output is sent */
+        APPEND("\r\n");
+    }
+    else {
+        if (res->n_parts > 1) {
+            APPEND("Content-Type: multipart/byteranges; boundary=%s\r\n",
+                    res->boundary);
+        }
+        else {
+            APPEND("Content-Type: %s\r\n",
+                    get_http_content_type_str(res->content_type));
+        }
+        APPEND("Content-Length: %lld\r\n",
+                (long long)res->content_length);
+        if (res->status == HTTP_STATUS_PARTIAL_CONTENT && res->n_parts == 1) {
+            APPEND("Content-Range: bytes %lld-%lld/%lld\r\n",
+                    (long long)res->parts[0].begin,
+                    (long long)(res->parts[0].begin +
+                                res->parts[0].length - 1),
+                    (long long)res->file->st.st_size);
+        }
+        APPEND("\r\n");
+    }
+
+    return len;
+
+    #undef APPEND
+}
+
+
+/* --------------------------------------------------------------------------
+ *  select_gzip_variant(filename, req, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Replaces the requested file by its compressed copy, if there is one.
+ *
+ *  A file "name.gz" next to the requested file is its gzip-compressed copy,
+ *  unless it is older than the file.  The copy is sent like any other file
+ *  (with sendfile(), in ranges, etc.), only with Content-Encoding "gzip".
+ *  Whether a copy exists is remembered in the file cache, so that the lookup
+ *  of a missing copy does not cost a stat() call for every request.  All
+ *  responses for a file with a compressed copy carry a Vary field.
+ *
+ *  \param filename  The path of the requested file.
+ *  \param req       The request, if it does not accept gzip, the file is not
+ *                   replaced.
+ *  \param res       A response for a readable file, res->file is replaced by
+ *                   the entry of the copy.
+ */
+static void
+select_gzip_variant(const char *filename, const request_t *req,
+        response_t *res) {
+
+    char path[MAX_SIZE_URI + 3];    /* filename with ".gz" */
+    file_entry_t *gz;
+    int cnt;
+
+    if (res->file->has_gzip == 0) {
+        return;
+    }
+    if (res->file->has_gzip == 1 && !req->accepts_gzip) {
+        res->vary_encoding = 1;
         return;
     }
 
-    strftime(timebuf, 32, "%a, %d %b %Y %H:%M:%S GMT\r\n", timestruct);
-    timebuf[31] = '\0';
+    cnt = snprintf(path, sizeof(path), "%s.gz", filename);
+    if (cnt < 0 || (size_t)cnt >= sizeof(path)) {
+        res->file->has_gzip = 0;
+        return;
+    }
+
+    gz = file_cache_get(path);
+    res->file->has_gzip = gz != NULL && gz->fd >= 0 &&
+                          IS_READABLE(gz->st.st_mode) &&
+                          gz->st.st_mtime >= res->file->st.st_mtime;
+    if (!res->file->has_gzip || !req->accepts_gzip) {
+        res->vary_encoding = res->file->has_gzip;
+        file_cache_put(gz);
+        return;
+    }
+
+    file_cache_put(res->file);
+    res->file          = gz;
+    res->content_gzip  = 1;
+    res->vary_encoding = 1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  select_compressed_copy(filename, req, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Replaces the requested file by a copy compressed on the fly.
+ *
+ *  Files without a compressed copy of their own are compressed into the
+ *  cache of the gzip module when they are requested for the first time, if
+ *  their content type compresses well; larger files are compressed in the
+ *  background and sent uncompressed until their copy is complete.
+ *  Afterwards, the copy is sent like a file "name.gz".  If compression does
+ *  not make a file smaller, the file itself is sent.
+ *
+ *  \param filename  The path of the requested file.
+ *  \param req       The request, if it does not accept gzip, the file is not
+ *                   replaced.
+ *  \param res       A response for a readable file without a compressed
+ *                   copy, res->file is replaced by the entry of the copy.
+ */
+static void
+select_compressed_copy(const char *filename, const request_t *req,
+        response_t *res) {
+
+    char path[PATH_MAX];
+    const struct stat *st = &res->file->st;
+    file_entry_t *gz;
 
-    if ((cnt = sprintf(buf, "Date: %s", timebuf)) < 0) {
+    if (res->file->fd < 0 || !gzip_wanted(get_http_content_type_str(
+                    get_http_content_type(filename)), st->st_size)) {
+        return;
+    }
+    res->vary_encoding = 1;
+    if (!req->accepts_gzip ||
+            gzip_copy_path(filename, st, path, sizeof(path)) < 0) {
         return;
     }
-    if (write_to_socket(sd, FIELD_SERVER, sizeof(FIELD_SERVER), 0) < 0) {
+
+    /* a small file is compressed by the first request for it, a larger one
+     * is sent as it is until its copy has been created in the background */
+    if ((gz = file_cache_get(path)) == NULL &&
+            (gzip_create_copy(filename, res->file->fd, st, path) != 0 ||
+             (gz = file_cache_get(path)) == NULL)) {
         return;
     }
-    if (write_to_socket(sd, "\r\n", 2, 0) < 0) {
+    if (gz->fd < 0 || gz->st.st_size >= st->st_size) {
+        file_cache_put(gz);
         return;
     }
+
+    file_cache_put(res->file);
+    res->file         = gz;
+    res->content_gzip = 1;
 }
 
-/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
 
 /* --------------------------------------------------------------------------
- *  send_date(sd, date, name, buf)
+ *  etag_list_matches(list, etag)
  * -------------------------------------------------------------------------- */
-/*! \brief Formats and sends the given timestamp under the given name.
+/*! \brief Checks whether the entity tag of a file is in an If-None-Match list.
  *
- *  (The parameter "buf" is only included because it is more convenient to reuse
- *  the buffer in the public "send_response" function instead of allocating a
- *  new buffer in this function).
+ *  The list is either "*", which matches every existing file, or a list of
+ *  entity tags, e.g. "\"a\", W/\"b\"".  Tags are compared with the weak
+ *  comparison function (RFC 7232): a weak tag matches the strong tag with
+ *  the same opaque value.  Parsing stops at the first malformed element.
  *
- *  \param sd    The socket descriptor of the client.  The formatted date is
- *               sent through this descriptor.
- *  \param date  The timestamp to format and send.
- *  \param name  The name of the HTTP response fields which shall be used, e.g.
- *               "Date".
- *  \param buf   A buffer which can be used to write the response line, should
- *               have length MAX_SIZE_LINE
+ *  \param list  The value of the If-None-Match field.
+ *  \param etag  The strong entity tag of the file, including the quotes.
  *
- *  \return Either 0 when the function executed successfully, or -1 otherwise.
+ *  \return  1 if the list contains the tag, 0 otherwise.
  */
 static int
-send_date(int sd, const time_t *date, char *name, char *buf) {
+etag_list_matches(const char *list, const char *etag) {
 
-    int cnt;
-    char timebuf[32];
-    struct tm *timestruct = gmtime(date);
-    strftime(timebuf, 32, "%a, %d %b %Y %H:%M:%S GMT\r\n", timestruct);
-    timebuf[31] = '\0';
+    size_t etag_len = strlen(etag);
+    const char *end;
 
-    if ((cnt = sprintf(buf, "%s: %s", name, timebuf)) < 0) {
-        return -1;
+    for (;;) {
+        list += strspn(list, " \t,");
+        if (*list == '*') {
+            return 1;
+        }
+        if (strncmp(list, "W/", 2) == 0) {
+            list += 2;
+        }
+        if (*list != '"' || (end = strchr(list + 1, '"')) == NULL) {
+            return 0;
+        }
+        end++;
+        if ((size_t)(end - list) == etag_len &&
+                strncmp(list, etag, etag_len) == 0) {
+            return 1;
+        }
+        list = end;
     }
-    if (write_to_socket(sd, buf, cnt, 0) < 0) {
+}
+
+
+/* --------------------------------------------------------------------------
+ *  if_range_holds(req, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks the If-Range condition of a request for ranges.
+ *
+ *  The condition holds if the request has no If-Range field, if the field
+ *  is the entity tag of the file, or if it is the modification time of the
+ *  file.  Only strong validators are accepted: weak entity tags never
+ *  match, and neither does a modification time less than a second before
+ *  the response, as the file might change again within the same second.
+ *
+ *  \param req  The request.
+ *  \param res  The response for a static file.
+ *
+ *  \return  1 if the ranges are sent, 0 if the complete file is sent.
+ */
+static int
+if_range_holds(const request_t *req, const response_t *res) {
+
+    if (req->if_range == 0) {
+        return 1;
+    }
+    if (req->if_range_etag[0] != '\0') {
+        return strcmp(req->if_range_etag, res->file->etag) == 0;
+    }
+    return req->if_range == res->last_modified &&
+           res->last_modified < res->date;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  select_ranges(req, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Resolves the requested ranges against the size of the file.
+ *
+ *  Ranges which start behind the end of the file are dropped, the others are
+ *  clipped to the file.  Overlapping and adjacent ranges are merged, so no
+ *  byte is sent twice (RFC 7233 allows servers to coalesce ranges), and the
+ *  ranges are sent in the order of their offsets.  A single range is sent
+ *  as the body, several ranges as the parts of a multipart/byteranges body.
+ *  If none of the ranges is satisfiable, the status is set to 416.
+ *
+ *  \param req  The request with at least one range.
+ *  \param res  A response for a static file with status 206, whose single
+ *              part is the complete file.
+ */
+static void
+select_ranges(const request_t *req, response_t *res) {
+
+    off_t size = res->file->st.st_size;
+    off_t begin, end;
+    body_part_t *parts = res->parts;
+    int i, j, n = 0;
+
+    for (i = 0; i < req->n_ranges; i++) {
+
+        const byte_range_t *range = &req->ranges[i];
+
+        if (range->first < 0) {
+            /* the last bytes of the file */
+            if (range->last == 0 || size == 0) {
+                continue;
+            }
+            begin = (range->last < size) ? size - range->last : 0;
+            end   = size - 1;
+        }
+        else {
+            if (range->first >= size) {
+                continue;
+            }
+            begin = range->first;
+            end   = (range->last < 0 || range->last >= size) ? size - 1
+                                                             : range->last;
+        }
+
+        /* insertion into the ranges sorted by their first byte */
+        for (j = n; j > 0 && parts[j - 1].begin > begin; j--) {
+            parts[j] = parts[j - 1];
+        }
+        parts[j].header     = NULL;
+        parts[j].header_len = 0;
+        parts[j].begin      = begin;
+        parts[j].length     = end - begin + 1;
+        n++;
+    }
+
+    if (n == 0) {
+        res->status  = HTTP_STATUS_RANGE_NOT_SATISFIABLE;
+        res->n_parts = 0;
+        return;
+    }
+
+    /* merges overlapping and adjacent ranges */
+    for (i = 0, j = 1; j < n; j++) {
+        end = parts[i].begin + parts[i].length;
+        if (parts[j].begin <= end) {
+            if (parts[j].begin + parts[j].length > end) {
+                parts[i].length = parts[j].begin + parts[j].length -
+                                  parts[i].begin;
+            }
+        }
+        else {
+            parts[++i] = parts[j];
+        }
+    }
+    res->n_parts        = i + 1;
+    res->content_length = parts[0].length;
+
+    if (res->n_parts > 1 && format_part_headers(res) < 0) {
+        res->status = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  format_part_headers(res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the delimiters and headers of a multipart/byteranges body.
+ *
+ *  Every range is preceded by the boundary delimiter and the Content-Type
+ *  and Content-Range of its part, a final part without a range holds the
+ *  closing delimiter.  The headers are written to res->part_headers, and
+ *  res->content_length is set to the length of the complete body.
+ *
+ *  \param res  A response with several ranges of a static file.
+ *
+ *  \return  0 on success, -1 if the memory cannot be allocated.
+ */
+static int
+format_part_headers(response_t *res) {
+
+    static unsigned int counter = 0;
+    const char *type = get_http_content_type_str(res->content_type);
+    size_t len = 0, size;
+    int i, cnt;
+
+    /* the boundary must not occur in the body, a value that changes with
+     * every response makes that as good as certain */
+    snprintf(res->boundary, sizeof(res->boundary), "%08x%08lx%06x",
+             (unsigned int)getpid(), (unsigned long)res->date,
+             counter++ & 0xffffff);
+
+    /* delimiter, Content-Type and Content-Range of each part (with 20
+     * digits for each number), and the closing delimiter */
+    size = (res->n_parts + 1) * (strlen(type) + SIZE_BOUNDARY + 128);
+    if ((res->part_headers = (char *)malloc(size)) == NULL) {
+        perror("ERROR: malloc()");
         return -1;
     }
 
+    res->content_length = 0;
+    for (i = 0; i <= res->n_parts; i++) {
+
+        body_part_t *part = &res->parts[i];
+
+        if (i < res->n_parts) {
+            cnt = snprintf(res->part_headers + len, size - len,
+                           "%s--%s\r\nContent-Type: %s\r\n"
+                           "Content-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                           (i > 0) ? "\r\n" : "", res->boundary, type,
+                           (long long)part->begin,
+                           (long long)(part->begin + part->length - 1),
+                           (long long)res->file->st.st_size);
+        }
+        else {
+            part->begin  = 0;
+            part->length = 0;
+            cnt = snprintf(res->part_headers + len, size - len,
+                           "\r\n--%s--\r\n", res->boundary);
+        }
+        if (cnt < 0 || (size_t)cnt >= size - len) {
+            return -1;
+        }
+
+        part->header         = res->part_headers + len;
+        part->header_len     = cnt;
+        res->content_length += cnt + part->length;
+        len += cnt;
+    }
+    res->n_parts++;
+
     return 0;
 }
 
 
 /* --------------------------------------------------------------------------
- *  send_cgi_output(sd_client, filename)
+ *  attach_cached_content(res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Takes the complete response to a small file from the file cache.
+ *
+ *  The cached content consists of the header fields which describe the file,
+ *  followed by the file itself.  It is identical for all responses with status
+ *  200 for the file, so it is rendered once and stays valid until the cache
+ *  notices a change of the file.  On a miss, the content is loaded into the
+ *  cache if the file is small enough.  res->cached remains NULL if the
+ *  content is not available.
+ *
+ *  \param res  A response with status 200 for a static file.
+ */
+static void
+attach_cached_content(response_t *res) {
+
+    char fields[MAX_SIZE_HEADER], *data;
+    const char *cached;
+    size_t size, file_size = res->file->st.st_size;
+    int cnt;
+
+    if ((cached = file_cache_data(res->file, &size)) == NULL) {
+        if (!file_cache_wants_data(res->file) || res->file->fd < 0 ||
+                (cnt = format_content_fields(res, fields,
+                                             sizeof(fields))) < 0 ||
+                (data = (char *)malloc(cnt + file_size)) == NULL) {
+            return;
+        }
+
+        memcpy(data, fields, cnt);
+        res->syscalls++;
+        if (pread(res->file->fd, data + cnt, file_size, 0) !=
+                (ssize_t)file_size ||
+                file_cache_set_data(res->file, data, cnt + file_size) < 0) {
+            free(data);
+            return;
+        }
+        cached = data;
+        size   = cnt + file_size;
+    }
+
+    res->cached     = cached;
+    res->cached_len = response_has_body(res) ? size : size - file_size;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  attach_status_page(res, format)
+ * -------------------------------------------------------------------------- */
+/*! \brief Renders the status page as the content of a response.
+ *
+ *  Like cached content, the page consists of the header fields which
+ *  describe it, followed by the page itself.  It belongs to the response and
+ *  is freed by release_response().  A request for a range of the page is
+ *  answered with the complete page.  If the page cannot be rendered, the
+ *  status is set to 500.
+ *
+ *  \param res     The response, its status is set to 200.
+ *  \param format  The requested format of the page.
+ */
+static void
+attach_status_page(response_t *res, stats_format_t format) {
+
+    char body[STATS_PAGE_SIZE], fields[MAX_SIZE_HEADER];
+    int body_len, cnt;
+
+    res->status = HTTP_STATUS_OK;
+    if ((body_len = stats_render(format, body, sizeof(body))) < 0) {
+        res->status = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+        return;
+    }
+
+    /* the counters change with every request, caches must not keep them */
+    cnt = snprintf(fields, sizeof(fields), "Content-Type: %s\r\n"
+                   "Content-Length: %d\r\nCache-Control: no-store\r\n\r\n",
+                   stats_content_type(format), body_len);
+    if (cnt < 0 || (size_t)cnt >= sizeof(fields) ||
+            (res->page = (char *)malloc(cnt + body_len)) == NULL) {
+        res->status = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+        return;
+    }
+
+    memcpy(res->page, fields, cnt);
+    memcpy(res->page + cnt, body, body_len);
+    res->cached     = res->page;
+    res->cached_len = response_has_body(res) ? (size_t)(cnt + body_len)
+                                             : (size_t)cnt;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  send_iov(sd_client, iov, iovcnt, flags, res)
  * -------------------------------------------------------------------------- */
-/*! \brief Executes the given CGI script and writes its output to sd_client.
+/*! \brief Sends all buffers of an I/O vector, like writev() with flags.
+ *
+ *  Partial sends are continued and every sendmsg() call is counted in
+ *  res->syscalls.
+ *
+ *  \param sd_client  The socket descriptor to which the data is sent.
+ *  \param iov        The buffers to send, modified during partial sends.
+ *  \param iovcnt     The number of buffers.
+ *  \param flags      Additional flags for sendmsg(), e.g. MSG_MORE.
+ *  \param res        The response to which the system calls are accounted.
+ *
+ *  \return The number of bytes sent, -1 on error.
+ */
+static int
+send_iov(int sd_client, struct iovec *iov, int iovcnt, int flags,
+        response_t *res) {
+
+    struct msghdr msg;
+    ssize_t cnt;
+    int bytes_sent = 0;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = iovcnt;
+
+    while (msg.msg_iovlen > 0) {
+        res->syscalls++;
+        cnt = sendmsg(sd_client, &msg, flags | MSG_NOSIGNAL);
+        if (cnt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: sendmsg()");
+            return -1;
+        }
+        bytes_sent += cnt;
+
+        /* skip the buffers which have been sent completely */
+        while (msg.msg_iovlen > 0 && (size_t)cnt >= msg.msg_iov->iov_len) {
+            cnt -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + cnt;
+            msg.msg_iov->iov_len -= cnt;
+        }
+    }
+
+    return bytes_sent;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  send_cgi_output(sd_client, filename, res, start)
+ * -------------------------------------------------------------------------- */
+/*! \brief Executes the given CGI script and sends its output to sd_client.
  *
  *  This function will write error messages to stderr if any of the involved
- *  system calls fail.
+ *  system calls fail.  The script writes its error messages to the stderr of
+ *  the server.
  *
- *  \param sd_client  The socket descriptor to which the CGI script's output is
- *                    written.
+ *  \param sd_client  The socket descriptor to which the response is written.
  *  \param filename   The path of the CGI script (including tinyweb's root
  *                    directory).
+ *  \param res        The response to which the system calls relaying the
+ *                    output are accounted.
+ *  \param start      The start of the current stage, updated when the header
+ *                    has been sent.
  *
  *  \return On success, the number of bytes sent is returned, on error, -1 is
  *          returned.
  */
-static int
-send_cgi_output(int sd_client, const char *filename) {
+static off_t
+send_cgi_output(int sd_client, const char *filename, response_t *res,
+        uint64_t *start) {
 
     int pid, fd_pipe[2];
-    int cnt = 0, bytes_sent = 0;
+    off_t bytes_sent;
+    fcgi_stream_t stream;
+    cgi_source_t src;
+
+    /* FastCGI scripts are served by a persistent process if possible */
+    if (fcgi_open(&stream, filename, http_method_list[res->method].name,
+                  &res->syscalls) == 0) {
+        src.fd     = -1;
+        src.fcgi   = &stream;
+        bytes_sent = relay_cgi_output(&src, sd_client, res, start);
+        fcgi_close(&stream);
+        if (bytes_sent != FCGI_UNAVAILABLE) {
+            return bytes_sent;
+        }
+    }
 
     /* initializes the two file handles for inter-process communication */
     if (pipe(fd_pipe) == -1) {
@@ -351,45 +1212,38 @@ send_cgi_output(int sd_client, const char *filename) {
         return -1;
     }
 
+    /* a larger pipe lets the script write ahead of the relay, and every
+     * splice() move more data; if this fails, the default size is used */
+    fcntl(fd_pipe[0], F_SETPIPE_SZ, CGI_PIPE_SIZE);
+
     if ((pid = fork()) < 0) {
         perror("ERROR: fork() before execle");
+        close(fd_pipe[0]);
+        close(fd_pipe[1]);
         return -1;
     }
     else if (pid > 0) { /* parent process */
 
+        stats_count(STATS_CGI_EXECUTIONS);
+
         /* only the receiving end of the pipe is used in the parent process */
         close(fd_pipe[1]);
-        char buf[MAX_SIZE_BUFFER_CGI];
-
-        /* redirect everything and count how many bytes the child writes */
-        do {
-            cnt = read(fd_pipe[0], buf, MAX_SIZE_BUFFER_CGI);
-
-            if (cnt < 0) {
-                if (errno != EINTR) {
-                    perror("ERROR: read() from pipe");
-                    return -1;
-                }
-            }
-            else {
-                if (write(sd_client, buf, cnt) == -1) {
-                    perror("ERROR: write() to socket");
-                    return -1;
-                }
-                bytes_sent += cnt;
-            }
-        } while (cnt > 0);
-
+        src.fd     = fd_pipe[0];
+        src.fcgi   = NULL;
+        bytes_sent = relay_cgi_output(&src, sd_client, res, start);
         close(fd_pipe[0]);
+
+        /* long-lived worker processes have to reap the script themselves */
+        waitpid(pid, NULL, 0);
         return bytes_sent;
     }
     else {
         /* In the child process the receiving end of the pipe is not required,
-         * and therefore closed.  Both stdout and stderr of this process are
-         * then redirected to the writing end of the pipe  */
+         * and therefore closed.  stdout of this process is then redirected to
+         * the writing end of the pipe, error messages must not end up in the
+         * response */
         close(fd_pipe[0]);
         dup2(fd_pipe[1], STDOUT_FILENO);
-        dup2(fd_pipe[1], STDERR_FILENO);
         execle(filename, filename, (char *)NULL, environ);
 
         /* if execle returns, something went wrong */
@@ -397,3 +1251,464 @@ send_cgi_output(int sd_client, const char *filename) {
         exit(EXIT_FAILURE);
     }
 }
+
+
+/* --------------------------------------------------------------------------
+ *  relay_cgi_output(src, sd_client, res, start)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends the response to a CGI request, built from the script output.
+ *
+ *  The header fields of the script are read and interpreted first.  The body
+ *  is sent as it is if the script gave its length, otherwise it is framed in
+ *  chunks if the client supports them.  If neither is possible, the end of
+ *  the body is marked by closing the connection.  A body of a compressible
+ *  content type is compressed with gzip if the client accepts it, its length
+ *  is not known in advance then.
+ *
+ *  \param src        The output of the script.
+ *  \param sd_client  The socket descriptor of the client.
+ *  \param res        The response; its status is taken from the script.
+ *  \param start      The start of the current stage, updated when the header
+ *                    has been sent.
+ *
+ *  \return  The number of bytes sent, -1 if nothing has been sent because of
+ *           an error, or FCGI_UNAVAILABLE if the connection to a FastCGI pool
+ *           failed before the script wrote anything.
+ */
+static off_t
+relay_cgi_output(cgi_source_t *src, int sd_client, response_t *res,
+        uint64_t *start) {
+
+    char head[CGI_MAX_HEADER], header[MAX_SIZE_HEADER + CGI_MAX_HEADER];
+    char buf[CGI_COPY_SIZE];
+    cgi_header_t hdr;
+    cgi_framing_t framing;
+    gzip_stream_t *gz = NULL;
+    size_t len = 0, end;
+    off_t bytes_sent, body_len, rest = -1;
+    ssize_t cnt;
+    int header_len, sent, flags = MSG_MORE;
+
+    /* the header fields, maybe followed by the beginning of the body */
+    while ((end = cgi_header_end(head, len)) == 0) {
+        if (len == sizeof(head)) {
+            fprintf(stderr, "ERROR: Header of CGI script too large\n");
+            return -1;
+        }
+        if ((cnt = read_cgi_output(src, head + len, sizeof(head) - len,
+                                   res)) <= 0) {
+            if (cnt < 0 && src->fcgi != NULL && src->fcgi->received == 0) {
+                return FCGI_UNAVAILABLE;
+            }
+            fprintf(stderr, "ERROR: CGI script did not send a header\n");
+            return -1;
+        }
+        len += cnt;
+    }
+    if (cgi_parse_header(head, end, &hdr) < 0) {
+        fprintf(stderr, "ERROR: Malformed header of CGI script\n");
+        return -1;
+    }
+    res->status = hdr.status;
+    body_len    = len - end;
+
+    if (hdr.code < 200 || hdr.code == 204 || hdr.code == 304) {
+        framing  = CGI_FRAME_NONE;
+        body_len = 0;
+        flags    = 0;
+    }
+    else {
+        /* the length of compressed output is not known in advance */
+        if (!hdr.content_encoded &&
+                gzip_wanted(hdr.content_type, hdr.content_length)) {
+            res->vary_encoding = 1;
+            if (res->accepts_gzip) {
+                gz = gzip_stream_open();
+            }
+        }
+        res->content_gzip = (gz != NULL);
+
+        if (hdr.content_length >= 0) {
+            if (body_len > hdr.content_length) {
+                body_len = hdr.content_length;
+            }
+            rest = hdr.content_length - body_len;
+        }
+
+        if (hdr.content_length >= 0 && gz == NULL) {
+            framing = CGI_FRAME_LENGTH;
+            if (rest == 0) {
+                flags = 0;
+            }
+        }
+        else if (res->accepts_chunked) {
+            framing = CGI_FRAME_CHUNKED;
+        }
+        else {
+            framing = CGI_FRAME_CLOSE;
+            res->keep_alive = FALSE;
+        }
+    }
+
+    if ((header_len = format_cgi_header(res, &hdr, framing, header,
+                                        sizeof(header))) < 0) {
+        fprintf(stderr, "ERROR: Header of CGI script too large\n");
+        gzip_stream_close(gz);
+        return -1;
+    }
+    if ((bytes_sent = send_cgi_data(sd_client, header, header_len,
+                                    head + end, (gz == NULL) ? body_len : 0,
+                                    framing == CGI_FRAME_CHUNKED, flags,
+                                    res)) < 0) {
+        gzip_stream_close(gz);
+        return -1;
+    }
+    *start = stats_stage(STATS_STAGE_HEADER, *start);
+    trace_mark(res->trace, TRACE_HEADER);
+
+    if (gz != NULL) {
+        bytes_sent += compress_cgi_output(src, sd_client, gz, head + end,
+                                          body_len, rest,
+                                          framing == CGI_FRAME_CHUNKED, res);
+        gzip_stream_close(gz);
+        return bytes_sent;
+    }
+
+    if (framing == CGI_FRAME_LENGTH || framing == CGI_FRAME_CLOSE) {
+        return bytes_sent + forward_cgi_output(src, sd_client, rest, res);
+    }
+    if (framing == CGI_FRAME_NONE) {
+        return bytes_sent;
+    }
+
+    /* every read() is sent as a chunk, so that the client gets the output as
+     * soon as the script writes it */
+    for (;;) {
+        if ((cnt = read_cgi_output(src, buf, sizeof(buf), res)) < 0) {
+            res->keep_alive = FALSE;    /* the last chunk is missing */
+            return bytes_sent;
+        }
+        sent = (cnt > 0)
+               ? send_cgi_data(sd_client, NULL, 0, buf, cnt, 1, 0, res)
+               : send_cgi_data(sd_client, NULL, 0, "0\r\n\r\n", 5, 0, 0, res);
+        if (sent < 0) {
+            res->keep_alive = FALSE;
+            return bytes_sent;
+        }
+        bytes_sent += sent;
+        if (cnt == 0) {
+            return bytes_sent;
+        }
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  forward_cgi_output(src, sd_client, limit, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Forwards the body of a CGI script to the client as it is.
+ *
+ *  The output is moved from a pipe into the socket with splice(), without
+ *  copying it through user space.  If the descriptors cannot be spliced, or
+ *  if the output comes from a FastCGI pool, it is copied with read() and
+ *  sendmsg() instead.  If the body is shorter than announced or an error
+ *  occurs, res->keep_alive is reset.
+ *
+ *  \param src        The output of the script.
+ *  \param sd_client  The socket descriptor of the client.
+ *  \param limit      The number of bytes to forward, -1 for the rest of the
+ *                    output.  Anything the script writes beyond is dropped.
+ *  \param res        The response to which the system calls are accounted.
+ *
+ *  \return  The number of bytes sent.
+ */
+static off_t
+forward_cgi_output(cgi_source_t *src, int sd_client, off_t limit,
+        response_t *res) {
+
+    char buf[CGI_COPY_SIZE];
+    struct iovec iov;
+    off_t bytes_sent = 0;
+    ssize_t cnt;
+    size_t len;
+    int copy = (src->fd < 0), eof = 0;
+
+    /* the data is only held back if the connection is closed at the end */
+    while (!copy && !eof && limit != 0) {
+        len = (limit > 0 && limit < CGI_PIPE_SIZE) ? (size_t)limit
+                                                   : CGI_PIPE_SIZE;
+        res->syscalls++;
+        cnt = splice(src->fd, NULL, sd_client, NULL, len,
+                     SPLICE_F_MOVE | (limit < 0 ? SPLICE_F_MORE : 0));
+        if (cnt > 0) {
+            bytes_sent += cnt;
+            limit      -= (limit > 0) ? cnt : 0;
+        }
+        else if (cnt == 0) {
+            eof = 1;
+        }
+        else if (errno == EAGAIN) {
+            /* the socket is non-blocking: wait until it is writable again */
+            struct pollfd pfd = { .fd = sd_client, .events = POLLOUT };
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+                perror("ERROR: poll()");
+                res->keep_alive = FALSE;
+                return bytes_sent;
+            }
+        }
+        else if (errno == EINVAL) {
+            copy = 1;               /* not spliceable, copied below */
+        }
+        else if (errno != EINTR) {
+            perror("ERROR: splice() to socket");
+            res->keep_alive = FALSE;
+            return bytes_sent;
+        }
+    }
+
+    while (copy && !eof && limit != 0) {
+        len = (limit > 0 && limit < (off_t)sizeof(buf)) ? (size_t)limit
+                                                         : sizeof(buf);
+        if ((cnt = read_cgi_output(src, buf, len, res)) <= 0) {
+            eof = 1;
+            continue;
+        }
+        iov.iov_base = buf;
+        iov.iov_len  = cnt;
+        if (send_iov(sd_client, &iov, 1, 0, res) < 0) {
+            res->keep_alive = FALSE;
+            return bytes_sent;
+        }
+        bytes_sent += cnt;
+        limit      -= (limit > 0) ? cnt : 0;
+    }
+
+    if (limit > 0) {
+        res->keep_alive = FALSE;    /* the body is incomplete */
+    }
+    return bytes_sent;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  compress_cgi_output(src, sd_client, gz, data, len, limit, chunked, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Compresses the body of a CGI script while it is sent to the client.
+ *
+ *  The output is compressed as it is read and flushed after every read(), so
+ *  that the client gets it as soon as the script writes it, just like the
+ *  uncompressed output.  If the output is incomplete or an error occurs,
+ *  the end of the body is not marked and res->keep_alive is reset.
+ *
+ *  \param src        The output of the script.
+ *  \param sd_client  The socket descriptor of the client.
+ *  \param gz         The compressed stream.
+ *  \param data       The beginning of the body, read together with the
+ *                    header fields.
+ *  \param len        The number of bytes of data.
+ *  \param limit      The number of bytes to read behind data, -1 for the
+ *                    rest of the output.
+ *  \param chunked    Whether the compressed body is framed in chunks.
+ *  \param res        The response to which the system calls are accounted.
+ *
+ *  \return  The number of bytes sent.
+ */
+static off_t
+compress_cgi_output(cgi_source_t *src, int sd_client, gzip_stream_t *gz,
+        const char *data, size_t len, off_t limit, int chunked,
+        response_t *res) {
+
+    char in[CGI_COPY_SIZE], out[CGI_COPY_SIZE];
+    off_t bytes_sent = 0;
+    ssize_t cnt;
+    size_t size;
+    int sent, finish = (limit == 0);
+
+    for (;;) {
+        while (len > 0 || finish) {
+            if ((cnt = gzip_stream_compress(gz, &data, &len, out,
+                                            sizeof(out), finish)) < 0) {
+                res->keep_alive = FALSE;
+                return bytes_sent;
+            }
+            if (cnt > 0) {
+                if ((sent = send_cgi_data(sd_client, NULL, 0, out, cnt,
+                                          chunked, 0, res)) < 0) {
+                    res->keep_alive = FALSE;
+                    return bytes_sent;
+                }
+                bytes_sent += sent;
+            }
+            if (len == 0 && cnt < (ssize_t)sizeof(out)) {
+                break;          /* all input has been flushed */
+            }
+        }
+        if (finish) {
+            break;
+        }
+
+        size = (limit > 0 && limit < (off_t)sizeof(in)) ? (size_t)limit
+                                                         : sizeof(in);
+        if ((cnt = read_cgi_output(src, in, size, res)) < 0 ||
+                (cnt == 0 && limit > 0)) {
+            res->keep_alive = FALSE;    /* the output is incomplete */
+            return bytes_sent;
+        }
+        data    = in;
+        len     = cnt;
+        limit  -= (limit > 0) ? cnt : 0;
+        finish  = (cnt == 0 || limit == 0);
+    }
+
+    if (chunked) {
+        if ((sent = send_cgi_data(sd_client, NULL, 0, "0\r\n\r\n", 5, 0, 0,
+                                  res)) < 0) {
+            res->keep_alive = FALSE;
+            return bytes_sent;
+        }
+        bytes_sent += sent;
+    }
+    return bytes_sent;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  read_cgi_output(src, buf, size, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Reads the next part of the output of a CGI script.
+ *
+ *  \return  The number of bytes read, 0 at the end of the output, -1 on
+ *           error.
+ */
+static ssize_t
+read_cgi_output(cgi_source_t *src, char *buf, size_t size, response_t *res) {
+
+    ssize_t cnt;
+
+    if (src->fcgi != NULL) {
+        return fcgi_read(src->fcgi, buf, size, &res->syscalls);
+    }
+
+    do {
+        res->syscalls++;
+        cnt = read(src->fd, buf, size);
+    } while (cnt < 0 && errno == EINTR);
+
+    if (cnt < 0) {
+        perror("ERROR: read() from pipe");
+    }
+    return cnt;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  format_cgi_header(res, hdr, framing, buf, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the response header for the output of a CGI script.
+ *
+ *  The status line is taken from the script, the header fields of the
+ *  script follow the fields written by the server for every response.
+ *
+ *  \param res      The HTTP response header data.
+ *  \param hdr      The interpreted header fields of the script.
+ *  \param framing  How the end of the body is marked.
+ *  \param buf      The buffer to which the header is written.
+ *  \param size     The size of buf in bytes.
+ *
+ *  \return  The length of the header in bytes, or -1 if the buffer is too
+ *           small.
+ */
+static int
+format_cgi_header(const response_t *res, const cgi_header_t *hdr,
+        cgi_framing_t framing, char *buf, size_t size) {
+
+    size_t len = 0;
+
+    /* Local macro as in format_response_header() */
+    #define APPEND(...)                                                      \
+        {                                                                    \
+            int cnt = snprintf(buf + len, size - len, __VA_ARGS__);          \
+            if (cnt < 0 || (size_t)cnt >= size - len) {                      \
+                return -1;                                                   \
+            }                                                                \
+            len += cnt;                                                      \
+        }
+
+    APPEND("HTTP/1.1 %d %s\r\n", hdr->code, hdr->reason);
+    APPEND("Date: %s\r\n", date_cache_http(res->date));
+    APPEND(FIELD_SERVER);
+    APPEND(res->keep_alive ? FIELD_KEEP_ALIVE : FIELD_CONNECTION);
+    if (res->vary_encoding) {
+        APPEND(FIELD_VARY);
+    }
+    if (res->content_gzip) {
+        APPEND(FIELD_GZIP);
+    }
+    APPEND("%.*s", (int)hdr->fields_len, hdr->fields);
+
+    if (framing == CGI_FRAME_LENGTH) {
+        APPEND("Content-Length: %lld\r\n", (long long)hdr->content_length);
+    }
+    else if (framing == CGI_FRAME_CHUNKED) {
+        APPEND(FIELD_CHUNKED);
+    }
+    APPEND("\r\n");
+
+    return len;
+
+    #undef APPEND
+}
+
+
+/* --------------------------------------------------------------------------
+ *  send_cgi_data(sd_client, header, header_len, data, len, chunked, flags,
+ *                res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sends a part of the output of a CGI script, optionally preceded by
+ *         the response header.
+ *
+ *  \param sd_client   The socket descriptor of the client.
+ *  \param header      The response header, NULL if it has been sent.
+ *  \param header_len  The length of the header.
+ *  \param data        The output of the script.
+ *  \param len         The number of bytes of data.
+ *  \param chunked     Whether the data is sent as a chunk (if it is not
+ *                     empty).
+ *  \param flags       Additional flags for sendmsg(), e.g. MSG_MORE.
+ *  \param res         The response to which the system calls are accounted.
+ *
+ *  \return  The number of bytes sent, -1 on error.
+ */
+static int
+send_cgi_data(int sd_client, const char *header, size_t header_len,
+        const char *data, size_t len, int chunked, int flags,
+        response_t *res) {
+
+    char size_line[24];
+    struct iovec iov[4];
+    int iovcnt = 0;
+
+    if (header_len > 0) {
+        iov[iovcnt].iov_base = (void *)header;
+        iov[iovcnt].iov_len  = header_len;
+        iovcnt++;
+    }
+    if (chunked && len > 0) {
+        iov[iovcnt].iov_base = size_line;
+        iov[iovcnt].iov_len  = snprintf(size_line, sizeof(size_line),
+                                        "%zx\r\n", len);
+        iovcnt++;
+    }
+    if (len > 0) {
+        iov[iovcnt].iov_base = (void *)data;
+        iov[iovcnt].iov_len  = len;
+        iovcnt++;
+    }
+    if (chunked && len > 0) {
+        iov[iovcnt].iov_base = "\r\n";
+        iov[iovcnt].iov_len  = 2;
+        iovcnt++;
+    }
+
+    return (iovcnt > 0) ? send_iov(sd_client, iov, iovcnt, flags, res) : 0;
+}
@@ -16,17 +16,34 @@
 #ifndef _RESPONSE_H_
 #define _RESPONSE_H_
 
+#include <sys/types.h>
+
 #include "content.h"
+#include "file_cache.h"
 #include "http.h"
 #include "request.h"
+#include "trace.h"
+
+#define MAX_SIZE_HEADER     1024
+
+/*! \brief The size of the boundary of a multipart/byteranges body */
+#define SIZE_BOUNDARY       24
 
 /*!
- *  \brief The start and end index of the Content-Range fields of a HTTP request
+ *  \brief A part of the body of a response for a static file.
+ *
+ *  The body is the file itself or a single range of it (one part without a
+ *  header), or a multipart/byteranges body: every range is preceded by the
+ *  boundary delimiter and the header of its part, and a final part without
+ *  a range holds the closing delimiter.
  */
 typedef struct {
-    int begin; /*!< the start index of the Content-Range field */
-    int total; /*!< the end index of the Content-Range field */
-} content_range_t;
+    const char *header;  /*!< the delimiter and the header fields of the
+                              part, points into response_t.part_headers */
+    size_t header_len;   /*!< the length of header, 0 if none */
+    off_t begin;         /*!< the first byte of the range of the file */
+    off_t length;        /*!< the number of bytes of the range */
+} body_part_t;
 
 
 /*! \brief The contents of a HTTP response header.
@@ -36,7 +53,6 @@ typedef struct {
  *  as they always have the same value:
  *
  *  \code{.unparsed}
- *      Connection     "Close"
  *      Server         "Tinyweb"
  *      Accept-Range   "bytes"
  *  \endcode
@@ -50,24 +66,84 @@ typedef struct {
                                            is generated */
     time_t last_modified;             /*!< The time the requested file was last
                                            modified */
-    size_t content_length;            /*!< The length of the requested file in
-                                           bytes */
+    off_t content_length;             /*!< The length of the body in bytes:
+                                           the requested file or ranges of
+                                           it, with the part headers of a
+                                           multipart/byteranges body */
     http_content_type_t content_type; /*!< The content type of the requested
                                            type */
     char *content_location;           /*!< The URI of the requested file (same
                                            as in HTTP request) */
-    content_range_t content_range;    /*!< File range to send */
+    body_part_t parts[MAX_RANGES + 1]; /*!< The parts of the body, ranges
+                                           of the file which are sent one
+                                           after another */
+    int n_parts;                      /*!< The number of parts, more than one
+                                           for a multipart/byteranges body */
+    char boundary[SIZE_BOUNDARY];     /*!< The boundary of a
+                                           multipart/byteranges body */
+    char *part_headers;               /*!< The headers of the parts of a
+                                           multipart/byteranges body, freed
+                                           by release_response() */
     int is_cgi;                       /*!< whether the requested file is a CGI
                                            script */
+    int keep_alive;                   /*!< whether the connection stays open
+                                           after the response (Connection
+                                           "Keep-Alive" instead of "Close") */
+    int accepts_chunked;              /*!< whether the output of a CGI script
+                                           may be sent with the chunked
+                                           transfer coding */
+    int accepts_gzip;                 /*!< whether the client accepts content
+                                           compressed with gzip */
+    int content_gzip;                 /*!< whether the content is compressed
+                                           (Content-Encoding "gzip"): file is
+                                           a compressed copy of the requested
+                                           file, or the output of a CGI
+                                           script is compressed on the fly */
+    int vary_encoding;                /*!< whether the content depends on the
+                                           Accept-Encoding field of the
+                                           request (Vary field) */
+    int syscalls;                     /*!< The number of system calls (or
+                                           io_uring operations) which read the
+                                           file and sent the response */
+    file_entry_t *file;               /*!< The requested file with its
+                                           descriptor, NULL if it does not
+                                           exist; released by
+                                           release_response() */
+    const char *cached;               /*!< The pre-rendered rest of the
+                                           response (the header fields which
+                                           describe the file and, unless the
+                                           method is HEAD, the file itself)
+                                           from the file cache, or NULL */
+    size_t cached_len;                /*!< The number of bytes of cached to
+                                           send after the header */
+    char *page;                       /*!< A page rendered for this response
+                                           (the status page), referenced by
+                                           cached; freed by
+                                           release_response() */
+    trace_request_t *trace;           /*!< The timing of the request, NULL if
+                                           it is not traced */
 } response_t;
 
 void
 generate_response_header(char *path, http_status_t status, request_t *req,
         response_t *out);
 
+void
+release_response(response_t *res);
+
 int
+response_has_body(const response_t *res);
+
+int
+format_response_header(const response_t *res, char *buf, size_t size);
+
+off_t
 send_response(int sd, const char *filename, response_t *res);
 
+int
+send_file_range(int sd, int fd, off_t *offset, off_t *remaining,
+        int *syscalls);
+
 void
 send_static_500(int sd);
 
@@ -0,0 +1,331 @@
+/*! \file       scan.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Vectorized search for the delimiters of request headers.
+ *
+ *  See scan.h for API documentation.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include "scan.h"
+
+/*! \brief A variant of scan_line(). */
+typedef const char *(*scan_line_fn)(const char *, const char *,
+        const char **);
+
+/*! \brief A variant of scan_byte(). */
+typedef const char *(*scan_byte_fn)(const char *, const char *, char);
+
+/* helper functions, defined at the bottom of the file */
+static const char *scan_line_scalar(const char *p, const char *end,
+        const char **colon);
+static const char *scan_byte_scalar(const char *p, const char *end, char c);
+#ifdef HAVE_X86_SIMD
+static const char *scan_line_sse2(const char *p, const char *end,
+        const char **colon);
+static const char *scan_byte_sse2(const char *p, const char *end, char c);
+static const char *scan_line_avx2(const char *p, const char *end,
+        const char **colon);
+static const char *scan_byte_avx2(const char *p, const char *end, char c);
+#endif
+
+/* the selected implementation, chosen by the first call of scan_line() or
+ * scan_byte() unless scan_select() has been called before */
+static scan_impl_t selected = SCAN_AUTO;
+static scan_line_fn line_fn = NULL;
+static scan_byte_fn byte_fn = NULL;
+
+/* --------------------------------------------------------------------------
+ *  scan_line(p, end, colon)
+ * -------------------------------------------------------------------------- */
+/*! \brief Finds the end of a header line and the colon of a header field.
+ *
+ *  \param p      The first byte to scan.
+ *  \param end    The end of the data to scan (exclusive).
+ *  \param colon  If not NULL and *colon is NULL, the position of the first ':'
+ *                in front of the line feed (or in front of end, if there is no
+ *                line feed) is stored in *colon, if there is one.  This way,
+ *                the colon of a line which is scanned in several parts is
+ *                found as well.
+ *
+ *  \return  The position of the first '\n', NULL if there is none.
+ */
+const char *
+scan_line(const char *p, const char *end, const char **colon) {
+
+    if (line_fn == NULL) {
+        scan_select(selected);
+    }
+    return line_fn(p, end, colon);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_byte(p, end, c)
+ * -------------------------------------------------------------------------- */
+/*! \brief Finds a byte, like memchr().
+ *
+ *  \param p    The first byte to scan.
+ *  \param end  The end of the data to scan (exclusive).
+ *  \param c    The byte to find, e.g. ' ' in the request line.
+ *
+ *  \return  The position of the first c, NULL if there is none.
+ */
+const char *
+scan_byte(const char *p, const char *end, char c) {
+
+    if (byte_fn == NULL) {
+        scan_select(selected);
+    }
+    return byte_fn(p, end, c);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_select(impl)
+ * -------------------------------------------------------------------------- */
+/*! \brief Selects the implementation of the scanning functions.
+ *
+ *  Only needed to compare the implementations, by default the fastest one
+ *  supported by the CPU is used.  The AVX2 variant scans the last 16 to 31
+ *  bytes of a block with SSE2, so short header lines do not fall back to the
+ *  byte-wise loop.
+ *
+ *  \param impl  The implementation.
+ *
+ *  \return  0 on success, -1 if the implementation is not supported by the
+ *           CPU (the previous one is kept in this case).
+ */
+int
+scan_select(scan_impl_t impl) {
+
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (impl == SCAN_AUTO) {
+        impl = __builtin_cpu_supports("avx2") ? SCAN_AVX2 : SCAN_SSE2;
+    }
+    if (impl == SCAN_AVX2 && !__builtin_cpu_supports("avx2")) {
+        return -1;
+    }
+#else
+    if (impl == SCAN_AUTO) {
+        impl = SCAN_SCALAR;
+    }
+    if (impl != SCAN_SCALAR) {
+        return -1;
+    }
+#endif
+
+    switch (impl) {
+#ifdef HAVE_X86_SIMD
+        case SCAN_AVX2:
+            line_fn = scan_line_avx2;
+            byte_fn = scan_byte_avx2;
+            break;
+        case SCAN_SSE2:
+            line_fn = scan_line_sse2;
+            byte_fn = scan_byte_sse2;
+            break;
+#endif
+        default:
+            impl    = SCAN_SCALAR;
+            line_fn = scan_line_scalar;
+            byte_fn = scan_byte_scalar;
+            break;
+    }
+    selected = impl;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_impl_name()
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the name of the selected implementation.
+ */
+const char *
+scan_impl_name(void) {
+
+    if (line_fn == NULL) {
+        scan_select(selected);
+    }
+    switch (selected) {
+        case SCAN_AVX2:
+            return "avx2";
+        case SCAN_SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  scan_line_scalar(p, end, colon)
+ * -------------------------------------------------------------------------- */
+/*! \brief scan_line() byte by byte, also used for the last bytes of the
+ *         vectorized variants.
+ */
+static const char *
+scan_line_scalar(const char *p, const char *end, const char **colon) {
+
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            return p;
+        }
+        if (*p == ':' && colon != NULL && *colon == NULL) {
+            *colon = p;
+        }
+    }
+    return NULL;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_byte_scalar(p, end, c)
+ * -------------------------------------------------------------------------- */
+/*! \brief scan_byte() byte by byte.
+ */
+static const char *
+scan_byte_scalar(const char *p, const char *end, char c) {
+
+    for (; p < end; p++) {
+        if (*p == c) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* Both variants compare a block of bytes with the delimiters and turn the
+ * results into bit masks (bit i is set if byte i matches).  The lowest set
+ * bit of the line feed mask is the end of the line, colons behind it are
+ * masked out. */
+
+/* --------------------------------------------------------------------------
+ *  scan_line_sse2(p, end, colon)
+ * -------------------------------------------------------------------------- */
+/*! \brief scan_line() with 16 bytes per step.
+ */
+static const char *
+scan_line_sse2(const char *p, const char *end, const char **colon) {
+
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i co = _mm_set1_epi8(':');
+
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        uint32_t lf_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, lf));
+
+        if (colon != NULL && *colon == NULL) {
+            uint32_t co_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, co));
+            if (lf_mask != 0) {
+                co_mask &= (lf_mask & -lf_mask) - 1;
+            }
+            if (co_mask != 0) {
+                *colon = p + __builtin_ctz(co_mask);
+            }
+        }
+        if (lf_mask != 0) {
+            return p + __builtin_ctz(lf_mask);
+        }
+        p += 16;
+    }
+    return scan_line_scalar(p, end, colon);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_byte_sse2(p, end, c)
+ * -------------------------------------------------------------------------- */
+/*! \brief scan_byte() with 16 bytes per step.
+ */
+static const char *
+scan_byte_sse2(const char *p, const char *end, char c) {
+
+    const __m128i needle = _mm_set1_epi8(c);
+
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return scan_byte_scalar(p, end, c);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_line_avx2(p, end, colon)
+ * -------------------------------------------------------------------------- */
+/*! \brief scan_line() with 32 bytes per step.
+ */
+__attribute__((target("avx2")))
+static const char *
+scan_line_avx2(const char *p, const char *end, const char **colon) {
+
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i co = _mm256_set1_epi8(':');
+
+    while (end - p >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)p);
+        uint32_t lf_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf));
+
+        if (colon != NULL && *colon == NULL) {
+            uint32_t co_mask =
+                    _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, co));
+            if (lf_mask != 0) {
+                co_mask &= (lf_mask & -lf_mask) - 1;
+            }
+            if (co_mask != 0) {
+                *colon = p + __builtin_ctz(co_mask);
+            }
+        }
+        if (lf_mask != 0) {
+            return p + __builtin_ctz(lf_mask);
+        }
+        p += 32;
+    }
+    /* the SSE2 variant is not VEX-encoded, avoid the transition penalty */
+    _mm256_zeroupper();
+    return scan_line_sse2(p, end, colon);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  scan_byte_avx2(p, end, c)
+ * -------------------------------------------------------------------------- */
+/*! \brief scan_byte() with 32 bytes per step.
+ */
+__attribute__((target("avx2")))
+static const char *
+scan_byte_avx2(const char *p, const char *end, char c) {
+
+    const __m256i needle = _mm256_set1_epi8(c);
+
+    while (end - p >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)p);
+        uint32_t mask =
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    _mm256_zeroupper();
+    return scan_byte_sse2(p, end, c);
+}
+
+#endif /* HAVE_X86_SIMD */
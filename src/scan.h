@@ -0,0 +1,37 @@
+/*! \file       scan.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Vectorized search for the delimiters of request headers.
+ *
+ *  The request parser spends most of its time looking for line breaks, the
+ *  colons of header fields and the spaces of the request line.  The functions
+ *  of this module compare 32 (AVX2) or 16 (SSE2) bytes at once and fall back
+ *  to a byte-wise loop for the remaining bytes and on other architectures.
+ *  The implementation is selected at runtime according to the features of
+ *  the CPU when a function is called for the first time.
+ */
+
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+/*! \brief The implementations of the scanning functions. */
+typedef enum {
+    SCAN_AUTO = 0,          /*!< the fastest one supported by the CPU */
+    SCAN_SCALAR,            /*!< byte by byte */
+    SCAN_SSE2,              /*!< 16 bytes per step */
+    SCAN_AVX2               /*!< 32 bytes per step */
+} scan_impl_t;
+
+const char *
+scan_line(const char *p, const char *end, const char **colon);
+
+const char *
+scan_byte(const char *p, const char *end, char c);
+
+int
+scan_select(scan_impl_t impl);
+
+const char *
+scan_impl_name(void);
+
+#endif // _SCAN_H_
@@ -0,0 +1,631 @@
+/*! \file       stats.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Server statistics in shared memory.
+ *
+ *  See stats.h for API documentation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "stats.h"
+
+/*! Number of histogram buckets: durations below 1 us, one bucket per power
+ *  of two up to 2^20 us (about one second), and everything above */
+#define STATS_BUCKETS       22
+
+/*! \brief A histogram of durations. */
+typedef struct {
+    unsigned long      count;                   /*!< number of durations */
+    unsigned long long sum_ns;                  /*!< their sum in ns */
+    unsigned long      buckets[STATS_BUCKETS];  /*!< bucket i counts the
+                                                     durations below 2^i us
+                                                     (and not below 2^(i-1)
+                                                     us), the last one all
+                                                     longer ones */
+} stats_histogram_t;
+
+/*! \brief The counters of a worker (or of all processes of the fork engine).
+ *
+ *  Every slot starts on a cache line of its own, so that workers do not
+ *  compete for the same cache lines. */
+typedef struct {
+    unsigned long      requests[STATS_STATUS_COUNT]; /*!< answered requests by
+                                                          http_status_t */
+    unsigned long long bytes_sent;      /*!< bytes of all responses */
+    unsigned long      connections;     /*!< accepted connections */
+    long               active;          /*!< currently open connections */
+    unsigned long      counters[STATS_COUNTERS];     /*!< event counters */
+    stats_histogram_t  stages[STATS_STAGES];         /*!< stage durations */
+} __attribute__((aligned(64))) stats_slot_t;
+
+/*! \brief The memory shared between all processes of the server. */
+typedef struct {
+    time_t       started;       /*!< start time of the server */
+    int          n_slots;       /*!< the number of slots */
+    stats_slot_t slots[];       /*!< one slot per worker */
+} stats_shared_t;
+
+static const char *stage_names[STATS_STAGES] = {
+    "accept", "parse", "stat", "header", "body"
+};
+
+/*! The statistics of all processes, NULL if they are not collected */
+static stats_shared_t *shared = NULL;
+static size_t shared_size = 0;
+
+/*! The slot of the current process */
+static stats_slot_t *slot = NULL;
+
+/*! The URI of the status page, NULL or empty if disabled */
+static const char *status_uri = NULL;
+
+/*! The time the current connection of a blocking process was accepted */
+static uint64_t connection_start = 0;
+
+/* helper functions, defined at the bottom of the file */
+static void sum_slots(stats_slot_t *total);
+static int stage_bucket(uint64_t ns);
+static double bucket_bound_us(int bucket);
+static double percentile_us(const stats_histogram_t *hist, double p);
+static int render_text(const stats_slot_t *total, time_t uptime, char *buf,
+        size_t size);
+static int render_prometheus(const stats_slot_t *total, time_t uptime,
+        char *buf, size_t size);
+
+/* --------------------------------------------------------------------------
+ *  stats_init(n_slots, uri)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sets up the shared statistics.
+ *
+ *  Must be called by the master process before any other process is forked.
+ *  Every worker uses a slot of its own (see stats_select_slot()), all other
+ *  processes share the first slot.
+ *
+ *  \param n_slots  The number of slots, at least 1.
+ *  \param uri      The URI of the status page, NULL or "" to disable it.
+ *
+ *  \return  0 on success, -1 if the shared memory could not be mapped.  In
+ *           this case, all other functions have no effect.
+ */
+int
+stats_init(int n_slots, const char *uri) {
+
+    shared_size = sizeof(stats_shared_t) + n_slots * sizeof(stats_slot_t);
+    shared = (stats_shared_t *)mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("ERROR: mmap() of statistics");
+        shared = NULL;
+        return -1;
+    }
+
+    shared->started = time(NULL);
+    shared->n_slots = n_slots;
+    slot       = &shared->slots[0];
+    status_uri = uri;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_select_slot(index)
+ * -------------------------------------------------------------------------- */
+/*! \brief Selects the slot which the current process updates.
+ *
+ *  \param index  The slot, modulo the number of slots.
+ */
+void
+stats_select_slot(int index) {
+
+    if (shared != NULL) {
+        slot = &shared->slots[index % shared->n_slots];
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_cleanup()
+ * -------------------------------------------------------------------------- */
+/*! \brief Unmaps the shared statistics, in the master process at shutdown.
+ */
+void
+stats_cleanup(void) {
+
+    if (shared != NULL) {
+        munmap(shared, shared_size);
+        shared = NULL;
+        slot   = NULL;
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_now()
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the current time for stats_stage().
+ *
+ *  \return  A monotonic time in ns, 0 if no statistics are collected.
+ */
+uint64_t
+stats_now(void) {
+
+    struct timespec ts;
+
+    if (slot == NULL) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_stage(stage, start)
+ * -------------------------------------------------------------------------- */
+/*! \brief Records the duration of a stage.
+ *
+ *  \param stage  The stage which has been completed.
+ *  \param start  The time the stage started, from stats_now() or the return
+ *                value of a previous call.  Nothing is recorded if it is 0.
+ *
+ *  \return  The current time, the start of the next stage.
+ */
+uint64_t
+stats_stage(stats_stage_t stage, uint64_t start) {
+
+    uint64_t now = stats_now(), ns;
+    stats_histogram_t *hist;
+
+    if (slot == NULL || start == 0 || stage >= STATS_STAGES) {
+        return now;
+    }
+
+    ns   = (now > start) ? now - start : 0;
+    hist = &slot->stages[stage];
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->buckets[stage_bucket(ns)], 1, __ATOMIC_RELAXED);
+    return now;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_connection_open()
+ * -------------------------------------------------------------------------- */
+/*! \brief Counts an accepted connection.
+ *
+ *  Every connection counted with this function has to be closed with
+ *  stats_connection_close(), possibly by another process (e.g. the child
+ *  process which serves it).
+ *
+ *  \return  The current time, the start of the accept stage.  It is also
+ *           returned by stats_connection_time() until the next call.
+ */
+uint64_t
+stats_connection_open(void) {
+
+    if (slot == NULL) {
+        return 0;
+    }
+    __atomic_fetch_add(&slot->connections, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->active, 1, __ATOMIC_RELAXED);
+    connection_start = stats_now();
+    return connection_start;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_connection_time()
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the time the last connection was accepted.
+ *
+ *  Used by the blocking engines, which serve one connection per process at a
+ *  time.  The time is inherited by a child process forked for the
+ *  connection.
+ */
+uint64_t
+stats_connection_time(void) {
+
+    return connection_start;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_connection_close()
+ * -------------------------------------------------------------------------- */
+/*! \brief Counts the end of a connection.
+ */
+void
+stats_connection_close(void) {
+
+    if (slot != NULL) {
+        __atomic_fetch_sub(&slot->active, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_count(counter)
+ * -------------------------------------------------------------------------- */
+/*! \brief Increments an event counter.
+ */
+void
+stats_count(stats_counter_t counter) {
+
+    if (slot != NULL && counter < STATS_COUNTERS) {
+        __atomic_fetch_add(&slot->counters[counter], 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_request(status, bytes_sent)
+ * -------------------------------------------------------------------------- */
+/*! \brief Counts an answered request.
+ *
+ *  \param status      The status of the response.
+ *  \param bytes_sent  The number of bytes sent for the response.
+ */
+void
+stats_request(http_status_t status, off_t bytes_sent) {
+
+    if (slot == NULL || status >= STATS_STATUS_COUNT) {
+        return;
+    }
+    __atomic_fetch_add(&slot->requests[status], 1, __ATOMIC_RELAXED);
+    if (bytes_sent > 0) {
+        __atomic_fetch_add(&slot->bytes_sent, (unsigned long long)bytes_sent,
+                           __ATOMIC_RELAXED);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_status_format(uri)
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks whether a request URI asks for the status page.
+ *
+ *  \param uri  The request URI, including the query string.
+ *
+ *  \return  The format of the page (STATS_FORMAT_PROMETHEUS if the query
+ *           string contains "format=prometheus"), or -1 if the URI is not
+ *           the status page or the status page is disabled.
+ */
+int
+stats_status_format(const char *uri) {
+
+    size_t len;
+
+    if (shared == NULL || status_uri == NULL || status_uri[0] == '\0') {
+        return -1;
+    }
+
+    len = strlen(status_uri);
+    if (strncmp(uri, status_uri, len) != 0 ||
+            (uri[len] != '\0' && uri[len] != '?')) {
+        return -1;
+    }
+    if (uri[len] == '?' && strstr(uri + len, "format=prometheus") != NULL) {
+        return STATS_FORMAT_PROMETHEUS;
+    }
+    return STATS_FORMAT_TEXT;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_render(format, buf, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the counters of all processes to a buffer.
+ *
+ *  The counters are read while other processes update them, so the page is
+ *  not an atomic snapshot: the counters of different slots (and the buckets
+ *  of a histogram and its count) may be off by the requests answered in the
+ *  meantime.
+ *
+ *  \param format  The format of the page.
+ *  \param buf     The buffer, STATS_PAGE_SIZE bytes are large enough.
+ *  \param size    The size of buf in bytes.
+ *
+ *  \return  The length of the page in bytes (not including a terminating
+ *           '\0' byte), or -1 if the buffer is too small or no statistics
+ *           are collected.
+ */
+int
+stats_render(stats_format_t format, char *buf, size_t size) {
+
+    stats_slot_t total;
+    time_t uptime;
+
+    if (shared == NULL) {
+        return -1;
+    }
+
+    sum_slots(&total);
+    uptime = time(NULL) - shared->started;
+
+    return (format == STATS_FORMAT_PROMETHEUS)
+           ? render_prometheus(&total, uptime, buf, size)
+           : render_text(&total, uptime, buf, size);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stats_content_type(format)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the media type of the status page in the given format.
+ */
+const char *
+stats_content_type(stats_format_t format) {
+
+    return (format == STATS_FORMAT_PROMETHEUS)
+           ? "text/plain; version=0.0.4; charset=utf-8"
+           : "text/plain; charset=utf-8";
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  sum_slots(total)
+ * -------------------------------------------------------------------------- */
+/*! \brief Adds up the counters of all slots.
+ */
+static void
+sum_slots(stats_slot_t *total) {
+
+    #define SUM(field) \
+        (total->field += __atomic_load_n(&s->field, __ATOMIC_RELAXED))
+
+    int i, j, k;
+
+    memset(total, 0, sizeof(*total));
+    for (i = 0; i < shared->n_slots; i++) {
+        stats_slot_t *s = &shared->slots[i];
+
+        for (j = 0; j < STATS_STATUS_COUNT; j++) {
+            SUM(requests[j]);
+        }
+        SUM(bytes_sent);
+        SUM(connections);
+        SUM(active);
+        for (j = 0; j < STATS_COUNTERS; j++) {
+            SUM(counters[j]);
+        }
+        for (j = 0; j < STATS_STAGES; j++) {
+            SUM(stages[j].count);
+            SUM(stages[j].sum_ns);
+            for (k = 0; k < STATS_BUCKETS; k++) {
+                SUM(stages[j].buckets[k]);
+            }
+        }
+    }
+
+    #undef SUM
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stage_bucket(ns)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the histogram bucket of a duration.
+ */
+static int
+stage_bucket(uint64_t ns) {
+
+    uint64_t us = ns / 1000;
+    int bucket;
+
+    if (us == 0) {
+        return 0;
+    }
+    bucket = 64 - __builtin_clzll(us);
+    return (bucket < STATS_BUCKETS - 1) ? bucket : STATS_BUCKETS - 1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  bucket_bound_us(bucket)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the upper bound of a histogram bucket in us (the last
+ *         bucket has none, the bound of the one before it is returned).
+ */
+static double
+bucket_bound_us(int bucket) {
+
+    if (bucket >= STATS_BUCKETS - 1) {
+        bucket = STATS_BUCKETS - 2;
+    }
+    return (double)(1UL << bucket);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  percentile_us(hist, p)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns the upper bound of the bucket of a percentile in us.
+ */
+static double
+percentile_us(const stats_histogram_t *hist, double p) {
+
+    unsigned long rank = (unsigned long)(p / 100.0 * hist->count + 0.5);
+    unsigned long seen = 0;
+    int i;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    return bucket_bound_us(i);
+}
+
+
+/* Local macro to remove some boilerplate, as in response.c */
+#define APPEND(...)                                                          \
+    {                                                                        \
+        int cnt = snprintf(buf + len, size - len, __VA_ARGS__);              \
+        if (cnt < 0 || (size_t)cnt >= size - len) {                          \
+            return -1;                                                       \
+        }                                                                    \
+        len += cnt;                                                          \
+    }
+
+/* --------------------------------------------------------------------------
+ *  render_text(total, uptime, buf, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the status page for humans.
+ *
+ *  Percentiles are the upper bounds of the histogram buckets in which they
+ *  fall, i.e. exact up to a factor of two.
+ */
+static int
+render_text(const stats_slot_t *total, time_t uptime, char *buf,
+        size_t size) {
+
+    unsigned long requests = 0;
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < STATS_STATUS_COUNT; i++) {
+        requests += total->requests[i];
+    }
+
+    APPEND("Tinyweb server status\n\n");
+    APPEND("Uptime:             %ld s\n", (long)uptime);
+    APPEND("Requests:           %lu\n", requests);
+    APPEND("Bytes sent:         %llu\n", total->bytes_sent);
+    APPEND("Connections:        %lu (%ld active)\n", total->connections,
+            total->active);
+    APPEND("CGI executions:     %lu\n",
+            total->counters[STATS_CGI_EXECUTIONS]);
+    APPEND("File cache:         %lu hits, %lu misses\n",
+            total->counters[STATS_FILE_CACHE_HITS],
+            total->counters[STATS_FILE_CACHE_MISSES]);
+    APPEND("Memory cache:       %lu hits, %lu misses\n",
+            total->counters[STATS_MEMORY_CACHE_HITS],
+            total->counters[STATS_MEMORY_CACHE_MISSES]);
+    APPEND("Compression:        %lu files, %lu CGI outputs\n",
+            total->counters[STATS_GZIP_FILES],
+            total->counters[STATS_GZIP_STREAMS]);
+
+    APPEND("\nRequests by status:\n");
+    for (i = 0; i < STATS_STATUS_COUNT; i++) {
+        APPEND("  %d %-32s %lu\n", http_status_list[i].code,
+                http_status_list[i].text, total->requests[i]);
+    }
+
+    APPEND("\nStage durations (us, percentiles are upper bounds):\n");
+    APPEND("  %-8s %12s %10s %10s %10s %10s\n", "stage", "count", "mean",
+            "p50", "p90", "p99");
+    for (i = 0; i < STATS_STAGES; i++) {
+        const stats_histogram_t *hist = &total->stages[i];
+
+        if (hist->count == 0) {
+            APPEND("  %-8s %12d %10s %10s %10s %10s\n", stage_names[i], 0,
+                    "-", "-", "-", "-");
+            continue;
+        }
+        APPEND("  %-8s %12lu %10.1f %10.0f %10.0f %10.0f\n", stage_names[i],
+                hist->count, hist->sum_ns / 1e3 / hist->count,
+                percentile_us(hist, 50), percentile_us(hist, 90),
+                percentile_us(hist, 99));
+    }
+
+    return len;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  render_prometheus(total, uptime, buf, size)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the status page in the Prometheus text exposition format.
+ */
+static int
+render_prometheus(const stats_slot_t *total, time_t uptime, char *buf,
+        size_t size) {
+
+    size_t len = 0;
+    unsigned long cumulative;
+    int i, j;
+
+    APPEND("# HELP tinyweb_uptime_seconds Time since the server was "
+           "started.\n"
+           "# TYPE tinyweb_uptime_seconds gauge\n"
+           "tinyweb_uptime_seconds %ld\n", (long)uptime);
+
+    APPEND("# HELP tinyweb_requests_total Answered requests by status "
+           "code.\n"
+           "# TYPE tinyweb_requests_total counter\n");
+    for (i = 0; i < STATS_STATUS_COUNT; i++) {
+        APPEND("tinyweb_requests_total{code=\"%d\"} %lu\n",
+                http_status_list[i].code, total->requests[i]);
+    }
+
+    APPEND("# HELP tinyweb_sent_bytes_total Bytes sent in responses.\n"
+           "# TYPE tinyweb_sent_bytes_total counter\n"
+           "tinyweb_sent_bytes_total %llu\n", total->bytes_sent);
+    APPEND("# HELP tinyweb_connections_total Accepted connections.\n"
+           "# TYPE tinyweb_connections_total counter\n"
+           "tinyweb_connections_total %lu\n", total->connections);
+    APPEND("# HELP tinyweb_connections_active Open connections.\n"
+           "# TYPE tinyweb_connections_active gauge\n"
+           "tinyweb_connections_active %ld\n", total->active);
+    APPEND("# HELP tinyweb_cgi_executions_total Started CGI scripts.\n"
+           "# TYPE tinyweb_cgi_executions_total counter\n"
+           "tinyweb_cgi_executions_total %lu\n",
+           total->counters[STATS_CGI_EXECUTIONS]);
+    APPEND("# HELP tinyweb_file_cache_lookups_total Lookups in the cache "
+           "of open files.\n"
+           "# TYPE tinyweb_file_cache_lookups_total counter\n"
+           "tinyweb_file_cache_lookups_total{result=\"hit\"} %lu\n"
+           "tinyweb_file_cache_lookups_total{result=\"miss\"} %lu\n",
+           total->counters[STATS_FILE_CACHE_HITS],
+           total->counters[STATS_FILE_CACHE_MISSES]);
+    APPEND("# HELP tinyweb_memory_cache_lookups_total Lookups of small "
+           "files in memory.\n"
+           "# TYPE tinyweb_memory_cache_lookups_total counter\n"
+           "tinyweb_memory_cache_lookups_total{result=\"hit\"} %lu\n"
+           "tinyweb_memory_cache_lookups_total{result=\"miss\"} %lu\n",
+           total->counters[STATS_MEMORY_CACHE_HITS],
+           total->counters[STATS_MEMORY_CACHE_MISSES]);
+    APPEND("# HELP tinyweb_gzip_compressions_total Contents compressed "
+           "with gzip.\n"
+           "# TYPE tinyweb_gzip_compressions_total counter\n"
+           "tinyweb_gzip_compressions_total{source=\"file\"} %lu\n"
+           "tinyweb_gzip_compressions_total{source=\"cgi\"} %lu\n",
+           total->counters[STATS_GZIP_FILES],
+           total->counters[STATS_GZIP_STREAMS]);
+
+    APPEND("# HELP tinyweb_stage_duration_seconds Time spent in the stages "
+           "of a request.\n"
+           "# TYPE tinyweb_stage_duration_seconds histogram\n");
+    for (i = 0; i < STATS_STAGES; i++) {
+        const stats_histogram_t *hist = &total->stages[i];
+
+        cumulative = 0;
+        for (j = 0; j < STATS_BUCKETS - 1; j++) {
+            cumulative += hist->buckets[j];
+            APPEND("tinyweb_stage_duration_seconds_bucket{stage=\"%s\","
+                   "le=\"%g\"} %lu\n", stage_names[i],
+                   bucket_bound_us(j) / 1e6, cumulative);
+        }
+        cumulative += hist->buckets[j];
+        APPEND("tinyweb_stage_duration_seconds_bucket{stage=\"%s\","
+               "le=\"+Inf\"} %lu\n", stage_names[i], cumulative);
+        APPEND("tinyweb_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n",
+               stage_names[i], hist->sum_ns / 1e9);
+        APPEND("tinyweb_stage_duration_seconds_count{stage=\"%s\"} %lu\n",
+               stage_names[i], cumulative);
+    }
+
+    return len;
+}
+
+#undef APPEND
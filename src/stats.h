@@ -0,0 +1,100 @@
+/*! \file       stats.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Server statistics in shared memory.
+ *
+ *  Every process of the server counts the requests it answers, the bytes it
+ *  sends, its connections, CGI executions and file cache lookups, and the
+ *  time spent in each stage of a request, in a segment of shared memory.  The
+ *  counters are updated with atomic operations, without locks and without
+ *  system calls.  A reserved URI (/server-status by default) renders the
+ *  counters of all processes as plain text or, with the query string
+ *  "?format=prometheus", in the Prometheus text exposition format.
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "http.h"
+
+/*! The number of entries of http_status_list */
+#define STATS_STATUS_COUNT  (HTTP_STATUS_NOT_IMPLEMENTED + 1)
+
+/*! Size of the buffer for a rendered status page */
+#define STATS_PAGE_SIZE     32768
+
+/*! \brief The timed stages of a request. */
+typedef enum {
+    STATS_STAGE_ACCEPT = 0, /*!< from the acceptance of a connection until
+                                 its first request header is complete */
+    STATS_STAGE_PARSE,      /*!< parsing the request header */
+    STATS_STAGE_STAT,       /*!< looking up and opening the requested file */
+    STATS_STAGE_HEADER,     /*!< formatting and sending the response header
+                                 (and content sent together with it) */
+    STATS_STAGE_BODY,       /*!< sending the file or the CGI output behind
+                                 the header */
+    STATS_STAGES
+} stats_stage_t;
+
+/*! \brief The event counters. */
+typedef enum {
+    STATS_CGI_EXECUTIONS = 0,   /*!< CGI scripts started */
+    STATS_FILE_CACHE_HITS,      /*!< files found in the descriptor cache */
+    STATS_FILE_CACHE_MISSES,    /*!< files opened for the descriptor cache */
+    STATS_MEMORY_CACHE_HITS,    /*!< responses taken from memory */
+    STATS_MEMORY_CACHE_MISSES,  /*!< small files which were not in memory */
+    STATS_GZIP_FILES,           /*!< files compressed into the cache */
+    STATS_GZIP_STREAMS,         /*!< CGI outputs compressed on the fly */
+    STATS_COUNTERS
+} stats_counter_t;
+
+/*! \brief The formats of the status page. */
+typedef enum {
+    STATS_FORMAT_TEXT = 0,      /*!< plain text for humans */
+    STATS_FORMAT_PROMETHEUS     /*!< Prometheus text exposition format */
+} stats_format_t;
+
+int
+stats_init(int n_slots, const char *status_uri);
+
+void
+stats_select_slot(int index);
+
+void
+stats_cleanup(void);
+
+uint64_t
+stats_now(void);
+
+uint64_t
+stats_stage(stats_stage_t stage, uint64_t start);
+
+uint64_t
+stats_connection_open(void);
+
+uint64_t
+stats_connection_time(void);
+
+void
+stats_connection_close(void);
+
+void
+stats_count(stats_counter_t counter);
+
+void
+stats_request(http_status_t status, off_t bytes_sent);
+
+int
+stats_status_format(const char *uri);
+
+int
+stats_render(stats_format_t format, char *buf, size_t size);
+
+const char *
+stats_content_type(stats_format_t format);
+
+#endif // _STATS_H_
@@ -39,14 +39,23 @@
 /* from libsocket */
 #include "connect_tcp.h"
 #include "passive_tcp.h"
+#include "socket_info.h"
 #include "socket_io.h"
 
+#include "event_loop.h"
+#include "fcgi.h"
+#include "file_cache.h"
+#include "gzip.h"
+#include "uring_loop.h"
 #include "http.h"
 #include "log.h"
 #include "request.h"
 #include "response.h"
 #include "safe_print.h"
 #include "sem_print.h"
+#include "stats.h"
+#include "trace.h"
+#include "worker.h"
 
 
 /* Must be true for the server accepting clients, otherwise, the server will
@@ -55,13 +64,36 @@ static volatile sig_atomic_t server_running = false;
 
 #define IS_ROOT_DIR(mode)   (S_ISDIR(mode) && ((S_IROTH || S_IXOTH) & (mode)))
 
+/* getopt_long() values of the options which have no short form */
+#define OPT_MAX_REQUESTS    256
+#define OPT_REUSEPORT       257
+#define OPT_CPU_AFFINITY    258
+#define OPT_FILE_CACHE      259
+#define OPT_FILE_CACHE_TTL  260
+#define OPT_MEMORY_CACHE    261
+#define OPT_MEMORY_CACHE_MAX 262
+#define OPT_STATUS_URI      263
+#define OPT_TRACE           264
+#define OPT_TRACE_SAMPLE    265
+#define OPT_FCGI_POOL       266
+#define OPT_FCGI_IDLE       267
+#define OPT_GZIP            268
+#define OPT_GZIP_MIN_SIZE   269
+#define OPT_GZIP_CACHE      270
+#define OPT_BACKLOG         271
+#define OPT_DEFER_ACCEPT    272
+#define OPT_FASTOPEN        273
+#define OPT_RCVBUF          274
+#define OPT_SNDBUF          275
+#define OPT_TCP_NODELAY     276
+
 /* --------------------------------------------------------------------------
  *  sig_handler(sig)
  * -------------------------------------------------------------------------- */
-/*! \brief Handles SIGINT and SIGCHLD signals.
+/*! \brief Handles SIGINT, SIGTERM and SIGCHLD signals.
  *
- *  Makes sure that the server exits gracefully on SIGINT and notifies the user
- *  about terminating child processes.
+ *  Makes sure that the server exits gracefully on SIGINT and SIGTERM and
+ *  notifies the user about terminating child processes.
  *
  *  \param sd  The signal number that was received by the process.
  */
@@ -77,6 +109,9 @@ sig_handler(int sig)
             safe_printf("\n[%d] Server terminated due to keyboard interrupt\n", getpid());
             server_running = false;
             break;
+        case SIGTERM:
+            server_running = false;
+            break;
         case SIGCHLD:
             while ((pid=wait3(&status, WNOHANG, (struct rusage *)0)) > 0) {
                 safe_printf("\n[%d] Child finished, pid %d.\n", getpid(), pid);
@@ -103,12 +138,163 @@ print_usage(const char *progname)
   fprintf(stderr,
       "  -f, --file=FILE    Write log output to FILE; if not specified, log\n"
       "                     messages are written to stdout.\n"
-      "  -p, --port=PORT    Accept clients on port PORT.\n"
+      "  -p, --port=PORT    Accept clients on port PORT of all IPv4 and IPv6\n"
+      "                     addresses.\n"
+      "  -l, --listen=[ADDR]:PORT\n"
+      "                     Accept clients on port PORT of the addresses\n"
+      "                     ADDR resolves to (an IPv6 address in brackets,\n"
+      "                     all addresses if ADDR is empty or '*'); may be\n"
+      "                     given several times and combined with -p.\n"
       "  -d, --dir=DIR      Use DIR as root directory for web contents.\n"
+      "  -w, --workers=N    Pre-fork N worker processes which serve requests\n"
+      "                     in a loop; if N is 0 (default), a new process is\n"
+      "                     forked for every connection.\n"
+      "      --max-requests-per-worker=N\n"
+      "                     Recycle a worker after it has served N\n"
+      "                     connections; 0 (default) means no limit.\n"
+      "      --reuseport    Open one SO_REUSEPORT listening socket per worker\n"
+      "                     instead of a single shared one (requires -w).\n"
+      "      --cpu-affinity Pin every worker to its own CPU (requires -w).\n"
+      "      --backlog=N    Queue up to N connections which have not been\n"
+      "                     accepted yet (default 511; limited by\n"
+      "                     net.core.somaxconn).\n"
+      "      --defer-accept=SEC\n"
+      "                     Only accept a connection when its request has\n"
+      "                     arrived, waiting up to SEC seconds\n"
+      "                     (TCP_DEFER_ACCEPT; default 0, disabled).\n"
+      "      --fastopen=N   Accept TCP Fast Open requests, with up to N\n"
+      "                     pending ones (default 0, disabled).\n"
+      "      --rcvbuf=BYTES, --sndbuf=BYTES\n"
+      "                     Size of the receive and send buffers of client\n"
+      "                     sockets (default 0, sized by the kernel).\n"
+      "      --tcp-nodelay  Disable Nagle's algorithm on client sockets.\n");
+  fprintf(stderr,
+      "  -e, --engine=ENGINE\n"
+      "                     Serve clients with ENGINE, which is either 'fork'\n"
+      "                     (default, blocking I/O), 'epoll' (event loop\n"
+      "                     with persistent connections; combined with -w,\n"
+      "                     every worker runs its own event loop) or 'uring'\n"
+      "                     (like 'epoll', but with io_uring; falls back to\n"
+      "                     'fork' if io_uring is not available).\n"
+      "  -t, --timeout=SEC  Close idle persistent connections after SEC\n"
+      "                     seconds (default 120).\n"
+      "      --file-cache=N Keep up to N requested files open together with\n"
+      "                     their metadata (default 1024, 0 disables); only\n"
+      "                     used by workers and event loops.\n"
+      "      --file-cache-ttl=SEC\n"
+      "                     Revalidate cached files after SEC seconds even if\n"
+      "                     inotify reports no change (default 10).\n"
+      "      --memory-cache=BYTES\n"
+      "                     Keep up to BYTES of small cached files in memory\n"
+      "                     together with their header (default 16777216,\n"
+      "                     0 disables).\n"
+      "      --memory-cache-max=BYTES\n"
+      "                     Only keep files of up to BYTES in memory\n"
+      "                     (default 65536).\n"
+      "      --status-uri=URI\n"
+      "                     Answer requests for URI with the server status,\n"
+      "                     in the Prometheus format if the query string is\n"
+      "                     '?format=prometheus' (default /server-status;\n"
+      "                     an empty URI disables the status page).\n"
+      "      --trace=FILE   Write the time spent in each stage of requests\n"
+      "                     to FILE in the Chrome trace event format.\n"
+      "      --trace-sample=N\n"
+      "                     Only trace every N-th request (default 1).\n"
+      "      --fcgi-pool=N  Serve CGI scripts named *.fcgi by N persistent\n"
+      "                     FastCGI processes per script (default 2, 0\n"
+      "                     executes them for every request).\n"
+      "      --fcgi-idle=SEC\n"
+      "                     Terminate the processes of a script after SEC\n"
+      "                     seconds without a request (default 60, 0 means\n"
+      "                     never).\n"
+      "      --gzip=LEVEL   Compress files and CGI output of text-like types\n"
+      "                     with gzip level LEVEL (1-9) for clients which\n"
+      "                     accept it; 0 (default) disables compression.\n"
+      "                     Files with a precompressed copy (name.gz) are\n"
+      "                     always sent compressed to such clients.\n"
+      "      --gzip-min-size=BYTES\n"
+      "                     Do not compress content smaller than BYTES\n"
+      "                     (default 1024).\n"
+      "      --gzip-cache=DIR\n"
+      "                     Keep the compressed copies of files in DIR\n"
+      "                     (default: a temporary directory, which is\n"
+      "                     removed when the server terminates).\n"
       "  -v, --verbose      More detailed output.\n" );
 } /* end of print_usage */
 
 
+/* --------------------------------------------------------------------------
+ *  add_endpoint(opt, endpoint)
+ * -------------------------------------------------------------------------- */
+/*! \brief Resolves an endpoint given with -p or --listen.
+ *
+ *  The endpoint is [ADDR]:PORT or ADDR:PORT, where ADDR is a host name or a
+ *  numeric address (IPv6 addresses are enclosed in brackets).  A missing or
+ *  empty ADDR or '*' stands for the wildcard addresses of IPv4 and IPv6.
+ *
+ *  \param opt       The program options, the addresses are appended to the
+ *                   server_addr field.
+ *  \param endpoint  The endpoint as given on the command line.
+ *
+ *  \return  1 on success, 0 if the endpoint is invalid or cannot be
+ *           resolved.
+ */
+static int
+add_endpoint(prog_options_t *opt, const char *endpoint)
+{
+    char host[NI_MAXHOST];
+    const char *addr = endpoint, *port, *end;
+    size_t len = 0;
+    struct addrinfo hints;
+    int err;
+
+    if (opt->n_endpoints == MAX_LISTENERS) {
+        fprintf(stderr, "Too many endpoints, at most %d are supported\n",
+                MAX_LISTENERS);
+        return 0;
+    } /* end if */
+
+    if (endpoint[0] == '[') {
+        end = strchr(endpoint, ']');
+        if (end == NULL || end[1] != ':') {
+            fprintf(stderr, "Invalid endpoint '%s'\n", endpoint);
+            return 0;
+        } /* end if */
+        addr = endpoint + 1;
+        len = end - addr;
+        port = end + 2;
+    } else if ((port = strrchr(endpoint, ':')) != NULL) {
+        len = port - endpoint;
+        port++;
+    } else {
+        port = endpoint;
+    } /* end if */
+
+    if (len >= sizeof(host) || *port == '\0') {
+        fprintf(stderr, "Invalid endpoint '%s'\n", endpoint);
+        return 0;
+    } /* end if */
+    memcpy(host, addr, len);
+    host[len] = '\0';
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_family = AF_UNSPEC;   /* Allows IPv4 or IPv6 */
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+    err = getaddrinfo((len == 0 || strcmp(host, "*") == 0) ? NULL : host,
+                      port, &hints, &opt->server_addr[opt->n_endpoints]);
+    if (err != 0) {
+        fprintf(stderr, "Cannot resolve '%s': %s\n", endpoint,
+                gai_strerror(err));
+        return 0;
+    } /* end if */
+
+    opt->n_endpoints++;
+    return 1;
+} /* end of add_endpoint */
+
+
 /* --------------------------------------------------------------------------
  *  get_options(argc, argv, opt)
  * -------------------------------------------------------------------------- */
@@ -120,17 +306,15 @@ print_usage(const char *progname)
  *               written.
  *
  *  \return      1, if the program options were parsed correctly, and if both
- *               the root dir and the port of the web server have been defined,
+ *               the root dir and an endpoint of the web server have been defined,
  *               0 otherwise.
  */
 static int
 get_options(int argc, char *argv[], prog_options_t *opt)
 {
     int                 c;
-    int                 err;
     int                 success = 1;
     char               *p;
-    struct addrinfo     hints;
 
     p = strrchr(argv[0], '/');
     if(p) {
@@ -149,27 +333,68 @@ get_options(int argc, char *argv[], prog_options_t *opt)
 
     opt->log_filename = NULL;
     opt->root_dir     = NULL;
-    opt->server_addr  = NULL;
+    opt->n_endpoints  =    0;
     opt->verbose      =    0;
     opt->timeout      =  120;
-
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_family = AF_UNSPEC;   /* Allows IPv4 or IPv6 */
-    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    opt->workers      =    0;
+    opt->max_requests =    0;
+    opt->engine       = ENGINE_FORK;
+    opt->reuseport    = false;
+    opt->cpu_affinity = false;
+    opt->file_cache_size = 1024;
+    opt->file_cache_ttl  =   10;
+    opt->memory_cache_size = 16 * 1024 * 1024;
+    opt->memory_cache_max  = 64 * 1024;
+    opt->status_uri        = "/server-status";
+    opt->trace_file        = NULL;
+    opt->trace_sample      = 1;
+    opt->fcgi_pool_size    = 2;
+    opt->fcgi_idle_timeout = 60;
+    opt->gzip_level        = 0;
+    opt->gzip_min_size     = 1024;
+    opt->gzip_cache        = NULL;
+    memset(&opt->listen_opts, 0, sizeof(opt->listen_opts));
+    opt->listen_opts.backlog = 511;
 
     while (success) {
         int option_index = 0;
         static struct option long_options[] = {
             { "file",    required_argument, 0, 'f' },
             { "port",    required_argument, 0, 'p' },
+            { "listen",  required_argument, 0, 'l' },
             { "dir",     required_argument, 0, 'd' },
+            { "workers", required_argument, 0, 'w' },
+            { "max-requests-per-worker",
+                         required_argument, 0, OPT_MAX_REQUESTS },
+            { "reuseport",    no_argument,  0, OPT_REUSEPORT },
+            { "cpu-affinity", no_argument,  0, OPT_CPU_AFFINITY },
+            { "file-cache",     required_argument, 0, OPT_FILE_CACHE },
+            { "file-cache-ttl", required_argument, 0, OPT_FILE_CACHE_TTL },
+            { "memory-cache",     required_argument, 0, OPT_MEMORY_CACHE },
+            { "memory-cache-max", required_argument, 0,
+              OPT_MEMORY_CACHE_MAX },
+            { "status-uri",       required_argument, 0, OPT_STATUS_URI },
+            { "trace",            required_argument, 0, OPT_TRACE },
+            { "trace-sample",     required_argument, 0, OPT_TRACE_SAMPLE },
+            { "fcgi-pool",        required_argument, 0, OPT_FCGI_POOL },
+            { "fcgi-idle",        required_argument, 0, OPT_FCGI_IDLE },
+            { "gzip",             required_argument, 0, OPT_GZIP },
+            { "gzip-min-size",    required_argument, 0, OPT_GZIP_MIN_SIZE },
+            { "gzip-cache",       required_argument, 0, OPT_GZIP_CACHE },
+            { "backlog",          required_argument, 0, OPT_BACKLOG },
+            { "defer-accept",     required_argument, 0, OPT_DEFER_ACCEPT },
+            { "fastopen",         required_argument, 0, OPT_FASTOPEN },
+            { "rcvbuf",           required_argument, 0, OPT_RCVBUF },
+            { "sndbuf",           required_argument, 0, OPT_SNDBUF },
+            { "tcp-nodelay",      no_argument,       0, OPT_TCP_NODELAY },
+            { "engine",  required_argument, 0, 'e' },
+            { "timeout", required_argument, 0, 't' },
             { "verbose", no_argument,       0, 'v' },
             { "debug",   no_argument,       0,  0  },
             { NULL,      0, 0, 0 }
         };
 
-        c = getopt_long(argc, argv, "f:p:d:v", long_options, &option_index);
+        c = getopt_long(argc, argv, "f:p:l:d:w:e:t:v", long_options, &option_index);
         if (c == -1) break;
 
         switch(c) {
@@ -184,19 +409,17 @@ get_options(int argc, char *argv[], prog_options_t *opt)
                 } /* end if */
                 break;
             case 'p':
-                /* 'optarg' contains port number */
-                if((err = getaddrinfo(NULL, optarg, &hints, &opt->server_addr)) != 0) {
-                    fprintf(stderr, "Cannot resolve service '%s': %s\n", optarg, gai_strerror(err));
-                    return EXIT_FAILURE;
+                /* 'optarg' contains port number, the same as ':PORT' */
+                if (strchr(optarg, ':') != NULL) {
+                    fprintf(stderr, "Invalid port '%s'\n", optarg);
+                    success = 0;
+                    break;
+                } /* end if */
+                /* fall through */
+            case 'l':
+                if (!add_endpoint(opt, optarg)) {
+                    success = 0;
                 } /* end if */
-
-                struct servent *pse = getservbyname(optarg, "http");
-                if (pse != 0) {
-                    opt->server_port = ntohs((unsigned short)pse->s_port);
-                }
-                else {
-                    opt->server_port = (unsigned short)atoi(optarg);
-                }
                 break;
             case 'd':
                 /* 'optarg contains root directory */
@@ -208,6 +431,159 @@ get_options(int argc, char *argv[], prog_options_t *opt)
                     return EXIT_FAILURE;
                 } /* end if */
                 break;
+            case 'w':
+                opt->workers = atoi(optarg);
+                if (opt->workers < 0) {
+                    fprintf(stderr, "Invalid number of workers '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_MAX_REQUESTS:
+                opt->max_requests = atoi(optarg);
+                if (opt->max_requests < 0) {
+                    fprintf(stderr, "Invalid request limit '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_REUSEPORT:
+                opt->reuseport = true;
+                break;
+            case OPT_CPU_AFFINITY:
+                opt->cpu_affinity = true;
+                break;
+            case OPT_FILE_CACHE:
+                opt->file_cache_size = atoi(optarg);
+                if (opt->file_cache_size < 0) {
+                    fprintf(stderr, "Invalid cache size '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_FILE_CACHE_TTL:
+                opt->file_cache_ttl = atoi(optarg);
+                if (opt->file_cache_ttl <= 0) {
+                    fprintf(stderr, "Invalid cache ttl '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_MEMORY_CACHE:
+                opt->memory_cache_size = atol(optarg);
+                if (opt->memory_cache_size < 0) {
+                    fprintf(stderr, "Invalid cache size '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_MEMORY_CACHE_MAX:
+                opt->memory_cache_max = atol(optarg);
+                if (opt->memory_cache_max < 0) {
+                    fprintf(stderr, "Invalid file size '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_STATUS_URI:
+                if (optarg[0] != '\0' && optarg[0] != '/') {
+                    fprintf(stderr, "Invalid status URI '%s'\n", optarg);
+                    success = 0;
+                } else {
+                    opt->status_uri = optarg;
+                } /* end if */
+                break;
+            case OPT_TRACE:
+                opt->trace_file = optarg;
+                break;
+            case OPT_TRACE_SAMPLE:
+                opt->trace_sample = atoi(optarg);
+                if (opt->trace_sample <= 0) {
+                    fprintf(stderr, "Invalid sample rate '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_FCGI_POOL:
+                opt->fcgi_pool_size = atoi(optarg);
+                if (opt->fcgi_pool_size < 0) {
+                    fprintf(stderr, "Invalid pool size '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_FCGI_IDLE:
+                opt->fcgi_idle_timeout = atoi(optarg);
+                if (opt->fcgi_idle_timeout < 0) {
+                    fprintf(stderr, "Invalid idle timeout '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_GZIP:
+                opt->gzip_level = atoi(optarg);
+                if (opt->gzip_level < 0 || opt->gzip_level > 9) {
+                    fprintf(stderr, "Invalid compression level '%s'\n",
+                            optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_GZIP_MIN_SIZE:
+                opt->gzip_min_size = atol(optarg);
+                if (opt->gzip_min_size < 0) {
+                    fprintf(stderr, "Invalid size '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_GZIP_CACHE:
+                opt->gzip_cache = optarg;
+                break;
+            case OPT_BACKLOG:
+                opt->listen_opts.backlog = atoi(optarg);
+                if (opt->listen_opts.backlog <= 0) {
+                    fprintf(stderr, "Invalid backlog '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_DEFER_ACCEPT:
+                opt->listen_opts.defer_accept = atoi(optarg);
+                if (opt->listen_opts.defer_accept < 0) {
+                    fprintf(stderr, "Invalid timeout '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_FASTOPEN:
+                opt->listen_opts.fastopen = atoi(optarg);
+                if (opt->listen_opts.fastopen < 0) {
+                    fprintf(stderr, "Invalid queue length '%s'\n", optarg);
+                    success = 0;
+                }
+                break;
+            case OPT_RCVBUF:
+            case OPT_SNDBUF:
+                if (atoi(optarg) < 0) {
+                    fprintf(stderr, "Invalid buffer size '%s'\n", optarg);
+                    success = 0;
+                } else if (c == OPT_RCVBUF) {
+                    opt->listen_opts.rcvbuf = atoi(optarg);
+                } else {
+                    opt->listen_opts.sndbuf = atoi(optarg);
+                } /* end if */
+                break;
+            case OPT_TCP_NODELAY:
+                opt->listen_opts.nodelay = 1;
+                break;
+            case 'e':
+                if (strcmp(optarg, "fork") == 0) {
+                    opt->engine = ENGINE_FORK;
+                } else if (strcmp(optarg, "epoll") == 0) {
+                    opt->engine = ENGINE_EPOLL;
+                } else if (strcmp(optarg, "uring") == 0) {
+                    opt->engine = ENGINE_URING;
+                } else {
+                    fprintf(stderr, "Unknown engine '%s'\n", optarg);
+                    success = 0;
+                } /* end if */
+                break;
+            case 't':
+                if (atoi(optarg) <= 0) {
+                    fprintf(stderr, "Invalid timeout '%s'\n", optarg);
+                    success = 0;
+                } else {
+                    opt->timeout = (unsigned short)atoi(optarg);
+                } /* end if */
+                break;
             case 'v':
                 opt->verbose = 1;
                 break;
@@ -217,7 +593,12 @@ get_options(int argc, char *argv[], prog_options_t *opt)
     } /* end while */
 
     /* check presence of required program parameters */
-    success = success && opt->server_addr && opt->root_dir;
+    success = success && opt->n_endpoints > 0 && opt->root_dir;
+
+    if (success && (opt->reuseport || opt->cpu_affinity) && opt->workers == 0) {
+        fprintf(stderr, "--reuseport and --cpu-affinity require --workers\n");
+        success = 0;
+    } /* end if */
 
     /* additional parameters are silently ignored, otherwise check for
      * ((optind < argc) && success) */
@@ -285,13 +666,17 @@ check_root_dir(prog_options_t *opt)
 /* --------------------------------------------------------------------------
  *  install_signal_handlers()
  * -------------------------------------------------------------------------- */
-/*! \brief Installs signal handlers for SIGINT and SIGCHLD signals.
+/*! \brief Installs signal handlers for SIGINT, SIGTERM and SIGCHLD signals.
  *
  *  If the handlers cannot be installed, the function exits the current process
  *  with return code 1 after writing an error message to stderr.
+ *
+ *  \param opt  The program options.  If a worker pool is used, SIGCHLD is not
+ *              handled, because the master process waits for its workers
+ *              itself.
  */
 static void
-install_signal_handlers(void)
+install_signal_handlers(prog_options_t *opt)
 {
     struct sigaction sa;
 
@@ -303,6 +688,14 @@ install_signal_handlers(void)
         perror("sigaction(SIGINT)");
         exit(EXIT_FAILURE);
     } /* end if */
+    if (sigaction(SIGTERM, &sa, NULL) < 0) {
+        perror("sigaction(SIGTERM)");
+        exit(EXIT_FAILURE);
+    } /* end if */
+
+    if (opt->workers > 0) {
+        return;
+    } /* end if */
 
     struct sigaction sa2;
     sa2.sa_flags = 0;
@@ -315,6 +708,252 @@ install_signal_handlers(void)
 } /* end of install_signal_handlers */
 
 
+/* --------------------------------------------------------------------------
+ *  print_listen_options(sd, opt)
+ * -------------------------------------------------------------------------- */
+/*! \brief Prints the address and the effective options of a listening
+ *         socket.
+ *
+ *  The kernel adjusts some of the requested values (e.g. it doubles the
+ *  buffer sizes and limits the backlog), so they are read back from the
+ *  socket.
+ *
+ *  \param sd   The listening socket.
+ *  \param opt  The program options with the requested values.
+ */
+static void
+print_listen_options(int sd, const prog_options_t *opt)
+{
+    passive_tcp_opts_t eff = opt->listen_opts;
+    struct sockaddr_storage sa;
+    socklen_t sa_len = sizeof(sa);
+    char addr[SOCKET_ADDRSTRLEN];
+    int port, v6only = 1;
+
+    if (get_passive_tcp_opts(sd, &eff) < 0) {
+        return;
+    } /* end if */
+    if (getsockname(sd, (struct sockaddr *)&sa, &sa_len) < 0) {
+        perror("ERROR: getsockname()");
+        return;
+    } /* end if */
+    port = format_socket_addr((struct sockaddr *)&sa, addr, sizeof(addr));
+    if (sa.ss_family == AF_INET6) {
+        sa_len = sizeof(v6only);
+        getsockopt(sd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, &sa_len);
+    } /* end if */
+
+    printf("[%d] Listening on %s%s%s:%d%s: backlog %d, "
+           "TCP_DEFER_ACCEPT %d s, TCP_FASTOPEN %d, SO_RCVBUF %d, "
+           "SO_SNDBUF %d, TCP_NODELAY %s\n", getpid(),
+           (sa.ss_family == AF_INET6) ? "[" : "", addr,
+           (sa.ss_family == AF_INET6) ? "]" : "", port,
+           v6only ? "" : " (IPv4 and IPv6)", eff.backlog, eff.defer_accept,
+           eff.fastopen, eff.rcvbuf, eff.sndbuf, eff.nodelay ? "on" : "off");
+    fflush(stdout);
+} /* end of print_listen_options */
+
+
+/* --------------------------------------------------------------------------
+ *  open_listeners(opt, sd_servers, print)
+ * -------------------------------------------------------------------------- */
+/*! \brief Opens a listening socket for every address of the endpoints.
+ *
+ *  If an endpoint has resolved to IPv4 addresses as well, its IPv6 sockets
+ *  only accept IPv6 clients, so that the sockets of both families can be
+ *  bound to the same port (e.g. for the wildcard addresses "0.0.0.0" and
+ *  "::").  Otherwise, an IPv6 socket is a dual-stack socket which also
+ *  accepts IPv4 clients, unless the system is configured differently.
+ *  Addresses which have already been bound for another endpoint and
+ *  addresses of a family the kernel does not support are skipped.
+ *
+ *  \param opt         The program options.
+ *  \param sd_servers  Receives the listening sockets, up to MAX_LISTENERS.
+ *  \param print       Whether the effective options of the sockets are
+ *                     printed.
+ *
+ *  \return  The number of listening sockets, -1 on error.  Error messages
+ *           are printed.
+ */
+static int
+open_listeners(const prog_options_t *opt, int *sd_servers, bool print)
+{
+    const struct addrinfo *bound[MAX_LISTENERS];
+    const struct addrinfo *ai, *other;
+    passive_tcp_opts_t lopts;
+    char addr[SOCKET_ADDRSTRLEN];
+    int i, k, n = 0;
+
+    for (i = 0; i < opt->n_endpoints; i++) {
+        lopts = opt->listen_opts;
+        lopts.v6only = 0;
+        for (ai = opt->server_addr[i]; ai != NULL; ai = ai->ai_next) {
+            if (ai->ai_family == AF_INET) {
+                lopts.v6only = 1;
+            } /* end if */
+        } /* end for */
+
+        for (ai = opt->server_addr[i]; ai != NULL; ai = ai->ai_next) {
+            for (k = 0; k < n; k++) {
+                other = bound[k];
+                if (other->ai_addrlen == ai->ai_addrlen &&
+                        memcmp(other->ai_addr, ai->ai_addr,
+                               ai->ai_addrlen) == 0) {
+                    break;
+                } /* end if */
+            } /* end for */
+            if (k < n) {
+                continue;       /* a duplicate */
+            } /* end if */
+
+            format_socket_addr(ai->ai_addr, addr, sizeof(addr));
+            if (n == MAX_LISTENERS) {
+                fprintf(stderr, "Too many addresses to listen on, at most "
+                        "%d are supported\n", MAX_LISTENERS);
+                return -1;
+            } /* end if */
+
+            /* passive_tcp prints error messages internally */
+            if ((sd_servers[n] = passive_tcp(ai, &lopts)) < 0) {
+                if (errno == EAFNOSUPPORT) {
+                    if (print) {
+                        printf("Note: the address family of %s is not "
+                               "supported, skipped.\n", addr);
+                    } /* end if */
+                    continue;
+                } /* end if */
+                fprintf(stderr, "Cannot listen on %s\n", addr);
+                return -1;
+            } /* end if */
+            if (print) {
+                print_listen_options(sd_servers[n], opt);
+            } /* end if */
+            bound[n++] = ai;
+        } /* end for */
+    } /* end for */
+
+    if (n == 0) {
+        fprintf(stderr, "No address to listen on\n");
+        return -1;
+    } /* end if */
+    return n;
+} /* end of open_listeners */
+
+
+/* --------------------------------------------------------------------------
+ *  handle_client(sd_client, opt)
+ * -------------------------------------------------------------------------- */
+/*! \brief Reads, processes and answers a single HTTP request.
+ *
+ *  This function is used by both the fork-per-connection mode and the
+ *  pre-forked worker pool.  Once the response has been sent, the writing side
+ *  of the client connection is shut down, but the socket descriptor is not
+ *  closed.
+ *
+ *  \param sd_client  The socket descriptor of the accepted client.
+ *  \param opt        The program options.
+ *
+ *  \return  0 if the request has been answered, -1 on error.  In case of an
+ *           error, a "500 - Internal Server Error" response has been sent to
+ *           the client if possible.
+ */
+static int
+handle_client(int sd_client, prog_options_t *opt)
+{
+    int cnt, status;
+    struct sockaddr_storage sa;
+    socklen_t sasize = sizeof(sa);
+    char client_ip[SOCKET_ADDRSTRLEN], buf[MAX_SIZE_REQUEST];
+    char filename[MAX_SIZE_URI];
+    trace_request_t trace;
+
+    trace_begin(&trace, sd_client, stats_connection_time());
+
+    /* retrieve the client's IP address for logging */
+    cnt = getpeername(sd_client, (struct sockaddr *)&sa, &sasize);
+    if (cnt < 0) {
+        perror("ERROR: getpeername()");
+        send_static_500(sd_client);
+        shutdown(sd_client, SHUT_WR);
+        return -1;
+    }
+    format_socket_addr((struct sockaddr *)&sa, client_ip, sizeof(client_ip));
+    trace_mark(&trace, TRACE_GETPEERNAME);
+
+    /* read until the request header is complete, it may be split across
+     * several segments.  The last byte of the request buffer is reserved for
+     * the terminating '\0' of the logged request line */
+    request_parser_t parser;
+    size_t len = 0;
+    request_parser_init(&parser, 0);
+    while (request_parser_run(&parser, buf, len) == PARSE_INCOMPLETE &&
+            len < MAX_SIZE_REQUEST - 1) {
+        cnt = read_from_socket(sd_client, buf + len,
+                               MAX_SIZE_REQUEST - 1 - len, 0);
+        if (cnt < 0) {
+            perror("ERROR: read_from_socket()");
+            send_static_500(sd_client);
+            shutdown(sd_client, SHUT_WR);
+            return -1;
+        }
+        if (cnt == 0) {
+            break;      /* incomplete, answered with "400 Bad Request" */
+        }
+        len += cnt;
+    }
+    uint64_t start = stats_stage(STATS_STAGE_ACCEPT, stats_connection_time());
+    trace_mark(&trace, TRACE_READ);
+
+    /* parse the request and retrieve the full filepath */
+    request_t req;
+    status = parse_request(&parser, buf, &req);
+    cnt = snprintf(filename, MAX_SIZE_URI, "%s%s", opt->root_dir, req.uri);
+    if (cnt < 0) {
+        fprintf(stderr, "ERROR: sprintf()");
+        send_static_500(sd_client);
+        shutdown(sd_client, SHUT_WR);
+        return -1;
+    }
+
+    start = stats_stage(STATS_STAGE_PARSE, start);
+    trace_mark(&trace, TRACE_PARSE);
+
+    /* generate the HTTP response and send it to the client */
+    response_t res;
+    generate_response_header(filename, status, &req, &res);
+    stats_stage(STATS_STAGE_STAT, start);
+    trace_mark(&trace, TRACE_STAT);
+    res.trace = &trace;
+
+    /* blocking I/O serves a single request per connection */
+    res.keep_alive = FALSE;
+    off_t bytes_sent;
+    if ((bytes_sent = send_response(sd_client, filename, &res)) < 0) {
+        fprintf(stderr, "ERROR: send_response()");
+
+        // this might not work, but we can try.  send_static_500
+        // will handle all further errors.
+        send_static_500(sd_client);
+        shutdown(sd_client, SHUT_WR);
+        release_response(&res);
+        return -1;
+    }
+
+    log_request(client_ip, res.date, request_line(&parser, buf), res.status,
+                bytes_sent);
+    stats_request(res.status, bytes_sent);
+    trace_mark(&trace, TRACE_LOG);
+    trace_end(&trace, request_line(&parser, buf), res.status, bytes_sent);
+    if (opt->verbose) {
+        printf("[%d] Sent %lld bytes with %d system calls.\n", getpid(),
+                (long long)bytes_sent, res.syscalls);
+    }
+    shutdown(sd_client, SHUT_WR);
+    release_response(&res);
+    return 0;
+} /* end of handle_client */
+
+
 int
 main(int argc, char *argv[])
 {
@@ -335,34 +974,105 @@ main(int argc, char *argv[])
     /* do some checks and initialisations... */
     open_logfile(&my_opt);
     check_root_dir(&my_opt);
-    install_signal_handlers();
+    install_signal_handlers(&my_opt);
     init_logging_semaphore();
 
     set_logfile(my_opt.log_fd);
 
+    /* log entries are written by a process of their own, every worker hands
+     * them over through a ring buffer of its own */
+    log_start_writer(my_opt.workers > 0 ? my_opt.workers : 1);
+
+    /* the same goes for the statistics, which are shown on the status page */
+    stats_init(my_opt.workers > 0 ? my_opt.workers : 1, my_opt.status_uri);
+
+    if (my_opt.trace_file != NULL &&
+            trace_init(my_opt.trace_file, my_opt.trace_sample) < 0) {
+        exit(EXIT_FAILURE);
+    } /* end if */
+
+    /* FastCGI scripts are executed as plain CGI scripts if this fails */
+    fcgi_start_manager(my_opt.fcgi_pool_size, my_opt.fcgi_idle_timeout);
+
+    if (gzip_init(my_opt.gzip_level, my_opt.gzip_min_size,
+                  my_opt.gzip_cache) < 0) {
+        printf("Note: gzip compression is not available, only precompressed "
+               "files are sent compressed.\n");
+    } /* end if */
+
+    if (my_opt.engine == ENGINE_URING && !uring_available()) {
+        printf("Note: io_uring is not available, using the fork engine.\n");
+        my_opt.engine = ENGINE_FORK;
+    } /* end if */
+
+    /* a process forked for a single connection would not benefit from the
+     * file cache; every worker sets up its own cache on first use */
+    if (my_opt.workers > 0 || my_opt.engine != ENGINE_FORK) {
+        file_cache_init(my_opt.file_cache_size, my_opt.file_cache_ttl,
+                        my_opt.memory_cache_size, my_opt.memory_cache_max);
+    } /* end if */
+
     /* here, as an example, show how to interact with the condition set by the
      * signal handler above */
     printf("[%d] Starting server '%s'...\n", getpid(), my_opt.progname);
+    fflush(stdout);
     server_running = true;
 
-    /* passive_tcp prints error messages internally */
-    int sd_server = passive_tcp(my_opt.server_port, 5);
-    if (sd_server == -1) {
+    /* one listening socket per address of the endpoints.  With
+     * --reuseport, every worker gets a group of listening sockets of its
+     * own */
+    int i, n_servers = 0, n_groups = my_opt.reuseport ? my_opt.workers : 1;
+    int *sd_servers = (int *)malloc(n_groups * MAX_LISTENERS * sizeof(int));
+    if (sd_servers == NULL) {
+        err_print("cannot allocate memory");
         exit(EXIT_FAILURE);
     }
+    my_opt.listen_opts.reuseport = my_opt.reuseport;
+    for (i = 0; i < n_groups; i++) {
+        n_servers = open_listeners(&my_opt, sd_servers + i * n_servers,
+                                   i == 0);
+        if (n_servers < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < my_opt.n_endpoints; i++) {
+        freeaddrinfo(my_opt.server_addr[i]);
+    }
 
-    while(server_running) {
+    /* blocking accept() calls wait for several listening sockets with
+     * poll(), see accept_client() */
+    if (my_opt.engine == ENGINE_FORK && n_servers > 1) {
+        for (i = 0; i < n_groups * n_servers; i++) {
+            fcntl(sd_servers[i], F_SETFL,
+                  fcntl(sd_servers[i], F_GETFL) | O_NONBLOCK);
+        }
+    }
 
-        int pid;
+    if (my_opt.workers > 0) {
+        printf("[%d] Pre-forking %d worker processes...\n", getpid(),
+                my_opt.workers);
+        if (run_worker_pool(sd_servers, n_servers, n_groups, &my_opt,
+                    handle_client, &server_running) < 0) {
+            retcode = EXIT_FAILURE;
+        }
+    } else if (my_opt.engine == ENGINE_EPOLL) {
+        if (run_event_loop(sd_servers, n_servers, &my_opt,
+                    &server_running) < 0) {
+            retcode = EXIT_FAILURE;
+        }
+    } else if (my_opt.engine == ENGINE_URING) {
+        if (run_uring_loop(sd_servers, n_servers, &my_opt,
+                    &server_running) < 0) {
+            retcode = EXIT_FAILURE;
+        }
+    }
 
-        socklen_t client_sa_len;
-        struct sockaddr_in client_sa;
-        client_sa_len = sizeof(client_sa);
+    while(server_running && my_opt.workers == 0 &&
+            my_opt.engine == ENGINE_FORK) {
 
+        int pid;
 
-        int sd_client = accept(sd_server,
-                (struct sockaddr *)&client_sa,
-                &client_sa_len);
+        int sd_client = accept_client(sd_servers, n_servers);
 
         if (sd_client == -1) {
             if (errno != EINTR) {
@@ -372,6 +1082,8 @@ main(int argc, char *argv[])
         }
         else {
 
+            /* the connection is closed by the child process */
+            stats_connection_open();
             if ((pid = fork()) < 0) {
                 perror("ERROR: fork()");
                 send_static_500(sd_client);
@@ -382,72 +1094,23 @@ main(int argc, char *argv[])
                 close(sd_client);
             }
             else {               /* child process */
-                close(sd_server);
-
-                int cnt, status;
-                struct sockaddr_in sa;
-                socklen_t sasize = sizeof(struct sockaddr_in);
-                char client_ip[20], buf[MAX_SIZE_REQUEST];
-                char filename[MAX_SIZE_URI];
-
-                /* retrieve the client's IP address for logging */
-                cnt = getpeername(sd_client, (struct sockaddr *)&sa, &sasize);
-                if (cnt < 0) {
-                    perror("ERROR: getpeername()");
-                    send_static_500(sd_client);
-                    shutdown(sd_client, SHUT_WR);
-                    exit(EXIT_FAILURE);
-                }
-                client_ip[cnt-1] = '\0';
-                strcpy(client_ip, inet_ntoa(sa.sin_addr));
-
-                /* read the entire request into memory.  The last byte of the
-                 * request buffer filled with a terminating '\0' */
-                cnt = read_from_socket(sd_client, buf, MAX_SIZE_REQUEST-1, 0);
-                if (cnt < 0) {
-                    perror("ERROR: read_from_socket()");
-                    send_static_500(sd_client);
-                    shutdown(sd_client, SHUT_WR);
-                    exit(EXIT_FAILURE);
-                }
-                buf[MAX_SIZE_REQUEST-1] = '\0';
-
-                /* parse the request and retrieve the full filepath */
-                request_t req;
-                status = parse_request(buf, &req);
-                cnt = snprintf(filename, MAX_SIZE_URI, "%s%s",
-                               my_opt.root_dir, req.uri);
-                if (cnt < 0) {
-                    fprintf(stderr, "ERROR: sprintf()");
-                    send_static_500(sd_client);
-                    shutdown(sd_client, SHUT_WR);
-                    exit(EXIT_FAILURE);
+                for (i = 0; i < n_servers; i++) {
+                    close(sd_servers[i]);
                 }
-
-                /* generate the HTTP response and send it to the client */
-                response_t res;
-                generate_response_header(filename, status, &req, &res);
-                if ((cnt = send_response(sd_client, filename, &res)) < 0) {
-                    fprintf(stderr, "ERROR: send_response()");
-
-                    // this might not work, but we can try.  send_static_500
-                    // will handle all further errors.
-                    send_static_500(sd_client);
-                    shutdown(sd_client, SHUT_WR);
-                    exit(EXIT_FAILURE);
-                }
-
-                // in parse_request, we put a '\0' at the end of the first line,
-                // so the use of buf below is "safe"
-                log_request(client_ip, res.date, buf, res.status, cnt);
-                shutdown(sd_client, SHUT_WR);
-                exit(EXIT_SUCCESS);
+                retcode = handle_client(sd_client, &my_opt);
+                stats_connection_close();
+                exit(retcode < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
             }
         }
     } /* end while */
 
+    free(sd_servers);
+    fcgi_stop_manager();
+    gzip_cleanup();
+    log_stop_writer();
+    stats_cleanup();
+    trace_finish();
     fclose(my_opt.log_fd);
     printf("[%d] Good Bye...\n", getpid());
     exit(retcode);
 } /* end of main */
-
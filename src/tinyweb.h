@@ -23,11 +23,23 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "passive_tcp.h"
+
 #define err_print(s)              fprintf(stderr, "ERROR: %s, %s:%d\n", (s), __FILE__, __LINE__)
 
 #define BUFFER_SIZE                      8192
 #define DEFAULT_HTML_PAGE      "default.html"
+#define MAX_LISTENERS                      16   /* listening sockets of a
+                                                   process */
+
 
+/*! \brief The engines which can be used to serve clients. */
+typedef enum server_engine {
+    ENGINE_FORK = 0,    /*!< blocking I/O, one process per connection or per
+                             pre-forked worker */
+    ENGINE_EPOLL,       /*!< non-blocking I/O multiplexed with epoll */
+    ENGINE_URING        /*!< asynchronous I/O submitted to an io_uring */
+} server_engine_t;
 
 /*! \brief The program options accepted by Tinyweb. */
 typedef struct prog_options {
@@ -36,9 +48,43 @@ typedef struct prog_options {
     char            *log_filename; /*!< The filename of the log file        */
     FILE            *log_fd;       /*!< The file descriptor of the log file */
     bool             verbose;      /*!< If more output should be printed    */
-    unsigned short   timeout;      /*!< (not used)                          */
-    struct addrinfo *server_addr;  /*!< The address info for the server     */
-    int              server_port;  /*!< The port, this server serves        */
+    unsigned short   timeout;      /*!< Idle timeout of persistent
+                                        connections in seconds              */
+    struct addrinfo *server_addr[MAX_LISTENERS]; /*!< The resolved
+                                        addresses of every endpoint (-p and
+                                        --listen)                           */
+    int              n_endpoints;  /*!< The number of endpoints             */
+    int              workers;      /*!< Number of pre-forked workers, 0 for
+                                        one process per connection          */
+    int              max_requests; /*!< Connections served by a worker
+                                        before it is recycled, 0 = no limit */
+    server_engine_t  engine;       /*!< The engine used to serve clients    */
+    bool             reuseport;    /*!< One SO_REUSEPORT listening socket
+                                        per worker                          */
+    passive_tcp_opts_t listen_opts; /*!< Backlog and TCP options of the
+                                        listening sockets                   */
+    bool             cpu_affinity; /*!< Pin every worker to its own CPU     */
+    int              file_cache_size; /*!< Maximum number of cached open
+                                        files, 0 disables the cache         */
+    int              file_cache_ttl; /*!< Seconds until a cached file is
+                                        revalidated                         */
+    long             memory_cache_size; /*!< Bytes of small files kept in
+                                        memory, 0 disables                  */
+    long             memory_cache_max; /*!< Largest file kept in memory     */
+    char            *status_uri;   /*!< URI of the status page, "" if
+                                        disabled                            */
+    char            *trace_file;   /*!< Chrome trace of the request stages,
+                                        NULL if disabled                    */
+    int              trace_sample; /*!< Trace every n-th request          */
+    int              fcgi_pool_size; /*!< FastCGI processes per script, 0
+                                        disables the pools                  */
+    int              fcgi_idle_timeout; /*!< Seconds until an idle FastCGI
+                                        pool is terminated                  */
+    int              gzip_level;   /*!< zlib level of on-the-fly
+                                        compression, 0 disables it          */
+    long             gzip_min_size; /*!< Smallest content compressed       */
+    char            *gzip_cache;   /*!< Directory of compressed copies of
+                                        files, NULL for a temporary one     */
 } prog_options_t;
 
 #endif
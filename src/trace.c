@@ -0,0 +1,319 @@
+/*! \file       trace.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Per-request stage timing in the Chrome trace event format.
+ *
+ *  See trace.h for API documentation.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/*! Size of the buffer in which the events of a request are formatted */
+#define TRACE_BUFFER_SIZE   8192
+/*! Maximum length of the request line shown as the name of a request */
+#define TRACE_NAME_MAX      256
+
+static const char *stage_names[TRACE_STAGES] = {
+    "accept", "getpeername", "read", "parse", "stat", "header", "body", "log"
+};
+
+/*! The trace file, -1 if no requests are traced */
+static int trace_fd = -1;
+
+/*! Every sample-th request is traced */
+static unsigned long sample = 1;
+
+/*! The number of requests of all processes, in shared memory */
+static unsigned long *requests = NULL;
+
+/*! The process which created the trace file */
+static pid_t owner = -1;
+
+/* helper functions, defined at the bottom of the file */
+static uint64_t now_ns(void);
+static size_t escape_json(char *dst, size_t size, const char *src);
+static int append_event(char *buf, size_t size, size_t len,
+        const char *name, const char *cat, uint64_t start, uint64_t end,
+        int tid, const char *args);
+
+/* --------------------------------------------------------------------------
+ *  trace_init(filename, sample)
+ * -------------------------------------------------------------------------- */
+/*! \brief Creates the trace file.
+ *
+ *  Must be called by the master process before any other process is forked.
+ *  The file is written in the JSON array format of the trace event format:
+ *  one event per line, each followed by a comma.  Every process appends the
+ *  events of a request with a single write() to the file, which is opened
+ *  with O_APPEND, so the events of different processes are not interleaved.
+ *  The array is closed by trace_finish(); trace viewers also accept a file
+ *  which has not been closed (e.g. while the server is still running).
+ *
+ *  \param filename  The name of the trace file.
+ *  \param rate      Only every rate-th request (of all processes) is traced.
+ *
+ *  \return  0 on success, -1 if the file could not be created.
+ */
+int
+trace_init(const char *filename, int rate) {
+
+    static const char begin[] = "[\n";
+
+    requests = (unsigned long *)mmap(NULL, sizeof(unsigned long),
+                                     PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (requests == MAP_FAILED) {
+        perror("ERROR: mmap() of trace counter");
+        requests = NULL;
+        return -1;
+    }
+
+    /* the descriptor must not be inherited by CGI scripts */
+    trace_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND |
+                    O_CLOEXEC, 0644);
+    if (trace_fd < 0 || write(trace_fd, begin, sizeof(begin) - 1) < 0) {
+        perror("ERROR: Cannot open trace file");
+        if (trace_fd >= 0) {
+            close(trace_fd);
+            trace_fd = -1;
+        }
+        munmap(requests, sizeof(unsigned long));
+        requests = NULL;
+        return -1;
+    }
+
+    sample = (rate > 0) ? (unsigned long)rate : 1;
+    owner  = getpid();
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  trace_finish()
+ * -------------------------------------------------------------------------- */
+/*! \brief Closes the array of events and the trace file.
+ *
+ *  Must be called by the master process after all other processes which may
+ *  trace requests have terminated.  The array is closed with a metadata
+ *  event which names the server process.
+ */
+void
+trace_finish(void) {
+
+    char end[128];
+    int cnt;
+
+    if (trace_fd < 0 || getpid() != owner) {
+        return;
+    }
+
+    cnt = snprintf(end, sizeof(end), "{\"name\":\"process_name\","
+                   "\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"tinyweb\"}}"
+                   "\n]\n", (int)owner);
+    if (cnt > 0 && (size_t)cnt < sizeof(end) && write(trace_fd, end, cnt) < 0) {
+        perror("ERROR: write() to trace file");
+    }
+
+    close(trace_fd);
+    munmap(requests, sizeof(unsigned long));
+    trace_fd = -1;
+    requests = NULL;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  trace_begin(t, tid, accepted)
+ * -------------------------------------------------------------------------- */
+/*! \brief Decides whether a request is traced and starts its timing.
+ *
+ *  If the request is not part of the sample, all other functions have no
+ *  effect on t, so the overhead is a single atomic increment.
+ *
+ *  \param t         The timing of the request.
+ *  \param tid       The row in which the request is shown, e.g. the client
+ *                   socket descriptor.  Concurrent requests of a process
+ *                   must use different rows.
+ *  \param accepted  The CLOCK_MONOTONIC time of the accept() in ns, see
+ *                   stats_connection_time(), or 0 if unknown.  The accept
+ *                   stage lasts until this function is called.
+ */
+void
+trace_begin(trace_request_t *t, int tid, uint64_t accepted) {
+
+    t->sampled = 0;
+    if (trace_fd < 0 ||
+            __atomic_fetch_add(requests, 1, __ATOMIC_RELAXED) % sample != 0) {
+        return;
+    }
+
+    memset(t->start, 0, sizeof(t->start));
+    t->sampled = 1;
+    t->tid     = tid;
+    t->mark    = now_ns();
+    if (accepted != 0 && accepted < t->mark) {
+        t->start[TRACE_ACCEPT] = accepted;
+        t->end[TRACE_ACCEPT]   = t->mark;
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  trace_mark(t, stage)
+ * -------------------------------------------------------------------------- */
+/*! \brief Ends a stage, which started at the end of the previous one.
+ *
+ *  \param t      The timing of the request, may be NULL.
+ *  \param stage  The stage which has been completed.
+ */
+void
+trace_mark(trace_request_t *t, trace_stage_t stage) {
+
+    if (t == NULL || !t->sampled || stage >= TRACE_STAGES) {
+        return;
+    }
+    t->start[stage] = t->mark;
+    t->mark         = now_ns();
+    t->end[stage]   = t->mark;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  trace_end(t, request_line, status, bytes_sent)
+ * -------------------------------------------------------------------------- */
+/*! \brief Writes the events of a traced request to the trace file.
+ *
+ *  \param t             The timing of the request.
+ *  \param request_line  The first line of the request, the name of the
+ *                       request slice.
+ *  \param status        The status of the response.
+ *  \param bytes_sent    The number of bytes sent.
+ */
+void
+trace_end(trace_request_t *t, const char *request_line, http_status_t status,
+        off_t bytes_sent) {
+
+    char buf[TRACE_BUFFER_SIZE], name[TRACE_NAME_MAX * 6 + 1], args[128];
+    uint64_t first = 0;
+    int i, len = 0;
+
+    if (!t->sampled) {
+        return;
+    }
+    t->sampled = 0;
+
+    for (i = 0; i < TRACE_STAGES; i++) {
+        if (t->start[i] != 0 && (first == 0 || t->start[i] < first)) {
+            first = t->start[i];
+        }
+    }
+    if (first == 0) {
+        return;             /* no stage has been completed */
+    }
+
+    escape_json(name, sizeof(name), request_line);
+    snprintf(args, sizeof(args), "{\"status\":%d,\"bytes\":%lld}",
+             http_status_list[status].code, (long long)bytes_sent);
+    len = append_event(buf, sizeof(buf), len, name, "request", first,
+                       t->mark, t->tid, args);
+
+    for (i = 0; i < TRACE_STAGES && len >= 0; i++) {
+        if (t->start[i] != 0) {
+            len = append_event(buf, sizeof(buf), len, stage_names[i],
+                               "stage", t->start[i], t->end[i], t->tid,
+                               NULL);
+        }
+    }
+
+    if (len > 0 && write(trace_fd, buf, len) < 0) {
+        perror("ERROR: write() to trace file");
+    }
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  now_ns()
+ * -------------------------------------------------------------------------- */
+static uint64_t
+now_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  escape_json(dst, size, src)
+ * -------------------------------------------------------------------------- */
+/*! \brief Copies at most TRACE_NAME_MAX characters of a string into a JSON
+ *         string (without the quotes).
+ *
+ *  \return  The length of the escaped string.
+ */
+static size_t
+escape_json(char *dst, size_t size, const char *src) {
+
+    size_t len = 0, n;
+
+    for (n = 0; src[n] != '\0' && n < TRACE_NAME_MAX && len + 7 < size;
+            n++) {
+        unsigned char c = (unsigned char)src[n];
+
+        if (c == '"' || c == '\\') {
+            dst[len++] = '\\';
+            dst[len++] = c;
+        }
+        else if (c < 0x20 || c >= 0x7f) {
+            len += snprintf(dst + len, size - len, "\\u%04x", c);
+        }
+        else {
+            dst[len++] = c;
+        }
+    }
+    dst[len] = '\0';
+    return len;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  append_event(buf, size, len, name, cat, start, end, tid, args)
+ * -------------------------------------------------------------------------- */
+/*! \brief Appends a complete event ("ph":"X") to a buffer.
+ *
+ *  The timestamps are converted to us with ns precision.
+ *
+ *  \return  The new length of the buffer, -1 if it is too small.
+ */
+static int
+append_event(char *buf, size_t size, size_t len, const char *name,
+        const char *cat, uint64_t start, uint64_t end, int tid,
+        const char *args) {
+
+    uint64_t dur = (end > start) ? end - start : 0;
+    int cnt;
+
+    cnt = snprintf(buf + len, size - len,
+                   "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                   "\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%d,"
+                   "\"tid\":%d%s%s},\n",
+                   name, cat,
+                   (unsigned long long)(start / 1000),
+                   (unsigned)(start % 1000),
+                   (unsigned long long)(dur / 1000),
+                   (unsigned)(dur % 1000),
+                   (int)getpid(), tid,
+                   (args != NULL) ? ",\"args\":" : "",
+                   (args != NULL) ? args : "");
+    if (cnt < 0 || (size_t)cnt >= size - len) {
+        return -1;
+    }
+    return len + cnt;
+}
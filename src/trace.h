@@ -0,0 +1,64 @@
+/*! \file       trace.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Per-request stage timing in the Chrome trace event format.
+ *
+ *  A sample of the requests is timed stage by stage (accept, getpeername,
+ *  read, parse, stat, header, body and log) and written to a trace file which
+ *  can be loaded into chrome://tracing or Perfetto.  The event loops (-e
+ *  epoll and -e uring) have no getpeername and read stages: the accept stage
+ *  of the first request of a connection lasts until its header has been
+ *  received, further requests start with the parse stage.
+ *  Every traced request is shown as a slice named after its request line,
+ *  with one nested slice per stage, in a row per process and client socket.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "http.h"
+
+/*! \brief The traced stages of a request. */
+typedef enum {
+    TRACE_ACCEPT = 0,       /*!< from accept() until the process serving the
+                                 connection takes it over */
+    TRACE_GETPEERNAME,      /*!< retrieving the client address */
+    TRACE_READ,             /*!< receiving the request header */
+    TRACE_PARSE,            /*!< parse_request() */
+    TRACE_STAT,             /*!< generate_response_header() */
+    TRACE_HEADER,           /*!< sending the response header */
+    TRACE_BODY,             /*!< sending the file or the CGI output */
+    TRACE_LOG,              /*!< handing the log entry over */
+    TRACE_STAGES
+} trace_stage_t;
+
+/*! \brief The timing of a request. */
+typedef struct {
+    int      sampled;               /*!< whether the request is traced */
+    int      tid;                   /*!< the row of the request */
+    uint64_t mark;                  /*!< end of the last stage, in ns */
+    uint64_t start[TRACE_STAGES];   /*!< start of each stage, 0 if the stage
+                                         has not been reached */
+    uint64_t end[TRACE_STAGES];     /*!< end of each stage */
+} trace_request_t;
+
+int
+trace_init(const char *filename, int sample);
+
+void
+trace_finish(void);
+
+void
+trace_begin(trace_request_t *t, int tid, uint64_t accepted);
+
+void
+trace_mark(trace_request_t *t, trace_stage_t stage);
+
+void
+trace_end(trace_request_t *t, const char *request_line, http_status_t status,
+        off_t bytes_sent);
+
+#endif // _TRACE_H_
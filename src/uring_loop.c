@@ -0,0 +1,1295 @@
+/*! \file       uring_loop.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      io_uring based engine.
+ *
+ *  See uring_loop.h for API documentation.
+ *
+ *  The ring is set up with the raw system calls, so that no additional
+ *  library is required.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+
+#include "uring_loop.h"
+
+#ifndef HAVE_IO_URING
+
+/* --------------------------------------------------------------------------
+ *  uring_available()
+ * -------------------------------------------------------------------------- */
+/*! \brief The io_uring engine has not been compiled in.
+ */
+int
+uring_available(void) {
+
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  run_uring_loop(sd_servers, n_servers, opt, running)
+ * -------------------------------------------------------------------------- */
+/*! \brief The io_uring engine has not been compiled in.
+ */
+int
+run_uring_loop(const int *sd_servers, int n_servers, prog_options_t *opt,
+        volatile sig_atomic_t *running) {
+
+    err_print("io_uring support has not been compiled in");
+    return -1;
+}
+
+#else /* HAVE_IO_URING */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "request.h"
+#include "response.h"
+#include "socket_info.h"
+#include "stats.h"
+#include "trace.h"
+#include "worker.h"
+
+#define RING_ENTRIES        256
+#define PIPE_SIZE           (256 * 1024)
+
+/*! \brief The kinds of operations, stored in the low bits of the user data. */
+typedef enum {
+    OP_RECV = 1,            /*!< receive a request */
+    OP_SEND,                /*!< send the response header (and the cached
+                                 content) */
+    OP_SEND_PART,           /*!< send the header of a part of a
+                                 multipart/byteranges body */
+    OP_SPLICE_IN,           /*!< move a file chunk into the pipe */
+    OP_SPLICE_OUT,          /*!< move the pipe contents to the socket */
+    OP_ACCEPT,              /*!< accept a client (no connection, the index
+                                 of the listener in the upper bits) */
+    OP_TIMER,               /*!< periodic wakeup (no connection) */
+    OP_CANCEL,              /*!< cancellation of an accept (no connection) */
+    OP_CGI                  /*!< wait for the child serving a CGI request */
+} uring_op_t;
+
+/* malloc() aligns connections to 16 bytes, which leaves four bits */
+#define OP_MASK             15
+
+/*! \brief The processing stages of a client connection. */
+typedef enum {
+    CONN_READ = 0,          /*!< waiting for a complete request header */
+    CONN_WRITE,             /*!< sending the response */
+    CONN_CGI                /*!< a child process is serving a CGI request */
+} conn_state_t;
+
+/*! \brief The state of a single client connection. */
+typedef struct connection {
+    int sd;                           /*!< the client socket descriptor */
+    conn_state_t state;               /*!< the current processing stage */
+    int inflight;                     /*!< number of submitted operations */
+    int failed;                       /*!< an operation failed, close */
+    char client_ip[SOCKET_ADDRSTRLEN]; /*!< the client address for logging */
+
+    char buf[MAX_SIZE_REQUEST];       /*!< received data, may contain
+                                           pipelined requests */
+    size_t buf_len;                   /*!< number of bytes in buf */
+    size_t req_start;                 /*!< offset of the next request */
+    request_parser_t parser;          /*!< parser of the next request */
+    const char *request;              /*!< first line of the current request
+                                           for the log, points into buf */
+    request_t req;                    /*!< the parsed current request */
+    response_t res;                   /*!< the response to the request */
+    trace_request_t trace;            /*!< the stage timing of the request */
+
+    char header[MAX_SIZE_HEADER];     /*!< the formatted response header */
+    size_t header_len;                /*!< length of the response header */
+    struct iovec iov[2];              /*!< the header and the cached content,
+                                           referenced by msg */
+    struct msghdr msg;                /*!< the message of the OP_SEND */
+    int fd;                           /*!< the file to send, -1 if none */
+    int part;                         /*!< next part of the body to send */
+    off_t offset;                     /*!< next file offset to splice */
+    off_t remaining;                  /*!< bytes of the current range of the
+                                           file not yet spliced into the
+                                           pipe */
+    int pipe[2];                      /*!< pipe between file and socket */
+    size_t in_pipe;                   /*!< bytes waiting in the pipe */
+    off_t bytes_sent;                 /*!< bytes sent for this response */
+    int cgi_fd;                       /*!< the status pipe of the child serving
+                                           a CGI request, -1 if none */
+    char cgi_status;                  /*!< the status read from cgi_fd */
+    uint64_t stage_start;             /*!< start of the current stage of the
+                                           response; the time of the accept
+                                           until the first request, 0 while
+                                           waiting for another request */
+
+    time_t last_active;               /*!< time of the last I/O activity */
+    struct connection *prev;          /*!< previous connection in the list */
+    struct connection *next;          /*!< next connection in the list */
+} connection_t;
+
+/*! \brief The mapped submission and completion queues of an io_uring. */
+typedef struct {
+    int fd;                           /*!< the io_uring instance */
+    unsigned entries;                 /*!< size of the submission queue */
+    unsigned *sq_head;                /*!< consumed by the kernel */
+    unsigned *sq_tail;                /*!< published to the kernel */
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_local_tail;           /*!< queued, but not yet published */
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;                     /*!< mapping of the submission ring */
+    size_t sq_map_size;
+    void *cq_map;                     /*!< mapping of the completion ring */
+    size_t cq_map_size;
+    size_t sqes_size;                 /*!< size of the mapping of sqes */
+} ring_t;
+
+/*! \brief A listening socket and its pending accept. */
+typedef struct {
+    int sd;                           /*!< the listening socket */
+    int accept_pending;               /*!< an accept has been submitted */
+    struct sockaddr_storage addr;     /*!< peer of the pending accept */
+    socklen_t addr_len;
+} listener_t;
+
+/*! \brief The state of an io_uring loop. */
+typedef struct {
+    ring_t ring;                      /*!< the submission/completion rings */
+    listener_t listeners[MAX_LISTENERS]; /*!< the listening sockets */
+    int n_listeners;                  /*!< number of listening sockets */
+    int accepting;                    /*!< whether new clients are accepted */
+    int accepts_pending;              /*!< number of submitted accepts */
+    int timer_pending;                /*!< the timer has been submitted */
+    struct __kernel_timespec tick;    /*!< period of the timer */
+    int served;                       /*!< number of answered requests */
+    unsigned long enters;             /*!< number of io_uring_enter() calls */
+    prog_options_t *opt;              /*!< the program options */
+    connection_t *conns;              /*!< list of open connections */
+} uring_loop_t;
+
+/* helper functions, defined at the bottom of the file */
+static int ring_init(ring_t *ring, unsigned entries);
+static void ring_exit(ring_t *ring);
+static struct io_uring_sqe *ring_get_sqe(uring_loop_t *loop);
+static int ring_enter(uring_loop_t *loop, unsigned wait_nr);
+static void submit_accept(uring_loop_t *loop, int index);
+static void submit_timer(uring_loop_t *loop);
+static void stop_accepting(uring_loop_t *loop);
+static void handle_completion(uring_loop_t *loop, uint64_t user_data,
+        int res);
+static void handle_accept(uring_loop_t *loop, int index, int res);
+static void conn_advance(uring_loop_t *loop, connection_t *conn);
+static int conn_submit_recv(uring_loop_t *loop, connection_t *conn);
+static int conn_prepare(uring_loop_t *loop, connection_t *conn);
+static int conn_submit_response(uring_loop_t *loop, connection_t *conn);
+static int conn_submit_part(uring_loop_t *loop, connection_t *conn);
+static int conn_submit_splice(uring_loop_t *loop, connection_t *conn);
+static int conn_done(uring_loop_t *loop, connection_t *conn);
+static int conn_serve_cgi(uring_loop_t *loop, connection_t *conn,
+        const char *filename);
+static void conn_close(uring_loop_t *loop, connection_t *conn);
+static void expire_connections(uring_loop_t *loop, time_t now);
+
+/* --------------------------------------------------------------------------
+ *  uring_available()
+ * -------------------------------------------------------------------------- */
+/*! \brief Checks whether the kernel supports the io_uring engine.
+ *
+ *  Creates a small ring and probes for all operations the engine uses.
+ *  io_uring may be missing in older kernels or disabled by the administrator
+ *  (kernel.io_uring_disabled) or by a seccomp filter.
+ *
+ *  \return  1 if the engine can be used, 0 otherwise.
+ */
+int
+uring_available(void) {
+
+    static const int required[] = {
+        IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_SPLICE,
+        IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL, IORING_OP_READ
+    };
+    struct io_uring_params params;
+    struct io_uring_probe *probe;
+    size_t i, probe_size;
+    int fd, ok = 1;
+
+    memset(&params, 0, sizeof(params));
+    if ((fd = syscall(__NR_io_uring_setup, 2, &params)) < 0) {
+        return 0;
+    }
+
+    probe_size = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+    if ((probe = (struct io_uring_probe *)calloc(1, probe_size)) == NULL ||
+            syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+                    probe, 256) < 0) {
+        ok = 0;
+    }
+    for (i = 0; ok && i < sizeof(required) / sizeof(required[0]); i++) {
+        if (required[i] > probe->last_op ||
+                !(probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED)) {
+            ok = 0;
+        }
+    }
+
+    free(probe);
+    close(fd);
+    return ok;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  run_uring_loop(sd_servers, n_servers, opt, running)
+ * -------------------------------------------------------------------------- */
+/*! \brief Accepts and serves clients until the server is stopped.
+ *
+ *  All socket I/O is submitted to an io_uring.  For every response, the
+ *  header is sent and the first chunk of the file is spliced through a pipe to
+ *  the socket by a chain of linked operations, which are submitted together
+ *  with the operations of all other connections by a single io_uring_enter()
+ *  call.  Connections are kept alive as in the epoll engine, idle connections
+ *  are closed after opt->timeout seconds and opt->max_requests limits the
+ *  number of answered requests.  CGI scripts are executed in a forked child
+ *  process which takes over the client connection; a persistent connection
+ *  is handed back when the child has sent the response.  An accept is
+ *  pending on every listening socket at any time.
+ *
+ *  \param sd_servers The listening sockets.
+ *  \param n_servers  The number of listening sockets (up to MAX_LISTENERS).
+ *  \param opt        The program options.
+ *  \param running    As soon as this flag becomes false, all open connections
+ *                    are terminated and the loop returns.
+ *
+ *  \return  0 on a regular shutdown, -1 if the ring could not be set up.
+ */
+int
+run_uring_loop(const int *sd_servers, int n_servers, prog_options_t *opt,
+        volatile sig_atomic_t *running) {
+
+    uring_loop_t loop;
+    struct rlimit rl;
+    unsigned head, tail;
+    int i;
+
+    memset(&loop, 0, sizeof(loop));
+    for (i = 0; i < n_servers; i++) {
+        loop.listeners[i].sd = sd_servers[i];
+    }
+    loop.n_listeners  = n_servers;
+    loop.opt          = opt;
+    loop.accepting    = 1;
+    loop.tick.tv_sec  = 1;
+
+    /* many concurrent connections need many descriptors */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    /* a client closing its connection must not terminate the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (ring_init(&loop.ring, RING_ENTRIES) < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < n_servers; i++) {
+        submit_accept(&loop, i);
+    }
+    submit_timer(&loop);
+
+    while (loop.accepting || loop.accepts_pending > 0 || loop.conns != NULL) {
+
+        /* on shutdown, the pending operations are completed by shutting down
+         * all sockets, so that no buffer is in use when it is released */
+        if (!*running && loop.accepting) {
+            stop_accepting(&loop);
+            expire_connections(&loop, (time_t)-1);
+        }
+
+        if (ring_enter(&loop, 1) < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            perror("ERROR: io_uring_enter()");
+            break;
+        }
+
+        /* process all completions, the handlers queue new submissions which
+         * are sent to the kernel by the next ring_enter() */
+        head = *loop.ring.cq_head;
+        tail = __atomic_load_n(loop.ring.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe =
+                    &loop.ring.cqes[head & *loop.ring.cq_mask];
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+
+            __atomic_store_n(loop.ring.cq_head, ++head, __ATOMIC_RELEASE);
+            handle_completion(&loop, user_data, res);
+            tail = __atomic_load_n(loop.ring.cq_tail, __ATOMIC_ACQUIRE);
+        }
+
+        /* reap the child processes which served CGI requests */
+        while (waitpid(-1, NULL, WNOHANG) > 0);
+    }
+
+    ring_exit(&loop.ring);
+
+    log_cache_stats();
+    if (opt->verbose) {
+        printf("[%d] io_uring loop answered %d requests with %lu "
+               "io_uring_enter() calls.\n", getpid(), loop.served,
+               loop.enters);
+    }
+    return 0;
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  ring_init(ring, entries)
+ * -------------------------------------------------------------------------- */
+/*! \brief Creates an io_uring and maps its queues.
+ */
+static int
+ring_init(ring_t *ring, unsigned entries) {
+
+    struct io_uring_params p;
+    unsigned char *sq, *cq;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+
+    if ((ring->fd = syscall(__NR_io_uring_setup, entries, &p)) < 0) {
+        perror("ERROR: io_uring_setup()");
+        return -1;
+    }
+    fcntl(ring->fd, F_SETFD, FD_CLOEXEC);
+
+    ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = p.cq_off.cqes +
+                        p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        perror("ERROR: mmap() of io_uring");
+        close(ring->fd);
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_map = ring->sq_map;
+    }
+    else {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring->fd, IORING_OFF_SQES);
+    if (ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        perror("ERROR: mmap() of io_uring");
+        if (ring->sqes != MAP_FAILED) {
+            munmap(ring->sqes, ring->sqes_size);
+        }
+        if (ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map) {
+            munmap(ring->cq_map, ring->cq_map_size);
+        }
+        munmap(ring->sq_map, ring->sq_map_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    sq = (unsigned char *)ring->sq_map;
+    cq = (unsigned char *)ring->cq_map;
+    ring->entries  = p.sq_entries;
+    ring->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring->sq_local_tail = *ring->sq_tail;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  ring_exit(ring)
+ * -------------------------------------------------------------------------- */
+/*! \brief Unmaps the queues and closes an io_uring.
+ */
+static void
+ring_exit(ring_t *ring) {
+
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    munmap(ring->sq_map, ring->sq_map_size);
+    close(ring->fd);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  ring_get_sqe(loop)
+ * -------------------------------------------------------------------------- */
+/*! \brief Returns a cleared submission queue entry.
+ *
+ *  If the submission queue is full, the queued entries are submitted first.
+ *
+ *  \return  The entry, NULL if the queue could not be drained.
+ */
+static struct io_uring_sqe *
+ring_get_sqe(uring_loop_t *loop) {
+
+    ring_t *ring = &loop->ring;
+    struct io_uring_sqe *sqe;
+    unsigned index;
+
+    if (ring->sq_local_tail -
+            __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->entries) {
+        ring_enter(loop, 0);
+        if (ring->sq_local_tail -
+                __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+                ring->entries) {
+            return NULL;
+        }
+    }
+
+    index = ring->sq_local_tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  ring_enter(loop, wait_nr)
+ * -------------------------------------------------------------------------- */
+/*! \brief Submits all queued entries and waits for wait_nr completions.
+ *
+ *  \return  The result of io_uring_enter(), errno is set on errors.
+ */
+static int
+ring_enter(uring_loop_t *loop, unsigned wait_nr) {
+
+    ring_t *ring = &loop->ring;
+    unsigned to_submit;
+
+    /* entries the kernel has not consumed yet are submitted again */
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    to_submit = ring->sq_local_tail -
+                __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    loop->enters++;
+    return syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr,
+                   wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  submit_accept(loop, index)
+ * -------------------------------------------------------------------------- */
+/*! \brief Queues the accept of the next client of a listening socket.
+ */
+static void
+submit_accept(uring_loop_t *loop, int index) {
+
+    listener_t *l = &loop->listeners[index];
+    struct io_uring_sqe *sqe;
+
+    if (!loop->accepting || l->accept_pending ||
+            (sqe = ring_get_sqe(loop)) == NULL) {
+        return;
+    }
+
+    l->addr_len       = sizeof(l->addr);
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = l->sd;
+    sqe->addr         = (uintptr_t)&l->addr;
+    sqe->addr2        = (uintptr_t)&l->addr_len;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data    = ((uint64_t)index << 4) | OP_ACCEPT;
+    l->accept_pending = 1;
+    loop->accepts_pending++;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  submit_timer(loop)
+ * -------------------------------------------------------------------------- */
+/*! \brief Queues a timeout, so that the loop wakes up once per second.
+ *
+ *  The periodic wakeup is needed to notice a shutdown request and to expire
+ *  idle connections.
+ */
+static void
+submit_timer(uring_loop_t *loop) {
+
+    struct io_uring_sqe *sqe;
+
+    if (loop->timer_pending || (sqe = ring_get_sqe(loop)) == NULL) {
+        return;
+    }
+
+    sqe->opcode    = IORING_OP_TIMEOUT;
+    sqe->fd        = -1;
+    sqe->addr      = (uintptr_t)&loop->tick;
+    sqe->len       = 1;
+    sqe->user_data = OP_TIMER;
+    loop->timer_pending = 1;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  stop_accepting(loop)
+ * -------------------------------------------------------------------------- */
+/*! \brief Cancels the pending accepts, no further clients are accepted.
+ *
+ *  Used when the request limit of a worker has been reached.  The open
+ *  connections are completed, but not kept alive.
+ */
+static void
+stop_accepting(uring_loop_t *loop) {
+
+    struct io_uring_sqe *sqe;
+    int i;
+
+    if (!loop->accepting) {
+        return;
+    }
+    loop->accepting = 0;
+
+    for (i = 0; i < loop->n_listeners; i++) {
+        if (loop->listeners[i].accept_pending &&
+                (sqe = ring_get_sqe(loop)) != NULL) {
+            sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+            sqe->fd        = -1;
+            sqe->addr      = ((uint64_t)i << 4) | OP_ACCEPT;
+            sqe->user_data = OP_CANCEL;
+        }
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  handle_completion(loop, user_data, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Processes the result of a completed operation.
+ *
+ *  The user data of connection related operations is the address of the
+ *  connection with the operation in its lowest bits.  The next step of a
+ *  connection is taken as soon as all of its operations have completed.
+ */
+static void
+handle_completion(uring_loop_t *loop, uint64_t user_data, int res) {
+
+    connection_t *conn = (connection_t *)(uintptr_t)(user_data & ~OP_MASK);
+    uring_op_t op = (uring_op_t)(user_data & OP_MASK);
+
+    switch (op) {
+        case OP_ACCEPT:
+            handle_accept(loop, (int)(user_data >> 4), res);
+            return;
+        case OP_TIMER:
+            loop->timer_pending = 0;
+            expire_connections(loop, time(NULL));
+            submit_timer(loop);
+            return;
+        case OP_CANCEL:
+            return;
+        case OP_RECV:
+            if (res <= 0) {
+                conn->failed = 1;   /* closed by the client or expired */
+            }
+            else {
+                conn->buf_len += res;
+                conn->last_active = time(NULL);
+            }
+            break;
+        case OP_SEND:
+            if (res < (int)(conn->header_len + conn->res.cached_len)) {
+                conn->failed = 1;
+            }
+            else {
+                conn->bytes_sent += res;
+                conn->stage_start = stats_stage(STATS_STAGE_HEADER,
+                                                conn->stage_start);
+                trace_mark(&conn->trace, TRACE_HEADER);
+            }
+            break;
+        case OP_SEND_PART:
+            if (res < (int)conn->res.parts[conn->part - 1].header_len) {
+                conn->failed = 1;
+            }
+            else {
+                conn->bytes_sent += res;
+                conn->last_active = time(NULL);
+            }
+            break;
+        case OP_SPLICE_IN:
+            /* a short splice cancels the linked OP_SPLICE_OUT, the rest of
+             * the pipe is sent by the next chain */
+            if (res <= 0) {
+                conn->failed = 1;   /* error or truncated file */
+            }
+            else {
+                conn->offset    += res;
+                conn->remaining -= res;
+                conn->in_pipe   += res;
+            }
+            break;
+        case OP_CGI:
+            /* the child reports a complete response of a persistent
+             * connection, it just terminates otherwise */
+            if (res != 1) {
+                conn->failed = 1;
+            }
+            else {
+                conn->last_active = time(NULL);
+            }
+            break;
+        case OP_SPLICE_OUT:
+            if (res > 0) {
+                conn->in_pipe    -= res;
+                conn->bytes_sent += res;
+                conn->last_active = time(NULL);
+            }
+            else if (res != -ECANCELED) {
+                conn->failed = 1;
+            }
+            break;
+        default:
+            return;
+    }
+
+    if (--conn->inflight == 0) {
+        conn_advance(loop, conn);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  handle_accept(loop, index, res)
+ * -------------------------------------------------------------------------- */
+/*! \brief Sets up a client accepted on a listening socket and queues the
+ *         next accept of this socket.
+ */
+static void
+handle_accept(uring_loop_t *loop, int index, int res) {
+
+    listener_t *l = &loop->listeners[index];
+    connection_t *conn;
+
+    l->accept_pending = 0;
+    loop->accepts_pending--;
+
+    if (res < 0) {
+        if (res != -ECANCELED && res != -EINTR && res != -ECONNABORTED &&
+                res != -EAGAIN) {
+            errno = -res;
+            perror("ERROR: accept()");
+        }
+        submit_accept(loop, index);
+        return;
+    }
+
+    worker_count_accept();
+
+    if ((conn = (connection_t *)calloc(1, sizeof(connection_t))) == NULL) {
+        err_print("cannot allocate memory");
+        close(res);
+        submit_accept(loop, index);
+        return;
+    }
+
+    conn->sd      = res;
+    conn->fd      = -1;
+    conn->cgi_fd  = -1;
+    conn->pipe[0] = conn->pipe[1] = -1;
+    request_parser_init(&conn->parser, 0);
+    conn->state   = CONN_READ;
+    conn->last_active = time(NULL);
+    conn->stage_start = stats_connection_open();
+    format_socket_addr((struct sockaddr *)&l->addr, conn->client_ip,
+                       sizeof(conn->client_ip));
+
+    conn->next = loop->conns;
+    if (loop->conns != NULL) {
+        loop->conns->prev = conn;
+    }
+    loop->conns = conn;
+
+    submit_accept(loop, index);
+    conn_advance(loop, conn);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_advance(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Takes the next step of a connection without pending operations.
+ */
+static void
+conn_advance(uring_loop_t *loop, connection_t *conn) {
+
+    if (conn->failed) {
+        conn_close(loop, conn);
+        return;
+    }
+
+    if (conn->state == CONN_WRITE) {
+        if (conn->in_pipe > 0 || conn->remaining > 0) {
+            if (conn_submit_splice(loop, conn) < 0) {
+                conn_close(loop, conn);
+            }
+            return;
+        }
+        if (conn->fd >= 0 && conn->part < conn->res.n_parts) {
+            if (conn_submit_part(loop, conn) < 0) {
+                conn_close(loop, conn);
+            }
+            return;
+        }
+        if (conn_done(loop, conn) < 0) {
+            return;                 /* closed */
+        }
+    }
+
+    /* the child which served a CGI request has handed the connection back */
+    if (conn->state == CONN_CGI) {
+        close(conn->cgi_fd);
+        conn->cgi_fd = -1;
+        release_response(&conn->res);
+        conn->stage_start = 0;
+        conn->state       = CONN_READ;
+    }
+
+    /* CONN_READ: a request may already be buffered behind the last one, the
+     * parser only scans the newly received bytes */
+    if (request_parser_run(&conn->parser, conn->buf, conn->buf_len) ==
+            PARSE_INCOMPLETE && conn->req_start > 0) {
+
+        /* make room by moving the incomplete request to the front, the
+         * previous requests have been answered */
+        conn->buf_len -= conn->req_start;
+        memmove(conn->buf, conn->buf + conn->req_start, conn->buf_len);
+        conn->req_start = 0;
+        request_parser_init(&conn->parser, 0);
+        request_parser_run(&conn->parser, conn->buf, conn->buf_len);
+    }
+    if (conn->parser.result == PARSE_INCOMPLETE &&
+            conn->buf_len < MAX_SIZE_REQUEST - 1) {
+        if (conn_submit_recv(loop, conn) < 0) {
+            conn_close(loop, conn);
+        }
+        return;
+    }
+
+    if (conn_prepare(loop, conn) < 0 ||
+            (conn->state != CONN_CGI &&
+             conn_submit_response(loop, conn) < 0)) {
+        conn_close(loop, conn);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_submit_recv(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Queues the receipt of (more of) a request header.
+ */
+static int
+conn_submit_recv(uring_loop_t *loop, connection_t *conn) {
+
+    struct io_uring_sqe *sqe = ring_get_sqe(loop);
+
+    if (sqe == NULL) {
+        return -1;
+    }
+
+    conn->state    = CONN_READ;
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = conn->sd;
+    sqe->addr      = (uintptr_t)(conn->buf + conn->buf_len);
+    sqe->len       = MAX_SIZE_REQUEST - 1 - conn->buf_len;
+    sqe->user_data = (uintptr_t)conn | OP_RECV;
+    conn->inflight++;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_prepare(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Interprets the parsed request and prepares the response.
+ *
+ *  The request stays in the receive buffer until the response has been sent,
+ *  the parser continues with a pipelined request behind it.  CGI requests are
+ *  handed over to a child process.
+ *
+ *  \return  0 if the response is ready to be sent or if a child process
+ *           serves the request (the state is CONN_CGI in this case), -1 if
+ *           the connection has to be closed.
+ */
+static int
+conn_prepare(uring_loop_t *loop, connection_t *conn) {
+
+    char filename[MAX_SIZE_URI];
+    http_status_t status;
+    int cnt;
+    uint64_t start = stats_stage(STATS_STAGE_ACCEPT, conn->stage_start);
+
+    /* the accept stage of the first request includes receiving it */
+    trace_begin(&conn->trace, conn->sd, conn->stage_start);
+
+    status = parse_request(&conn->parser, conn->buf, &conn->req);
+    conn->request   = request_line(&conn->parser, conn->buf);
+    conn->req_start = (conn->parser.result == PARSE_DONE) ? conn->parser.end
+                                                          : conn->buf_len;
+    request_parser_init(&conn->parser, conn->req_start);
+
+    /* after a malformed request, the rest of the stream cannot be trusted */
+    if (status == HTTP_STATUS_BAD_REQUEST ||
+            status == HTTP_STATUS_NOT_IMPLEMENTED || !loop->accepting) {
+        conn->req.keep_alive = FALSE;
+    }
+
+    cnt = snprintf(filename, MAX_SIZE_URI, "%s%s", loop->opt->root_dir,
+                   conn->req.uri);
+    if (cnt < 0) {
+        status = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    }
+    start = stats_stage(STATS_STAGE_PARSE, start);
+    trace_mark(&conn->trace, TRACE_PARSE);
+
+    generate_response_header(filename, status, &conn->req, &conn->res);
+    conn->stage_start = stats_stage(STATS_STAGE_STAT, start);
+    trace_mark(&conn->trace, TRACE_STAT);
+    conn->res.trace = &conn->trace;
+
+    if (response_has_body(&conn->res)) {
+        if (conn->res.is_cgi) {
+            return conn_serve_cgi(loop, conn, filename);
+        }
+
+        /* the descriptor belongs to the file cache, cached content is sent
+         * together with the header */
+        if (conn->res.cached != NULL) {
+            conn->fd = -1;
+        }
+        else if ((conn->fd = conn->res.file->fd) < 0) {
+            conn->res.status     = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+            conn->res.keep_alive = FALSE;
+        }
+        else {
+            conn->part      = 0;
+            conn->remaining = 0;
+        }
+    }
+
+    cnt = format_response_header(&conn->res, conn->header,
+                                 sizeof(conn->header));
+    if (cnt < 0) {
+        return -1;
+    }
+    conn->header_len = cnt;
+    conn->bytes_sent = 0;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_submit_response(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Queues the response header, linked to the first part of the body.
+ *
+ *  Pre-rendered content from the file cache is part of the same message.
+ */
+static int
+conn_submit_response(uring_loop_t *loop, connection_t *conn) {
+
+    struct io_uring_sqe *sqe = ring_get_sqe(loop);
+    int has_body = (conn->fd >= 0 && conn->res.content_length > 0);
+
+    if (sqe == NULL) {
+        return -1;
+    }
+
+    conn->iov[0].iov_base = conn->header;
+    conn->iov[0].iov_len  = conn->header_len;
+    conn->iov[1].iov_base = (void *)conn->res.cached;
+    conn->iov[1].iov_len  = conn->res.cached_len;
+    memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov     = conn->iov;
+    conn->msg.msg_iovlen  = (conn->res.cached_len > 0) ? 2 : 1;
+
+    /* MSG_WAITALL: a short send would break the chain, the header and the
+     * beginning of the file should share a segment */
+    conn->state    = CONN_WRITE;
+    sqe->opcode    = IORING_OP_SENDMSG;
+    sqe->fd        = conn->sd;
+    sqe->addr      = (uintptr_t)&conn->msg;
+    sqe->len       = 1;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL | (has_body ? MSG_MORE : 0);
+    sqe->user_data = (uintptr_t)conn | OP_SEND;
+    conn->inflight++;
+    conn->res.syscalls++;
+
+    if (has_body) {
+        sqe->flags |= IOSQE_IO_LINK;
+        return conn_submit_part(loop, conn);
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_submit_part(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Queues the next part of the body.
+ *
+ *  The header of a part of a multipart/byteranges body is sent first, linked
+ *  to the first chunk of its range of the file.  Every part has a header or
+ *  a range, the body of an empty file is not sent.
+ */
+static int
+conn_submit_part(uring_loop_t *loop, connection_t *conn) {
+
+    const body_part_t *part = &conn->res.parts[conn->part++];
+    struct io_uring_sqe *sqe;
+
+    conn->offset    = part->begin;
+    conn->remaining = part->length;
+
+    if (part->header_len > 0) {
+        if ((sqe = ring_get_sqe(loop)) == NULL) {
+            return -1;
+        }
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = conn->sd;
+        sqe->addr      = (uintptr_t)part->header;
+        sqe->len       = part->header_len;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL |
+                         (conn->part < conn->res.n_parts ? MSG_MORE : 0);
+        sqe->user_data = (uintptr_t)conn | OP_SEND_PART;
+        conn->inflight++;
+        conn->res.syscalls++;
+        if (conn->remaining == 0) {
+            return 0;
+        }
+        sqe->flags |= IOSQE_IO_LINK;
+    }
+    return conn_submit_splice(loop, conn);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_submit_splice(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Queues the transfer of the next file chunk through the pipe.
+ *
+ *  A chunk is spliced from the file into the pipe and, linked to it, from the
+ *  pipe to the socket.  Data left in the pipe by a short transfer is sent
+ *  first.
+ */
+static int
+conn_submit_splice(uring_loop_t *loop, connection_t *conn) {
+
+    struct io_uring_sqe *sqe;
+    size_t len;
+    off_t more;
+    int size;
+
+    if (conn->pipe[0] < 0) {
+        if (pipe2(conn->pipe, O_CLOEXEC) < 0) {
+            perror("ERROR: pipe2()");
+            return -1;
+        }
+        /* fewer, larger chunks; the default capacity is 64 KiB */
+        fcntl(conn->pipe[1], F_SETPIPE_SZ, PIPE_SIZE);
+    }
+    size = fcntl(conn->pipe[1], F_GETPIPE_SZ);
+    if (size <= 0) {
+        size = 65536;
+    }
+
+    if (conn->in_pipe == 0) {
+        if ((sqe = ring_get_sqe(loop)) == NULL) {
+            return -1;
+        }
+        len = (conn->remaining < size) ? (size_t)conn->remaining
+                                       : (size_t)size;
+        sqe->opcode        = IORING_OP_SPLICE;
+        sqe->flags         = IOSQE_IO_LINK;
+        sqe->splice_fd_in  = conn->fd;
+        sqe->splice_off_in = conn->offset;
+        sqe->fd            = conn->pipe[1];
+        sqe->off           = (uint64_t)-1;
+        sqe->len           = len;
+        sqe->user_data     = (uintptr_t)conn | OP_SPLICE_IN;
+        conn->inflight++;
+        conn->res.syscalls++;
+        more = conn->remaining - len;
+    }
+    else {
+        len  = conn->in_pipe;
+        more = conn->remaining;
+    }
+
+    if ((sqe = ring_get_sqe(loop)) == NULL) {
+        return -1;
+    }
+    sqe->opcode        = IORING_OP_SPLICE;
+    sqe->splice_fd_in  = conn->pipe[0];
+    sqe->splice_off_in = (uint64_t)-1;
+    sqe->fd            = conn->sd;
+    sqe->off           = (uint64_t)-1;
+    sqe->len           = len;
+    sqe->splice_flags  = (more > 0 || conn->part < conn->res.n_parts)
+                         ? SPLICE_F_MORE : 0;
+    sqe->user_data     = (uintptr_t)conn | OP_SPLICE_OUT;
+    conn->inflight++;
+    conn->res.syscalls++;
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_done(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Logs the completed request and prepares for the next one.
+ *
+ *  \return  0 if the connection is kept alive, -1 if it has been closed.
+ */
+static int
+conn_done(uring_loop_t *loop, connection_t *conn) {
+
+    if (conn->fd >= 0) {
+        stats_stage(STATS_STAGE_BODY, conn->stage_start);
+        trace_mark(&conn->trace, TRACE_BODY);
+    }
+    log_request(conn->client_ip, conn->res.date, conn->request,
+                conn->res.status, conn->bytes_sent);
+    stats_request(conn->res.status, conn->bytes_sent);
+    trace_mark(&conn->trace, TRACE_LOG);
+    trace_end(&conn->trace, conn->request, conn->res.status,
+              conn->bytes_sent);
+    conn->stage_start = 0;
+    if (loop->opt->verbose) {
+        printf("[%d] Sent %lld bytes with %d io_uring operations.\n",
+                getpid(), (long long)conn->bytes_sent, conn->res.syscalls);
+    }
+
+    release_response(&conn->res);
+    conn->fd    = -1;
+    conn->state = CONN_READ;
+
+    loop->served++;
+    if (loop->opt->max_requests > 0 &&
+            loop->served >= loop->opt->max_requests) {
+        stop_accepting(loop);
+    }
+
+    if (!conn->res.keep_alive) {
+        shutdown(conn->sd, SHUT_WR);
+        conn_close(loop, conn);
+        return -1;
+    }
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_serve_cgi(loop, conn, filename)
+ * -------------------------------------------------------------------------- */
+/*! \brief Hands a CGI request over to a forked child process.
+ *
+ *  The child process executes the script with the blocking send_response()
+ *  and terminates afterwards.  If the connection is kept alive, the child
+ *  reports through a pipe whether the response has been sent completely, a
+ *  read of the pipe is queued.
+ *
+ *  \return  0 if the loop waits for the child, -1 if the connection has to be
+ *           closed.
+ */
+static int
+conn_serve_cgi(uring_loop_t *loop, connection_t *conn, const char *filename) {
+
+    struct io_uring_sqe *sqe;
+    connection_t *other;
+    int i, status[2] = { -1, -1 };
+    off_t cnt;
+    pid_t pid;
+
+    if (conn->res.keep_alive && pipe2(status, O_CLOEXEC) < 0) {
+        perror("ERROR: pipe2() for CGI script");
+        conn->res.keep_alive = FALSE;
+    }
+
+    if ((pid = fork()) < 0) {
+        perror("ERROR: fork() for CGI script");
+        send_static_500(conn->sd);
+        if (status[0] >= 0) {
+            close(status[0]);
+            close(status[1]);
+        }
+        return -1;
+    }
+    else if (pid > 0) {
+        if (status[0] < 0) {
+            return -1;
+        }
+        close(status[1]);
+        conn->cgi_fd = status[0];
+
+        if ((sqe = ring_get_sqe(loop)) == NULL) {
+            return -1;
+        }
+        conn->state    = CONN_CGI;
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = conn->cgi_fd;
+        sqe->off       = (uint64_t)-1;
+        sqe->addr      = (uintptr_t)&conn->cgi_status;
+        sqe->len       = 1;
+        sqe->user_data = (uintptr_t)conn | OP_CGI;
+        conn->inflight++;
+        return 0;
+    }
+
+    /* child process: only the CGI connection is kept */
+    for (other = loop->conns; other != NULL; other = other->next) {
+        if (other != conn) {
+            close(other->sd);
+            if (other->cgi_fd >= 0) {
+                close(other->cgi_fd);
+            }
+        }
+    }
+    close(loop->ring.fd);
+    for (i = 0; i < loop->n_listeners; i++) {
+        close(loop->listeners[i].sd);
+    }
+    if (status[0] >= 0) {
+        close(status[0]);
+    }
+
+    signal(SIGPIPE, SIG_DFL);
+
+    if ((cnt = send_response(conn->sd, filename, &conn->res)) < 0) {
+        send_static_500(conn->sd);
+        shutdown(conn->sd, SHUT_WR);
+        exit(EXIT_FAILURE);
+    }
+
+    log_request(conn->client_ip, conn->res.date, conn->request,
+                conn->res.status, cnt);
+    stats_request(conn->res.status, cnt);
+    trace_mark(&conn->trace, TRACE_LOG);
+    trace_end(&conn->trace, conn->request, conn->res.status, cnt);
+
+    if (conn->res.keep_alive) {
+        signal(SIGPIPE, SIG_IGN);
+        if (write(status[1], "1", 1) == 1) {
+            exit(EXIT_SUCCESS);
+        }
+    }
+    shutdown(conn->sd, SHUT_WR);
+    exit(EXIT_SUCCESS);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  conn_close(loop, conn)
+ * -------------------------------------------------------------------------- */
+/*! \brief Closes a connection and releases all of its resources.
+ *
+ *  Must only be called when no operation of the connection is pending.
+ */
+static void
+conn_close(uring_loop_t *loop, connection_t *conn) {
+
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    }
+    else {
+        loop->conns = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+
+    close(conn->sd);
+    if (conn->cgi_fd >= 0) {
+        close(conn->cgi_fd);
+    }
+    release_response(&conn->res);
+    if (conn->pipe[0] >= 0) {
+        close(conn->pipe[0]);
+        close(conn->pipe[1]);
+    }
+    free(conn);
+    stats_connection_close();
+}
+
+
+/* --------------------------------------------------------------------------
+ *  expire_connections(loop, now)
+ * -------------------------------------------------------------------------- */
+/*! \brief Terminates all connections which were idle for opt->timeout seconds.
+ *
+ *  The pending receive of an idle connection completes when the socket is
+ *  shut down, the connection is closed afterwards.  A connection served by a
+ *  CGI child process is not idle.  If now is (time_t)-1, all connections are
+ *  terminated; the child of a CGI connection fails and terminates as well.
+ */
+static void
+expire_connections(uring_loop_t *loop, time_t now) {
+
+    connection_t *conn;
+
+    for (conn = loop->conns; conn != NULL; conn = conn->next) {
+        if (now == (time_t)-1 || (conn->state != CONN_CGI &&
+                now - conn->last_active >= loop->opt->timeout)) {
+            shutdown(conn->sd, SHUT_RDWR);
+        }
+    }
+}
+
+#endif /* HAVE_IO_URING */
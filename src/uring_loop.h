@@ -0,0 +1,32 @@
+/*! \file       uring_loop.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      io_uring based engine.
+ *
+ *  This module provides run_uring_loop(), an engine which performs all client
+ *  I/O (accept, receive, sending the header and splicing the file to the
+ *  socket) through an io_uring submission queue.  The operations of a
+ *  response are linked and submitted together, so a typical request needs
+ *  only a few io_uring_enter() calls instead of one system call per step.
+ *
+ *  The engine is only compiled in if HAVE_IO_URING is defined (make
+ *  IO_URING=1).  uring_available() tells at runtime whether the kernel
+ *  supports all required operations; if not, the server falls back to the
+ *  fork engine.
+ */
+
+#ifndef _URING_LOOP_H_
+#define _URING_LOOP_H_
+
+#include <signal.h>
+
+#include "tinyweb.h"
+
+int
+uring_available(void);
+
+int
+run_uring_loop(const int *sd_servers, int n_servers, prog_options_t *opt,
+        volatile sig_atomic_t *running);
+
+#endif // _URING_LOOP_H_
@@ -0,0 +1,435 @@
+/*! \file       worker.c
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Pre-forked worker process pool.
+ *
+ *  See worker.h for API documentation.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+#include "log.h"
+#include "stats.h"
+#include "uring_loop.h"
+
+#include "worker.h"
+
+/*! Number of accepted connections per worker slot, shared between the
+ *  master and all workers.  Respawned workers continue the count of their
+ *  slot. */
+static unsigned long *accept_counts = NULL;
+
+/*! The pool slot of the current process, -1 in the master process */
+static int worker_slot = -1;
+
+/* helper functions, defined at the bottom of the file */
+static pid_t spawn_worker(int slot, const int *sd_servers, int n_servers,
+        int n_groups, prog_options_t *opt, client_handler_t handler,
+        volatile sig_atomic_t *running);
+static void worker_loop(int slot, const int *sd_servers, int n_servers,
+        prog_options_t *opt, client_handler_t handler,
+        volatile sig_atomic_t *running);
+static void pin_to_cpu(int slot, prog_options_t *opt);
+static void print_accept_counts(prog_options_t *opt);
+
+/* --------------------------------------------------------------------------
+ *  run_worker_pool(sd_servers, n_servers, n_groups, opt, handler, running)
+ * -------------------------------------------------------------------------- */
+/*! \brief Starts the worker processes and supervises them.
+ *
+ *  The calling process becomes the master of the pool.  It forks opt->workers
+ *  worker processes which accept clients, either with blocking accept() calls
+ *  or, if opt->engine is ENGINE_EPOLL or ENGINE_URING, in their own event
+ *  loop.  The listening sockets come in n_groups groups of n_servers sockets
+ *  (one per address the server listens on), worker i listens on the sockets
+ *  of group i % n_groups: with a single group, all workers share the accept
+ *  queues, with one group of SO_REUSEPORT sockets per worker, the kernel
+ *  distributes the connections among the workers.  The master keeps all
+ *  listening sockets open, so that connections queued for a worker are not
+ *  lost when it is respawned.
+ *
+ *  If opt->cpu_affinity is set, worker i is pinned to the i-th CPU the server
+ *  may run on (modulo the number of CPUs).  The number of connections accepted
+ *  by each worker is printed when the pool is shut down.
+ *
+ *  Whenever a worker terminates (because it crashed or because it reached the
+ *  limit of opt->max_requests served requests), a new worker is forked into
+ *  its slot; if fork() fails, the slot is retried once per second.  As soon
+ *  as *running becomes false, the workers are terminated with SIGTERM and
+ *  this function returns after all of them have been reaped.
+ *
+ *  The SIGCHLD signal must not be handled by a reaping signal handler while
+ *  this function runs, because the master needs the exit status of its
+ *  workers to respawn them.
+ *
+ *  \param sd_servers The listening sockets, n_groups * n_servers of them.
+ *  \param n_servers  The number of listening sockets of a group.
+ *  \param n_groups   The number of groups, either 1 or opt->workers.
+ *  \param opt        The program options.  The fields workers, max_requests
+ *                    and cpu_affinity configure the pool.
+ *  \param handler    The function which serves a single client connection
+ *                    with blocking I/O (not used by the event loops).
+ *  \param running    The server stops as soon as this flag becomes false.  It
+ *                    is usually cleared by a signal handler.
+ *
+ *  \return  0 on a regular shutdown, -1 if the pool could not be started.
+ */
+int
+run_worker_pool(const int *sd_servers, int n_servers, int n_groups,
+        prog_options_t *opt, client_handler_t handler,
+        volatile sig_atomic_t *running) {
+
+    int i, status, vacant, spawn_failed = 0;
+    pid_t pid;
+    pid_t *workers = (pid_t *)calloc(opt->workers, sizeof(pid_t));
+
+    if (workers == NULL) {
+        err_print("cannot allocate memory");
+        return -1;
+    }
+
+    accept_counts = (unsigned long *)mmap(NULL,
+            opt->workers * sizeof(unsigned long), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (accept_counts == MAP_FAILED) {
+        perror("ERROR: mmap() of accept counters");
+        free(workers);
+        return -1;
+    }
+
+    for (i = 0; i < opt->workers; i++) {
+        workers[i] = spawn_worker(i, sd_servers, n_servers, n_groups, opt,
+                                  handler, running);
+        if (workers[i] < 0) {
+            spawn_failed = 1;
+            *running = 0;   /* terminate the workers started so far */
+            break;
+        }
+    }
+
+    while (*running) {
+
+        /* a slot whose worker could not be respawned is retried once per
+         * second, meanwhile terminated workers are reaped without
+         * blocking */
+        vacant = 0;
+        for (i = 0; i < opt->workers; i++) {
+            if (workers[i] < 0) {
+                workers[i] = spawn_worker(i, sd_servers, n_servers, n_groups,
+                                          opt, handler, running);
+                vacant = vacant || workers[i] < 0;
+            }
+        }
+
+        /* waitpid() is interrupted by SIGINT, so the loop condition is
+         * re-evaluated when the server is about to be terminated */
+        if ((pid = waitpid(-1, &status, vacant ? WNOHANG : 0)) <= 0) {
+            if (pid == 0) {
+                sleep(1);
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("ERROR: waitpid()");
+            break;
+        }
+
+        for (i = 0; i < opt->workers && workers[i] != pid; i++);
+        if (i == opt->workers) {
+            continue;           /* not one of our workers */
+        }
+        workers[i] = 0;
+
+        if (opt->verbose) {
+            printf("[%d] Worker %d (pid %d) finished with status %d.\n",
+                    getpid(), i, pid, WIFEXITED(status) ? WEXITSTATUS(status)
+                                                        : -WTERMSIG(status));
+        }
+
+        if (*running) {
+            /* throttle respawning if the worker did not exit regularly, a
+             * worker which crashes immediately would otherwise keep the
+             * master busy forking */
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                sleep(1);
+            }
+            workers[i] = spawn_worker(i, sd_servers, n_servers, n_groups,
+                                      opt, handler, running);
+            if (workers[i] < 0) {
+                fprintf(stderr, "[%d] Worker %d could not be respawned, "
+                        "retrying.\n", getpid(), i);
+            }
+        }
+    }
+
+    /* graceful shutdown: workers finish the request they are serving */
+    for (i = 0; i < opt->workers; i++) {
+        if (workers[i] > 0) {
+            kill(workers[i], SIGTERM);
+        }
+    }
+    for (i = 0; i < opt->workers; i++) {
+        /* only the workers, other children (the log writer) are not
+         * terminated yet */
+        while (workers[i] > 0 && waitpid(workers[i], NULL, 0) < 0 &&
+                errno == EINTR);
+    }
+
+    print_accept_counts(opt);
+    munmap(accept_counts, opt->workers * sizeof(unsigned long));
+    accept_counts = NULL;
+
+    free(workers);
+    return spawn_failed ? -1 : 0;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  worker_count_accept()
+ * -------------------------------------------------------------------------- */
+/*! \brief Counts an accepted connection for the current worker.
+ *
+ *  Must be called by the engines for every accepted client.  Outside of a
+ *  worker process, this function has no effect.
+ */
+void
+worker_count_accept(void) {
+
+    if (worker_slot >= 0) {
+        __atomic_fetch_add(&accept_counts[worker_slot], 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  accept_client(sd_servers, n_servers)
+ * -------------------------------------------------------------------------- */
+/*! \brief Waits for a client on any of the listening sockets and accepts it.
+ *
+ *  A single listening socket is accepted on directly.  Several listening
+ *  sockets are multiplexed with poll(), they have to be non-blocking, so that
+ *  a client accepted by another process in the meantime does not block the
+ *  caller.  The sockets are served round-robin when clients are pending on
+ *  several of them.
+ *
+ *  \param sd_servers The listening sockets.
+ *  \param n_servers  The number of listening sockets (up to MAX_LISTENERS).
+ *
+ *  \return  The socket descriptor of the client, -1 on error (errno is set,
+ *           EINTR if a signal has been caught).
+ */
+int
+accept_client(const int *sd_servers, int n_servers) {
+
+    static int next = 0;
+    struct pollfd fds[MAX_LISTENERS];
+    int i, k, sd;
+
+    if (n_servers == 1) {
+        return accept(sd_servers[0], NULL, NULL);
+    }
+
+    for (i = 0; i < n_servers; i++) {
+        fds[i].fd     = sd_servers[i];
+        fds[i].events = POLLIN;
+    }
+
+    for (;;) {
+        if (poll(fds, n_servers, -1) < 0) {
+            return -1;
+        }
+
+        for (i = 0; i < n_servers; i++) {
+            k = (next + i) % n_servers;
+            if (!(fds[k].revents & POLLIN)) {
+                continue;
+            }
+            sd = accept(fds[k].fd, NULL, NULL);
+            if (sd >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                next = k + 1;
+                return sd;
+            }
+        }
+        /* the clients have been accepted by other processes */
+    }
+}
+
+/* ======================== PRIVATE HELPER FUNCTIONS ======================== */
+
+/* --------------------------------------------------------------------------
+ *  spawn_worker(slot, sd_servers, n_servers, n_groups, opt, handler, running)
+ * -------------------------------------------------------------------------- */
+/*! \brief Forks a new worker process for the given pool slot.
+ *
+ *  \return  The process ID of the new worker in the master process, -1 if
+ *           fork() failed.  This function does not return in the worker.
+ */
+static pid_t
+spawn_worker(int slot, const int *sd_servers, int n_servers, int n_groups,
+        prog_options_t *opt, client_handler_t handler,
+        volatile sig_atomic_t *running) {
+
+    int i, group = slot % n_groups;
+    const int *own = sd_servers + group * n_servers;
+    pid_t pid;
+
+    /* make sure buffered output is not duplicated in the child */
+    fflush(stdout);
+    if (opt->log_fd != NULL) {
+        fflush(opt->log_fd);
+    }
+
+    if ((pid = fork()) < 0) {
+        perror("ERROR: fork() of worker");
+        return -1;
+    }
+    else if (pid == 0) {
+        worker_slot = slot;
+        log_select_ring(slot);
+        stats_select_slot(slot);
+
+        /* the listening sockets of the other workers are not needed */
+        for (i = 0; i < n_groups * n_servers; i++) {
+            if (i / n_servers != group) {
+                close(sd_servers[i]);
+            }
+        }
+        if (opt->cpu_affinity) {
+            pin_to_cpu(slot, opt);
+        }
+
+        if (opt->engine == ENGINE_EPOLL) {
+            exit(run_event_loop(own, n_servers, opt, running) < 0
+                    ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+        if (opt->engine == ENGINE_URING) {
+            exit(run_uring_loop(own, n_servers, opt, running) < 0
+                    ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+        worker_loop(slot, own, n_servers, opt, handler, running);
+    }
+
+    if (opt->verbose) {
+        printf("[%d] Worker %d started, pid %d.\n", getpid(), slot, pid);
+    }
+    return pid;
+}
+
+
+/* --------------------------------------------------------------------------
+ *  worker_loop(slot, sd_servers, n_servers, opt, handler, running)
+ * -------------------------------------------------------------------------- */
+/*! \brief The main loop of a worker process, accepts and serves clients.
+ *
+ *  The worker terminates when *running becomes false or when it has served
+ *  opt->max_requests connections (unless this limit is 0).  This function
+ *  never returns.
+ */
+static void
+worker_loop(int slot, const int *sd_servers, int n_servers,
+        prog_options_t *opt, client_handler_t handler,
+        volatile sig_atomic_t *running) {
+
+    int served = 0;
+
+    while (*running &&
+            (opt->max_requests == 0 || served < opt->max_requests)) {
+
+        int sd_client = accept_client(sd_servers, n_servers);
+
+        if (sd_client == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("ERROR: accept()");
+            exit(EXIT_FAILURE);
+        }
+
+        worker_count_accept();
+        stats_connection_open();
+        handler(sd_client, opt);
+        close(sd_client);
+        stats_connection_close();
+        served++;
+    }
+
+    log_cache_stats();
+    if (opt->verbose) {
+        printf("[%d] Worker %d served %d connections.\n",
+                getpid(), slot, served);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+
+/* --------------------------------------------------------------------------
+ *  pin_to_cpu(slot, opt)
+ * -------------------------------------------------------------------------- */
+/*! \brief Restricts the current process to a single CPU.
+ *
+ *  The CPU is chosen among the CPUs the process is allowed to run on, so that
+ *  restrictions imposed by e.g. taskset(1) are respected.
+ */
+static void
+pin_to_cpu(int slot, prog_options_t *opt) {
+
+    cpu_set_t allowed, pinned;
+    int cpu, n;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        perror("WARNING: sched_getaffinity()");
+        return;
+    }
+
+    /* the (slot % number of allowed CPUs)-th allowed CPU */
+    n = slot % CPU_COUNT(&allowed);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+            break;
+        }
+    }
+
+    CPU_ZERO(&pinned);
+    CPU_SET(cpu, &pinned);
+    if (sched_setaffinity(0, sizeof(pinned), &pinned) < 0) {
+        perror("WARNING: sched_setaffinity()");
+    }
+    else if (opt->verbose) {
+        printf("[%d] Worker %d pinned to CPU %d.\n", getpid(), slot, cpu);
+    }
+}
+
+
+/* --------------------------------------------------------------------------
+ *  print_accept_counts(opt)
+ * -------------------------------------------------------------------------- */
+/*! \brief Prints the number of connections accepted by each worker slot.
+ */
+static void
+print_accept_counts(prog_options_t *opt) {
+
+    int i;
+    unsigned long total = 0;
+
+    for (i = 0; i < opt->workers; i++) {
+        total += accept_counts[i];
+    }
+    for (i = 0; i < opt->workers; i++) {
+        printf("[%d] Worker %d accepted %lu connections (%.1f%%).\n",
+                getpid(), i, accept_counts[i],
+                total > 0 ? 100.0 * accept_counts[i] / total : 0.0);
+    }
+}
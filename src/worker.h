@@ -0,0 +1,39 @@
+/*! \file       worker.h
+ *  \author     Wolfram Reinke
+ *  \date       October 16, 2026
+ *  \brief      Pre-forked worker process pool.
+ *
+ *  This module provides run_worker_pool(), which starts a fixed number of
+ *  long-lived worker processes that share the listening sockets of the server
+ *  (or use SO_REUSEPORT listening sockets of their own).  Each worker accepts and
+ *  serves clients in a loop, so the cost of fork() is no longer paid for every
+ *  single connection.  The master process only
+ *  supervises the workers and respawns them when they terminate.
+ */
+
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <signal.h>
+
+#include "tinyweb.h"
+
+/*! \brief Serves a single accepted client connection.
+ *
+ *  The handler must not close the client socket descriptor, this is done by
+ *  the caller.  A negative return value signals an error.
+ */
+typedef int (*client_handler_t)(int sd_client, prog_options_t *opt);
+
+int
+run_worker_pool(const int *sd_servers, int n_servers, int n_groups,
+        prog_options_t *opt, client_handler_t handler,
+        volatile sig_atomic_t *running);
+
+int
+accept_client(const int *sd_servers, int n_servers);
+
+void
+worker_count_accept(void);
+
+#endif // _WORKER_H_
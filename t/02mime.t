@@ -28,7 +28,8 @@ my @tests = (
     [ { method => 'GET',  url => "/css/default.css", status => 200 } ],
     [ { method => 'GET',  url => "/zeros1.jpg", status => 200 } ],
     [ { method => 'GET',  url => "/zeros2.jpg", status => 200 } ],
-    [ { method => 'GET',  url => "/zeros3.jpg", status => 200 } ]
+    [ { method => 'GET',  url => "/zeros3.jpg", status => 200 } ],
+    [ { method => 'GET',  url => "/notes.html.txt", status => 200 } ]
 );
 
 # Set the number of test cases (excluding subtests)
@@ -0,0 +1,157 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+# required to set LC_TIME
+use locale;
+use POSIX qw(locale_h); # Imports setlocale() and the LC_ constants.
+
+use POSIX qw(tzset);
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(check_date_header);
+use TinyWebTest qw(get_url_properties);
+
+my $root_dir    = "web";
+my $remote_host = "localhost";
+my $remote_port = "8080";
+my $remote_path = "";
+
+my $locale_str = "en_US.UTF-8";
+setlocale(LC_TIME, $locale_str) or die "Cannot set LC_TIME to '$locale_str'";
+
+# A sparse file larger than 4 GB, which does not occupy any disk space.  Its
+# size exceeds both 32-bit offsets and the maximum transfer of a single
+# sendfile() call.
+my $large_url  = "/large.bin";
+my $large_size = 4 * 1024 * 1024 * 1024 + 4096;
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @tests = (
+    # Large files
+    [ { method => 'HEAD', url => $large_url, status => 200 } ],
+    [ { method => 'GET',  url => $large_url, status => 206, range_offset => -1 } ],
+    [ { method => 'GET',  url => $large_url, status => 206, range_offset => -1000 } ],
+    [ { method => 'GET',  url => $large_url, status => 206, range_offset => 4 * 1024 * 1024 * 1024 } ],
+    [ { method => 'GET',  url => $large_url, status => 416, range_offset => $large_size } ],
+    [ { method => 'GET',  url => $large_url, status => 200 } ]
+);
+
+# Set the number of test cases (excluding subtests)
+plan tests => scalar @tests;
+
+# Force the time zone to be GMT
+$ENV{TZ} = 'GMT';
+tzset;
+
+open(my $fh, '>', $root_dir . $large_url) or die "ERROR: cannot create $large_url: $!";
+truncate($fh, $large_size) or die "ERROR: cannot truncate $large_url: $!";
+close($fh);
+
+connect_to_server(@$_) for @tests;
+
+unlink($root_dir . $large_url);
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Establish an HTTP connection to a server and perform tests on the
+# returned HTTP response
+#
+# Parameter(s):
+# (IN) Reference to a hash containing test data
+#      'method'       -> HTTP method be used in HTTP request
+#      'url'          -> URL
+#      'status'       -> expected HTTP status in the response
+#      'range_offset' -> start of the requested range, counted from the end
+#                        of the file if negative
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub connect_to_server {
+    my $ref = shift;
+
+    my $method = $ref->{method};
+    my $url = $ref->{url};
+    my $offset = undef;
+
+    # Create a user agent object
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 120);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+    # Create a request
+    my $req = HTTP::Request->new($method => "http://$remote_host:$remote_port$remote_path$url");
+    $req->header('Accept' => '*/*');
+    if (exists $ref->{range_offset}) {
+        $offset = ($ref->{range_offset} < 0) ?
+                   $large_size + $ref->{range_offset} : $ref->{range_offset};
+        $req->header('Range' => "bytes=$offset-");
+    } # end if
+
+    # The body is not kept in memory, only its length and whether it
+    # contains anything but zeros is recorded
+    my $body_length = 0;
+    my $body_zeros  = 1;
+    my $res = $ua->request($req, sub {
+        my $chunk = shift;
+        $body_length += length($chunk);
+        $body_zeros = 0 if $chunk =~ /[^\0]/;
+    }, 1024 * 1024);
+
+    subtest "$method '$url'" . (defined $offset ? " from $offset" : "") => sub {
+        #--------------------------------------------------
+        # Subtest: HTTP Status is as expected
+        #--------------------------------------------------
+        like($res->status_line, qr/^$ref->{status}/, "Status");
+
+        #--------------------------------------------------
+        # Subtest: Date and time is correct (the transfer of the whole
+        # file takes several seconds, so the Date of the response is
+        # older than the time the check is performed)
+        #--------------------------------------------------
+        check_date_header($res->headers->{'date'}) if $body_length < 1024 * 1024;
+
+        #--------------------------------------------------
+        # Subtest: Header field 'Server' is provided
+        #--------------------------------------------------
+        isnt($res->headers->{'server'}, undef, "Server");
+
+        if ($ref->{status} == 200 || $ref->{status} == 206) {
+            # Determine file properties
+            (my $file, my $file_time, my $file_size) = get_url_properties($root_dir, $ref);
+
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Last-Modified' equal to file mtime
+            #------------------------------------------------------------------
+            is($res->headers->{'last-modified'}, $file_time, "Last-Modified");
+
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Content-Length' equal to file size
+            #------------------------------------------------------------------
+            my $exp_size = (defined $offset) ? $file_size - $offset : $file_size;
+            is($res->headers->{'content-length'}, $exp_size, "Content-Length");
+
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Content-Range'
+            #------------------------------------------------------------------
+            if (defined $offset) {
+                my $range_str = sprintf "bytes %d-%d/%d", $offset, $file_size-1, $file_size;
+                is($res->headers->{'content-range'}, $range_str, "Content-Range");
+            } # end if
+
+            #------------------------------------------------------------------
+            # Subtest: Complete response body of zeros was received
+            #------------------------------------------------------------------
+            if ($method eq 'GET') {
+                is($body_length, $exp_size, "Response body length: $exp_size");
+                ok($body_zeros, "Response body content: '$file'");
+            } # end if
+        } # end if
+    } # end if
+} # end of connect_to_server
@@ -0,0 +1,159 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+# required to set LC_TIME
+use locale;
+use POSIX qw(locale_h); # Imports setlocale() and the LC_ constants.
+
+use POSIX qw(tzset);
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(check_date_header);
+
+my $remote_host = "localhost";
+my $remote_port = "8080";
+my $remote_path = "";
+
+my $locale_str = "en_US.UTF-8";
+setlocale(LC_TIME, $locale_str) or die "Cannot set LC_TIME to '$locale_str'";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @tests = (
+    # Plain text
+    [ { method => 'GET',  url => "/server-status", format => 'text' } ],
+    [ { method => 'HEAD', url => "/server-status", format => 'text' } ],
+    [ { method => 'GET',  url => "/server-status?refresh=1", format => 'text' } ],
+    # Prometheus text exposition format
+    [ { method => 'GET',  url => "/server-status?format=prometheus",
+        format => 'prometheus' } ],
+    [ { method => 'HEAD', url => "/server-status?format=prometheus",
+        format => 'prometheus' } ],
+);
+
+# Set the number of test cases (excluding subtests)
+plan tests => scalar @tests + 1;
+
+# Force the time zone to be GMT
+$ENV{TZ} = 'GMT';
+tzset;
+
+connect_to_server(@$_) for @tests;
+
+#--------------------------------------------------------------------------
+# The counters are shared by all processes of the server: every answered
+# request is counted, whichever process answered it
+#--------------------------------------------------------------------------
+subtest "Counters" => sub {
+    my $before = count_ok_requests();
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->request(HTTP::Request->new(
+        GET => "http://$remote_host:$remote_port$remote_path/index.html"))
+        for 1 .. 3;
+    my $after = count_ok_requests();
+
+    # the request for the first status page is counted after it was sent
+    cmp_ok($after - $before, '>=', 4, "Requests with status 200");
+};
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Returns the number of answered requests with status 200
+#--------------------------------------------------------------------------
+sub count_ok_requests {
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    my $res = $ua->request(HTTP::Request->new(
+        GET => "http://$remote_host:$remote_port$remote_path" .
+               "/server-status?format=prometheus"));
+
+    return $res->content =~ /^tinyweb_requests_total\{code="200"\} (\d+)$/m
+           ? $1 : -1;
+} # end of count_ok_requests
+
+
+#--------------------------------------------------------------------------
+# Establish an HTTP connection to a server and perform tests on the
+# returned HTTP response
+#
+# Parameter(s):
+# (IN) Reference to a hash containing test data
+#      'method' -> HTTP method be used in HTTP request
+#      'url'    -> URL
+#      'format' -> expected format of the status page
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub connect_to_server {
+    my $ref = shift;
+
+    my $method = $ref->{method};
+    my $url = $ref->{url};
+
+    # Create a user agent object
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+    # Create a request
+    my $req = HTTP::Request->new($method => "http://$remote_host:$remote_port$remote_path$url");
+
+    # Pass request to the user agent and get a response back from the server
+    my $res = $ua->request($req);
+
+    subtest "$method '$url'" => sub {
+        like($res->status_line, qr/^200/, "Status");
+        check_date_header($res->headers->{'date'});
+        is($res->headers->{'cache-control'}, 'no-store', "Cache-Control");
+
+        if ($ref->{format} eq 'prometheus') {
+            like($res->headers->{'content-type'}, qr/^text\/plain; version=0\.0\.4/,
+                 "Content-Type");
+        }
+        else {
+            like($res->headers->{'content-type'}, qr/^text\/plain/,
+                 "Content-Type");
+            unlike($res->headers->{'content-type'}, qr/version=/,
+                   "Content-Type");
+        } # end if
+
+        if ($method eq 'HEAD') {
+            is($res->content, '', "No body");
+            cmp_ok($res->headers->{'content-length'}, '>', 0, "Content-Length");
+            return;
+        } # end if
+
+        is(length($res->content), $res->headers->{'content-length'},
+           "Content-Length");
+
+        my $body = $res->content;
+        if ($ref->{format} eq 'prometheus') {
+            like($body, qr/^# TYPE tinyweb_requests_total counter$/m, "Requests");
+            like($body, qr/^tinyweb_requests_total\{code="404"\} \d+$/m,
+                 "Requests by status");
+            like($body, qr/^tinyweb_sent_bytes_total \d+$/m, "Bytes sent");
+            like($body, qr/^tinyweb_connections_active \d+$/m, "Connections");
+            like($body, qr/^tinyweb_cgi_executions_total \d+$/m, "CGI");
+
+            # every histogram ends with a +Inf bucket equal to its count
+            for my $stage (qw(accept parse stat header body)) {
+                my ($inf) = $body =~
+                    /^tinyweb_stage_duration_seconds_bucket\{stage="$stage",le="\+Inf"\} (\d+)$/m;
+                my ($count) = $body =~
+                    /^tinyweb_stage_duration_seconds_count\{stage="$stage"\} (\d+)$/m;
+                ok(defined $inf && defined $count && $inf == $count,
+                   "Histogram of stage $stage");
+            }
+        }
+        else {
+            like($body, qr/^Requests:\s+\d+$/m, "Requests");
+            like($body, qr/^  200 OK\s+\d+$/m, "Requests by status");
+            like($body, qr/^  parse\s+\d+/m, "Stage durations");
+        } # end if
+    };
+} # end of connect_to_server
@@ -0,0 +1,95 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+# required to set LC_TIME
+use locale;
+use POSIX qw(locale_h); # Imports setlocale() and the LC_ constants.
+
+use POSIX qw(tzset);
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(check_date_header);
+
+my $remote_host = "localhost";
+my $remote_port = "8080";
+my $remote_path = "";
+
+my $locale_str = "en_US.UTF-8";
+setlocale(LC_TIME, $locale_str) or die "Cannot set LC_TIME to '$locale_str'";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+# With the default options, counter.fcgi is served by a pool of two
+# persistent FastCGI processes, which count the requests they answer
+my $url      = "/cgi-bin/counter.fcgi";
+my $requests = 5;
+
+# Set the number of test cases (excluding subtests)
+plan tests => $requests + 1;
+
+# Force the time zone to be GMT
+$ENV{TZ} = 'GMT';
+tzset;
+
+my %served;
+for my $i (1 .. $requests) {
+    my $res = connect_to_server({ method => 'GET', url => $url });
+    if ($res->content =~ /^pid: (\d+)\nrequests: (\d+)$/m) {
+        $served{$1} = $2 if !defined $served{$1} || $2 > $served{$1};
+    }
+}
+
+#--------------------------------------------------------------------------
+# Some process must have answered more than one of the requests
+#--------------------------------------------------------------------------
+subtest "Persistent processes" => sub {
+    cmp_ok(scalar keys %served, '>', 0, "Processes");
+    cmp_ok(scalar keys %served, '<', $requests, "Pool size");
+    ok((grep { $_ > 1 } values %served), "Requests per process");
+};
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Establish an HTTP connection to a server and perform tests on the
+# returned HTTP response
+#
+# Parameter(s):
+# (IN) Reference to a hash containing test data
+#      'method' -> HTTP method be used in HTTP request
+#      'url'    -> URL
+#
+# Return value: The HTTP response
+#
+#--------------------------------------------------------------------------
+sub connect_to_server {
+    my $ref = shift;
+
+    my $method = $ref->{method};
+    my $url = $ref->{url};
+
+    # Create a user agent object
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+    # Create a request
+    my $req = HTTP::Request->new($method => "http://$remote_host:$remote_port$remote_path$url");
+
+    # Pass request to the user agent and get a response back from the server
+    my $res = $ua->request($req);
+
+    subtest "$method '$url'" => sub {
+        like($res->status_line, qr/^200/, "Status");
+        check_date_header($res->headers->{'date'});
+        like($res->headers->{'content-type'}, qr/^text\/plain/,
+             "Content-Type");
+        like($res->content, qr/^mode: fastcgi$/m, "Served by the pool");
+    };
+
+    return $res;
+} # end of connect_to_server
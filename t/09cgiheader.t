@@ -0,0 +1,150 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+
+use Test::More;
+use IO::Socket::IP;
+
+
+my $remote_host = "localhost";
+my $remote_port = "8080";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @tests = (
+    # Status and Content-Length of the script
+    { url => "/cgi-bin/status.pl", status => "404 Nothing Here",
+      framing => "length", type => qr/^text\/plain/ },
+    # no length: the output is sent in chunks
+    { url => "/cgi-bin/hello.pl", status => "200 OK",
+      framing => "chunked", type => qr/^text\/html/ },
+    # Location without Status
+    { url => "/cgi-bin/redirect.pl", status => "302 Found",
+      framing => "chunked", location => "/index.html" },
+);
+
+# Set the number of test cases (excluding subtests)
+plan tests => scalar @tests + 1;
+
+# the requests share a connection as long as the server keeps it alive
+my $socket;
+for my $test (@tests) {
+    $socket //= open_connection();
+    print $socket "GET $test->{url} HTTP/1.1\r\nHost: $remote_host\r\n\r\n";
+
+    my $fields = check_response($socket, $test);
+    if (($fields->{'connection'} // '') ne 'Keep-Alive') {
+        close($socket);
+        undef $socket;
+    }
+}
+close($socket) if defined $socket;
+
+#--------------------------------------------------------------------------
+# HTTP/1.0 clients do not understand chunks, the connection is closed
+#--------------------------------------------------------------------------
+$socket = open_connection();
+print $socket "GET /cgi-bin/hello.pl HTTP/1.0\r\n\r\n";
+check_response($socket, { url => "/cgi-bin/hello.pl", status => "200 OK",
+                          framing => "close", type => qr/^text\/html/ });
+close($socket);
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Connect to the server
+#
+# Return value: The socket of the connection
+#
+#--------------------------------------------------------------------------
+sub open_connection {
+    return IO::Socket::IP->new(
+                PeerAddr => $remote_host,
+                PeerPort => $remote_port,
+                Type     => SOCK_STREAM
+    ) or die "ERROR: socket() - $@";
+} # end of open_connection
+
+
+#--------------------------------------------------------------------------
+# Read a response from a connection and check its header and
+# the framing of its body
+#
+# Parameter(s):
+# (IN) The socket of the connection
+# (IN) Reference to a hash containing test data
+#      'url'      -> URL
+#      'status'   -> expected status code and reason phrase
+#      'framing'  -> expected framing of the body: 'length', 'chunked' or
+#                    'close'
+#      'type'     -> expected Content-Type (optional)
+#      'location' -> expected Location (optional)
+#
+# Return value: Reference to a hash of the header fields
+#
+#--------------------------------------------------------------------------
+sub check_response {
+    my $socket = shift;
+    my $ref = shift;
+
+    my $status_line = <$socket>;
+    my %fields;
+    while (defined(my $line = <$socket>)) {
+        $line =~ s/\R\z//;
+        last if $line eq '';
+        my ($name, $value) = split /:\s*/, $line, 2;
+        $fields{lc $name} = $value;
+    }
+
+    my $body = '';
+    my $complete = 0;
+    if (defined $fields{'content-length'}) {
+        $complete = read($socket, $body, $fields{'content-length'}) ==
+                    $fields{'content-length'};
+    }
+    elsif (($fields{'transfer-encoding'} // '') eq 'chunked') {
+        while (defined(my $size = <$socket>)) {
+            $size = hex($size =~ s/\R\z//r);
+            if ($size == 0) {
+                $complete = defined <$socket>;  # the empty line
+                last;
+            }
+            my $chunk;
+            last if read($socket, $chunk, $size + 2) != $size + 2;
+            $body .= substr($chunk, 0, $size);
+        }
+    }
+    else {
+        local $/;
+        $body = <$socket> // '';
+        $complete = 1;
+    }
+
+    subtest "GET '$ref->{url}'" => sub {
+        like($status_line // '', qr/^HTTP\/1\.1 \Q$ref->{status}\E\r?$/,
+             "Status $ref->{status}");
+        isnt($fields{'date'}, undef, "Date");
+        is($fields{'server'}, "TinyWeb", "Server");
+
+        if ($ref->{framing} eq 'length') {
+            isnt($fields{'content-length'}, undef, "Content-Length");
+        }
+        elsif ($ref->{framing} eq 'chunked') {
+            is($fields{'transfer-encoding'}, "chunked", "Transfer-Encoding");
+        }
+        else {
+            is($fields{'connection'}, "Close", "Connection");
+        }
+        ok($complete, "Complete body");
+
+        like($fields{'content-type'}, $ref->{type}, "Content-Type")
+            if defined $ref->{type};
+        is($fields{'location'}, $ref->{location}, "Location")
+            if defined $ref->{location};
+    };
+
+    return \%fields;
+} # end of check_response
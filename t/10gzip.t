@@ -0,0 +1,160 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+# required to set LC_TIME
+use locale;
+use POSIX qw(locale_h); # Imports setlocale() and the LC_ constants.
+
+use POSIX qw(tzset strftime);
+use File::stat;
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(check_date_header);
+use TinyWebTest qw(get_url_properties);
+use TinyWebTest qw(check_file_content);
+
+my $root_dir    = "web";
+my $remote_host = "localhost";
+my $remote_port = "8080";
+my $remote_path = "";
+
+my $locale_str = "en_US.UTF-8";
+setlocale(LC_TIME, $locale_str) or die "Cannot set LC_TIME to '$locale_str'";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @tests = (
+    # the compressed copy web/css/default.css.gz is sent if gzip is accepted
+    [ { method => 'GET',  url => "/css/default.css", status => 200, encoding => "gzip",
+        file => "/css/default.css.gz" } ],
+    [ { method => 'GET',  url => "/css/default.css", status => 200, encoding => "deflate, x-gzip",
+        file => "/css/default.css.gz" } ],
+    [ { method => 'GET',  url => "/css/default.css", status => 200, encoding => "*",
+        file => "/css/default.css.gz" } ],
+    [ { method => 'HEAD', url => "/css/default.css", status => 200, encoding => "gzip",
+        file => "/css/default.css.gz" } ],
+    [ { method => 'GET',  url => "/css/default.css", status => 206, encoding => "gzip",
+        file => "/css/default.css.gz", range_offset => 100 } ],
+    [ { method => 'GET',  url => "/css/default.css", status => 304, encoding => "gzip",
+        file => "/css/default.css.gz", mod_offset => 0 } ],
+    # the file itself, which still depends on Accept-Encoding
+    [ { method => 'GET',  url => "/css/default.css", status => 200, vary => 1 } ],
+    [ { method => 'GET',  url => "/css/default.css", status => 200, encoding => "gzip;q=0",
+        vary => 1 } ],
+    [ { method => 'GET',  url => "/css/default.css", status => 200, encoding => "*, gzip;q=0",
+        vary => 1 } ],
+    [ { method => 'GET',  url => "/css/default.css", status => 206, vary => 1,
+        range_offset => 100 } ],
+    # no compressed copy
+    [ { method => 'GET',  url => "/index.html", status => 200, encoding => "gzip" } ]
+);
+
+# Set the number of test cases (excluding subtests)
+plan tests => scalar @tests;
+
+# Force the time zone to be GMT
+$ENV{TZ} = 'GMT';
+tzset;
+
+connect_to_server(@$_) for @tests;
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Establish an HTTP connection to a server and perform tests on the
+# returned HTTP response
+#
+# Parameter(s):
+# (IN) Reference to a hash containing test data
+#      'method'       -> HTTP method be used in HTTP request
+#      'url'          -> URL
+#      'status'       -> expected HTTP status in the response
+#      'encoding'     -> value of the Accept-Encoding field (optional)
+#      'file'         -> file expected as body, if it differs from the URL
+#                        (the compressed copy)
+#      'vary'         -> the file has a compressed copy which is not sent
+#      'range_offset' -> start of the requested range (optional)
+#      'mod_offset'   -> If-Modified-Since relative to the mtime of the file
+#                        (optional)
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub connect_to_server {
+    my $ref = shift;
+
+    my $method = $ref->{method};
+    my $url = $ref->{url};
+    my $offset = $ref->{range_offset};
+    my $compressed = exists $ref->{file};
+
+    # Determine file properties
+    (my $file, my $file_time, my $file_size) = get_url_properties($root_dir, $ref);
+
+    # Create a user agent object
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+    # Create a request
+    my $req = HTTP::Request->new($method => "http://$remote_host:$remote_port$remote_path$url");
+    $req->header('Accept' => '*/*');
+    $req->header('Accept-Encoding' => $ref->{encoding}) if exists $ref->{encoding};
+    $req->header('Range' => "bytes=$offset-") if defined $offset;
+    if (exists $ref->{mod_offset}) {
+        my $st = stat($file) or die "ERROR: cannot access $file: $!";
+        $req->header('If-Modified-Since'
+             => strftime "%a, %d %b %Y %H:%M:%S GMT", gmtime ($st->mtime + $ref->{mod_offset}));
+    } # end if
+
+    # Pass request to the user agent and get a response back from the server
+    my $res = $ua->request($req);
+
+    subtest "$method '$url' (" . ($ref->{encoding} // "identity") . ")" => sub {
+        #--------------------------------------------------
+        # Subtest: HTTP Status is as expected
+        #--------------------------------------------------
+        like($res->status_line, qr/^$ref->{status}/, "Status");
+
+        #--------------------------------------------------
+        # Subtest: Date and time is correct
+        #--------------------------------------------------
+        check_date_header($res->headers->{'date'});
+
+        #--------------------------------------------------
+        # Subtest: Content-Encoding and Vary
+        #--------------------------------------------------
+        is($res->headers->{'content-encoding'}, $compressed ? "gzip" : undef,
+           "Content-Encoding");
+        is($res->headers->{'vary'}, ($compressed || $ref->{vary}) ? "Accept-Encoding" : undef,
+           "Vary");
+
+        if ($ref->{status} == 200 || $ref->{status} == 206) {
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Content-Type' of the uncompressed file
+            #------------------------------------------------------------------
+            like($res->headers->{'content-type'}, qr/^text\//, "Content-Type");
+
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Last-Modified' equal to file mtime
+            #------------------------------------------------------------------
+            is($res->headers->{'last-modified'}, $file_time, "Last-Modified");
+
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Content-Length' equal to the size of
+            #          the file sent
+            #------------------------------------------------------------------
+            my $exp_size = (defined $offset) ? $file_size - $offset : $file_size;
+            is($res->headers->{'content-length'}, $exp_size, "Content-Length");
+
+            #------------------------------------------------------------------
+            # Subtest: Provided response body matches file content
+            #------------------------------------------------------------------
+            check_file_content($res->content, $file, $offset) if $method eq 'GET';
+        } # end if
+    };
+} # end of connect_to_server
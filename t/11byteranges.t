@@ -0,0 +1,210 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+# required to set LC_TIME
+use locale;
+use POSIX qw(locale_h); # Imports setlocale() and the LC_ constants.
+
+use POSIX qw(tzset strftime);
+use File::stat;
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(check_date_header);
+use TinyWebTest qw(get_url_properties);
+
+my $root_dir    = "web";
+my $remote_host = "localhost";
+my $remote_port = "8080";
+my $remote_path = "";
+
+my $locale_str = "en_US.UTF-8";
+setlocale(LC_TIME, $locale_str) or die "Cannot set LC_TIME to '$locale_str'";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @tests = (
+    # a single range, negative offsets count from the end of the file
+    [ { url => "/example.pdf", range => "bytes=0-99",       status => 206, parts => [ [0, 99] ] } ],
+    [ { url => "/example.pdf", range => "bytes=1000-1999",  status => 206, parts => [ [1000, 1999] ] } ],
+    [ { url => "/example.pdf", range => "bytes=-500",       status => 206, parts => [ [-500, -1] ] } ],
+    [ { url => "/example.pdf", range => "bytes=100000-",    status => 206, parts => [ [100000, -1] ] } ],
+    [ { url => "/example.pdf", range => "bytes=0-99999999", status => 206, parts => [ [0, -1] ] } ],
+    # a last byte position which overflows off_t extends to the end of the file
+    [ { url => "/example.pdf", range => "bytes=0-99999999999999999999", status => 206,
+        parts => [ [0, -1] ] } ],
+    [ { url => "/example.pdf", range => "bytes=-99999999999999999999", status => 206,
+        parts => [ [0, -1] ] } ],
+    # overlapping and adjacent ranges are merged
+    [ { url => "/example.pdf", range => "bytes=0-99, 50-149",  status => 206, parts => [ [0, 149] ] } ],
+    [ { url => "/example.pdf", range => "bytes=100-199,0-99",  status => 206, parts => [ [0, 199] ] } ],
+    # several ranges: multipart/byteranges, in the order of their offsets
+    [ { url => "/example.pdf", range => "bytes=0-9, 100-109, -10", status => 206,
+        parts => [ [0, 9], [100, 109], [-10, -1] ] } ],
+    [ { url => "/example.pdf", range => "bytes=-1,0-0", status => 206,
+        parts => [ [0, 0], [-1, -1] ] } ],
+    [ { url => "/index.html", range => "bytes=10-19,99999-,30-", status => 206,
+        parts => [ [10, 19], [30, -1] ] } ],
+    # invalid fields are ignored
+    [ { url => "/example.pdf", range => "bytes=5-1",  status => 200 } ],
+    [ { url => "/example.pdf", range => "items=0-9",  status => 200 } ],
+    [ { url => "/example.pdf", range => "bytes=a-b",  status => 200 } ],
+    [ { url => "/example.pdf", range => "bytes=99999999999999999999-", status => 200 } ],
+    # no satisfiable range
+    [ { url => "/index.html",  range => "bytes=99999-", status => 416 } ],
+    [ { url => "/index.html",  range => "bytes=-0",     status => 416 } ],
+    # If-Range
+    [ { url => "/example.pdf", range => "bytes=0-99", status => 206, parts => [ [0, 99] ],
+        if_range => 0 } ],
+    [ { url => "/example.pdf", range => "bytes=0-99", status => 200, if_range => -1 } ],
+    [ { url => "/example.pdf", range => "bytes=0-99", status => 200, if_range => '"abc"' } ]
+);
+
+# Set the number of test cases (excluding subtests)
+plan tests => scalar @tests;
+
+# Force the time zone to be GMT
+$ENV{TZ} = 'GMT';
+tzset;
+
+connect_to_server(@$_) for @tests;
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Establish an HTTP connection to a server and perform tests on the
+# returned HTTP response
+#
+# Parameter(s):
+# (IN) Reference to a hash containing test data
+#      'url'      -> URL
+#      'range'    -> value of the Range field
+#      'status'   -> expected HTTP status in the response
+#      'parts'    -> expected ranges [first, last] of a 206 response,
+#                    negative offsets count from the end of the file
+#      'if_range' -> If-Range: the mtime of the file plus the given number
+#                    of seconds, or an entity tag (optional)
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub connect_to_server {
+    my $ref = shift;
+
+    my $url = $ref->{url};
+
+    # Determine file properties
+    (my $file, my $file_time, my $file_size) = get_url_properties($root_dir, $ref);
+    my $content = do {
+        local $/ = undef;
+        open my $fh, "<", $file or die "ERROR: cannot open $file: $!";
+        <$fh>;
+    };
+
+    # Create a user agent object
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+    # Create a request
+    my $req = HTTP::Request->new(GET => "http://$remote_host:$remote_port$remote_path$url");
+    $req->header('Accept' => '*/*');
+    $req->header('Range' => $ref->{range});
+    if (exists $ref->{if_range}) {
+        if ($ref->{if_range} =~ /^-?\d+$/) {
+            my $st = stat($file) or die "ERROR: cannot access $file: $!";
+            $req->header('If-Range'
+                 => strftime "%a, %d %b %Y %H:%M:%S GMT", gmtime ($st->mtime + $ref->{if_range}));
+        }
+        else {
+            $req->header('If-Range' => $ref->{if_range});
+        } # end if
+    } # end if
+
+    # Pass request to the user agent and get a response back from the server
+    my $res = $ua->request($req);
+
+    subtest "GET '$url' ($ref->{range})" => sub {
+        #--------------------------------------------------
+        # Subtest: HTTP Status is as expected
+        #--------------------------------------------------
+        like($res->status_line, qr/^$ref->{status}/, "Status");
+
+        #--------------------------------------------------
+        # Subtest: Date and time is correct
+        #--------------------------------------------------
+        check_date_header($res->headers->{'date'});
+
+        if ($ref->{status} == 200) {
+            #------------------------------------------------------------------
+            # Subtest: the complete file
+            #------------------------------------------------------------------
+            is($res->headers->{'content-range'}, undef, "Content-Range");
+            is($res->headers->{'content-length'}, $file_size, "Content-Length");
+            ok($res->content eq $content, "Response body content: '$file'");
+        }
+        elsif ($ref->{status} == 416) {
+            is($res->headers->{'content-range'}, "bytes */$file_size", "Content-Range");
+        }
+        else {
+            is($res->headers->{'last-modified'}, $file_time, "Last-Modified");
+            is($res->headers->{'content-length'}, length($res->content), "Content-Length");
+
+            my @parts = map { [ map { $_ < 0 ? $file_size + $_ : $_ } @$_ ] } @{$ref->{parts}};
+            if (@parts == 1) {
+                #--------------------------------------------------------------
+                # Subtest: a single range is the body
+                #--------------------------------------------------------------
+                check_part($res->headers->{'content-range'}, $res->content,
+                           $parts[0], $content);
+                return;
+            } # end if
+
+            #------------------------------------------------------------------
+            # Subtest: every range is a part of a multipart/byteranges body
+            #------------------------------------------------------------------
+            my ($boundary) = ($res->headers->{'content-type'} // '')
+                             =~ /^multipart\/byteranges; boundary=(\S+)$/;
+            ok(defined $boundary, "Content-Type multipart/byteranges");
+            return unless defined $boundary;
+
+            my @bodies = split /\r\n--\Q$boundary\E(?:--)?\r\n/, "\r\n" . $res->content, -1;
+            shift @bodies;      # the empty preamble
+            pop @bodies;        # the empty epilogue
+            is(scalar @bodies, scalar @parts, "Number of parts");
+
+            for my $i (0 .. $#parts) {
+                my ($fields, $body) = split /\r\n\r\n/, $bodies[$i] // '', 2;
+                my %fields = map { my ($n, $v) = split /:\s*/, $_, 2; (lc $n => $v) }
+                             split /\r\n/, $fields // '';
+                like($fields{'content-type'}, qr/^application\/pdf|^text\/html/, "Content-Type of part $i");
+                check_part($fields{'content-range'}, $body // '', $parts[$i], $content);
+            } # end for
+        } # end if
+    };
+} # end of connect_to_server
+
+
+#--------------------------------------------------------------------------
+# Compare the Content-Range and the content of a part with the file
+#
+# Parameter(s):
+# (IN) The value of the Content-Range field
+# (IN) The content of the part
+# (IN) Reference to the expected range [first, last]
+# (IN) The content of the file
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub check_part {
+    my ($range, $body, $part, $content) = @_;
+
+    my ($first, $last) = @$part;
+    is($range, sprintf("bytes %d-%d/%d", $first, $last, length($content)), "Content-Range");
+    ok($body eq substr($content, $first, $last - $first + 1),
+       "Content of bytes $first-$last");
+} # end of check_part
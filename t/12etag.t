@@ -0,0 +1,189 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+# required to set LC_TIME
+use locale;
+use POSIX qw(locale_h); # Imports setlocale() and the LC_ constants.
+
+use POSIX qw(tzset strftime);
+use File::stat;
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(check_date_header);
+use TinyWebTest qw(get_url_properties);
+use TinyWebTest qw(check_file_content);
+
+my $root_dir    = "web";
+my $remote_host = "localhost";
+my $remote_port = "8080";
+my $remote_path = "";
+
+my $locale_str = "en_US.UTF-8";
+setlocale(LC_TIME, $locale_str) or die "Cannot set LC_TIME to '$locale_str'";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @tests = (
+    # no condition
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 200 } ],
+    [ { method => 'GET',  url => "/index.html", status => 200 } ],
+    # If-None-Match
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 304, none_match => 'same' } ],
+    [ { method => 'HEAD', url => "/images/computerhead1.gif", status => 304, none_match => 'same' } ],
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 304, none_match => 'weak' } ],
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 304, none_match => 'list' } ],
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 304, none_match => 'any' } ],
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 200, none_match => 'other' } ],
+    [ { method => 'GET',  url => "/index.html", status => 200, none_match => 'other' } ],
+    # If-None-Match takes precedence over If-Modified-Since
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 200, none_match => 'other',
+        mod_offset => 0 } ],
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 304, none_match => 'same',
+        mod_offset => -1 } ],
+    # If-Range with an entity tag
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 206, if_range => 'same',
+        range_offset => 100 } ],
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 200, if_range => 'weak',
+        range_offset => 100 } ],
+    [ { method => 'GET',  url => "/images/computerhead1.gif", status => 200, if_range => 'other',
+        range_offset => 100 } ]
+);
+
+# Set the number of test cases (excluding subtests)
+plan tests => scalar @tests;
+
+# Force the time zone to be GMT
+$ENV{TZ} = 'GMT';
+tzset;
+
+connect_to_server(@$_) for @tests;
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Request a file without conditions and return its entity tag
+#
+# Parameter(s):
+# (IN) URL
+#
+# Return value: The value of the ETag field
+#
+#--------------------------------------------------------------------------
+sub get_etag {
+    my $url = shift;
+
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+    my $req = HTTP::Request->new(HEAD => "http://$remote_host:$remote_port$remote_path$url");
+    return $ua->request($req)->headers->{'etag'} // '"none"';
+} # end of get_etag
+
+
+#--------------------------------------------------------------------------
+# Establish an HTTP connection to a server and perform tests on the
+# returned HTTP response
+#
+# Parameter(s):
+# (IN) Reference to a hash containing test data
+#      'method'       -> HTTP method be used in HTTP request
+#      'url'          -> URL
+#      'status'       -> expected HTTP status in the response
+#      'none_match'   -> If-None-Match: the entity tag of the file ('same'),
+#                        its weak version ('weak'), a list containing it
+#                        ('list'), '*' ('any') or another tag ('other')
+#                        (optional)
+#      'mod_offset'   -> If-Modified-Since relative to the mtime of the file
+#                        (optional)
+#      'if_range'     -> If-Range: 'same', 'weak' or 'other' as above
+#                        (optional)
+#      'range_offset' -> start of the requested range (optional)
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub connect_to_server {
+    my $ref = shift;
+
+    my $method = $ref->{method};
+    my $url = $ref->{url};
+    my $offset = $ref->{range_offset};
+
+    # Determine file properties
+    (my $file, my $file_time, my $file_size) = get_url_properties($root_dir, $ref);
+
+    my $etag = get_etag($url);
+    my %tags = ( same  => $etag,
+                 weak  => "W/$etag",
+                 list  => "\"abc\", W/\"def\" ,$etag",
+                 any   => "*",
+                 other => "\"0-0-0\"" );
+
+    # Create a user agent object
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+    # Create a request
+    my $req = HTTP::Request->new($method => "http://$remote_host:$remote_port$remote_path$url");
+    $req->header('Accept' => '*/*');
+    $req->header('If-None-Match' => $tags{$ref->{none_match}}) if exists $ref->{none_match};
+    $req->header('If-Range' => $tags{$ref->{if_range}}) if exists $ref->{if_range};
+    $req->header('Range' => "bytes=$offset-") if defined $offset;
+    if (exists $ref->{mod_offset}) {
+        my $st = stat($file) or die "ERROR: cannot access $file: $!";
+        $req->header('If-Modified-Since'
+             => strftime "%a, %d %b %Y %H:%M:%S GMT", gmtime ($st->mtime + $ref->{mod_offset}));
+    } # end if
+
+    # Pass request to the user agent and get a response back from the server
+    my $res = $ua->request($req);
+
+    subtest "$method '$url'" . (exists $ref->{none_match} ? " ($ref->{none_match})" : "") => sub {
+        #--------------------------------------------------
+        # Subtest: HTTP Status is as expected
+        #--------------------------------------------------
+        like($res->status_line, qr/^$ref->{status}/, "Status");
+
+        #--------------------------------------------------
+        # Subtest: Date and time is correct
+        #--------------------------------------------------
+        check_date_header($res->headers->{'date'});
+
+        #--------------------------------------------------
+        # Subtest: Header field 'ETag' is a strong tag which contains
+        #          the size of the file
+        #--------------------------------------------------
+        like($res->headers->{'etag'}, qr/^"[0-9a-f]+-[0-9a-f]+-[0-9a-f]+"$/, "ETag format");
+        is((split /-/, $res->headers->{'etag'} // '')[1], sprintf("%x", $file_size), "ETag size");
+        is($res->headers->{'etag'}, $etag, "ETag unchanged");
+
+        if ($ref->{status} == 304) {
+            #------------------------------------------------------------------
+            # Subtest: no body
+            #------------------------------------------------------------------
+            is($res->content, '', "No body");
+        }
+        else {
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Last-Modified' equal to file mtime
+            #------------------------------------------------------------------
+            is($res->headers->{'last-modified'}, $file_time, "Last-Modified");
+
+            #------------------------------------------------------------------
+            # Subtest: Header field 'Content-Length' equal to file size
+            #------------------------------------------------------------------
+            $offset = undef if $ref->{status} == 200;
+            my $exp_size = (defined $offset) ? $file_size - $offset : $file_size;
+            is($res->headers->{'content-length'}, $exp_size, "Content-Length");
+
+            #------------------------------------------------------------------
+            # Subtest: Provided response body matches file content
+            #------------------------------------------------------------------
+            check_file_content($res->content, $file, $offset) if $method eq 'GET';
+        } # end if
+    };
+} # end of connect_to_server
@@ -0,0 +1,97 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+use JSON::PP;
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(start_server stop_server);
+
+my $trace_port  = "8090";
+my $trace_file  = "/tmp/tinyweb-trace-$$.json";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @engines = ( "fork", "epoll", "uring" );
+
+# the stages every request passes; small files are sent with the header,
+# so only the large file has a body stage of its own
+my @urls   = ( "/index.html", "/example.pdf", "/nonexistent.html" );
+my @stages = ( "parse", "stat", "header", "log" );
+
+# Set the number of test cases (excluding subtests)
+plan tests => scalar @engines;
+
+trace_engine($_) for @engines;
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Start a traced server with the given engine, send it some requests and
+# check that the trace file holds a request slice and the stage events of
+# every request
+#
+# Parameter(s):
+# (IN) Name of the engine
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub trace_engine {
+    my $engine = shift;
+
+    unlink $trace_file;
+
+    my $pid = start_server($trace_port, "-e", $engine, "--trace=$trace_file");
+
+    SKIP: {
+        skip "cannot start the server with engine '$engine'", 1 unless defined $pid;
+
+        my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+        $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+        my @status = map {
+            $ua->request(HTTP::Request->new(GET => "http://127.0.0.1:$trace_port$_"))->code
+        } @urls;
+
+        stop_server($pid);
+
+        subtest "trace of engine '$engine'" => sub {
+            is_deeply(\@status, [ 200, 200, 404 ], "Status");
+
+            ok(open(my $fh, "<", $trace_file), "Trace file written") or return;
+            my $json = do { local $/; <$fh> };
+            close $fh;
+
+            my $events = eval { decode_json($json) };
+            ok(ref $events eq 'ARRAY', "Trace file is a JSON array") or return;
+
+            #------------------------------------------------------------------
+            # Subtest: every request has a request slice and all its stages
+            #------------------------------------------------------------------
+            my @requests = grep { ($_->{cat} // "") eq "request" &&
+                                  $_->{name} =~ m{^GET /} } @$events;
+            is(scalar @requests, scalar @urls, "Request slices");
+
+            for my $request (@requests) {
+                my @names = map { $_->{name} }
+                            grep { ($_->{cat} // "") eq "stage" &&
+                                   $_->{pid} == $request->{pid} &&
+                                   $_->{tid} == $request->{tid} &&
+                                   $_->{ts} >= $request->{ts} &&
+                                   $_->{ts} <= $request->{ts} + $request->{dur} } @$events;
+                my %seen = map { $_ => 1 } @names;
+                my @expected = @stages;
+                push @expected, "body" if $request->{name} =~ m{/example\.pdf };
+                ok(!grep({ !$seen{$_} } @expected), "Stages of '$request->{name}'")
+                    or diag("stages: @names");
+            } # end for
+        };
+    } # end SKIP
+
+    unlink $trace_file;
+} # end of trace_engine
@@ -0,0 +1,289 @@
+#!/usr/bin/perl
+
+use strict;
+use warnings;
+use lib 't/lib';
+
+use File::Temp qw(tempdir);
+use IO::Socket::INET;
+use IO::Uncompress::Gunzip qw(gunzip $GunzipError);
+use LWP::UserAgent;
+use Test::More;
+use TinyWebTest qw(start_server stop_server);
+
+my $root_dir    = "web";
+my $gzip_port   = "8091";
+
+# a file too large to be compressed in the request path, created by the test
+my $large_url  = "/gzip-large.txt";
+my $large_file = "$root_dir$large_url";
+
+#--------------------------------------------------------------------------
+# Test Cases
+#--------------------------------------------------------------------------
+my @engines = ( "fork", "epoll", "uring" );
+
+my @tests = (
+    # a static file is compressed on the fly, its body decompresses to the file
+    [ { url => "/index.html", encoding => "gzip", compressed => 1, vary => 1,
+        file => "/index.html" } ],
+    [ { url => "/index.html", compressed => 0, vary => 1, file => "/index.html" } ],
+    # a file below --gzip-min-size is never compressed
+    [ { url => "/notes.html.txt", encoding => "gzip", compressed => 0, vary => 0,
+        file => "/notes.html.txt" } ],
+    # CGI output of unknown length is compressed while it is relayed, chunked
+    [ { url => "/cgi-bin/hello.pl", encoding => "gzip", compressed => 1, vary => 1,
+        chunked => 1 } ],
+    # output which a script has compressed itself is passed on unchanged
+    [ { url => "/cgi-bin/encoded.pl", encoding => "gzip", compressed => 1, vary => 0,
+        text => "Hello, world!\n" x 100 } ]
+);
+
+# on-the-fly compression is only compiled in with zlib (not with make ZLIB=0)
+my ($binary) = glob("build/*/tinyweb");
+plan skip_all => "the server is built without zlib"
+    unless defined $binary && `ldd $binary` =~ /libz\./;
+
+# Set the number of test cases (excluding subtests)
+plan tests => @engines * (@tests + 2);
+
+for my $engine (@engines) {
+    my $cache = tempdir(CLEANUP => 1);
+    my $pid = start_server($gzip_port, "-e", $engine, "--gzip=6",
+                           "--gzip-min-size=1024", "--gzip-cache=$cache");
+
+    SKIP: {
+        skip "cannot start the server with engine '$engine'", @tests + 2 unless defined $pid;
+
+        connect_to_server($engine, @$_) for @tests;
+        check_large_file($engine, $cache);
+
+        stop_server($pid);
+
+        # the compressor must not keep the listening sockets open
+        ok(!IO::Socket::INET->new(PeerAddr => "127.0.0.1", PeerPort => $gzip_port),
+           "No listening socket left after stopping the server ($engine)");
+    } # end SKIP
+} # end for
+
+unlink $large_file;
+
+exit 0;
+
+
+#--------------------------------------------------------------------------
+# Send a GET request to the server
+#
+# Parameter(s):
+# (IN) URL
+# (IN) Value of the Accept-Encoding field, undef for none
+#
+# Return value: The response
+#
+#--------------------------------------------------------------------------
+sub get_url {
+    my ($url, $encoding) = @_;
+
+    my $ua = LWP::UserAgent->new(max_redirect => 0, timeout => 30);
+    $ua->agent("TinyWeb Test Harness, Test Script $0");
+
+    my $req = HTTP::Request->new(GET => "http://127.0.0.1:$gzip_port$url");
+    $req->header('Accept' => '*/*');
+    $req->header('Accept-Encoding' => $encoding) if defined $encoding;
+
+    return $ua->request($req);
+} # end of get_url
+
+
+#--------------------------------------------------------------------------
+# Return the body of a response, decompressed if it has been compressed
+#
+# Parameter(s):
+# (IN) The response
+#
+# Return value: The body, undef if it cannot be decompressed
+#
+#--------------------------------------------------------------------------
+sub response_body {
+    my $res = shift;
+
+    my $body = $res->content;
+    return $body unless ($res->headers->{'content-encoding'} // "") eq "gzip";
+
+    my $plain;
+    gunzip(\$body => \$plain) or return undef;
+    return $plain;
+} # end of response_body
+
+
+#--------------------------------------------------------------------------
+# Return the content of a file
+#
+# Parameter(s):
+# (IN) Path of the file
+#
+# Return value: The content
+#
+#--------------------------------------------------------------------------
+sub read_file {
+    my $file = shift;
+
+    open(my $fh, "<", $file) or die "ERROR: cannot open $file: $!";
+    binmode $fh;
+    my $content = do { local $/; <$fh> };
+    close $fh;
+    return $content;
+} # end of read_file
+
+
+#--------------------------------------------------------------------------
+# Write a version of the large text file, replacing the previous one
+#
+# Parameter(s):
+# (IN) Version of the file, which changes its content and size
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub write_large_file {
+    my $version = shift;
+
+    open(my $fh, ">", "$large_file.tmp") or die "ERROR: cannot create $large_file: $!";
+    print $fh "Version $version, line $_ of a file compressed in the background.\n"
+        for 1 .. 4000 * $version;
+    close $fh;
+    rename "$large_file.tmp", $large_file or die "ERROR: cannot rename $large_file: $!";
+} # end of write_large_file
+
+
+#--------------------------------------------------------------------------
+# Request a URL until the server sends it compressed
+#
+# Parameter(s):
+# (IN) URL
+#
+# Return value: The compressed response, or the last response if the server
+#               does not compress it within 5 s
+#
+#--------------------------------------------------------------------------
+sub get_compressed {
+    my $url = shift;
+    my $res;
+
+    for (1 .. 50) {
+        $res = get_url($url, "gzip");
+        last if ($res->headers->{'content-encoding'} // "") eq "gzip";
+        select(undef, undef, undef, 0.1);
+    } # end for
+    return $res;
+} # end of get_compressed
+
+
+#--------------------------------------------------------------------------
+# Establish an HTTP connection to a server and perform tests on the
+# returned HTTP response
+#
+# Parameter(s):
+# (IN) Name of the engine of the server
+# (IN) Reference to a hash containing test data
+#      'url'        -> URL
+#      'encoding'   -> value of the Accept-Encoding field (optional)
+#      'compressed' -> whether the response is expected to be gzip-encoded
+#      'vary'       -> whether the response is expected to depend on
+#                      Accept-Encoding
+#      'chunked'    -> the response is expected to be sent in chunks, its
+#                      body is compared to the uncompressed response
+#      'file'       -> file expected as (decompressed) body (optional)
+#      'text'       -> expected (decompressed) body (optional)
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub connect_to_server {
+    my ($engine, $ref) = @_;
+
+    my $url = $ref->{url};
+    my $res = get_url($url, $ref->{encoding});
+
+    subtest "GET '$url' (" . ($ref->{encoding} // "identity") . ", $engine)" => sub {
+        #--------------------------------------------------
+        # Subtest: HTTP Status is as expected
+        #--------------------------------------------------
+        like($res->status_line, qr/^200/, "Status");
+
+        #--------------------------------------------------
+        # Subtest: Content-Encoding and Vary
+        #--------------------------------------------------
+        is($res->headers->{'content-encoding'}, $ref->{compressed} ? "gzip" : undef,
+           "Content-Encoding");
+        is($res->headers->{'vary'}, $ref->{vary} ? "Accept-Encoding" : undef, "Vary");
+
+        if ($ref->{chunked}) {
+            is($res->headers->{'transfer-encoding'}, "chunked", "Transfer-Encoding");
+            is($res->headers->{'content-length'}, undef, "Content-Length");
+        } # end if
+
+        #--------------------------------------------------
+        # Subtest: the decompressed body is the content
+        #--------------------------------------------------
+        my $expected = exists $ref->{file} ? read_file("$root_dir$ref->{file}")
+                     : exists $ref->{text} ? $ref->{text}
+                     : response_body(get_url($url));
+        my $body = response_body($res);
+        ok(defined $body && $body eq $expected, "Body") or diag("gunzip: $GunzipError");
+    };
+} # end of connect_to_server
+
+
+#--------------------------------------------------------------------------
+# Check that a large file is compressed in the background, and that its
+# copy replaces the copy of the previous version in the cache
+#
+# Parameter(s):
+# (IN) Name of the engine of the server
+# (IN) The cache directory of the server
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub check_large_file {
+    my ($engine, $cache) = @_;
+
+    write_large_file(1);
+
+    subtest "GET '$large_url' (gzip, $engine)" => sub {
+        #------------------------------------------------------------------
+        # Subtest: the file is sent uncompressed or compressed, but always
+        #          with its content
+        #------------------------------------------------------------------
+        my $res = get_url($large_url, "gzip");
+        like($res->status_line, qr/^200/, "Status");
+        is($res->headers->{'vary'}, "Accept-Encoding", "Vary");
+        is(response_body($res), read_file($large_file), "Body");
+
+        #------------------------------------------------------------------
+        # Subtest: the compressed copy becomes available
+        #------------------------------------------------------------------
+        $res = get_compressed($large_url);
+        is($res->headers->{'content-encoding'}, "gzip", "Compressed copy");
+        is(response_body($res), read_file($large_file), "Decompressed body");
+        my @copies = glob("$cache/*.gz");
+
+        #------------------------------------------------------------------
+        # Subtest: the copy of a new version replaces the old copy
+        #------------------------------------------------------------------
+        write_large_file(2);
+        my $expected = read_file($large_file);
+        for (1 .. 50) {
+            $res = get_compressed($large_url);
+            last if (response_body($res) // "") eq $expected;
+            select(undef, undef, undef, 0.1);
+        } # end for
+        is(response_body($res), $expected, "Decompressed body of the new version");
+
+        my @new_copies = glob("$cache/*.gz");
+        is(scalar @new_copies, scalar @copies, "Old copy removed");
+        my %old = map { $_ => 1 } @copies;
+        is(scalar(grep { !$old{$_} } @new_copies), 1, "New copy stored");
+    };
+} # end of check_large_file
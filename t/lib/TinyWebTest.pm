@@ -7,7 +7,8 @@ use vars qw($VERSION @ISA @EXPORT @EXPORT_OK %EXPORT_TAGS);
 
 
 use File::stat;
-use POSIX qw(strftime);
+use IO::Socket::INET;
+use POSIX qw(strftime :sys_wait_h);
 use POSIX::strptime;
 use POSIX qw(tzset);
 use Test::More;
@@ -15,7 +16,8 @@ use Test::More;
 $VERSION     = 1.00;
 @ISA         = qw(Exporter);
 @EXPORT      = ();
-@EXPORT_OK   = qw(get_gmtime check_date_header get_url_properties check_file_content);
+@EXPORT_OK   = qw(get_gmtime check_date_header get_url_properties check_file_content
+                  start_server stop_server);
 %EXPORT_TAGS = ( DEFAULT => [qw(&check_date_header get_url_properties check_file_content)] );
 
 
@@ -90,3 +92,64 @@ sub get_url_properties {
     return ($file, $file_time, $st->size);
 } # end of get_url_properties
 
+
+#--------------------------------------------------------------------------
+# Start a server of its own with the given options, for tests which need
+# options the server under test has not been started with
+#
+# Parameter(s):
+# (IN) The port of the server
+# (IN) Further options passed to the server
+#
+# Return value: The process ID of the server, undef if there is no server
+#               binary, if it has exited or if it does not accept
+#               connections within 5 s
+#
+#--------------------------------------------------------------------------
+sub start_server {
+    my ($port, @options) = @_;
+
+    my ($binary) = glob("build/*/tinyweb");
+    return undef unless defined $binary && -x $binary;
+
+    my $pid = fork();
+    die "ERROR: cannot fork: $!" unless defined $pid;
+    if ($pid == 0) {
+        open STDOUT, ">", "/dev/null";
+        open STDERR, ">", "/dev/null";
+        exec $binary, "-p", $port, "-d", "web", "-f", "/dev/null", @options;
+        exit 1;
+    } # end if
+
+    for (1 .. 50) {
+        # the server has exited, e.g. because the port is in use
+        return undef if waitpid($pid, WNOHANG) == $pid;
+
+        my $sock = IO::Socket::INET->new(PeerAddr => "127.0.0.1", PeerPort => $port);
+        if ($sock) {
+            close $sock;
+            return $pid;
+        } # end if
+        select(undef, undef, undef, 0.1);
+    } # end for
+
+    stop_server($pid);
+    return undef;
+} # end of start_server
+
+
+#--------------------------------------------------------------------------
+# Terminate a server started with start_server() and wait for it
+#
+# Parameter(s):
+# (IN) The process ID of the server
+#
+# Return value: NONE
+#
+#--------------------------------------------------------------------------
+sub stop_server {
+    my $pid = shift;
+
+    kill 'INT', $pid;
+    waitpid $pid, 0;
+} # end of stop_server
@@ -0,0 +1,139 @@
+#!/usr/bin/perl
+#
+# Generates the MIME type lookup table of src/content.c from a file in the
+# format of mime.types (a media type followed by file extensions per line,
+# '#' starts a comment).
+#
+# The table is a perfect hash ("hash and displace"): the 32-bit FNV-1a hash
+# of the lower-case extension selects a bucket, and the seed of the bucket is
+# mixed into the hash to select a slot.  The seeds are chosen here so that
+# no two extensions share a slot, so a lookup needs one hash, two table reads
+# and one string comparison.  The hash functions must match those of
+# src/content.c.
+#
+# Usage: tools/gen_mime.pl DEFAULT_TYPE < mime.types > mime_table.h
+#
+# Only core Perl modules are used.
+
+use strict;
+use warnings;
+
+my $default = shift @ARGV or die "Usage: $0 DEFAULT_TYPE < mime.types\n";
+
+#--------------------------------------------------------------------------
+# Read the type list
+#--------------------------------------------------------------------------
+my @types = ($default);     # index 0 is the default type
+my %type_index = ($default => 0);
+my %ext_type;               # extension -> index into @types
+my $ext_max = 0;
+
+while (my $line = <STDIN>) {
+    $line =~ s/#.*//;
+    my ($type, @exts) = split ' ', $line;
+    next if !defined $type || !@exts;
+
+    if (!exists $type_index{$type}) {
+        $type_index{$type} = scalar @types;
+        push @types, $type;
+    }
+    for my $ext (map { lc } @exts) {
+        die "line $.: invalid extension '$ext'\n"
+            if $ext !~ /^[!-~]+$/ || $ext =~ /["\\]/;
+        die "line $.: duplicate extension '$ext'\n" if exists $ext_type{$ext};
+        $ext_type{$ext} = $type_index{$type};
+        $ext_max = length $ext if length $ext > $ext_max;
+    }
+}
+die "no extensions found\n" if !%ext_type;
+die "too many types\n" if @types > 65535;
+
+#--------------------------------------------------------------------------
+# Hash functions (32-bit arithmetic, as in src/content.c)
+#--------------------------------------------------------------------------
+sub mul32 {
+    my ($x, $y) = @_;
+    return ($x * ($y & 0xffff) + ((($x * ($y >> 16)) & 0xffff) << 16))
+           & 0xffffffff;
+}
+
+sub fnv1a {
+    my $hash = 2166136261;
+    for my $c (unpack 'C*', shift) {
+        $hash = mul32($hash ^ $c, 16777619);
+    }
+    return $hash;
+}
+
+sub mix {
+    my $hash = shift;
+    $hash = mul32($hash ^ ($hash >> 16), 0x85ebca6b);
+    $hash = mul32($hash ^ ($hash >> 13), 0xc2b2ae35);
+    return $hash ^ ($hash >> 16);
+}
+
+#--------------------------------------------------------------------------
+# Find a seed per bucket, largest buckets first
+#--------------------------------------------------------------------------
+my @exts = sort keys %ext_type;
+my $n_slots = 1;
+$n_slots *= 2 while $n_slots < @exts * 1.25;
+my $n_buckets = $n_slots / 4 || 1;
+
+my %hash = map { $_ => fnv1a($_) } @exts;
+my @buckets;
+push @{ $buckets[$hash{$_} & ($n_buckets - 1)] }, $_ for @exts;
+
+my @seeds = (0) x $n_buckets;
+my @slots;                  # slot -> extension
+
+BUCKET:
+for my $bucket (sort { @{ $buckets[$b] || [] } <=> @{ $buckets[$a] || [] }
+                       or $a <=> $b } 0 .. $n_buckets - 1) {
+    my $keys = $buckets[$bucket] or next;
+
+    SEED:
+    for my $seed (1 .. 65535) {
+        my %taken;
+        for my $ext (@$keys) {
+            my $slot = mix($hash{$ext} ^ $seed) & ($n_slots - 1);
+            next SEED if defined $slots[$slot] || $taken{$slot}++;
+        }
+        for my $ext (@$keys) {
+            $slots[mix($hash{$ext} ^ $seed) & ($n_slots - 1)] = $ext;
+        }
+        $seeds[$bucket] = $seed;
+        next BUCKET;
+    }
+    die "no seed found for bucket $bucket (@$keys)\n";
+}
+
+#--------------------------------------------------------------------------
+# Write the table
+#--------------------------------------------------------------------------
+print <<"EOF";
+/* Generated by tools/gen_mime.pl, do not edit.
+ * ${\ scalar @types} types, ${\ scalar @exts} extensions. */
+
+#define MIME_HASH_BUCKETS   $n_buckets
+#define MIME_HASH_SLOTS     $n_slots
+#define MIME_EXT_MAX        $ext_max
+
+static const char *const mime_type_names[] = {
+EOF
+print qq(    "$_",\n) for @types;
+print "};\n\nstatic const unsigned short mime_hash_seeds[MIME_HASH_BUCKETS] = {\n";
+for (my $i = 0; $i < @seeds; $i += 8) {
+    my $last = $i + 7 < $#seeds ? $i + 7 : $#seeds;
+    print '    ', join(', ', @seeds[$i .. $last]), ",\n";
+}
+print "};\n\nstatic const mime_hash_slot_t mime_hash_slots[MIME_HASH_SLOTS] = {\n";
+for my $ext (@slots[0 .. $n_slots - 1]) {
+    if (defined $ext) {
+        print qq(    { "$ext", $ext_type{$ext} },\n);
+    }
+    else {
+        print "    { NULL, 0 },\n";
+    }
+}
+print "};\n";
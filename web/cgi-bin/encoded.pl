@@ -0,0 +1,14 @@
+#!/usr/bin/perl
+
+# encoded.pl -- compresses its output itself, the server must pass it on
+
+use IO::Compress::Gzip qw(gzip);
+
+my $text = "Hello, world!\n" x 100;
+my $body;
+gzip(\$text => \$body) or die "gzip failed\n";
+
+binmode STDOUT;
+print "Content-Type: text/plain\r\n";
+print "Content-Encoding: gzip\r\n\r\n";
+print $body;
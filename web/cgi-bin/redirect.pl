@@ -0,0 +1,5 @@
+#!/usr/bin/perl
+
+# redirect.pl -- redirects the client to the start page
+
+print "Location: /index.html\n\n";
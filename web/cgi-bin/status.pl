@@ -0,0 +1,10 @@
+#!/usr/bin/perl
+
+# status.pl -- sets its own status and the length of its output
+
+my $body = "There is nothing here.\n";
+
+print "Status: 404 Nothing Here\r\n";
+print "Content-Type: text/plain\r\n";
+print "Content-Length: ", length($body), "\r\n\r\n";
+print $body;